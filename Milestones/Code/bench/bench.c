@@ -0,0 +1,65 @@
+/**
+ * @file
+ * @brief This file implements the helpers shared by the benchmarks as
+ * declared in bench.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bench.h"
+#include "row.h"
+
+
+static const char* CITIES[] = {"toronto", "montreal", "ottawa", "calgary", "halifax", "regina", "victoria", "quebec"};
+
+
+uint64_t next_random(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int bench_insert(struct hash_table* table, const char* key, const char* value)
+{
+    char row[MAX_VALUE_LEN];
+
+    struct record* record = table_insert(table, key);
+    if(record == NULL || row_parse(table->schema, &table->layout, value, row) != 0
+            || table_set_value(table, record, row, table->layout.size) != 0)
+        return -1;
+
+    return 0;
+}
+
+
+int bench_load_people(struct hash_table* table, int rows)
+{
+    char key[MAX_KEY_LEN], value[MAX_VALUE_LEN];
+    uint64_t state = BENCH_SEED;
+    int i;
+
+    for(i = 0; i < rows; i++)
+    {
+        sprintf(key, "key%d", i);
+        sprintf(value, "id %d,age %d,score %d,name person%d,city %s", (int) (next_random(&state) % rows),
+                (int) (next_random(&state) % 100), (int) (next_random(&state) % 1000), (int) (next_random(&state) % 1000),
+                CITIES[next_random(&state) % (sizeof CITIES / sizeof CITIES[0])]);
+
+        if(bench_insert(table, key, value) != 0)
+            return -1;
+    }
+
+    return 0;
+}
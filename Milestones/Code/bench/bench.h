@@ -0,0 +1,53 @@
+/**
+ * @file
+ * @brief This file declares the helpers shared by the benchmarks, to draw
+ * random numbers, read the time and load rows.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include "table.h"
+
+#define BENCH_SEED 88172645463325252ull ///< Seed of the generator, so every run loads the same rows.
+
+
+/**
+ * @brief Returns the next number of a xorshift generator.
+ *
+ * @param state The generator state, seeded with BENCH_SEED.
+ * @return Returns the next number.
+ */
+uint64_t next_random(uint64_t* state);
+
+
+/**
+ * @brief Returns the current time in seconds.
+ */
+double now();
+
+
+/**
+ * @brief Inserts a record and sets its value from text.
+ *
+ * @param table A table with a schema.
+ * @param key The key of the record.
+ * @param value The value as text, parsed in the layout of the table.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int bench_insert(struct hash_table* table, const char* key, const char* value);
+
+
+/**
+ * @brief Loads random rows of people, keyed key0 to key<rows - 1>.
+ *
+ * The table has the columns id:int, age:int, score:int, name:char[16] and
+ * city:char[12].
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int bench_load_people(struct hash_table* table, int rows);
+
+
+#endif
@@ -0,0 +1,173 @@
+/**
+ * @file
+ * @brief This file benchmarks the dictionary encoding of the char[n]
+ * columns of tables stored by columns.
+ *
+ * Usage: dict_bench [rows]
+ *
+ * The same cities are loaded in a table stored by rows and in one stored
+ * by columns. The memory of each char[n] column is compared as its n bytes
+ * per row, as the column held before dictionaries, against its codes and
+ * dictionary, for a column of a dozen provinces and one of a distinct
+ * city per 4 rows. String predicates are then timed through query_scan(),
+ * comparing the strings of each row of the table stored by rows and the
+ * codes of the table stored by columns. Rates are in millions of rows per
+ * second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+#include "bench.h"
+
+#define DEFAULT_ROWS 1000000 ///< Rows loaded when not given.
+#define MIN_SCAN_TIME 0.5 ///< Seconds each query is repeated for.
+
+/**
+ * @brief Schemas of the benchmark tables, stored by rows then by columns.
+ */
+static const char* SCHEMA_LINES[] = {
+    "table rows city:char[24],province:char[16],pop:int",
+    "table cols city:char[24],province:char[16],pop:int layout=columns",
+};
+
+/**
+ * @brief Queries timed on both tables.
+ */
+static const char* QUERIES[] = {
+    "province = Ontario",
+    "province < Manitoba",
+    "province ^= N",
+    "city ^= Town12",
+    "city > Town5, pop < 500",
+};
+
+static const char* PROVINCES[] = {"Alberta", "BritishColumbia", "Manitoba", "NewBrunswick", "Newfoundland", "NovaScotia", "Nunavut",
+        "Ontario", "PEI", "Quebec", "Saskatchewan", "NWT", "Yukon"};
+
+
+/**
+ * @brief Loads cities of random provinces and names.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int load(struct hash_table* table, int rows)
+{
+    char key[MAX_KEY_LEN], value[MAX_VALUE_LEN];
+    uint64_t state = BENCH_SEED;
+    int i;
+
+    for(i = 0; i < rows; i++)
+    {
+        sprintf(key, "city%d", i);
+        sprintf(value, "city Town%d,province %s,pop %d", (int) (next_random(&state) % (rows / 4 + 1)),
+                PROVINCES[next_random(&state) % (sizeof PROVINCES / sizeof PROVINCES[0])], (int) (next_random(&state) % 1000));
+
+        if(bench_insert(table, key, value) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Repeats a query scan for MIN_SCAN_TIME seconds.
+ *
+ * @param matches Where the number of matching rows is stored.
+ * @return Returns the scan rate in millions of rows per second.
+ */
+double time_scan(struct hash_table* table, const struct predicate predicates[], int num_predicates, int* matches)
+{
+    char matched_keys[MAX_KEY_LEN + 2];
+    double start = now();
+    int runs;
+
+    for(runs = 0; runs == 0 || now() - start < MIN_SCAN_TIME; runs++)
+        *matches = query_scan(table, predicates, num_predicates, 0, matched_keys);
+
+    return (double) table->num_keys * runs / (now() - start) / 1e6;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct config_params params = {.server_port = -1, .concurrency = -1};
+    int rows = argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS;
+    struct hash_table* tables[sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]];
+    char line[MAX_CONFIG_LINE_LEN];
+    int t, q, i;
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+    {
+        strcpy(line, SCHEMA_LINES[t]);
+        if(rows <= 0 || process_config_line(line, &params) != 0)
+        {
+            fprintf(stderr, "Usage: %s [rows]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        if((tables[t] = table_create(&params.table_schemas[t])) == NULL || load(tables[t], rows) != 0)
+        {
+            fprintf(stderr, "Failed to load %d rows\n", rows);
+            return EXIT_FAILURE;
+        }
+
+    // Bytes are those allocated for every entry of the table, per record
+    struct hash_table* columns = tables[1];
+    double capacity = columns->entries_capacity;
+
+    printf("Memory of %d cities, in bytes per record\n\n", rows);
+    printf("%-12s %9s | %9s %9s %9s %9s\n", "column", "distinct", "char[n]", "codes", "dict", "saved");
+    for(i = 0; i < columns->schema->num_columns; i++)
+    {
+        const struct dictionary* dict = columns->columns->dictionaries[i];
+        double plain, codes;
+
+        if(dict == NULL)
+            continue;
+
+        plain = capacity * columns->schema->data_types[i] / rows;
+        codes = capacity * columns->columns->widths[i] / rows;
+        printf("%-12s %9d | %9.2f %9.2f %9.2f %8.1f%%\n", columns->schema->column_names[i], dict->num_values - dict->num_unused,
+                plain, codes, (double) dict_bytes(dict) / rows, 100.0 - 100.0 * (codes + (double) dict_bytes(dict) / rows) / plain);
+    }
+    printf("%-12s %9s | %9.2f %29.2f %8.1f%%\n", "all columns", "", capacity * columns->layout.size / rows,
+            (double) table_column_bytes(columns) / rows, 100.0 - 100.0 * table_column_bytes(columns) / (capacity * columns->layout.size));
+
+    printf("\nString predicates, in Mrows/s\n\n");
+    printf("%-28s %8s | %9s %9s %8s\n", "query", "matches", "strings", "codes", "speedup");
+
+    for(q = 0; q < sizeof QUERIES / sizeof QUERIES[0]; q++)
+    {
+        double rates[sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]];
+        int matches[sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]];
+
+        for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        {
+            struct predicate predicates[MAX_COLUMNS_PER_TABLE];
+            char text[MAX_CONFIG_LINE_LEN];
+            int num_predicates;
+
+            strcpy(text, QUERIES[q]);
+            num_predicates = query_parse(tables[t]->schema, &tables[t]->layout, text, predicates);
+            rates[t] = time_scan(tables[t], predicates, num_predicates, &matches[t]);
+        }
+
+        if(matches[0] != matches[1])
+        {
+            fprintf(stderr, "\nQuery \"%s\" matched %d rows compared as strings, %d as codes\n", QUERIES[q], matches[0], matches[1]);
+            return EXIT_FAILURE;
+        }
+
+        printf("%-28s %8d | %9.1f %9.1f %7.1fx\n", QUERIES[q], matches[0], rates[0], rates[1], rates[1] / rates[0]);
+    }
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        table_destroy(tables[t]);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file
+ * @brief This file benchmarks the memory used by the records of each table
+ * of a config file, against the original fixed size records.
+ *
+ * Usage: footprint_bench [config_file] [rows]
+ *
+ * Each table is filled with random rows matching its schema: ints are
+ * uniformly spread over six digits and strings take any length their
+ * char[n] type allows. The original records are malloc'd one at a time as
+ * the server used to, and their footprint includes the malloc chunk
+ * overhead. The current records hold binary rows, and their footprint is
+ * all the slab memory of the table, so it includes size class rounding and
+ * free space, plus the column arrays of a table stored by columns.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "table.h"
+#include "legacy.h"
+#include "bench.h"
+
+#define DEFAULT_CONFIG "../src/default.conf" ///< Config file read when none is given.
+#define DEFAULT_ROWS 100000 ///< Rows per table when not given.
+
+
+/**
+ * @brief Generates a random value matching a schema, as sent by a client.
+ */
+void random_value(const struct table_schema* schema, char* value, uint64_t* state)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    char* end = value;
+    int i, j;
+
+    for(i = 0; i < schema->num_columns; i++)
+    {
+        end += sprintf(end, "%s%s ", i == 0 ? "" : ",", schema->column_names[i]);
+
+        if(schema->data_types[i] == 0)
+            end += sprintf(end, "%d", (int) (next_random(state) % 1000000));
+        else
+        {
+            int length = 1 + next_random(state) % (schema->data_types[i] - 1);
+            for(j = 0; j < length; j++)
+                *end++ = alphabet[next_random(state) % (sizeof alphabet - 1)];
+            *end = 0;
+        }
+    }
+}
+
+
+/**
+ * @brief Fills a table and its legacy counterpart, then prints their footprints.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int measure(struct table_schema* schema, int rows)
+{
+    struct legacy_record** legacy = (struct legacy_record**) malloc(rows * sizeof(struct legacy_record*));
+    struct hash_table* table = table_create(schema);
+    char key[MAX_KEY_LEN], value[MAX_VALUE_LEN], row[MAX_VALUE_LEN];
+    uint64_t state = BENCH_SEED;
+    size_t legacy_bytes = 0, value_bytes = 0;
+    int i, inline_values = 0;
+    struct slab_stats stats;
+
+    if(legacy == NULL || table == NULL)
+        return -1;
+
+    for(i = 0; i < rows; i++)
+    {
+        sprintf(key, "key%d", i);
+        random_value(schema, value, &state);
+        value_bytes += strlen(value) + 1;
+
+        legacy[i] = (struct legacy_record*) calloc(1, sizeof(struct legacy_record));
+        struct record* record = table_insert(table, key);
+        if(legacy[i] == NULL || record == NULL || row_parse(schema, &table->layout, value, row) != 0
+                || table_set_value(table, record, row, table->layout.size) != 0)
+            return -1;
+
+        strcpy(legacy[i]->key, key);
+        strcpy(legacy[i]->value, value);
+        legacy_bytes += malloc_usable_size(legacy[i]) + sizeof(size_t);
+        inline_values += table->columns == NULL && record->value_len <= RECORD_INLINE_LEN;
+    }
+
+    slab_get_stats(&table->records, &stats);
+
+    printf("%-12s %8d %10.1f %10.1f %10.1f %9.1f%% %8.1f%%\n", schema->table_name, rows,
+            (double) value_bytes / rows, (double) legacy_bytes / rows, (double) (stats.slab_bytes + table_column_bytes(table)) / rows,
+            100.0 * inline_values / rows, 100.0 - 100.0 * (stats.slab_bytes + table_column_bytes(table)) / legacy_bytes);
+
+    for(i = 0; i < rows; i++)
+        free(legacy[i]);
+    free(legacy);
+    table_destroy(table);
+
+    return 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    const char* config_file = argc > 1 ? argv[1] : DEFAULT_CONFIG;
+    int rows = argc > 2 ? atoi(argv[2]) : DEFAULT_ROWS;
+    static struct config_params params = {.server_port = -1, .concurrency = -1};
+    int i;
+
+    if(rows <= 0 || read_config(config_file, &params) != 0)
+    {
+        fprintf(stderr, "Usage: %s [config_file] [rows]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("Bytes per record for %s: value is the average value length, original the\n"
+           "malloc'd fixed size records and current all slab and column memory of the table.\n\n", config_file);
+    printf("%-12s %8s %10s %10s %10s %10s %9s\n", "table", "rows", "value", "original", "current", "inline", "saved");
+
+    for(i = 0; i < params.num_tables; i++)
+        if(measure(&params.table_schemas[i], rows) != 0)
+        {
+            fprintf(stderr, "Failed to fill table %s\n", params.table_schemas[i].table_name);
+            return EXIT_FAILURE;
+        }
+
+    return EXIT_SUCCESS;
+}
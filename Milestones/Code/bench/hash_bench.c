@@ -0,0 +1,203 @@
+/**
+ * @file
+ * @brief This file benchmarks key lookups in a table against the original
+ * recursive hash() of the server.
+ *
+ * Usage: hash_bench <census data file>
+ *
+ * Both implementations are loaded with the census keys, then every key is
+ * looked up repeatedly (hits) along with a modified copy of every key
+ * (misses). The average time per lookup and the distribution of the number
+ * of probes per lookup are printed for each. The original table probes one
+ * slot at a time, the current one a group of GROUP_WIDTH slots.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "table.h"
+#include "hash.h"
+#include "legacy.h"
+
+#define ROUNDS 2000 ///< Times every key is looked up.
+#define MAX_PROBES 17 ///< Probe lengths from this value up share a histogram bucket.
+
+
+/**
+ * @brief Distribution of the number of slots probed per lookup.
+ */
+struct probe_stats {
+    long histogram[MAX_PROBES + 1];
+    long lookups;
+    long total;
+    int max;
+};
+
+
+/**
+ * @brief Reads the distinct keys of the census file the way the server does.
+ *
+ * @return Returns the number of keys read into keys.
+ */
+int read_keys(const char* data_file, char keys[][MAX_KEY_LEN], int max_keys)
+{
+    FILE* file = fopen(data_file, "r");
+    char key[MAX_CONFIG_LINE_LEN], value[MAX_CONFIG_LINE_LEN];
+    int i, num_keys = 0;
+    
+    if(file == NULL)
+        return 0;
+    
+    while(num_keys < max_keys && fscanf(file, "%[^,],%s", key, value) == 2)
+    {
+        make_key(key);
+        key[MAX_KEY_LEN - 1] = 0;
+        
+        for(i = 0; i < num_keys; i++)
+            if(strcmp(keys[i], key) == 0)
+                break;
+        if(i == num_keys && key[0] != 0)
+            strcpy(keys[num_keys++], key);
+    }
+    
+    fclose(file);
+    return num_keys;
+}
+
+
+double elapsed_ns(const struct timespec* start, const struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+
+void count_probes(struct probe_stats* stats, int probes)
+{
+    stats->histogram[probes < MAX_PROBES ? probes : MAX_PROBES]++;
+    stats->lookups++;
+    stats->total += probes;
+    if(probes > stats->max)
+        stats->max = probes;
+}
+
+
+void print_probes(const char* name, const struct probe_stats* stats)
+{
+    int i;
+    
+    printf("  %s probe lengths:", name);
+    for(i = 1; i <= MAX_PROBES; i++)
+        if(stats->histogram[i] > 0)
+            printf(" %d%s:%.1f%%", i, i == MAX_PROBES ? "+" : "", 100.0 * stats->histogram[i] / stats->lookups);
+    printf("\n  %s mean probes %.2f, max %d\n", name, (double) stats->total / stats->lookups, stats->max);
+}
+
+
+int main(int argc, char *argv[])
+{
+    static char keys[MAX_RECORDS_PER_TABLE][MAX_KEY_LEN];
+    static char missing[MAX_RECORDS_PER_TABLE][MAX_KEY_LEN];
+    struct probe_stats hit_probes = {{0}}, miss_probes = {{0}};
+    struct timespec start, end;
+    struct table_schema schema = {.table_name = "census", .num_columns = 0};
+    volatile long found = 0;
+    int i, round, probes;
+    
+    if(argc != 2)
+    {
+        printf("Usage %s <census data file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    int num_keys = read_keys(argv[1], keys, MAX_RECORDS_PER_TABLE);
+    if(num_keys == 0)
+        die("Error reading census keys", EXIT_FAILURE);
+    
+    // Misses share a prefix with the keys, like in a real workload
+    for(i = 0; i < num_keys; i++)
+        snprintf(missing[i], MAX_KEY_LEN, "%.17sZ", keys[i]);
+    
+    printf("%d census keys, %d lookups per measurement\n\n", num_keys, num_keys * ROUNDS);
+    
+    // Original recursive hash over the fixed table
+    for(i = 0; i < num_keys; i++)
+    {
+        probes = 0;
+        legacy_slots[legacy_hash(keys[i], 0, &probes)] = keys[i];
+    }
+    
+    for(i = 0; i < num_keys; i++)
+    {
+        probes = 0;
+        legacy_hash(keys[i], 0, &probes);
+        count_probes(&hit_probes, probes);
+        probes = 0;
+        legacy_hash(missing[i], 0, &probes);
+        count_probes(&miss_probes, probes);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(round = 0; round < ROUNDS; round++)
+        for(i = 0; i < num_keys; i++)
+            found += legacy_slots[legacy_hash(keys[i], 0, &probes)] != NULL;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double legacy_hit = elapsed_ns(&start, &end) / ((double) num_keys * ROUNDS);
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(round = 0; round < ROUNDS; round++)
+        for(i = 0; i < num_keys; i++)
+            found += legacy_slots[legacy_hash(missing[i], 0, &probes)] != NULL;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double legacy_miss = elapsed_ns(&start, &end) / ((double) num_keys * ROUNDS);
+    
+    printf("original hash(), %d fixed slots\n", MAX_RECORDS_PER_TABLE);
+    printf("  hit  %8.1f ns/op\n  miss %8.1f ns/op\n", legacy_hit, legacy_miss);
+    print_probes("hit", &hit_probes);
+    print_probes("miss", &miss_probes);
+    
+    // Seeded hash with cached key hashes in a growable table
+    hash_seed_init();
+    struct hash_table* table = table_create(&schema);
+    for(i = 0; i < num_keys; i++)
+        table_insert(table, keys[i]);
+    
+    // Let the last resize finish before measuring
+    for(i = 0; i < num_keys; i++)
+        table_find(table, keys[i]);
+    
+    memset(&hit_probes, 0, sizeof hit_probes);
+    memset(&miss_probes, 0, sizeof miss_probes);
+    for(i = 0; i < num_keys; i++)
+    {
+        unsigned long long before = table->probes;
+        table_find(table, keys[i]);
+        count_probes(&hit_probes, table->probes - before);
+        before = table->probes;
+        table_find(table, missing[i]);
+        count_probes(&miss_probes, table->probes - before);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(round = 0; round < ROUNDS; round++)
+        for(i = 0; i < num_keys; i++)
+            found += table_find(table, keys[i]) != NULL;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double table_hit = elapsed_ns(&start, &end) / ((double) num_keys * ROUNDS);
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(round = 0; round < ROUNDS; round++)
+        for(i = 0; i < num_keys; i++)
+            found += table_find(table, missing[i]) != NULL;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double table_miss = elapsed_ns(&start, &end) / ((double) num_keys * ROUNDS);
+    
+    printf("\nSipHash-1-3 table_find(), %d slots in groups of %d\n", table->arrays[0].capacity, GROUP_WIDTH);
+    printf("  hit  %8.1f ns/op\n  miss %8.1f ns/op\n", table_hit, table_miss);
+    print_probes("hit", &hit_probes);
+    print_probes("miss", &miss_probes);
+    
+    table_destroy(table);
+    
+    return found > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
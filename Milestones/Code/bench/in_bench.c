@@ -0,0 +1,190 @@
+/**
+ * @file
+ * @brief This file benchmarks IN lists against one query per value.
+ *
+ * Usage: in_bench [rows]
+ *
+ * The same cities, each of one of REGIONS regions and with a random zip
+ * code, are loaded in a table stored by rows and one stored by columns.
+ * Each query asks for the cities of a number of regions or zip codes, as
+ * one predicate whose values are probed in a hash set, and as a client
+ * without IN lists would, one equality query per value. Times are in
+ * milliseconds per query, the queries per value being summed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+#include "bench.h"
+
+#define DEFAULT_ROWS 1000000 ///< Rows loaded when not given.
+#define REGIONS 1000 ///< Distinct regions of the cities.
+#define MIN_QUERY_TIME 0.5 ///< Seconds each query is repeated for.
+
+/**
+ * @brief Schemas of the benchmark tables.
+ */
+static const char* SCHEMA_LINES[] = {
+    "table rows region:char[12],zip:int,pop:int",
+    "table cols region:char[12],zip:int,pop:int layout=columns",
+};
+
+/**
+ * @brief Queries timed on every table, each listing the first values of a column joined by a separator.
+ */
+static const struct {
+    const char* column;
+    int num_values;
+    bool alternatives; ///< Whether the values are equalities joined by " OR " rather than an IN list.
+} QUERIES[] = {
+    {"region", 10, false},
+    {"region", 200, false},
+    {"region", 10, true},
+    {"zip", 10, false},
+    {"zip", 200, false},
+};
+
+
+/**
+ * @brief Loads cities of random regions and zip codes, the zip codes being in [0, rows).
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int load(struct hash_table* table, int rows)
+{
+    char key[MAX_KEY_LEN], value[MAX_VALUE_LEN];
+    uint64_t state = BENCH_SEED;
+    int i;
+
+    for(i = 0; i < rows; i++)
+    {
+        sprintf(key, "city%d", i);
+        sprintf(value, "region R%d,zip %d,pop %d", (int) (next_random(&state) % REGIONS), (int) (next_random(&state) % rows),
+                (int) (next_random(&state) % 1000));
+
+        if(bench_insert(table, key, value) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Writes value i of a query, the i-th region or a zip code spread over the rows.
+ */
+void write_value(char* text, const char* column, int i, int rows)
+{
+    if(strcmp(column, "region") == 0)
+        sprintf(text, "R%d", i);
+    else
+        sprintf(text, "%d", (int) ((long long) i * rows / 200));
+}
+
+
+/**
+ * @brief Repeats queries for MIN_QUERY_TIME seconds, each set of predicates being scanned in turn.
+ *
+ * @param texts The predicates of each query.
+ * @param matches Where the matching rows of all the queries are stored.
+ * @return Returns the time of one run of all the queries in milliseconds, or -1 if a query is invalid.
+ */
+double time_queries(struct hash_table* table, char* texts[], int num_texts, int* matches)
+{
+    struct predicate predicates[num_texts][MAX_COLUMNS_PER_TABLE];
+    int num_predicates[num_texts];
+    char matched_keys[MAX_KEY_LEN + 2];
+    char text[MAX_CMD_LEN];
+    double start;
+    int runs, i;
+
+    *matches = 0;
+    for(i = 0; i < num_texts; i++)
+    {
+        strcpy(text, texts[i]);
+        if((num_predicates[i] = query_parse(table->schema, &table->layout, text, predicates[i])) < 0)
+            return -1;
+    }
+
+    for(runs = 0, start = now(); runs == 0 || now() - start < MIN_QUERY_TIME; runs++)
+        for(i = 0, *matches = 0; i < num_texts; i++)
+            *matches += query_scan(table, predicates[i], num_predicates[i], 0, matched_keys);
+
+    for(i = 0; i < num_texts; i++)
+        query_release(predicates[i], num_predicates[i]);
+
+    return (now() - start) / runs * 1e3;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct config_params params = {.server_port = -1, .concurrency = -1};
+    static char list[MAX_CMD_LEN], equalities[200][MAX_CONFIG_LINE_LEN];
+    int rows = argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS;
+    struct hash_table* tables[sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]];
+    char line[MAX_CONFIG_LINE_LEN], value[MAX_VALUE_LEN], name[MAX_CONFIG_LINE_LEN];
+    char* texts[200];
+    int t, q, i;
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+    {
+        strcpy(line, SCHEMA_LINES[t]);
+        if(rows <= 0 || process_config_line(line, &params) != 0)
+        {
+            fprintf(stderr, "Usage: %s [rows]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        if((tables[t] = table_create(&params.table_schemas[t])) == NULL || load(tables[t], rows) != 0)
+        {
+            fprintf(stderr, "Failed to load %d rows\n", rows);
+            return EXIT_FAILURE;
+        }
+
+    printf("Cities of a list of values out of %d, in ms per query\n\n", rows);
+    printf("%-24s %-6s %8s | %9s %9s %8s\n", "query", "table", "matches", "per value", "list", "speedup");
+
+    for(q = 0; q < sizeof QUERIES / sizeof QUERIES[0]; q++)
+    {
+        // The list, "region IN (R0, R1, ...)" or "region = R0 OR region = R1 ...", and the equalities it replaces
+        sprintf(list, QUERIES[q].alternatives ? "" : "%s IN (", QUERIES[q].column);
+        for(i = 0; i < QUERIES[q].num_values; i++)
+        {
+            write_value(value, QUERIES[q].column, i, rows);
+            sprintf(equalities[i], "%s = %s", QUERIES[q].column, value);
+            texts[i] = equalities[i];
+            if(QUERIES[q].alternatives)
+                sprintf(list + strlen(list), "%s%s", i == 0 ? "" : " OR ", equalities[i]);
+            else
+                sprintf(list + strlen(list), "%s%s", i == 0 ? "" : ", ", value);
+        }
+        strcat(list, QUERIES[q].alternatives ? "" : ")");
+        sprintf(name, "%s %d %s", QUERIES[q].column, QUERIES[q].num_values, QUERIES[q].alternatives ? "OR" : "IN");
+
+        for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        {
+            char* list_text = list;
+            int value_matches, list_matches;
+            double value_time = time_queries(tables[t], texts, QUERIES[q].num_values, &value_matches);
+            double list_time = time_queries(tables[t], &list_text, 1, &list_matches);
+
+            if(value_time < 0 || list_time < 0 || value_matches != list_matches)
+            {
+                fprintf(stderr, "\nQuery \"%s\" matched %d rows by value, %d as a list\n", name, value_matches, list_matches);
+                return EXIT_FAILURE;
+            }
+
+            printf("%-24s %-6s %8d | %9.3f %9.3f %7.1fx\n", name, params.table_schemas[t].table_name, list_matches, value_time,
+                    list_time, value_time / list_time);
+        }
+    }
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        table_destroy(tables[t]);
+
+    return EXIT_SUCCESS;
+}
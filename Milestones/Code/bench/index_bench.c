@@ -0,0 +1,173 @@
+/**
+ * @file
+ * @brief This file benchmarks queries driven by column indexes against
+ * full scans of the same table.
+ *
+ * Usage: index_bench [rows ...]
+ *
+ * For each number of rows, a table stored by rows with its id and score
+ * int columns and its name string column indexed is loaded with random
+ * rows. Each query is timed through query_scan(), which ignores the
+ * indexes, and through query_run(), which lets query_plan() pick the most
+ * selective index or fall back to a scan.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+#include "bench.h"
+
+#define MIN_QUERY_TIME 0.5 ///< Seconds each query is repeated for.
+
+/**
+ * @brief Schema of the benchmark table.
+ */
+static const char* SCHEMA_LINE = "table people id:int,age:int,score:int,name:char[8] index=id index=score index=name";
+
+/**
+ * @brief Rows loaded when not given.
+ */
+static const int DEFAULT_ROWS[] = {10000, 1000000, 10000000};
+
+/**
+ * @brief Queries timed on every table, from a single match to half the table.
+ */
+static const char* QUERIES[] = {
+    "id = 4242",
+    "age > 90, id < 1000",
+    "score > 990",
+    "score < 5, age > 50",
+    "score > 500",
+    "name = n42",
+    "name = n42, score > 500",
+    "score < 20, id < 30000",
+    "name = n42, age > 90",
+};
+
+
+/**
+ * @brief Loads random rows whose ids are spread over as many values as there are rows.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int load(struct hash_table* table, int rows)
+{
+    char key[MAX_KEY_LEN], value[MAX_VALUE_LEN];
+    uint64_t state = BENCH_SEED;
+    int i;
+
+    for(i = 0; i < rows; i++)
+    {
+        sprintf(key, "key%d", i);
+        sprintf(value, "id %d,age %d,score %d,name n%d", (int) (next_random(&state) % rows),
+                (int) (next_random(&state) % 100), (int) (next_random(&state) % 1000), i % 1000);
+
+        if(bench_insert(table, key, value) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Repeats a query for MIN_QUERY_TIME seconds.
+ *
+ * @param indexed Whether the query may use the indexes.
+ * @param matches Where the number of matching rows is stored.
+ * @return Returns the average time of a query in microseconds.
+ */
+double time_query(struct hash_table* table, const struct predicate predicates[], int num_predicates, bool indexed, int* matches)
+{
+    char matched_keys[MAX_KEY_LEN + 2];
+    double start = now();
+    int runs;
+
+    for(runs = 0; runs == 0 || now() - start < MIN_QUERY_TIME; runs++)
+        *matches = indexed ? query_run(table, predicates, num_predicates, 0, matched_keys)
+                : query_scan(table, predicates, num_predicates, 0, matched_keys);
+
+    return (now() - start) / runs * 1e6;
+}
+
+
+/**
+ * @brief Loads a table and times every query with and without its indexes.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int measure(struct table_schema* schema, int rows)
+{
+    struct hash_table* table = table_create(schema);
+    double start = now();
+    int q;
+
+    if(table == NULL || load(table, rows) != 0)
+    {
+        fprintf(stderr, "Failed to load %d rows\n", rows);
+        return -1;
+    }
+
+    printf("%d rows loaded in %.2f s, indexes of %.1f bytes per row\n\n", rows, now() - start, (double) table_index_bytes(table) / rows);
+    printf("%-24s %8s %8s %12s %12s %9s\n", "query", "matches", "plan", "scan us", "query us", "speedup");
+
+    for(q = 0; q < sizeof QUERIES / sizeof QUERIES[0]; q++)
+    {
+        struct predicate predicates[MAX_COLUMNS_PER_TABLE];
+        struct query_plan chosen;
+        char text[MAX_CONFIG_LINE_LEN], plan[MAX_COLNAME_LEN];
+        int num_predicates, scan_matches, matches;
+        double scan_time, query_time;
+
+        strcpy(text, QUERIES[q]);
+        num_predicates = query_parse(schema, &table->layout, text, predicates);
+        query_plan(table, predicates, num_predicates, &chosen);
+        strcpy(plan, chosen.driver < 0 ? "scan" : schema->column_names[chosen.predicate_arr[chosen.driver].column_id]);
+
+        scan_time = time_query(table, predicates, num_predicates, false, &scan_matches);
+        query_time = time_query(table, predicates, num_predicates, true, &matches);
+
+        if(matches != scan_matches)
+        {
+            fprintf(stderr, "Query \"%s\" matched %d rows, %d by a scan\n", QUERIES[q], matches, scan_matches);
+            return -1;
+        }
+
+        printf("%-24s %8d %8s %12.1f %12.1f %8.1fx\n", QUERIES[q], matches, plan, scan_time, query_time, scan_time / query_time);
+    }
+
+    printf("\n");
+    table_destroy(table);
+
+    return 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct config_params params = {.server_port = -1, .concurrency = -1};
+    char line[MAX_CONFIG_LINE_LEN];
+    int i, rows;
+
+    strcpy(line, SCHEMA_LINE);
+    if(process_config_line(line, &params) != 0)
+        return EXIT_FAILURE;
+
+    printf("Queries over \"%s\", indexed or scanned\n\n", SCHEMA_LINE + strlen("table "));
+
+    for(i = 0; i < (argc > 1 ? argc - 1 : sizeof DEFAULT_ROWS / sizeof DEFAULT_ROWS[0]); i++)
+    {
+        rows = argc > 1 ? atoi(argv[i + 1]) : DEFAULT_ROWS[i];
+        if(rows <= 0)
+        {
+            fprintf(stderr, "Usage: %s [rows ...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        if(measure(&params.table_schemas[0], rows) != 0)
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @brief This file implements the original key hashing of the server as
+ * declared in legacy.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "legacy.h"
+
+
+char* legacy_slots[MAX_RECORDS_PER_TABLE];
+
+
+int legacy_hash(char* hash_string, int collisions, int* probes)
+{
+    int i;
+    int hashed_index = 0;
+    
+    for(i = 0; i < strlen(hash_string); i++)
+        hashed_index += hash_string[i] * (strlen(hash_string) - i - 1);
+    
+    hashed_index = (hashed_index + collisions) % MAX_RECORDS_PER_TABLE;
+    (*probes)++;
+    
+    if(legacy_slots[hashed_index] != NULL && strcmp(legacy_slots[hashed_index], hash_string) != 0)
+        return legacy_hash(hash_string, collisions + 1, probes);
+    
+    return hashed_index;
+}
+
+
+int legacy_run_predicates(struct hash_table* table, const struct legacy_predicate predicate_arr[], const int num_predicates,
+        const int max_keys, char* matched_keys)
+{
+    // Temp array of all values indexed by column id
+    char values[table->schema->num_columns][MAX_VALUE_LEN];
+    memset(values, 0, sizeof values);
+    
+    char buf[MAX_VALUE_LEN] = {0};
+    char column_name[MAX_COLNAME_LEN] = {0};
+    int num_matched_keys = 0;
+    
+    struct table_iterator iterator;
+    struct record* record; // Going through all the exisiting records
+    table_iterator_init(&iterator);
+    while((record = table_next(table, &iterator)) != NULL)
+    {
+        // Make copy of the value of the current record
+        strcpy(buf, record_value(record));
+        
+        int column_id = 0; // Counter going though all columns in predicate array and values array
+        char* cur_column = strtok(buf, ",");
+        // Loop though all the values and store them in values array
+        while(cur_column != NULL && column_id < table->schema->num_columns)
+        {
+            sscanf(cur_column, "%s %[^,]", column_name, values[column_id]);
+            cur_column = strtok(NULL, ",");
+            column_id++;
+        } // Finished populating values array
+        
+        int p_index; // Counter going through all the predicates
+        bool matched = true; // Flag to find if value matches predicate
+        
+        // Break loop if any value fails to satisfy predicate for that column
+        for(p_index = 0; p_index < num_predicates && matched == true; p_index++)
+        {
+            if(table->schema->data_types[predicate_arr[p_index].column_id] == 0) // Integer data type predicate
+            {
+                switch(predicate_arr[p_index].operator) // Three types of comparison for integers
+                {
+                    case '<':
+                        matched = (atoi(values[predicate_arr[p_index].column_id]) < atoi(predicate_arr[p_index].argument));
+                        break;
+                        
+                    case '>':
+                        matched = (atoi(values[predicate_arr[p_index].column_id]) > atoi(predicate_arr[p_index].argument));
+                        break;
+                        
+                    case '=':
+                        matched = (atoi(values[predicate_arr[p_index].column_id]) == atoi(predicate_arr[p_index].argument));
+                        break;
+                }
+            }
+            else // String data type predicate
+                matched = (strcmp(values[predicate_arr[p_index].column_id], predicate_arr[p_index].argument) == 0);
+        } // Loop of predicates comparison. Finished matching current value against predicates
+        
+        if(matched == true) // No mismatching predicates
+        {
+            if(num_matched_keys < max_keys)
+            {
+                if(matched_keys[0] == 0) // Adding first matched key
+                    sprintf(matched_keys, "%s", record->key);
+                else
+                    sprintf(matched_keys + strlen(matched_keys), ", %s", record->key);
+            }
+            
+            num_matched_keys++;
+        } // Finished populating matched keys with current key if matched
+        
+    } // Loop of records in table
+    
+    return num_matched_keys;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file
+ * @brief This file declares the original key hashing of the server, kept
+ * as a baseline for the benchmarks.
+ */
+
+#ifndef LEGACY_H
+#define LEGACY_H
+
+#include "storage.h"
+#include "table.h"
+
+
+/**
+ * @brief The original record layout, with fixed size value and metadata arrays.
+ */
+struct legacy_record {
+    char key[MAX_KEY_LEN];
+    char value[MAX_VALUE_LEN];
+    uintptr_t metadata[8];
+};
+
+
+/**
+ * @brief The original predicate, with its argument kept as text.
+ */
+struct legacy_predicate {
+    int column_id;
+    char operator;
+    char argument[MAX_VALUE_LEN];
+};
+
+
+/**
+ * @brief Slots of the original fixed size table, holding only keys.
+ */
+extern char* legacy_slots[MAX_RECORDS_PER_TABLE];
+
+
+/**
+ * @brief The original key hash, recursing on every collision.
+ *
+ * @param hash_string The key to hash.
+ * @param collisions Number of collisions so far, 0 on the first call.
+ * @param probes Incremented for every slot visited.
+ * @return Returns the slot holding the key or the empty slot where it belongs.
+ */
+int legacy_hash(char* hash_string, int collisions, int* probes);
+
+
+/**
+ * @brief The original query scan, tokenizing the text value of every record.
+ *
+ * @param table A table whose record values are null terminated text values.
+ * @param predicate_arr Array containing all predicates.
+ * @param num_predicates Number of predicates to match values with.
+ * @param max_keys Maximum number of keys written to matched_keys.
+ * @param matched_keys All keys that match every predicate.
+ * @return Returns the number of matching records.
+ */
+int legacy_run_predicates(struct hash_table* table, const struct legacy_predicate predicate_arr[], const int num_predicates,
+        const int max_keys, char* matched_keys);
+
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * @file
+ * @brief This file benchmarks hit and miss lookup throughput of a table
+ * against the original hash() based table of the server.
+ *
+ * Usage: lookup_bench
+ *
+ * Random alphanumeric keys are loaded into both tables at increasing sizes
+ * up to the 1000 slots of the original table, then into the current table
+ * alone at sizes the original could not hold.
+ *
+ * A collision-heavy key set is measured as well: keys of the longest
+ * length sharing all but their last COLLIDING_CHARS characters. The
+ * original hash() weighs the last characters the least, so these keys
+ * pile up in a few probe chains, while the table must compare every byte
+ * of a key to tell it from its neighbours.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "table.h"
+#include "hash.h"
+#include "legacy.h"
+
+#define LOOKUPS 2000000 ///< Lookups per measurement.
+#define MIN_KEY_LEN 4 ///< Shortest generated key.
+#define COLLIDING_CHARS 4 ///< Characters telling apart the keys of the collision-heavy set.
+
+static const char ALPHABET[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+
+/**
+ * @brief Generates a random alphanumeric key from a xorshift state.
+ */
+void random_key(char* key, uint64_t* state)
+{
+    int i, length;
+    
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    length = MIN_KEY_LEN + *state % (MAX_KEY_LEN - MIN_KEY_LEN);
+    
+    for(i = 0; i < length; i++)
+    {
+        *state ^= *state << 13;
+        *state ^= *state >> 7;
+        *state ^= *state << 17;
+        key[i] = ALPHABET[*state % (sizeof ALPHABET - 1)];
+    }
+    key[i] = 0;
+}
+
+
+/**
+ * @brief Generates the key number n of the collision-heavy set.
+ *
+ * Keys are MAX_KEY_LEN - 1 characters long, and only differ in their last
+ * COLLIDING_CHARS characters, which spell n in base 62.
+ */
+void colliding_key(char* key, int n)
+{
+    int i, length = MAX_KEY_LEN - 1;
+
+    memset(key, 'k', length - COLLIDING_CHARS);
+    for(i = length - 1; i >= length - COLLIDING_CHARS; i--)
+    {
+        key[i] = ALPHABET[n % (sizeof ALPHABET - 1)];
+        n /= sizeof ALPHABET - 1;
+    }
+    key[length] = 0;
+}
+
+
+/**
+ * @brief Finishes any resize of a table, then loads the same keys in the original table if they fit.
+ */
+void prepare(struct hash_table* table, char (*keys)[MAX_KEY_LEN], int num_keys)
+{
+    int i, probes;
+
+    // Let the last resize finish before measuring
+    for(i = 0; i < num_keys; i++)
+        table_find(table, keys[i]);
+
+    if(num_keys <= MAX_RECORDS_PER_TABLE)
+    {
+        memset(legacy_slots, 0, sizeof legacy_slots);
+        for(i = 0; i < num_keys; i++)
+            legacy_slots[legacy_hash(keys[i], 0, &probes)] = keys[i];
+    }
+}
+
+
+double elapsed_ns(const struct timespec* start, const struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+
+/**
+ * @brief Measures lookups of keys in the original table.
+ *
+ * @return Returns millions of lookups per second.
+ */
+double legacy_throughput(char (*keys)[MAX_KEY_LEN], int num_keys, volatile long* found)
+{
+    struct timespec start, end;
+    int i, probes;
+    long done;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(done = 0, i = 0; done < LOOKUPS; done++, i = (i + 1 == num_keys) ? 0 : i + 1)
+        *found += legacy_slots[legacy_hash(keys[i], 0, &probes)] != NULL;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    return LOOKUPS * 1e3 / elapsed_ns(&start, &end);
+}
+
+
+/**
+ * @brief Measures lookups of keys in a table.
+ *
+ * @return Returns millions of lookups per second.
+ */
+double table_throughput(struct hash_table* table, char (*keys)[MAX_KEY_LEN], int num_keys, volatile long* found)
+{
+    struct timespec start, end;
+    long done;
+    int i;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(done = 0, i = 0; done < LOOKUPS; done++, i = (i + 1 == num_keys) ? 0 : i + 1)
+        *found += table_find(table, keys[i]) != NULL;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    return LOOKUPS * 1e3 / elapsed_ns(&start, &end);
+}
+
+
+int main(int argc, char *argv[])
+{
+    static const int sizes[] = {250, 500, 750, 900, 990, 10000, 100000};
+    struct table_schema schema = {.table_name = "bench", .num_columns = 0};
+    volatile long found = 0;
+    int i, size;
+    
+    hash_seed_init();
+    
+    printf("Million lookups per second (%d lookups per measurement)\n\n", LOOKUPS);
+    printf("%8s  %14s %14s %14s  %14s %14s %14s\n", "keys", "original hit", "original miss", "original coll",
+            "table hit", "table miss", "table coll");
+    
+    for(size = 0; size < sizeof sizes / sizeof sizes[0]; size++)
+    {
+        int num_keys = sizes[size];
+        char (*keys)[MAX_KEY_LEN] = malloc(num_keys * sizeof *keys);
+        char (*missing)[MAX_KEY_LEN] = malloc(num_keys * sizeof *missing);
+        char (*colliding)[MAX_KEY_LEN] = malloc(num_keys * sizeof *colliding);
+        struct hash_table* table = table_create(&schema);
+        struct hash_table* colliding_table = table_create(&schema);
+        uint64_t state = 88172645463325252ULL;
+        double rates[6];
+        
+        // Distinct keys, and as many others sure to be absent
+        for(i = 0; i < num_keys; i++)
+        {
+            do
+                random_key(keys[i], &state);
+            while(table_find(table, keys[i]) != NULL);
+            table_insert(table, keys[i]);
+        }
+        for(i = 0; i < num_keys; i++)
+            do
+                random_key(missing[i], &state);
+            while(table_find(table, missing[i]) != NULL);
+        for(i = 0; i < num_keys; i++)
+        {
+            colliding_key(colliding[i], i);
+            table_insert(colliding_table, colliding[i]);
+        }
+        
+        // The original table is refilled for each key set
+        prepare(colliding_table, colliding, num_keys);
+        if(num_keys <= MAX_RECORDS_PER_TABLE)
+            rates[2] = legacy_throughput(colliding, num_keys, &found);
+        rates[5] = table_throughput(colliding_table, colliding, num_keys, &found);
+        
+        prepare(table, keys, num_keys);
+        if(num_keys <= MAX_RECORDS_PER_TABLE)
+        {
+            rates[0] = legacy_throughput(keys, num_keys, &found);
+            rates[1] = legacy_throughput(missing, num_keys, &found);
+        }
+        rates[3] = table_throughput(table, keys, num_keys, &found);
+        rates[4] = table_throughput(table, missing, num_keys, &found);
+        
+        printf("%8d  ", num_keys);
+        if(num_keys <= MAX_RECORDS_PER_TABLE)
+            printf("%14.1f %14.1f %14.1f  ", rates[0], rates[1], rates[2]);
+        else
+            printf("%14s %14s %14s  ", "-", "-", "-");
+        printf("%14.1f %14.1f %14.1f\n", rates[3], rates[4], rates[5]);
+        
+        table_destroy(table);
+        table_destroy(colliding_table);
+        free(keys);
+        free(missing);
+        free(colliding);
+    }
+    
+    return found > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file
+ * @brief This file benchmarks the top-k queries of query_top() against
+ * sorting every match.
+ *
+ * Usage: order_bench [rows]
+ *
+ * The same cars, with random prices, are loaded in tables stored by rows
+ * and by columns, with and without an index on the price. Each query
+ * lists the 10 first cars in the order of their price, through
+ * query_top(), and as a client ordering the result of storage_query()
+ * would: every matching record gathered with its price, then sorted.
+ * Times are in milliseconds per query.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+#include "bench.h"
+
+#define DEFAULT_ROWS 1000000 ///< Rows loaded when not given.
+#define TOP_KEYS 10 ///< Keys listed by each query.
+#define MIN_QUERY_TIME 0.5 ///< Seconds each query is repeated for.
+
+/**
+ * @brief Schemas of the benchmark tables.
+ */
+static const char* SCHEMA_LINES[] = {
+    "table rowsplain price:int,brand:char[8]",
+    "table rowsindexed price:int,brand:char[8] index=price",
+    "table colsplain price:int,brand:char[8] layout=columns",
+    "table colsindexed price:int,brand:char[8] layout=columns index=price",
+};
+
+/**
+ * @brief Queries timed on every table, prices being in [0, rows).
+ */
+static const struct {
+    const char* predicates;
+    bool descending;
+} QUERIES[] = {
+    {"", false},
+    {"", true},
+    {"brand = fiat", false},
+    {"price > %d", true},
+};
+
+static const char* BRANDS[] = {"opel", "audi", "fiat", "bmw"};
+
+
+/**
+ * @brief A matching record and its price, as sorted by the client.
+ */
+struct priced_row {
+    int32_t price;
+    int row;
+};
+
+
+/**
+ * @brief Loads cars of random prices and brands.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int load(struct hash_table* table, int rows)
+{
+    char key[MAX_KEY_LEN], value[MAX_VALUE_LEN];
+    uint64_t state = BENCH_SEED;
+    int i;
+
+    for(i = 0; i < rows; i++)
+    {
+        sprintf(key, "car%d", i);
+        sprintf(value, "price %d,brand %s", (int) (next_random(&state) % rows), BRANDS[next_random(&state) % 4]);
+
+        if(bench_insert(table, key, value) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Orders matching records by price for qsort.
+ */
+int compare_prices(const void* a, const void* b)
+{
+    const struct priced_row* x = (const struct priced_row*) a;
+    const struct priced_row* y = (const struct priced_row*) b;
+    return x->price != y->price ? (x->price < y->price ? -1 : 1) : x->row - y->row;
+}
+
+
+/**
+ * @brief Gathers every matching record with its price and sorts them, keeping the first TOP_KEYS keys.
+ *
+ * @return Returns the number of keys kept, or -1 if out of memory.
+ */
+int sort_matches(struct hash_table* table, const struct predicate predicates[], int num_predicates, bool descending, char* matched_keys)
+{
+    struct priced_row* matches = (struct priced_row*) malloc((table->num_keys > 0 ? table->num_keys : 1) * sizeof(struct priced_row));
+    char buf[MAX_VALUE_LEN];
+    char* end = matched_keys;
+    int num_matches = 0, i, entry;
+
+    if(matches == NULL)
+        return -1;
+
+    for(entry = 0; entry < table->num_entries; entry++)
+    {
+        const char* row;
+
+        if(table->entries[entry].record == NULL)
+            continue;
+        row = table_get_row(table, table->entries[entry].record, buf);
+        if(query_match(predicates, num_predicates, row))
+        {
+            matches[num_matches].price = descending ? -row_int(&table->layout, row, 0) : row_int(&table->layout, row, 0);
+            matches[num_matches++].row = entry;
+        }
+    }
+
+    qsort(matches, num_matches, sizeof matches[0], compare_prices);
+    for(i = 0; i < num_matches && i < TOP_KEYS; i++)
+        end += sprintf(end, i == 0 ? "%s" : ", %s", table->entries[matches[i].row].record->key);
+    free(matches);
+
+    return i;
+}
+
+
+/**
+ * @brief Repeats a query for MIN_QUERY_TIME seconds.
+ *
+ * @param sorted Whether every match is sorted, rather than run through query_top().
+ * @param found Where the number of keys listed is stored.
+ * @return Returns the time of one query in milliseconds.
+ */
+double time_query(struct hash_table* table, const struct predicate predicates[], int num_predicates, bool descending, bool sorted,
+        int* found)
+{
+    char matched_keys[TOP_KEYS * (MAX_KEY_LEN + 2)];
+    double start = now();
+    int runs;
+
+    for(runs = 0; runs == 0 || now() - start < MIN_QUERY_TIME; runs++)
+        *found = sorted ? sort_matches(table, predicates, num_predicates, descending, matched_keys)
+                : query_top(table, predicates, num_predicates, 0, descending, TOP_KEYS, matched_keys);
+
+    return (now() - start) / runs * 1e3;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct config_params params = {.server_port = -1, .concurrency = -1};
+    int rows = argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS;
+    struct hash_table* tables[sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]];
+    char line[MAX_CONFIG_LINE_LEN];
+    int t, q;
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+    {
+        strcpy(line, SCHEMA_LINES[t]);
+        if(rows <= 0 || process_config_line(line, &params) != 0)
+        {
+            fprintf(stderr, "Usage: %s [rows]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        if((tables[t] = table_create(&params.table_schemas[t])) == NULL || load(tables[t], rows) != 0)
+        {
+            fprintf(stderr, "Failed to load %d rows\n", rows);
+            return EXIT_FAILURE;
+        }
+
+    printf("First %d of %d cars by price, in ms per query\n\n", TOP_KEYS, rows);
+    printf("%-24s %-12s | %8s %8s %8s\n", "query", "table", "sorted", "top-k", "speedup");
+
+    for(q = 0; q < sizeof QUERIES / sizeof QUERIES[0]; q++)
+        for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        {
+            struct predicate predicates[MAX_COLUMNS_PER_TABLE];
+            char text[MAX_CONFIG_LINE_LEN], query[MAX_CONFIG_LINE_LEN + 8];
+            int num_predicates, sorted_found, top_found;
+            double sorted_time, top_time;
+
+            sprintf(text, QUERIES[q].predicates, rows - rows / 100);
+            sprintf(query, "%s%s%s", text, *text != 0 ? " " : "", QUERIES[q].descending ? "DESC" : "ASC");
+            num_predicates = query_parse(tables[t]->schema, &tables[t]->layout, text, predicates);
+
+            sorted_time = time_query(tables[t], predicates, num_predicates, QUERIES[q].descending, true, &sorted_found);
+            top_time = time_query(tables[t], predicates, num_predicates, QUERIES[q].descending, false, &top_found);
+
+            if(sorted_found != top_found)
+            {
+                fprintf(stderr, "\nQuery \"%s\" listed %d keys sorted, %d by query_top()\n", query, sorted_found, top_found);
+                return EXIT_FAILURE;
+            }
+
+            printf("%-24s %-12s | %8.3f %8.3f %7.1fx\n", query, params.table_schemas[t].table_name, sorted_time, top_time,
+                    sorted_time / top_time);
+        }
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        table_destroy(tables[t]);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file
+ * @brief This file benchmarks query scans split into morsels run by the
+ * pool of scan workers.
+ *
+ * Usage: parallel_bench [rows [threads]]
+ *
+ * Random rows are loaded in a table stored by columns, and each query is
+ * timed through query_scan() on 1 thread, then on 2 and so on up to the
+ * given number of threads, one per CPU by default. Rates are in millions
+ * of rows per second, and the speedup is that of the most threads over 1.
+ * A host with fewer CPUs than threads shows no speedup beyond its CPUs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "query.h"
+#include "pool.h"
+#include "bench.h"
+
+#define DEFAULT_ROWS 10000000 ///< Rows loaded when not given.
+#define MIN_SCAN_TIME 1.0 ///< Seconds each query is repeated for.
+
+/**
+ * @brief Schema of the benchmark table.
+ */
+static const char* SCHEMA_LINE = "table people id:int,age:int,score:int,name:char[16],city:char[12] layout=columns";
+
+/**
+ * @brief Queries timed on every number of threads.
+ */
+static const char* QUERIES[] = {
+    "age > 90",
+    "age < 50, score > 500",
+    "id < 1000",
+    "city = toronto",
+    "city = ottawa, age > 50",
+};
+
+/**
+ * @brief Repeats a query scan for MIN_SCAN_TIME seconds.
+ *
+ * @param matches Where the number of matching rows is stored.
+ * @return Returns the scan rate in millions of rows per second.
+ */
+double time_scan(struct hash_table* table, const struct predicate predicates[], int num_predicates, int* matches)
+{
+    char matched_keys[MAX_KEY_LEN + 2];
+    double start = now();
+    int runs;
+
+    for(runs = 0; runs == 0 || now() - start < MIN_SCAN_TIME; runs++)
+        *matches = query_scan(table, predicates, num_predicates, 0, matched_keys);
+
+    return (double) table->num_keys * runs / (now() - start) / 1e6;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct config_params params = {.server_port = -1, .concurrency = -1};
+    int rows = argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS;
+    int max_threads = argc > 2 ? atoi(argv[2]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    char line[MAX_CONFIG_LINE_LEN];
+    int q, t;
+
+    strcpy(line, SCHEMA_LINE);
+    if(rows <= 0 || max_threads <= 0 || max_threads > POOL_MAX_WORKERS + 1 || process_config_line(line, &params) != 0)
+    {
+        fprintf(stderr, "Usage: %s [rows [threads]], at most %d threads\n", argv[0], POOL_MAX_WORKERS + 1);
+        return EXIT_FAILURE;
+    }
+
+    if(pool_start(max_threads - 1) != 0)
+    {
+        fprintf(stderr, "Failed to start %d scan workers\n", max_threads - 1);
+        return EXIT_FAILURE;
+    }
+
+    struct hash_table* table = table_create(&params.table_schemas[0]);
+    if(table == NULL || bench_load_people(table, rows) != 0)
+    {
+        fprintf(stderr, "Failed to load %d rows\n", rows);
+        return EXIT_FAILURE;
+    }
+
+    printf("Parallel column scans over %d rows of \"%s\", in Mrows/s, on %ld CPUs\n\n", rows,
+            SCHEMA_LINE + strlen("table "), sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-24s %8s", "query", "matches");
+    for(t = 1; t <= max_threads; t++)
+        printf(" %5d thr", t);
+    printf(" %8s\n", "speedup");
+
+    for(q = 0; q < sizeof QUERIES / sizeof QUERIES[0]; q++)
+    {
+        struct predicate predicates[MAX_COLUMNS_PER_TABLE];
+        char text[MAX_CONFIG_LINE_LEN];
+        int num_predicates, matches, serial_matches = 0;
+        double rate = 0, serial_rate = 0;
+
+        strcpy(text, QUERIES[q]);
+        num_predicates = query_parse(table->schema, &table->layout, text, predicates);
+        printf("%-24s", QUERIES[q]);
+
+        for(t = 1; t <= max_threads; t++)
+        {
+            pool_limit(t);
+            rate = time_scan(table, predicates, num_predicates, &matches);
+            if(t == 1)
+            {
+                serial_rate = rate;
+                serial_matches = matches;
+                printf(" %8d", matches);
+            }
+            else if(matches != serial_matches)
+            {
+                fprintf(stderr, "\nQuery \"%s\" matched %d rows on %d threads, %d on 1\n", QUERIES[q], matches, t, serial_matches);
+                return EXIT_FAILURE;
+            }
+
+            printf(" %9.1f", rate);
+            fflush(stdout);
+        }
+
+        printf(" %7.1fx\n", rate / serial_rate);
+    }
+
+    table_destroy(table);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+/**
+ * @file
+ * @brief This file benchmarks query scans over typed binary rows and over
+ * columns against the original scan tokenizing text values.
+ *
+ * Usage: query_bench [rows]
+ *
+ * The same random rows are loaded three times: as text values scanned by
+ * the original run_predicates(), and as rows decoded by row_parse() into a
+ * table stored by rows and into a table stored by columns, both scanned by
+ * query_run(). Each query is timed on all three tables.
+ *
+ * The predicates of each query are then compiled repeatedly, by parsing
+ * them every time and through a plan cache as the server does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+#include "hash.h"
+#include "legacy.h"
+#include "bench.h"
+
+#define DEFAULT_ROWS 1000000 ///< Rows loaded when not given.
+#define MIN_SCAN_TIME 1.0 ///< Seconds each query is repeated for.
+
+/**
+ * @brief Schema of the benchmark table.
+ */
+static const char* SCHEMA_LINE = "table people id:int,age:int,score:int,name:char[16],city:char[12]";
+
+/**
+ * @brief Queries timed on every table.
+ */
+static const char* QUERIES[] = {
+    "age > 90",
+    "age < 50, score > 500",
+    "city = toronto",
+    "name = ab, age = 30",
+};
+
+static const char* CITIES[] = {"toronto", "montreal", "ottawa", "calgary", "halifax", "regina", "victoria", "quebec"};
+
+
+/**
+ * @brief Generates a random value of the benchmark table, as sent by a client.
+ */
+void random_value(char* value, uint64_t* state)
+{
+    char name[3] = {'a' + next_random(state) % 26, 'a' + next_random(state) % 26, 0};
+
+    sprintf(value, "id %d,age %d,score %d,name %s,city %s", (int) (next_random(state) % 1000000),
+            (int) (next_random(state) % 100), (int) (next_random(state) % 1000), name,
+            CITIES[next_random(state) % (sizeof CITIES / sizeof CITIES[0])]);
+}
+
+
+/**
+ * @brief Loads the same random rows in a text table and in tables storing typed rows.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int load(struct hash_table* text_table, struct hash_table* row_tables[], int num_row_tables, int rows)
+{
+    char key[MAX_KEY_LEN], value[MAX_VALUE_LEN];
+    uint64_t state = BENCH_SEED;
+    int i, t;
+
+    for(i = 0; i < rows; i++)
+    {
+        sprintf(key, "key%d", i);
+        random_value(value, &state);
+
+        struct record* text = table_insert(text_table, key);
+        if(text == NULL || table_set_value(text_table, text, value, strlen(value) + 1) != 0)
+            return -1;
+
+        for(t = 0; t < num_row_tables; t++)
+        {
+            if(bench_insert(row_tables[t], key, value) != 0)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Repeats a query scan for MIN_SCAN_TIME seconds.
+ *
+ * @param matches Where the number of matching rows is stored.
+ * @return Returns the scan rate in millions of rows per second.
+ */
+double time_scan(struct hash_table* table, const struct predicate predicates[], int num_predicates, int rows, int* matches)
+{
+    char matched_keys[MAX_KEY_LEN + 2];
+    double start = now();
+    int runs;
+
+    for(runs = 0; runs == 0 || now() - start < MIN_SCAN_TIME; runs++)
+        *matches = query_run(table, predicates, num_predicates, 0, matched_keys);
+
+    return (double) rows * runs / (now() - start) / 1e6;
+}
+
+
+/**
+ * @brief Repeats the compilation of predicates for MIN_SCAN_TIME seconds.
+ *
+ * @param cache The plan cache to use, or NULL to parse the predicates every time.
+ * @return Returns the average time of a compilation in nanoseconds.
+ */
+double time_prepare(struct hash_table* table, struct plan_cache* cache, const char* query)
+{
+    struct predicate predicates[MAX_COLUMNS_PER_TABLE];
+    char text[MAX_CONFIG_LINE_LEN];
+    double start = now();
+    int runs;
+
+    for(runs = 0; runs == 0 || (runs % 1000 != 0 || now() - start < MIN_SCAN_TIME); runs++)
+    {
+        strcpy(text, query);
+        if(cache != NULL)
+            query_prepare(cache, table, text, predicates);
+        else
+            query_parse(table->schema, &table->layout, text, predicates);
+    }
+
+    return (now() - start) / runs * 1e9;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct config_params params = {.server_port = -1, .concurrency = -1};
+    int rows = argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS;
+    char line[MAX_CONFIG_LINE_LEN], matched_keys[MAX_KEY_LEN + 2];
+    int q, i;
+
+    hash_seed_init();
+    strcpy(line, SCHEMA_LINE);
+    if(rows <= 0 || process_config_line(line, &params) != 0)
+    {
+        fprintf(stderr, "Usage: %s [rows]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // The same schema, stored by rows and by columns
+    struct table_schema* schema = &params.table_schemas[0];
+    struct table_schema column_schema = *schema;
+    schema->layout = TABLE_LAYOUT_ROWS;
+    column_schema.layout = TABLE_LAYOUT_COLUMNS;
+
+    struct hash_table* text_table = table_create(schema);
+    struct hash_table* row_tables[2] = {table_create(schema), table_create(&column_schema)};
+
+    if(text_table == NULL || row_tables[0] == NULL || row_tables[1] == NULL || load(text_table, row_tables, 2, rows) != 0)
+    {
+        fprintf(stderr, "Failed to load %d rows\n", rows);
+        return EXIT_FAILURE;
+    }
+
+    printf("Query scans over %d rows of \"%s\", in Mrows/s\n\n", rows, SCHEMA_LINE + strlen("table "));
+    printf("%-24s %8s %10s %10s %10s %8s %8s\n", "query", "matches", "text", "rows", "columns", "rows", "columns");
+
+    for(q = 0; q < sizeof QUERIES / sizeof QUERIES[0]; q++)
+    {
+        struct predicate predicates[MAX_COLUMNS_PER_TABLE];
+        struct legacy_predicate legacy[MAX_COLUMNS_PER_TABLE];
+        char text[MAX_CONFIG_LINE_LEN];
+        int num_predicates, matches[2], legacy_matches = 0, runs;
+        double start, text_rate, row_rate, column_rate;
+
+        strcpy(text, QUERIES[q]);
+        num_predicates = query_parse(schema, &row_tables[0]->layout, text, predicates);
+
+        // The original predicates held their argument as text
+        for(i = 0; i < num_predicates; i++)
+        {
+            legacy[i].column_id = predicates[i].column_id;
+            legacy[i].operator = predicates[i].operator;
+            if(schema->data_types[predicates[i].column_id] == 0)
+                sprintf(legacy[i].argument, "%d", predicates[i].int_argument);
+            else
+                strcpy(legacy[i].argument, predicates[i].argument);
+        }
+
+        start = now();
+        for(runs = 0; runs == 0 || now() - start < MIN_SCAN_TIME; runs++)
+            legacy_matches = legacy_run_predicates(text_table, legacy, num_predicates, 0, matched_keys);
+        text_rate = (double) rows * runs / (now() - start) / 1e6;
+
+        row_rate = time_scan(row_tables[0], predicates, num_predicates, rows, &matches[0]);
+        column_rate = time_scan(row_tables[1], predicates, num_predicates, rows, &matches[1]);
+
+        if(matches[0] != legacy_matches || matches[1] != legacy_matches)
+        {
+            fprintf(stderr, "Query \"%s\" matched %d and %d rows, %d originally\n", QUERIES[q], matches[0], matches[1], legacy_matches);
+            return EXIT_FAILURE;
+        }
+
+        printf("%-24s %8d %10.2f %10.2f %10.2f %7.1fx %7.1fx\n", QUERIES[q], legacy_matches, text_rate, row_rate, column_rate,
+                row_rate / text_rate, column_rate / text_rate);
+    }
+
+    struct plan_cache* cache = plan_cache_create();
+    if(cache == NULL)
+        return EXIT_FAILURE;
+
+    printf("\nCompiling the predicates of each query, in ns\n\n");
+    printf("%-24s %10s %10s %8s\n", "query", "parsed", "cached", "");
+
+    for(q = 0; q < sizeof QUERIES / sizeof QUERIES[0]; q++)
+    {
+        double parse_time = time_prepare(row_tables[0], NULL, QUERIES[q]);
+        double cached_time = time_prepare(row_tables[0], cache, QUERIES[q]);
+
+        printf("%-24s %10.1f %10.1f %7.1fx\n", QUERIES[q], parse_time, cached_time, parse_time / cached_time);
+    }
+
+    plan_cache_destroy(cache);
+    table_destroy(text_table);
+    table_destroy(row_tables[0]);
+    table_destroy(row_tables[1]);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file
+ * @brief This file benchmarks the predicate kernels scanning a table stored
+ * by columns.
+ *
+ * Usage: scan_bench [rows]
+ *
+ * Random rows are loaded in a table stored by columns, and each query is
+ * timed through query_scan() with the scalar, SSE2 and AVX2 kernels in
+ * turn, on a single thread. The char[n] columns hold dictionary codes, so
+ * their equalities run the int kernels as well. Rates are in millions of
+ * rows per second per core, and the kernels the CPU lacks are skipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+#include "kernel.h"
+#include "bench.h"
+
+#define DEFAULT_ROWS 1000000 ///< Rows loaded when not given.
+#define MIN_SCAN_TIME 0.5 ///< Seconds each query is repeated for.
+
+/**
+ * @brief Schema of the benchmark table.
+ */
+static const char* SCHEMA_LINE = "table people id:int,age:int,score:int,name:char[16],city:char[12] layout=columns";
+
+/**
+ * @brief Queries timed with every kernel.
+ */
+static const char* QUERIES[] = {
+    "age > 90",
+    "age < 50, score > 500",
+    "id < 1000",
+    "city = toronto",
+    "name = person42",
+    "city = ottawa, age > 50",
+};
+
+/**
+ * @brief Repeats a query scan for MIN_SCAN_TIME seconds.
+ *
+ * @param matches Where the number of matching rows is stored.
+ * @return Returns the scan rate in millions of rows per second.
+ */
+double time_scan(struct hash_table* table, const struct predicate predicates[], int num_predicates, int* matches)
+{
+    char matched_keys[MAX_KEY_LEN + 2];
+    double start = now();
+    int runs;
+
+    for(runs = 0; runs == 0 || now() - start < MIN_SCAN_TIME; runs++)
+        *matches = query_scan(table, predicates, num_predicates, 0, matched_keys);
+
+    return (double) table->num_keys * runs / (now() - start) / 1e6;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct config_params params = {.server_port = -1, .concurrency = -1};
+    static const int LEVELS[] = {KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2};
+    int rows = argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS;
+    char line[MAX_CONFIG_LINE_LEN];
+    int q, l;
+
+    strcpy(line, SCHEMA_LINE);
+    if(rows <= 0 || process_config_line(line, &params) != 0)
+    {
+        fprintf(stderr, "Usage: %s [rows]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct hash_table* table = table_create(&params.table_schemas[0]);
+    if(table == NULL || bench_load_people(table, rows) != 0)
+    {
+        fprintf(stderr, "Failed to load %d rows\n", rows);
+        return EXIT_FAILURE;
+    }
+
+    printf("Column scans over %d rows of \"%s\", in Mrows/s per core, %s kernels by default\n\n", rows,
+            SCHEMA_LINE + strlen("table "), kernels_get()->name);
+    printf("%-24s %8s", "query", "matches");
+    for(l = 0; l < sizeof LEVELS / sizeof LEVELS[0]; l++)
+        printf(" %10s", kernels_select(LEVELS[l]) == 0 ? kernels_get()->name : "-");
+    printf(" %8s\n", "speedup");
+
+    for(q = 0; q < sizeof QUERIES / sizeof QUERIES[0]; q++)
+    {
+        struct predicate predicates[MAX_COLUMNS_PER_TABLE];
+        char text[MAX_CONFIG_LINE_LEN];
+        int num_predicates, matches, scalar_matches = 0;
+        double rate, scalar_rate = 0, best_rate = 0;
+
+        strcpy(text, QUERIES[q]);
+        num_predicates = query_parse(table->schema, &table->layout, text, predicates);
+        printf("%-24s", QUERIES[q]);
+
+        for(l = 0; l < sizeof LEVELS / sizeof LEVELS[0]; l++)
+        {
+            if(kernels_select(LEVELS[l]) != 0)
+            {
+                printf(" %10s", "-");
+                continue;
+            }
+
+            rate = time_scan(table, predicates, num_predicates, &matches);
+            if(LEVELS[l] == KERNEL_SCALAR)
+            {
+                scalar_rate = rate;
+                scalar_matches = matches;
+                printf(" %8d", matches);
+            }
+            else if(matches != scalar_matches)
+            {
+                fprintf(stderr, "\nQuery \"%s\" matched %d rows with %s kernels, %d with scalar ones\n",
+                        QUERIES[q], matches, kernels_get()->name, scalar_matches);
+                return EXIT_FAILURE;
+            }
+
+            best_rate = rate;
+            printf(" %10.1f", rate);
+        }
+
+        printf(" %7.1fx\n", best_rate / scalar_rate);
+    }
+
+    table_destroy(table);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file
+ * @brief This file benchmarks the zone maps skipping blocks of rows during
+ * query scans.
+ *
+ * Usage: zone_bench [rows]
+ *
+ * The same rows are loaded in time order, as an append-only table of
+ * events gets them, and in random order, where every block holds the
+ * whole range of times and no block can be skipped. Each query is timed
+ * through query_scan() on both, for tables stored by rows and by columns.
+ * Rates are in millions of rows per second, and the share of the blocks
+ * skipped is that of the rows loaded in time order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+#include "bench.h"
+
+#define DEFAULT_ROWS 1000000 ///< Rows loaded when not given.
+#define MIN_SCAN_TIME 0.5 ///< Seconds each query is repeated for.
+
+/**
+ * @brief Schemas of the benchmark tables, the rows loaded in time order then in random order.
+ */
+static const char* SCHEMA_LINES[] = {
+    "table rowsordered ts:int,user:int,kind:char[8]",
+    "table rowsrandom ts:int,user:int,kind:char[8]",
+    "table colsordered ts:int,user:int,kind:char[8] layout=columns",
+    "table colsrandom ts:int,user:int,kind:char[8] layout=columns",
+};
+
+/**
+ * @brief Queries timed on every table, ts being in [0, rows).
+ */
+static const char* QUERIES[] = {
+    "ts > %d",
+    "ts < %d",
+    "ts > %d, kind = click",
+    "user = 42",
+};
+
+static const char* KINDS[] = {"view", "click", "login", "logout"};
+
+
+/**
+ * @brief Loads one event per time, in time order or shuffled.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int load(struct hash_table* table, int rows, int shuffled)
+{
+    char key[MAX_KEY_LEN], value[MAX_VALUE_LEN];
+    uint64_t state = BENCH_SEED;
+    int* times = (int*) malloc(rows * sizeof(int));
+    int i, j, t;
+
+    if(times == NULL)
+        return -1;
+
+    for(i = 0; i < rows; i++)
+        times[i] = i;
+    for(i = rows - 1; shuffled && i > 0; i--)
+    {
+        j = (int) (next_random(&state) % (i + 1));
+        t = times[i];
+        times[i] = times[j];
+        times[j] = t;
+    }
+
+    // Users and kinds depend on the time alone, so both orders hold the same rows
+    for(i = 0; i < rows; i++)
+    {
+        sprintf(key, "event%d", times[i]);
+        sprintf(value, "ts %d,user %d,kind %s", times[i], (int) ((times[i] * 2654435761u) % 1000),
+                KINDS[(times[i] * 40503u) % (sizeof KINDS / sizeof KINDS[0])]);
+
+        if(bench_insert(table, key, value) != 0)
+        {
+            free(times);
+            return -1;
+        }
+    }
+
+    free(times);
+
+    return 0;
+}
+
+
+/**
+ * @brief Repeats a query scan for MIN_SCAN_TIME seconds.
+ *
+ * @param matches Where the number of matching rows is stored.
+ * @param skipped Where the share of the blocks skipped by a scan is stored.
+ * @return Returns the scan rate in millions of rows per second.
+ */
+double time_scan(struct hash_table* table, const struct predicate predicates[], int num_predicates, int* matches, double* skipped)
+{
+    char matched_keys[MAX_KEY_LEN + 2];
+    unsigned long long read = table->zones->zones_read, skips = table->zones->zones_skipped;
+    double start = now();
+    int runs;
+
+    for(runs = 0; runs == 0 || now() - start < MIN_SCAN_TIME; runs++)
+        *matches = query_scan(table, predicates, num_predicates, 0, matched_keys);
+
+    read = table->zones->zones_read - read;
+    skips = table->zones->zones_skipped - skips;
+    *skipped = 100.0 * skips / (read + skips);
+
+    return (double) table->num_keys * runs / (now() - start) / 1e6;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct config_params params = {.server_port = -1, .concurrency = -1};
+    int rows = argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS;
+    struct hash_table* tables[sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]];
+    char line[MAX_CONFIG_LINE_LEN];
+    int t, q;
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+    {
+        strcpy(line, SCHEMA_LINES[t]);
+        if(rows <= 0 || process_config_line(line, &params) != 0)
+        {
+            fprintf(stderr, "Usage: %s [rows]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        if((tables[t] = table_create(&params.table_schemas[t])) == NULL || load(tables[t], rows, t % 2) != 0)
+        {
+            fprintf(stderr, "Failed to load %d rows\n", rows);
+            return EXIT_FAILURE;
+        }
+
+    printf("Scans over %d events loaded in time order and in random order, in Mrows/s\n\n", rows);
+    printf("%-28s %8s | %9s %9s %8s %8s | %9s %9s %8s %8s\n", "query", "matches", "rows ord", "rows rnd", "speedup", "skipped",
+            "cols ord", "cols rnd", "speedup", "skipped");
+
+    for(q = 0; q < sizeof QUERIES / sizeof QUERIES[0]; q++)
+    {
+        int fractions[] = {rows - rows / 100, rows / 10};
+        char text[MAX_CONFIG_LINE_LEN], query[MAX_CONFIG_LINE_LEN];
+
+        sprintf(query, QUERIES[q], fractions[q % 2]);
+        printf("%-28s", query);
+
+        for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t += 2)
+        {
+            struct predicate predicates[MAX_COLUMNS_PER_TABLE];
+            int num_predicates, ordered_matches, random_matches;
+            double ordered_rate, random_rate, ordered_skipped, random_skipped;
+
+            strcpy(text, query);
+            num_predicates = query_parse(tables[t]->schema, &tables[t]->layout, text, predicates);
+            ordered_rate = time_scan(tables[t], predicates, num_predicates, &ordered_matches, &ordered_skipped);
+            random_rate = time_scan(tables[t + 1], predicates, num_predicates, &random_matches, &random_skipped);
+
+            if(ordered_matches != random_matches)
+            {
+                fprintf(stderr, "\nQuery \"%s\" matched %d rows in time order, %d in random order\n", query, ordered_matches, random_matches);
+                return EXIT_FAILURE;
+            }
+
+            if(t == 0)
+                printf(" %8d", ordered_matches);
+            printf(" | %9.1f %9.1f %7.1fx %7.1f%%", ordered_rate, random_rate, ordered_rate / random_rate, ordered_skipped);
+        }
+        printf("\n");
+    }
+
+    for(t = 0; t < sizeof SCHEMA_LINES / sizeof SCHEMA_LINES[0]; t++)
+        table_destroy(tables[t]);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,456 @@
+/**
+ * @file
+ * @brief This file implements the bitmaps declared in bitmap.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bitmap.h"
+
+#define MIN_ARRAY_CAPACITY 16 ///< Values an array container has room for when created.
+#define BITMAP_ADD_MANY_MIN 64 ///< Values added at once are only grouped by container beyond this many.
+#define BITMAP_FILL_INSERTION 32 ///< Values of a container filled at once that are sorted by insertion rather than by radix.
+
+
+void bitmap_init(struct bitmap* bitmap)
+{
+    memset(bitmap, 0, sizeof *bitmap);
+}
+
+
+/**
+ * @brief Frees the values of a container.
+ */
+static void container_free(struct bitmap_container* container)
+{
+    free(container->array);
+    free(container->bits);
+}
+
+
+void bitmap_free(struct bitmap* bitmap)
+{
+    int i;
+
+    for(i = 0; i < bitmap->num_containers; i++)
+        container_free(&bitmap->containers[i]);
+    free(bitmap->containers);
+    bitmap_init(bitmap);
+}
+
+
+/**
+ * @brief Finds the container of a key, adding an empty array container if missing.
+ *
+ * @return Returns the container on success, NULL if out of memory.
+ */
+static struct bitmap_container* find_container(struct bitmap* bitmap, uint16_t key)
+{
+    int low = 0, high = bitmap->num_containers;
+    struct bitmap_container* container;
+
+    // Values mostly come in increasing order, so the last container is checked first
+    if(high > 0 && bitmap->containers[high - 1].key <= key)
+        low = bitmap->containers[high - 1].key == key ? high - 1 : high;
+
+    while(low < high)
+    {
+        int middle = (low + high) / 2;
+
+        if(bitmap->containers[middle].key < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if(low < bitmap->num_containers && bitmap->containers[low].key == key)
+        return &bitmap->containers[low];
+
+    if(bitmap->num_containers == bitmap->capacity)
+    {
+        int capacity = bitmap->capacity > 0 ? 2 * bitmap->capacity : 4;
+        struct bitmap_container* containers = (struct bitmap_container*) realloc(bitmap->containers, capacity * sizeof *containers);
+
+        if(containers == NULL)
+            return NULL;
+
+        bitmap->containers = containers;
+        bitmap->capacity = capacity;
+    }
+
+    container = &bitmap->containers[low];
+    memmove(container + 1, container, (bitmap->num_containers - low) * sizeof *container);
+    memset(container, 0, sizeof *container);
+    container->key = key;
+    bitmap->num_containers++;
+
+    return container;
+}
+
+
+/**
+ * @brief Turns an array container into a bitset.
+ *
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+static int to_bitset(struct bitmap_container* container)
+{
+    uint64_t* bits = (uint64_t*) calloc(BITMAP_WORDS, sizeof(uint64_t));
+    int i;
+
+    if(bits == NULL)
+        return -1;
+
+    for(i = 0; i < container->cardinality; i++)
+        bits[container->array[i] >> 6] |= 1ull << (container->array[i] & 63);
+
+    free(container->array);
+    container->array = NULL;
+    container->capacity = 0;
+    container->bits = bits;
+
+    return 0;
+}
+
+
+/**
+ * @brief Adds the low 16 bits of a value to its container.
+ *
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+static int container_add(struct bitmap_container* container, uint16_t low)
+{
+    int position = container->cardinality;
+
+    if(container->bits == NULL && container->cardinality == BITMAP_ARRAY_MAX && to_bitset(container) != 0)
+        return -1;
+
+    if(container->bits != NULL)
+    {
+        uint64_t bit = 1ull << (low & 63);
+
+        container->cardinality += (container->bits[low >> 6] & bit) == 0;
+        container->bits[low >> 6] |= bit;
+        return 0;
+    }
+
+    // Appending is the common case, otherwise the array is searched
+    if(position > 0 && container->array[position - 1] >= low)
+    {
+        int first = 0;
+
+        while(first < position)
+        {
+            int middle = (first + position) / 2;
+
+            if(container->array[middle] < low)
+                first = middle + 1;
+            else
+                position = middle;
+        }
+
+        if(container->array[position] == low)
+            return 0;
+    }
+
+    if(container->cardinality == container->capacity)
+    {
+        int capacity = container->capacity > 0 ? 2 * container->capacity : MIN_ARRAY_CAPACITY;
+        uint16_t* array = (uint16_t*) realloc(container->array, capacity * sizeof(uint16_t));
+
+        if(array == NULL)
+            return -1;
+
+        container->array = array;
+        container->capacity = capacity;
+    }
+
+    memmove(container->array + position + 1, container->array + position, (container->cardinality - position) * sizeof(uint16_t));
+    container->array[position] = low;
+    container->cardinality++;
+
+    return 0;
+}
+
+
+int bitmap_add(struct bitmap* bitmap, uint32_t value)
+{
+    struct bitmap_container* container = find_container(bitmap, value >> 16);
+
+    return container == NULL ? -1 : container_add(container, value & 0xffff);
+}
+
+
+/**
+ * @brief Sorts the low 16 bits of values, a byte at a time.
+ *
+ * @param scratch Room for count values.
+ */
+static void sort_lows(uint16_t* lows, uint16_t* scratch, int count)
+{
+    int offsets[257];
+    int i, shift;
+
+    for(shift = 0; shift < 16; shift += 8)
+    {
+        uint16_t* from = shift == 0 ? lows : scratch;
+        uint16_t* to = shift == 0 ? scratch : lows;
+
+        memset(offsets, 0, sizeof offsets);
+        for(i = 0; i < count; i++)
+            offsets[((from[i] >> shift) & 255) + 1]++;
+        for(i = 0; i < 256; i++)
+            offsets[i + 1] += offsets[i];
+        for(i = 0; i < count; i++)
+            to[offsets[(from[i] >> shift) & 255]++] = from[i];
+    }
+}
+
+
+/**
+ * @brief Fills a new container with the low 16 bits of its values, in any order.
+ *
+ * Up to BITMAP_ARRAY_MAX values are sorted in place, by insertion if they
+ * are few, and copied to an array. More are set in a bitset on the stack,
+ * then copied to the container as a bitset, or read back in order if they
+ * were mostly duplicates.
+ *
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+static int container_fill(struct bitmap_container* container, uint16_t* lows, int count)
+{
+    int i, j;
+
+    if(count <= BITMAP_ARRAY_MAX)
+    {
+        uint16_t scratch[BITMAP_ARRAY_MAX];
+
+        if(count > BITMAP_FILL_INSERTION)
+            sort_lows(lows, scratch, count);
+        else
+            for(i = 1; i < count; i++)
+            {
+                uint16_t low = lows[i];
+
+                for(j = i; j > 0 && lows[j - 1] > low; j--)
+                    lows[j] = lows[j - 1];
+                lows[j] = low;
+            }
+
+        if((container->array = (uint16_t*) malloc(count * sizeof(uint16_t))) == NULL)
+            return -1;
+
+        container->capacity = count;
+        for(i = 0; i < count; i++)
+            if(i == 0 || lows[i] != lows[i - 1])
+                container->array[container->cardinality++] = lows[i];
+        return 0;
+    }
+
+    uint64_t bits[BITMAP_WORDS];
+
+    // Values are counted as they are set, sparing a pass over the words
+    memset(bits, 0, sizeof bits);
+    for(i = 0; i < count; i++)
+    {
+        uint64_t bit = 1ull << (lows[i] & 63);
+
+        container->cardinality += (bits[lows[i] >> 6] & bit) == 0;
+        bits[lows[i] >> 6] |= bit;
+    }
+
+    if(container->cardinality > BITMAP_ARRAY_MAX)
+    {
+        if((container->bits = (uint64_t*) malloc(sizeof bits)) == NULL)
+            return -1;
+
+        memcpy(container->bits, bits, sizeof bits);
+        return 0;
+    }
+
+    if((container->array = (uint16_t*) malloc(container->cardinality * sizeof(uint16_t))) == NULL)
+        return -1;
+
+    container->capacity = container->cardinality;
+    for(i = 0, j = 0; i < BITMAP_WORDS; i++)
+    {
+        uint64_t word;
+        for(word = bits[i]; word != 0; word &= word - 1)
+            container->array[j++] = i * 64 + __builtin_ctzll(word);
+    }
+
+    return 0;
+}
+
+
+int bitmap_add_many(struct bitmap* bitmap, const uint32_t* values, int count)
+{
+    uint16_t* lows = NULL;
+    int* offsets = NULL;
+    uint32_t max_key = 0, key;
+    int i, status = 0;
+
+    for(i = 0; i < count; i++)
+        if(values[i] >> 16 > max_key)
+            max_key = values[i] >> 16;
+
+    // Few values, values joining existing containers, or no memory to group them, are added one at a time
+    if(count > BITMAP_ADD_MANY_MIN && bitmap->num_containers == 0)
+    {
+        offsets = (int*) calloc(max_key + 2, sizeof(int));
+        lows = (uint16_t*) malloc(count * sizeof(uint16_t));
+    }
+
+    if(offsets == NULL || lows == NULL)
+    {
+        free(offsets);
+        free(lows);
+
+        for(i = 0; i < count; i++)
+            if(bitmap_add(bitmap, values[i]) != 0)
+                return -1;
+        return 0;
+    }
+
+    // The low 16 bits of the values are grouped by key, each group filling a container
+    for(i = 0; i < count; i++)
+        offsets[(values[i] >> 16) + 1]++;
+    for(key = 0; key <= max_key; key++)
+        offsets[key + 1] += offsets[key];
+    for(i = 0; i < count; i++)
+        lows[offsets[values[i] >> 16]++] = values[i] & 0xffff;
+
+    // Grouping advanced each offset to the end of its group
+    for(key = 0; status == 0 && key <= max_key; key++)
+    {
+        int first = key > 0 ? offsets[key - 1] : 0;
+        struct bitmap_container* container;
+
+        if(offsets[key] == first)
+            continue;
+
+        if((container = find_container(bitmap, key)) == NULL || container_fill(container, lows + first, offsets[key] - first) != 0)
+            status = -1;
+    }
+
+    free(offsets);
+    free(lows);
+
+    return status;
+}
+
+
+int bitmap_add_word(struct bitmap* bitmap, uint32_t first, uint64_t word)
+{
+    struct bitmap_container* container;
+
+    if(word == 0)
+        return 0;
+
+    if((container = find_container(bitmap, first >> 16)) == NULL)
+        return -1;
+
+    // A word too large for the array is ORed into a bitset at once
+    if(container->bits == NULL && container->cardinality + __builtin_popcountll(word) > BITMAP_ARRAY_MAX && to_bitset(container) != 0)
+        return -1;
+
+    if(container->bits != NULL)
+    {
+        uint64_t* bits = &container->bits[(first & 0xffff) >> 6];
+
+        container->cardinality += __builtin_popcountll(word & ~*bits);
+        *bits |= word;
+        return 0;
+    }
+
+    for(; word != 0; word &= word - 1)
+        if(container_add(container, (first & 0xffff) + __builtin_ctzll(word)) != 0)
+            return -1;
+
+    return 0;
+}
+
+
+int bitmap_append(struct bitmap* bitmap, struct bitmap* other)
+{
+    if(bitmap->num_containers + other->num_containers > bitmap->capacity)
+    {
+        int capacity = bitmap->num_containers + other->num_containers;
+        struct bitmap_container* containers = (struct bitmap_container*) realloc(bitmap->containers, capacity * sizeof *containers);
+
+        if(containers == NULL)
+            return -1;
+
+        bitmap->containers = containers;
+        bitmap->capacity = capacity;
+    }
+
+    if(other->num_containers > 0)
+        memcpy(&bitmap->containers[bitmap->num_containers], other->containers, other->num_containers * sizeof *other->containers);
+    bitmap->num_containers += other->num_containers;
+
+    // The values now belong to bitmap, only the container array is freed
+    free(other->containers);
+    bitmap_init(other);
+
+    return 0;
+}
+
+
+long bitmap_cardinality(const struct bitmap* bitmap)
+{
+    long cardinality = 0;
+    int i;
+
+    for(i = 0; i < bitmap->num_containers; i++)
+        cardinality += bitmap->containers[i].cardinality;
+
+    return cardinality;
+}
+
+
+void bitmap_iterator_init(struct bitmap_iterator* iterator, const struct bitmap* bitmap)
+{
+    iterator->bitmap = bitmap;
+    iterator->container = 0;
+    iterator->position = 0;
+}
+
+
+bool bitmap_next_word(struct bitmap_iterator* iterator, uint32_t* first, uint64_t* word)
+{
+    while(iterator->container < iterator->bitmap->num_containers)
+    {
+        const struct bitmap_container* container = &iterator->bitmap->containers[iterator->container];
+        uint32_t base = (uint32_t) container->key << 16;
+
+        if(container->bits != NULL)
+        {
+            while(iterator->position < BITMAP_WORDS && container->bits[iterator->position] == 0)
+                iterator->position++;
+
+            if(iterator->position < BITMAP_WORDS)
+            {
+                *first = base + iterator->position * 64;
+                *word = container->bits[iterator->position++];
+                return true;
+            }
+        }
+        else if(iterator->position < container->cardinality)
+        {
+            // The values of the array sharing the same word are gathered
+            int low = container->array[iterator->position] & ~63;
+
+            *first = base + low;
+            *word = 0;
+            while(iterator->position < container->cardinality && (container->array[iterator->position] & ~63) == low)
+                *word |= 1ull << (container->array[iterator->position++] & 63);
+            return true;
+        }
+
+        iterator->container++;
+        iterator->position = 0;
+    }
+
+    return false;
+}
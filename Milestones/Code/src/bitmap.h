@@ -0,0 +1,141 @@
+/**
+ * @file
+ * @brief This file declares the compressed bitmaps of row ids built by
+ * queries.
+ *
+ * As in Roaring bitmaps, row ids are split by their high 16 bits into
+ * containers holding the low 16 bits of up to 65536 values. A container
+ * with at most BITMAP_ARRAY_MAX values keeps them in a sorted array of 2
+ * bytes each, and a fuller one in a bitset of 8 KB, so a bitmap costs at
+ * most 2 bytes per value and at most a bit per row id of its range.
+ * Values are added and visited 64 consecutive ones at a time, as the
+ * selection masks of the scan kernels (kernel.h) produce them.
+ */
+
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BITMAP_ARRAY_MAX 4096 ///< Values of a container stored as an array, beyond which it becomes a bitset.
+#define BITMAP_WORDS 1024 ///< 64-bit words of a bitset container.
+
+
+/**
+ * @brief The values of a bitmap sharing their high 16 bits.
+ */
+struct bitmap_container {
+    uint16_t key; ///< High 16 bits of the values.
+    int cardinality; ///< Number of values.
+    int capacity; ///< Values the array has room for.
+    uint16_t* array; ///< Low 16 bits of the values in increasing order, NULL for a bitset.
+    uint64_t* bits; ///< BITMAP_WORDS words holding the values of a bitset, NULL for an array.
+};
+
+
+/**
+ * @brief A set of 32-bit values.
+ */
+struct bitmap {
+    struct bitmap_container* containers; ///< In increasing key order, none of them empty.
+    int num_containers;
+    int capacity;
+};
+
+
+/**
+ * @brief Position of an iteration over the values of a bitmap, 64 at a time.
+ */
+struct bitmap_iterator {
+    const struct bitmap* bitmap;
+    int container; ///< Container being visited.
+    int position; ///< Next array index or bitset word of the container.
+};
+
+
+/**
+ * @brief Initializes an empty bitmap.
+ */
+void bitmap_init(struct bitmap* bitmap);
+
+
+/**
+ * @brief Frees the containers of a bitmap, leaving it empty.
+ */
+void bitmap_free(struct bitmap* bitmap);
+
+
+/**
+ * @brief Adds a value to a bitmap.
+ *
+ * Values are added fastest in increasing order.
+ *
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+int bitmap_add(struct bitmap* bitmap, uint32_t value);
+
+
+/**
+ * @brief Adds values in any order to an empty bitmap.
+ *
+ * Rather than inserting each value in the middle of its array, the values
+ * are grouped by container, and each group is sorted, or set in a bitset
+ * if too many for an array, before filling its container. Values added to
+ * a bitmap that is not empty are inserted one at a time.
+ *
+ * @param values The values.
+ * @param count Number of values.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+int bitmap_add_many(struct bitmap* bitmap, const uint32_t* values, int count);
+
+
+/**
+ * @brief Adds up to 64 consecutive values to a bitmap.
+ *
+ * @param first The value of bit 0 of the word, a multiple of 64.
+ * @param word The values to add, bit i for first + i.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+int bitmap_add_word(struct bitmap* bitmap, uint32_t first, uint64_t word);
+
+
+/**
+ * @brief Moves the values of a bitmap to the end of another.
+ *
+ * The containers are moved rather than copied, so bitmaps built over
+ * consecutive ranges of values are merged in the time of their number.
+ *
+ * @param bitmap The bitmap to add to.
+ * @param other The bitmap moved, all of its values greater than those of
+ * bitmap and outside its containers. It is left empty.
+ * @return Returns 0 on success, -1 if out of memory, other then left unchanged.
+ */
+int bitmap_append(struct bitmap* bitmap, struct bitmap* other);
+
+
+/**
+ * @brief Returns the number of values in a bitmap.
+ */
+long bitmap_cardinality(const struct bitmap* bitmap);
+
+
+/**
+ * @brief Starts an iteration over the values of a bitmap, in increasing order.
+ */
+void bitmap_iterator_init(struct bitmap_iterator* iterator, const struct bitmap* bitmap);
+
+
+/**
+ * @brief Returns the next non-empty word of values of a bitmap.
+ *
+ * @param iterator The iteration position.
+ * @param first Where the value of bit 0 of the word is stored, a multiple of 64.
+ * @param word Where the values are stored, bit i for first + i.
+ * @return Returns true if a word was found, false once every value was visited.
+ */
+bool bitmap_next_word(struct bitmap_iterator* iterator, uint32_t* first, uint64_t* word);
+
+
+#endif
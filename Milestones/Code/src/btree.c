@@ -0,0 +1,510 @@
+/**
+ * @file
+ * @brief This file implements the ordered key index declared in btree.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "btree.h"
+
+
+/**
+ * @brief Returns the bytes allocated for a node, leaves having no children array.
+ */
+static size_t node_size(bool leaf)
+{
+    return leaf ? sizeof(struct btree_node) : sizeof(struct btree_internal);
+}
+
+
+/**
+ * @brief Returns the children of an internal node.
+ */
+static inline struct btree_node** node_children(const struct btree_node* node)
+{
+    return ((struct btree_internal*) node)->children;
+}
+
+
+/**
+ * @brief Allocates an empty node.
+ *
+ * @return Returns the node on success, NULL otherwise.
+ */
+static struct btree_node* node_alloc(struct btree* tree, bool leaf)
+{
+    struct btree_node* node = (struct btree_node*) malloc(node_size(leaf));
+    if(node == NULL)
+        return NULL;
+
+    node->num_keys = 0;
+    node->leaf = leaf;
+    node->next = NULL;
+    tree->bytes += node_size(leaf);
+
+    return node;
+}
+
+
+/**
+ * @brief Frees a node, but not its children.
+ */
+static void node_free(struct btree* tree, struct btree_node* node)
+{
+    tree->bytes -= node_size(node->leaf);
+    free(node);
+}
+
+
+/**
+ * @brief Frees a node and all its children.
+ */
+static void subtree_free(struct btree* tree, struct btree_node* node)
+{
+    int i;
+
+    if(!node->leaf)
+        for(i = 0; i <= node->num_keys; i++)
+            subtree_free(tree, node_children(node)[i]);
+
+    node_free(tree, node);
+}
+
+
+/**
+ * @brief Finds the first key of a node not less than a key.
+ *
+ * @return Returns its index, or num_keys if every key is less.
+ */
+static int lower_bound(const struct btree* tree, const struct btree_node* node, const void* key)
+{
+    int low = 0, high = node->num_keys;
+
+    while(low < high)
+    {
+        int middle = (low + high) / 2;
+        if(tree->compare(node->keys[middle], key) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+
+/**
+ * @brief Finds the first key of a node greater than a key.
+ *
+ * In an internal node, this is the index of the child whose subtree holds the key.
+ *
+ * @return Returns its index, or num_keys if no key is greater.
+ */
+static int upper_bound(const struct btree* tree, const struct btree_node* node, const void* key)
+{
+    int low = 0, high = node->num_keys;
+
+    while(low < high)
+    {
+        int middle = (low + high) / 2;
+        if(tree->compare(node->keys[middle], key) <= 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+
+int btree_init(struct btree* tree, btree_compare compare)
+{
+    tree->compare = compare;
+    tree->height = 0;
+    tree->num_keys = 0;
+    tree->bytes = 0;
+
+    return (tree->root = node_alloc(tree, true)) == NULL ? -1 : 0;
+}
+
+
+void btree_destroy(struct btree* tree)
+{
+    if(tree->root != NULL)
+        subtree_free(tree, tree->root);
+    tree->root = NULL;
+}
+
+
+/**
+ * @brief Inserts a key and a right child into a full internal node, moving its upper half to a new node.
+ *
+ * @param node The full node.
+ * @param index Where the key goes, its child going right after it.
+ * @param key The key to insert, replaced by the key moving up to the parent.
+ * @param child The child to insert.
+ * @param right The empty node receiving the upper half.
+ */
+static void split_internal(struct btree_node* node, int index, char* key, struct btree_node* child, struct btree_node* right)
+{
+    char keys[BTREE_MAX_KEYS + 1][BTREE_KEY_SIZE];
+    struct btree_node* children[BTREE_MAX_KEYS + 2];
+    int middle = (BTREE_MAX_KEYS + 1) / 2;
+
+    // Lay out all the keys and children in order before dealing them out
+    memcpy(keys, node->keys, index * sizeof keys[0]);
+    memcpy(keys[index], key, BTREE_KEY_SIZE);
+    memcpy(keys + index + 1, node->keys + index, (BTREE_MAX_KEYS - index) * sizeof keys[0]);
+    memcpy(children, node_children(node), (index + 1) * sizeof children[0]);
+    children[index + 1] = child;
+    memcpy(children + index + 2, node_children(node) + index + 1, (BTREE_MAX_KEYS - index) * sizeof children[0]);
+
+    node->num_keys = middle;
+    memcpy(node->keys, keys, middle * sizeof keys[0]);
+    memcpy(node_children(node), children, (middle + 1) * sizeof children[0]);
+
+    // The middle key separates the halves, so only the parent keeps it
+    memcpy(key, keys[middle], BTREE_KEY_SIZE);
+
+    right->num_keys = BTREE_MAX_KEYS - middle;
+    memcpy(right->keys, keys + middle + 1, right->num_keys * sizeof keys[0]);
+    memcpy(node_children(right), children + middle + 1, (right->num_keys + 1) * sizeof children[0]);
+}
+
+
+/**
+ * @brief Inserts a key into a full leaf, moving its upper half to a new leaf.
+ *
+ * @param key The key to insert, replaced by the first key of the new leaf.
+ */
+static void split_leaf(struct btree_node* leaf, int index, char* key, struct btree_node* right)
+{
+    char keys[BTREE_MAX_KEYS + 1][BTREE_KEY_SIZE];
+    int middle = (BTREE_MAX_KEYS + 1) / 2;
+
+    memcpy(keys, leaf->keys, index * sizeof keys[0]);
+    memcpy(keys[index], key, BTREE_KEY_SIZE);
+    memcpy(keys + index + 1, leaf->keys + index, (BTREE_MAX_KEYS - index) * sizeof keys[0]);
+
+    leaf->num_keys = middle;
+    memcpy(leaf->keys, keys, middle * sizeof keys[0]);
+
+    right->num_keys = BTREE_MAX_KEYS + 1 - middle;
+    memcpy(right->keys, keys + middle, right->num_keys * sizeof keys[0]);
+    right->next = leaf->next;
+    leaf->next = right;
+
+    memcpy(key, right->keys[0], BTREE_KEY_SIZE);
+}
+
+
+int btree_insert(struct btree* tree, const void* key)
+{
+    struct btree_node* path[BTREE_MAX_HEIGHT];
+    struct btree_node* spares[BTREE_MAX_HEIGHT + 1];
+    struct btree_node* node = tree->root;
+    struct btree_node* child = NULL;
+    char moving_key[BTREE_KEY_SIZE];
+    int indexes[BTREE_MAX_HEIGHT];
+    int depth, index, num_spares = 0, used_spares = 0;
+
+    for(depth = 0; depth < tree->height; depth++)
+    {
+        path[depth] = node;
+        indexes[depth] = upper_bound(tree, node, key);
+        node = node_children(node)[indexes[depth]];
+    }
+
+    index = lower_bound(tree, node, key);
+    if(index < node->num_keys && tree->compare(node->keys[index], key) == 0)
+        return 0;
+
+    // A full leaf splits, and so does each full ancestor, up to a new root if all are full
+    if(node->num_keys == BTREE_MAX_KEYS)
+    {
+        num_spares = 1;
+        for(depth = tree->height - 1; depth >= 0 && path[depth]->num_keys == BTREE_MAX_KEYS; depth--)
+            num_spares++;
+        if(depth < 0)
+        {
+            if(tree->height == BTREE_MAX_HEIGHT)
+                return -1;
+            num_spares++;
+        }
+    }
+
+    for(used_spares = 0; used_spares < num_spares; used_spares++)
+        if((spares[used_spares] = node_alloc(tree, used_spares == 0)) == NULL)
+        {
+            while(used_spares-- > 0)
+                node_free(tree, spares[used_spares]);
+            return -1;
+        }
+
+    used_spares = 0;
+    memcpy(moving_key, key, BTREE_KEY_SIZE);
+    tree->num_keys++;
+
+    if(node->num_keys < BTREE_MAX_KEYS)
+    {
+        memmove(node->keys + index + 1, node->keys + index, (node->num_keys - index) * sizeof node->keys[0]);
+        memcpy(node->keys[index], moving_key, BTREE_KEY_SIZE);
+        node->num_keys++;
+        return 0;
+    }
+
+    child = spares[used_spares++];
+    split_leaf(node, index, moving_key, child);
+
+    // Each split adds a key and a child to the parent, which may split in turn
+    for(depth = tree->height - 1; depth >= 0; depth--)
+    {
+        node = path[depth];
+        index = indexes[depth];
+
+        if(node->num_keys < BTREE_MAX_KEYS)
+        {
+            memmove(node->keys + index + 1, node->keys + index, (node->num_keys - index) * sizeof node->keys[0]);
+            memmove(node_children(node) + index + 2, node_children(node) + index + 1, (node->num_keys - index) * sizeof(struct btree_node*));
+            memcpy(node->keys[index], moving_key, BTREE_KEY_SIZE);
+            node_children(node)[index + 1] = child;
+            node->num_keys++;
+            return 0;
+        }
+
+        struct btree_node* right = spares[used_spares++];
+        split_internal(node, index, moving_key, child, right);
+        child = right;
+    }
+
+    // The root split, so the tree grows a level
+    node = spares[used_spares];
+    node->num_keys = 1;
+    memcpy(node->keys[0], moving_key, BTREE_KEY_SIZE);
+    node_children(node)[0] = tree->root;
+    node_children(node)[1] = child;
+    tree->root = node;
+    tree->height++;
+
+    return 0;
+}
+
+
+/**
+ * @brief Moves the last key of a node's left sibling to the node.
+ *
+ * @param parent The parent of both nodes.
+ * @param index The index of the node in its parent.
+ */
+static void borrow_left(struct btree_node* parent, int index, struct btree_node* left, struct btree_node* node)
+{
+    memmove(node->keys + 1, node->keys, node->num_keys * sizeof node->keys[0]);
+
+    if(node->leaf)
+    {
+        memcpy(node->keys[0], left->keys[left->num_keys - 1], BTREE_KEY_SIZE);
+        memcpy(parent->keys[index - 1], node->keys[0], BTREE_KEY_SIZE);
+    }
+    else
+    {
+        // The separator comes down, and the last key of the sibling replaces it
+        memmove(node_children(node) + 1, node_children(node), (node->num_keys + 1) * sizeof(struct btree_node*));
+        memcpy(node->keys[0], parent->keys[index - 1], BTREE_KEY_SIZE);
+        node_children(node)[0] = node_children(left)[left->num_keys];
+        memcpy(parent->keys[index - 1], left->keys[left->num_keys - 1], BTREE_KEY_SIZE);
+    }
+
+    left->num_keys--;
+    node->num_keys++;
+}
+
+
+/**
+ * @brief Moves the first key of a node's right sibling to the node.
+ *
+ * @param parent The parent of both nodes.
+ * @param index The index of the node in its parent.
+ */
+static void borrow_right(struct btree_node* parent, int index, struct btree_node* node, struct btree_node* right)
+{
+    if(node->leaf)
+    {
+        memcpy(node->keys[node->num_keys], right->keys[0], BTREE_KEY_SIZE);
+        memmove(right->keys, right->keys + 1, (right->num_keys - 1) * sizeof right->keys[0]);
+        memcpy(parent->keys[index], right->keys[0], BTREE_KEY_SIZE);
+    }
+    else
+    {
+        // The separator comes down, and the first key of the sibling replaces it
+        memcpy(node->keys[node->num_keys], parent->keys[index], BTREE_KEY_SIZE);
+        node_children(node)[node->num_keys + 1] = node_children(right)[0];
+        memcpy(parent->keys[index], right->keys[0], BTREE_KEY_SIZE);
+        memmove(right->keys, right->keys + 1, (right->num_keys - 1) * sizeof right->keys[0]);
+        memmove(node_children(right), node_children(right) + 1, right->num_keys * sizeof(struct btree_node*));
+    }
+
+    right->num_keys--;
+    node->num_keys++;
+}
+
+
+/**
+ * @brief Merges a node into its left sibling and frees it.
+ *
+ * @param parent The parent of both nodes.
+ * @param index The index of the right node in its parent.
+ */
+static void merge(struct btree* tree, struct btree_node* parent, int index, struct btree_node* left, struct btree_node* right)
+{
+    if(left->leaf)
+        left->next = right->next;
+    else
+    {
+        // The separator comes down between the keys of both nodes
+        memcpy(left->keys[left->num_keys], parent->keys[index - 1], BTREE_KEY_SIZE);
+        memcpy(node_children(left) + left->num_keys + 1, node_children(right), (right->num_keys + 1) * sizeof(struct btree_node*));
+        left->num_keys++;
+    }
+
+    memcpy(left->keys + left->num_keys, right->keys, right->num_keys * sizeof right->keys[0]);
+    left->num_keys += right->num_keys;
+
+    memmove(parent->keys + index - 1, parent->keys + index, (parent->num_keys - index) * sizeof parent->keys[0]);
+    memmove(node_children(parent) + index, node_children(parent) + index + 1, (parent->num_keys - index) * sizeof(struct btree_node*));
+    parent->num_keys--;
+
+    node_free(tree, right);
+}
+
+
+int btree_remove(struct btree* tree, const void* key)
+{
+    struct btree_node* path[BTREE_MAX_HEIGHT];
+    struct btree_node* node = tree->root;
+    int indexes[BTREE_MAX_HEIGHT];
+    int depth, index;
+
+    for(depth = 0; depth < tree->height; depth++)
+    {
+        path[depth] = node;
+        indexes[depth] = upper_bound(tree, node, key);
+        node = node_children(node)[indexes[depth]];
+    }
+
+    index = lower_bound(tree, node, key);
+    if(index == node->num_keys || tree->compare(node->keys[index], key) != 0)
+        return -1;
+
+    memmove(node->keys + index, node->keys + index + 1, (node->num_keys - index - 1) * sizeof node->keys[0]);
+    node->num_keys--;
+    tree->num_keys--;
+
+    // Separators equal to the removed key still route correctly, so only underflows need fixing
+    for(depth = tree->height - 1; depth >= 0 && node->num_keys < BTREE_MIN_KEYS; depth--)
+    {
+        struct btree_node* parent = path[depth];
+        struct btree_node* left = NULL;
+        struct btree_node* right = NULL;
+
+        index = indexes[depth];
+        if(index > 0)
+            left = node_children(parent)[index - 1];
+        if(index < parent->num_keys)
+            right = node_children(parent)[index + 1];
+
+        if(left != NULL && left->num_keys > BTREE_MIN_KEYS)
+        {
+            borrow_left(parent, index, left, node);
+            break;
+        }
+        else if(right != NULL && right->num_keys > BTREE_MIN_KEYS)
+        {
+            borrow_right(parent, index, node, right);
+            break;
+        }
+        else if(left != NULL)
+            merge(tree, parent, index, left, node);
+        else
+            merge(tree, parent, index + 1, node, right);
+
+        node = parent;
+    }
+
+    // A root left with a single child is replaced by it
+    if(tree->height > 0 && tree->root->num_keys == 0)
+    {
+        node = tree->root;
+        tree->root = node_children(node)[0];
+        node_free(tree, node);
+        tree->height--;
+    }
+
+    return 0;
+}
+
+
+void btree_seek(const struct btree* tree, const void* key, bool inclusive, struct btree_cursor* cursor)
+{
+    const struct btree_node* node = tree->root;
+
+    while(!node->leaf)
+        node = node_children(node)[key == NULL ? 0 : upper_bound(tree, node, key)];
+
+    cursor->leaf = node;
+    if(key == NULL)
+        cursor->index = 0;
+    else
+        cursor->index = inclusive ? lower_bound(tree, node, key) : upper_bound(tree, node, key);
+}
+
+
+const void* btree_next(struct btree_cursor* cursor)
+{
+    // Past the end of a leaf, the scan continues with the next one
+    while(cursor->leaf != NULL && cursor->index >= cursor->leaf->num_keys)
+    {
+        cursor->leaf = cursor->leaf->next;
+        cursor->index = 0;
+    }
+
+    return cursor->leaf == NULL ? NULL : cursor->leaf->keys[cursor->index++];
+}
+
+
+const void* btree_last(const struct btree* tree)
+{
+    const struct btree_node* node = tree->root;
+
+    while(!node->leaf)
+        node = node_children(node)[node->num_keys];
+
+    return node->num_keys == 0 ? NULL : node->keys[node->num_keys - 1];
+}
+
+
+const void* btree_before(const struct btree* tree, const void* key)
+{
+    const struct btree_node* node = tree->root;
+    const struct btree_node* left = NULL;
+    int i;
+
+    // Keys less than the bound are in the child reached, or else all in the nearest subtree on its left
+    while(!node->leaf)
+    {
+        i = key == NULL ? node->num_keys : lower_bound(tree, node, key);
+        if(i > 0)
+            left = node_children(node)[i - 1];
+        node = node_children(node)[i];
+    }
+
+    i = key == NULL ? node->num_keys : lower_bound(tree, node, key);
+    if(i > 0)
+        return node->keys[i - 1];
+    if(left == NULL)
+        return NULL;
+
+    while(!left->leaf)
+        left = node_children(left)[left->num_keys];
+
+    return left->keys[left->num_keys - 1];
+}
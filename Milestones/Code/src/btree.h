@@ -0,0 +1,161 @@
+/**
+ * @file
+ * @brief This file declares the B+trees behind the ordered indexes of a
+ * table: the ordered key index of tables declared with "keys=ordered" and
+ * the indexes on int columns.
+ *
+ * A tree holds fixed size keys of up to BTREE_KEY_SIZE bytes, in the order
+ * of a comparison function given when it is created. Internal nodes only
+ * route a search, while the leaves hold every key in order and are linked
+ * to the next leaf, so a range scan seeks its first key once and then
+ * walks the leaves sequentially.
+ */
+
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "storage.h"
+
+#define BTREE_KEY_SIZE MAX_KEY_LEN ///< Bytes of each key, enough for a record key and its null terminator.
+#define BTREE_MAX_KEYS 32 ///< Keys held by a full node.
+#define BTREE_MIN_KEYS (BTREE_MAX_KEYS / 2) ///< Keys held by any node but the root, after a delete.
+#define BTREE_MAX_HEIGHT 16 ///< Levels of the deepest tree, far more than BTREE_MIN_KEYS allows in memory.
+
+
+/**
+ * @brief A node of a B+tree, a whole leaf or the start of a btree_internal.
+ */
+struct btree_node {
+    int num_keys;
+    bool leaf;
+    struct btree_node* next; ///< The next leaf in key order, NULL for the last leaf and internal nodes.
+    char keys[BTREE_MAX_KEYS][BTREE_KEY_SIZE];
+};
+
+
+/**
+ * @brief An internal node of a B+tree, leaves having no children array.
+ *
+ * Subtree children[i] holds the keys from keys[i - 1] included to keys[i]
+ * excluded.
+ */
+struct btree_internal {
+    struct btree_node node;
+    struct btree_node* children[BTREE_MAX_KEYS + 1]; ///< num_keys + 1 subtrees.
+};
+
+
+/**
+ * @brief Compares two keys of a tree.
+ *
+ * @return Returns a negative number, zero or a positive number if the first key
+ * is respectively less than, equal to or greater than the second.
+ */
+typedef int (*btree_compare)(const void* a, const void* b);
+
+
+/**
+ * @brief A set of keys kept in order.
+ */
+struct btree {
+    btree_compare compare;
+    struct btree_node* root; ///< Always allocated, a leaf while the tree fits in one node.
+    int height; ///< Levels of internal nodes above the leaves.
+    size_t num_keys;
+    size_t bytes; ///< Memory allocated for the nodes.
+};
+
+
+/**
+ * @brief Position of a scan over the keys of a B+tree.
+ */
+struct btree_cursor {
+    const struct btree_node* leaf;
+    int index; ///< Next key of the leaf to return.
+};
+
+
+/**
+ * @brief Initializes an empty tree.
+ *
+ * @param tree The tree to initialize.
+ * @param compare The order of the keys, strcmp() for null terminated strings.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int btree_init(struct btree* tree, btree_compare compare);
+
+
+/**
+ * @brief Frees all the nodes of a tree.
+ */
+void btree_destroy(struct btree* tree);
+
+
+/**
+ * @brief Adds a key to a tree.
+ *
+ * Every node a split may need is allocated first, so a failure leaves the
+ * tree unchanged.
+ *
+ * @param tree The tree to modify.
+ * @param key The key, of which BTREE_KEY_SIZE bytes are copied.
+ * @return Returns 0 on success or if the key is already in the tree, -1 otherwise.
+ */
+int btree_insert(struct btree* tree, const void* key);
+
+
+/**
+ * @brief Removes a key from a tree.
+ *
+ * @param tree The tree to modify.
+ * @param key The key to remove.
+ * @return Returns 0 on success, -1 if the key is not in the tree.
+ */
+int btree_remove(struct btree* tree, const void* key);
+
+
+/**
+ * @brief Positions a cursor on the first key of a tree not less than a bound.
+ *
+ * @param tree The tree to scan.
+ * @param key The bound, or NULL to start from the first key.
+ * @param inclusive Whether a key equal to the bound is returned, or skipped.
+ * @param cursor The cursor to position.
+ */
+void btree_seek(const struct btree* tree, const void* key, bool inclusive, struct btree_cursor* cursor);
+
+
+/**
+ * @brief Returns the key under a cursor and advances it.
+ *
+ * The tree must not be modified while a cursor is in use.
+ *
+ * @return Returns the key, or NULL once past the last key.
+ */
+const void* btree_next(struct btree_cursor* cursor);
+
+
+/**
+ * @brief Returns the greatest key of a tree, found down its rightmost children.
+ *
+ * @return Returns the key, or NULL if the tree is empty.
+ */
+const void* btree_last(const struct btree* tree);
+
+
+/**
+ * @brief Returns the greatest key of a tree less than a bound.
+ *
+ * As leaves are only linked forward, each call descends from the root, so
+ * walking the keys backwards costs a search per key.
+ *
+ * @param tree The tree to search.
+ * @param key The bound, or NULL to return the greatest key of the tree.
+ * @return Returns the key, or NULL if no key is less than the bound.
+ */
+const void* btree_before(const struct btree* tree, const void* key);
+
+
+#endif
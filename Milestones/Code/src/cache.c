@@ -0,0 +1,167 @@
+/**
+ * @file
+ * @brief This file implements the result caches declared in cache.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "hash.h"
+
+
+struct result_cache* result_cache_create(void)
+{
+    return (struct result_cache*) calloc(1, sizeof(struct result_cache));
+}
+
+
+void result_cache_destroy(struct result_cache* cache)
+{
+    int i;
+
+    for(i = 0; i < cache->num_results; i++)
+    {
+        free(cache->results[i].predicates);
+        free(cache->results[i].matched_keys);
+    }
+    free(cache);
+}
+
+
+/**
+ * @brief Returns the hash of a query, that of its predicates mixed with its maximum number of keys.
+ */
+static uint64_t query_hash(const char* predicates, int max_keys)
+{
+    return hash_string(predicates) ^ ((uint64_t) (unsigned) max_keys * 0x9e3779b97f4a7c15ull);
+}
+
+
+/**
+ * @brief Finds the result of a query whatever its version, NULL if not cached.
+ */
+static struct cached_result* lookup(struct result_cache* cache, uint64_t hash, const char* predicates, int max_keys)
+{
+    struct cached_result* result;
+
+    for(result = cache->buckets[hash & (RESULT_CACHE_BUCKETS - 1)]; result != NULL; result = result->next)
+        if(result->hash == hash && result->max_keys == max_keys && strcmp(result->predicates, predicates) == 0)
+            return result;
+
+    return NULL;
+}
+
+
+/**
+ * @brief Takes a result out of the recency list.
+ */
+static void unlink_recent(struct result_cache* cache, struct cached_result* result)
+{
+    if(result->newer != NULL)
+        result->newer->older = result->older;
+    else
+        cache->newest = result->older;
+
+    if(result->older != NULL)
+        result->older->newer = result->newer;
+    else
+        cache->oldest = result->newer;
+}
+
+
+/**
+ * @brief Puts a result at the head of the recency list, as the most recently used.
+ */
+static void push_newest(struct result_cache* cache, struct cached_result* result)
+{
+    result->newer = NULL;
+    result->older = cache->newest;
+    if(cache->newest != NULL)
+        cache->newest->newer = result;
+    else
+        cache->oldest = result;
+    cache->newest = result;
+}
+
+
+/**
+ * @brief Takes a result out of its hash chain.
+ */
+static void unlink_bucket(struct result_cache* cache, struct cached_result* result)
+{
+    struct cached_result** link = &cache->buckets[result->hash & (RESULT_CACHE_BUCKETS - 1)];
+
+    while(*link != result)
+        link = &(*link)->next;
+    *link = result->next;
+}
+
+
+const struct cached_result* result_cache_find(struct result_cache* cache, const char* predicates, int max_keys, unsigned long long version)
+{
+    struct cached_result* result = lookup(cache, query_hash(predicates, max_keys), predicates, max_keys);
+
+    // A stale result stays until the query is run again and replaces it
+    if(result == NULL || result->version != version)
+    {
+        cache->misses++;
+        return NULL;
+    }
+
+    cache->hits++;
+    unlink_recent(cache, result);
+    push_newest(cache, result);
+
+    return result;
+}
+
+
+int result_cache_add(struct result_cache* cache, const char* predicates, int max_keys, unsigned long long version,
+        int num_matches, const char* matched_keys)
+{
+    uint64_t hash = query_hash(predicates, max_keys);
+    struct cached_result* result = lookup(cache, hash, predicates, max_keys);
+    char* keys = strdup(matched_keys);
+    char* text = result == NULL ? strdup(predicates) : NULL;
+
+    if(keys == NULL || (result == NULL && text == NULL))
+    {
+        free(keys);
+        free(text);
+        return -1;
+    }
+
+    if(result != NULL)
+    {
+        // The stale result of the same query is refreshed in place
+        free(result->matched_keys);
+        unlink_recent(cache, result);
+    }
+    else
+    {
+        if(cache->num_results < RESULT_CACHE_SIZE)
+            result = &cache->results[cache->num_results++];
+        else
+        {
+            result = cache->oldest;
+            unlink_recent(cache, result);
+            unlink_bucket(cache, result);
+            free(result->predicates);
+            free(result->matched_keys);
+            cache->evictions++;
+        }
+
+        result->hash = hash;
+        result->predicates = text;
+        result->max_keys = max_keys;
+        result->next = cache->buckets[hash & (RESULT_CACHE_BUCKETS - 1)];
+        cache->buckets[hash & (RESULT_CACHE_BUCKETS - 1)] = result;
+    }
+
+    result->version = version;
+    result->num_matches = num_matches;
+    result->matched_keys = keys;
+    push_newest(cache, result);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file
+ * @brief This file declares the caches of query results.
+ *
+ * The reply to a query is cached under its normalized predicates and
+ * maximum number of keys, along with the version of the table it was read
+ * from. A result is only returned while the table still has that version,
+ * so any change to the table invalidates the results of all its queries
+ * without visiting them. The least recently used result is evicted to make
+ * room for a new one.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+
+#define RESULT_CACHE_SIZE 64 ///< Query results cached per table.
+#define RESULT_CACHE_BUCKETS 128 ///< Hash chains of a result cache, a power of two.
+
+
+/**
+ * @brief The reply to a query, cached under its predicates and maximum number of keys.
+ */
+struct cached_result {
+    uint64_t hash; ///< Hash of the predicates.
+    char* predicates; ///< The normalized predicates, NULL for an unused result.
+    int max_keys;
+    unsigned long long version; ///< The version of the table the result was read from.
+    int num_matches; ///< Number of matching records.
+    char* matched_keys; ///< The first max_keys matching keys, separated by ", ".
+    struct cached_result* next; ///< The next result of the same hash chain.
+    struct cached_result* newer; ///< The result used next after this one, NULL for the most recent.
+    struct cached_result* older; ///< The result used last before this one, NULL for the least recent.
+};
+
+
+/**
+ * @brief The results of the last queries of a table.
+ */
+struct result_cache {
+    struct cached_result results[RESULT_CACHE_SIZE];
+    struct cached_result* buckets[RESULT_CACHE_BUCKETS]; ///< The results by hash of their predicates.
+    struct cached_result* newest; ///< The most recently used result.
+    struct cached_result* oldest; ///< The least recently used result, evicted first.
+    int num_results; ///< Results in use, the first ones of results.
+    unsigned long long hits; ///< Queries answered from the cache.
+    unsigned long long misses; ///< Queries run, including those whose result was stale.
+    unsigned long long evictions; ///< Results dropped to make room for others.
+};
+
+
+/**
+ * @brief Allocates an empty result cache.
+ *
+ * @return Returns the cache on success, NULL otherwise.
+ */
+struct result_cache* result_cache_create(void);
+
+
+/**
+ * @brief Frees a result cache and its results.
+ */
+void result_cache_destroy(struct result_cache* cache);
+
+
+/**
+ * @brief Finds the result of a query, and counts a hit or a miss.
+ *
+ * @param cache The result cache of the queried table.
+ * @param predicates The normalized predicates of the query.
+ * @param max_keys The maximum number of keys of the reply.
+ * @param version The current version of the table.
+ * @return Returns the result if cached for this version of the table, NULL otherwise.
+ */
+const struct cached_result* result_cache_find(struct result_cache* cache, const char* predicates, int max_keys, unsigned long long version);
+
+
+/**
+ * @brief Caches the result of a query, replacing a stale one or evicting the least recently used.
+ *
+ * @param cache The result cache of the queried table.
+ * @param predicates The normalized predicates of the query.
+ * @param max_keys The maximum number of keys of the reply.
+ * @param version The version of the table the result was read from.
+ * @param num_matches Number of matching records.
+ * @param matched_keys The keys of the reply.
+ * @return Returns 0 on success, -1 if out of memory, the result then not cached.
+ */
+int result_cache_add(struct result_cache* cache, const char* predicates, int max_keys, unsigned long long version,
+        int num_matches, const char* matched_keys);
+
+
+#endif
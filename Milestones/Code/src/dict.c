@@ -0,0 +1,350 @@
+/**
+ * @file
+ * @brief This file implements the dictionaries declared in dict.h.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dict.h"
+
+#define DICT_SPREAD (INT64_C(1) << 31) ///< Range of the codes given by a respacing, centered on 0 so values can be added at both ends.
+
+
+/**
+ * @brief A key of a dictionary, stored in the first bytes of a B+tree key.
+ */
+struct dict_key {
+    int32_t code; ///< DICT_NO_CODE for a probe by string.
+    const char* string; ///< The string of the value, NULL for a probe by code.
+};
+
+
+/**
+ * @brief Packs a code and a string into a B+tree key.
+ */
+static void make_key(char* key, int32_t code, const char* string)
+{
+    struct dict_key fields = {code, string};
+
+    memset(key, 0, BTREE_KEY_SIZE);
+    memcpy(key, &fields, sizeof fields);
+}
+
+
+/**
+ * @brief Unpacks a B+tree key, whose bytes may not be aligned.
+ */
+static struct dict_key read_key(const void* key)
+{
+    struct dict_key fields;
+
+    memcpy(&fields, key, sizeof fields);
+    return fields;
+}
+
+
+/**
+ * @brief Orders dictionary keys by code, or by string against a probe by string.
+ *
+ * Both orders agree on the keys of a dictionary, so a probe by string
+ * descends the tree like a probe by code.
+ */
+static int compare_dict_keys(const void* a, const void* b)
+{
+    struct dict_key first = read_key(a), second = read_key(b);
+
+    if(first.code == DICT_NO_CODE || second.code == DICT_NO_CODE)
+        return strcmp(first.string, second.string);
+    return first.code < second.code ? -1 : first.code > second.code;
+}
+
+
+/**
+ * @brief Returns the value holding a string of a dictionary.
+ */
+static struct dict_value* value_of(const char* string)
+{
+    return (struct dict_value*) (string - offsetof(struct dict_value, string));
+}
+
+
+/**
+ * @brief Returns the bytes allocated for a value.
+ */
+static size_t value_size(const struct dict_value* value)
+{
+    return sizeof(struct dict_value) + strlen(value->string) + 1;
+}
+
+
+/**
+ * @brief Finds the key of the first value not less than a string.
+ *
+ * @return Returns the key, or NULL if every value is less than the string.
+ */
+static const void* seek_string(const struct dictionary* dict, const char* string)
+{
+    struct btree_cursor cursor;
+    char probe[BTREE_KEY_SIZE];
+
+    make_key(probe, DICT_NO_CODE, string);
+    btree_seek(&dict->tree, probe, true, &cursor);
+
+    return btree_next(&cursor);
+}
+
+
+/**
+ * @brief Finds the key of a code.
+ *
+ * @return Returns the key, or NULL if no value has the code.
+ */
+static const void* seek_code(const struct dictionary* dict, int32_t code)
+{
+    struct btree_cursor cursor;
+    char probe[BTREE_KEY_SIZE];
+    const void* key;
+
+    make_key(probe, code, NULL);
+    btree_seek(&dict->tree, probe, true, &cursor);
+
+    return (key = btree_next(&cursor)) != NULL && read_key(key).code == code ? key : NULL;
+}
+
+
+/**
+ * @brief Chooses the code of a value added between two keys.
+ *
+ * A value between two others takes the middle code, and a value past
+ * either end the code one gap away, so values appended in order use up
+ * the codes no faster than the respacing left them.
+ *
+ * @param before The key of the previous value, NULL for a new first value.
+ * @param after The key of the next value, NULL for a new last value.
+ * @param code Where the code is stored.
+ * @return Returns 0 on success, -1 if no code is left between the keys.
+ */
+static int free_code(const struct dictionary* dict, const void* before, const void* after, int32_t* code)
+{
+    int64_t low = before != NULL ? read_key(before).code : DICT_NO_CODE;
+    int64_t high = after != NULL ? read_key(after).code : DICT_END_CODE;
+    int64_t half = (high - low) / 2;
+
+    if(half < 1)
+        return -1;
+
+    if(before == NULL && after == NULL)
+        *code = 0;
+    else if(before != NULL && after != NULL)
+        *code = (int32_t) (low + half);
+    else if(after == NULL)
+        *code = (int32_t) (low + (half < dict->gap ? half : dict->gap));
+    else
+        *code = (int32_t) (high - (half < dict->gap ? half : dict->gap));
+
+    return 0;
+}
+
+
+/**
+ * @brief Rebuilds the tree of a dictionary without its unused values, and respaces their codes if asked.
+ *
+ * The new tree is built before the old one is freed, so a failure leaves
+ * the dictionary unchanged.
+ *
+ * @param codes The codes of the column, rewritten with the new codes if respaced.
+ * @param num_rows Number of codes in the column.
+ * @param respace Whether the values are given new codes, spread evenly over DICT_SPREAD codes.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int rebuild(struct dictionary* dict, int32_t* codes, int num_rows, bool respace)
+{
+    int num_used = dict->num_values - dict->num_unused, i = 0, row, low, high, middle;
+    int64_t step = DICT_SPREAD / (num_used + 1);
+    int32_t* old_codes = (int32_t*) malloc((num_used > 0 ? num_used : 1) * sizeof(int32_t));
+    char new_key[BTREE_KEY_SIZE];
+    struct btree_cursor cursor;
+    struct btree tree;
+    const void* key;
+
+    if(old_codes == NULL || btree_init(&tree, compare_dict_keys) != 0)
+    {
+        free(old_codes);
+        return -1;
+    }
+
+    // The i-th value in use takes code -DICT_SPREAD / 2 + (i + 1) * step when respaced
+    btree_seek(&dict->tree, NULL, true, &cursor);
+    while((key = btree_next(&cursor)) != NULL)
+    {
+        struct dict_key fields = read_key(key);
+
+        if(value_of(fields.string)->count == 0)
+            continue;
+
+        old_codes[i] = fields.code;
+        make_key(new_key, respace ? (int32_t) (-DICT_SPREAD / 2 + (i + 1) * step) : fields.code, fields.string);
+        if(btree_insert(&tree, new_key) != 0)
+        {
+            btree_destroy(&tree);
+            free(old_codes);
+            return -1;
+        }
+        i++;
+    }
+
+    btree_seek(&dict->tree, NULL, true, &cursor);
+    while((key = btree_next(&cursor)) != NULL)
+    {
+        struct dict_value* value = value_of(read_key(key).string);
+
+        if(value->count == 0)
+        {
+            dict->bytes -= value_size(value);
+            free(value);
+        }
+    }
+
+    // Old codes are sorted, so each field finds the rank of its value by a binary search
+    for(row = 0; respace && row < num_rows; row++)
+    {
+        if(codes[row] == DICT_NO_CODE)
+            continue;
+
+        for(low = 0, high = num_used; low < high; )
+        {
+            middle = low + (high - low) / 2;
+            if(old_codes[middle] < codes[row])
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        codes[row] = (int32_t) (-DICT_SPREAD / 2 + (low + 1) * step);
+    }
+
+    free(old_codes);
+    btree_destroy(&dict->tree);
+    dict->tree = tree;
+    dict->num_values = num_used;
+    dict->num_unused = 0;
+    if(respace)
+    {
+        dict->gap = step;
+        dict->reencodes++;
+    }
+
+    return 0;
+}
+
+
+int dict_init(struct dictionary* dict)
+{
+    memset(dict, 0, sizeof *dict);
+    dict->gap = DICT_INITIAL_GAP;
+
+    return btree_init(&dict->tree, compare_dict_keys);
+}
+
+
+void dict_destroy(struct dictionary* dict)
+{
+    struct btree_cursor cursor;
+    const void* key;
+
+    btree_seek(&dict->tree, NULL, true, &cursor);
+    while((key = btree_next(&cursor)) != NULL)
+        free(value_of(read_key(key).string));
+    btree_destroy(&dict->tree);
+}
+
+
+int dict_encode(struct dictionary* dict, const char* string, int32_t* codes, int num_rows, int32_t* code)
+{
+    const void* after = seek_string(dict, string);
+    size_t length = strlen(string);
+    char key[BTREE_KEY_SIZE];
+    struct dict_value* value;
+
+    if(after != NULL && strcmp(read_key(after).string, string) == 0)
+    {
+        value = value_of(read_key(after).string);
+        if(value->count++ == 0)
+            dict->num_unused--;
+        *code = read_key(after).code;
+        return 0;
+    }
+
+    if((value = (struct dict_value*) malloc(sizeof(struct dict_value) + length + 1)) == NULL)
+        return -1;
+    value->count = 1;
+    memcpy(value->string, string, length + 1);
+
+    // Without a free code between the neighbours of the value, every value is respaced first, which leaves room
+    make_key(key, DICT_NO_CODE, string);
+    if(free_code(dict, btree_before(&dict->tree, key), after, code) != 0)
+    {
+        if(rebuild(dict, codes, num_rows, true) != 0)
+        {
+            free(value);
+            return -1;
+        }
+        free_code(dict, btree_before(&dict->tree, key), seek_string(dict, string), code);
+    }
+
+    make_key(key, *code, value->string);
+    if(btree_insert(&dict->tree, key) != 0)
+    {
+        free(value);
+        return -1;
+    }
+
+    dict->num_values++;
+    dict->bytes += value_size(value);
+
+    return 0;
+}
+
+
+void dict_release(struct dictionary* dict, int32_t code)
+{
+    const void* key;
+
+    if(code == DICT_NO_CODE || (key = seek_code(dict, code)) == NULL)
+        return;
+
+    if(--value_of(read_key(key).string)->count > 0)
+        return;
+
+    // Failing to rebuild only keeps the unused values longer
+    dict->num_unused++;
+    if(dict->num_unused > dict->num_values - dict->num_unused + DICT_MIN_UNUSED)
+        rebuild(dict, NULL, 0, false);
+}
+
+
+const char* dict_decode(const struct dictionary* dict, int32_t code)
+{
+    const void* key;
+
+    if(code == DICT_NO_CODE || (key = seek_code(dict, code)) == NULL)
+        return "";
+
+    return read_key(key).string;
+}
+
+
+int32_t dict_lower_bound(const struct dictionary* dict, const char* string, bool* equal)
+{
+    const void* key = seek_string(dict, string);
+
+    *equal = key != NULL && strcmp(read_key(key).string, string) == 0;
+
+    return key != NULL ? read_key(key).code : DICT_END_CODE;
+}
+
+
+size_t dict_bytes(const struct dictionary* dict)
+{
+    return dict->bytes + dict->tree.bytes;
+}
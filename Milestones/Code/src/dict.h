@@ -0,0 +1,119 @@
+/**
+ * @file
+ * @brief This file declares the order-preserving dictionaries that encode
+ * the char[n] columns of tables stored by columns.
+ *
+ * Each distinct value of a column gets an int code, and the column holds
+ * the 4-byte code of each row instead of its n bytes. Codes are ordered as
+ * their values are, so "name < Tor" holds for the rows whose code is less
+ * than that of the first value not less than "Tor", and a string predicate
+ * becomes an int range the kernels of kernel.h compare as fast as any int
+ * column. A column of few distinct values, such as a province, shrinks to
+ * its codes and one copy of each value.
+ *
+ * Codes are spread apart, so a new value takes a free code between those
+ * of its neighbours. Once no code is left between them, every value is
+ * given a new code, evenly spaced, and the column is rewritten with them.
+ * A value no row holds any more stays in the dictionary, harmless to
+ * queries, until the values left unused outnumber those in use, when the
+ * dictionary is rebuilt without them.
+ */
+
+#ifndef DICT_H
+#define DICT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "btree.h"
+
+#define DICT_NO_CODE INT32_MIN ///< Code of a field without a value, decoded as the empty string.
+#define DICT_END_CODE INT32_MAX ///< Bound greater than every code.
+#define DICT_INITIAL_GAP (1 << 20) ///< Distance between the codes of values appended to a new dictionary.
+#define DICT_MIN_UNUSED 64 ///< Unused values always kept before a rebuild.
+
+
+/**
+ * @brief A value of a dictionary.
+ */
+struct dict_value {
+    int count; ///< Fields holding the value, 0 once unused.
+    char string[]; ///< The null terminated value.
+};
+
+
+/**
+ * @brief The dictionary of a column.
+ */
+struct dictionary {
+    struct btree tree; ///< The (code, value) pairs, in the order of both.
+    int num_values; ///< Values in the tree, unused ones included.
+    int num_unused; ///< Values no field holds.
+    int32_t gap; ///< Distance between the codes of values appended before the first value or after the last.
+    size_t bytes; ///< Memory allocated for the values, the tree excluded.
+    unsigned long long reencodes; ///< Times the column was rewritten with new codes.
+};
+
+
+/**
+ * @brief Initializes an empty dictionary.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int dict_init(struct dictionary* dict);
+
+
+/**
+ * @brief Frees the values and the tree of a dictionary.
+ */
+void dict_destroy(struct dictionary* dict);
+
+
+/**
+ * @brief Returns the code of a value for one more field holding it, adding the value if new.
+ *
+ * Adding a value may give every value a new code, in which case the codes
+ * of the column are rewritten. The code returned is valid until the next
+ * call.
+ *
+ * @param string The value.
+ * @param codes The codes of the column, DICT_NO_CODE for fields without a value.
+ * @param num_rows Number of codes in the column.
+ * @param code Where the code of the value is stored.
+ * @return Returns 0 on success, -1 otherwise in which case the value is not counted, though the codes may have been respaced.
+ */
+int dict_encode(struct dictionary* dict, const char* string, int32_t* codes, int num_rows, int32_t* code);
+
+
+/**
+ * @brief Counts one less field holding the value of a code.
+ *
+ * @param code The code, ignored if DICT_NO_CODE.
+ */
+void dict_release(struct dictionary* dict, int32_t code);
+
+
+/**
+ * @brief Returns the value of a code.
+ *
+ * @return Returns the value, the empty string for DICT_NO_CODE.
+ */
+const char* dict_decode(const struct dictionary* dict, int32_t code);
+
+
+/**
+ * @brief Finds the first value of a dictionary not less than a string.
+ *
+ * @param string The string.
+ * @param equal Where whether the value found is the string itself is stored.
+ * @return Returns the code of the value, or DICT_END_CODE if every value is less than the string.
+ */
+int32_t dict_lower_bound(const struct dictionary* dict, const char* string, bool* equal);
+
+
+/**
+ * @brief Returns the memory of a dictionary, its tree included.
+ */
+size_t dict_bytes(const struct dictionary* dict);
+
+
+#endif
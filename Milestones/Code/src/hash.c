@@ -0,0 +1,82 @@
+/**
+ * @file
+ * @brief This file implements SipHash-1-3 as declared in hash.h.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "hash.h"
+
+
+/**
+ * @brief The 128-bit key of the hash function.
+ */
+static uint64_t seed[2] = {0x736f6d6570736575ULL, 0x646f72616e646f6dULL};
+
+
+#define ROTATE(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND \
+    { \
+        v0 += v1; v1 = ROTATE(v1, 13); v1 ^= v0; v0 = ROTATE(v0, 32); \
+        v2 += v3; v3 = ROTATE(v3, 16); v3 ^= v2; \
+        v0 += v3; v3 = ROTATE(v3, 21); v3 ^= v0; \
+        v2 += v1; v1 = ROTATE(v1, 17); v1 ^= v2; v2 = ROTATE(v2, 32); \
+    }
+
+
+void hash_seed_init(void)
+{
+    FILE* random = fopen("/dev/urandom", "r");
+
+    if(random == NULL || fread(seed, sizeof seed, 1, random) != 1)
+    {
+        seed[0] ^= (uint64_t) time(NULL);
+        seed[1] ^= (uint64_t) getpid() << 32;
+    }
+
+    if(random != NULL)
+        fclose(random);
+}
+
+
+uint64_t hash_bytes(const void* data, size_t length)
+{
+    const unsigned char* in = (const unsigned char*) data;
+    const unsigned char* end = in + (length & ~(size_t) 7);
+    uint64_t v0 = seed[0] ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = seed[1] ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = seed[0] ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = seed[1] ^ 0x7465646279746573ULL;
+    uint64_t b = (uint64_t) length << 56;
+    uint64_t m;
+    int i;
+
+    // One compression round per 8-byte little endian word
+    for(; in != end; in += 8)
+    {
+        m = 0;
+        for(i = 0; i < 8; i++)
+            m |= (uint64_t) in[i] << (8 * i);
+        v3 ^= m;
+        SIPROUND;
+        v0 ^= m;
+    }
+
+    // The remaining bytes go in the last word along with the length
+    for(i = 0; i < (int) (length & 7); i++)
+        b |= (uint64_t) in[i] << (8 * i);
+
+    v3 ^= b;
+    SIPROUND;
+    v0 ^= b;
+
+    // Three finalization rounds
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+
+    return v0 ^ v1 ^ v2 ^ v3;
+}
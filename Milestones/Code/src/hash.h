@@ -0,0 +1,45 @@
+/**
+ * @file
+ * @brief This file declares the hash function used for table names and keys.
+ *
+ * Strings are hashed with SipHash-1-3 keyed by a random seed chosen when
+ * the server starts, so clients cannot precompute keys that all collide.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+
+/**
+ * @brief Seeds the hash function from the system's random source.
+ *
+ * Must be called before any table is created. Falls back to the time and
+ * process id if no random source is available.
+ */
+void hash_seed_init(void);
+
+
+/**
+ * @brief Hashes a sequence of bytes.
+ *
+ * @param data The bytes to hash.
+ * @param length Number of bytes.
+ * @return Returns the 64-bit hash.
+ */
+uint64_t hash_bytes(const void* data, size_t length);
+
+
+/**
+ * @brief Hashes a null terminated string.
+ */
+static inline uint64_t hash_string(const char* string)
+{
+    return hash_bytes(string, strlen(string));
+}
+
+
+#endif
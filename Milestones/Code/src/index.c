@@ -0,0 +1,549 @@
+/**
+ * @file
+ * @brief This file implements the secondary indexes declared in index.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "index.h"
+#include "hash.h"
+
+
+/**
+ * @brief A key of an index, stored in the first bytes of a B+tree key.
+ */
+struct index_key {
+    int32_t value;
+    uintptr_t record;
+};
+
+
+/**
+ * @brief Packs a value and a record address into a B+tree key.
+ */
+static void make_key(char* key, int32_t value, uintptr_t record)
+{
+    struct index_key fields = {value, record};
+
+    memset(key, 0, BTREE_KEY_SIZE);
+    memcpy(key, &fields, sizeof fields);
+}
+
+
+/**
+ * @brief Unpacks a B+tree key, whose bytes may not be aligned.
+ */
+static struct index_key read_key(const void* key)
+{
+    struct index_key fields;
+
+    memcpy(&fields, key, sizeof fields);
+    return fields;
+}
+
+
+/**
+ * @brief Orders index keys by value, then by record address.
+ */
+static int compare_index_keys(const void* a, const void* b)
+{
+    struct index_key first = read_key(a), second = read_key(b);
+
+    if(first.value != second.value)
+        return first.value < second.value ? -1 : 1;
+    if(first.record != second.record)
+        return first.record < second.record ? -1 : 1;
+    return 0;
+}
+
+
+/**
+ * @brief Reads an int field, whose bytes may not be aligned.
+ */
+static int32_t read_int(const void* field)
+{
+    int32_t value;
+
+    memcpy(&value, field, sizeof value);
+    return value;
+}
+
+
+/**
+ * @brief Returns the home slot of a record address in a set of records.
+ */
+static int record_slot(const struct record* record, int capacity)
+{
+    return (int) (((uint64_t) (uintptr_t) record * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+}
+
+
+/**
+ * @brief Checks whether an entry probed past a hole may move into it.
+ *
+ * Linear probing needs no deleted markers: on a delete, each following
+ * entry moves back into the hole unless its home slot lies after the hole.
+ *
+ * @param home The home slot of the entry.
+ * @param slot The slot holding the entry.
+ * @param hole The empty slot.
+ */
+static bool fills_hole(int home, int slot, int hole, int capacity)
+{
+    return ((slot - home) & (capacity - 1)) >= ((slot - hole) & (capacity - 1));
+}
+
+
+/**
+ * @brief Reallocates the set of records of a posting.
+ *
+ * @return Returns 0 on success, -1 otherwise in which case the set is unchanged.
+ */
+static int records_resize(struct column_index* index, struct posting* posting, int capacity)
+{
+    struct record** records = (struct record**) calloc(capacity, sizeof(struct record*));
+    int i, slot;
+
+    if(records == NULL)
+        return -1;
+
+    for(i = 0; i < posting->capacity; i++)
+        if(posting->records[i] != NULL)
+        {
+            for(slot = record_slot(posting->records[i], capacity); records[slot] != NULL; slot = (slot + 1) & (capacity - 1))
+                ;
+            records[slot] = posting->records[i];
+        }
+
+    free(posting->records);
+    index->bytes += (capacity - posting->capacity) * sizeof(struct record*);
+    posting->records = records;
+    posting->capacity = capacity;
+
+    return 0;
+}
+
+
+/**
+ * @brief Adds a record to the set of records of a posting.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int records_add(struct column_index* index, struct posting* posting, struct record* record)
+{
+    int slot;
+
+    if((posting->count + 1) * 4 > posting->capacity * 3
+            && records_resize(index, posting, posting->capacity == 0 ? INDEX_MIN_CAPACITY : posting->capacity * 2) != 0)
+        return -1;
+
+    for(slot = record_slot(record, posting->capacity); posting->records[slot] != NULL; slot = (slot + 1) & (posting->capacity - 1))
+        if(posting->records[slot] == record)
+            return 0;
+
+    posting->records[slot] = record;
+    posting->count++;
+
+    return 0;
+}
+
+
+/**
+ * @brief Removes a record from the set of records of a posting.
+ *
+ * @return Returns 0 on success, -1 if the record is not in the set.
+ */
+static int records_remove(struct column_index* index, struct posting* posting, struct record* record)
+{
+    int slot, hole, mask = posting->capacity - 1;
+
+    for(hole = record_slot(record, posting->capacity); posting->records[hole] != record; hole = (hole + 1) & mask)
+        if(posting->records[hole] == NULL)
+            return -1;
+
+    for(slot = (hole + 1) & mask; posting->records[slot] != NULL; slot = (slot + 1) & mask)
+        if(fills_hole(record_slot(posting->records[slot], posting->capacity), slot, hole, posting->capacity))
+        {
+            posting->records[hole] = posting->records[slot];
+            hole = slot;
+        }
+
+    posting->records[hole] = NULL;
+    posting->count--;
+
+    // The set shrinks with its records, so a scan of its slots stays proportional to its records
+    if(posting->capacity > INDEX_MIN_CAPACITY && posting->count * 8 < posting->capacity)
+        records_resize(index, posting, posting->capacity / 2);
+
+    return 0;
+}
+
+
+/**
+ * @brief Finds the posting of a value in a hashed index.
+ *
+ * @return Returns its slot in the postings, -1 if no record holds the value.
+ */
+static int find_posting(const struct column_index* index, const char* value, uint64_t hash)
+{
+    int slot;
+
+    if(index->capacity == 0)
+        return -1;
+
+    for(slot = hash & (index->capacity - 1); index->postings[slot] != NULL; slot = (slot + 1) & (index->capacity - 1))
+        if(index->postings[slot]->hash == hash && strcmp(index->postings[slot]->value, value) == 0)
+            return slot;
+
+    return -1;
+}
+
+
+/**
+ * @brief Reallocates the postings of a hashed index.
+ *
+ * @return Returns 0 on success, -1 otherwise in which case the postings are unchanged.
+ */
+static int postings_resize(struct column_index* index, int capacity)
+{
+    struct posting** postings = (struct posting**) calloc(capacity, sizeof(struct posting*));
+    int i, slot;
+
+    if(postings == NULL)
+        return -1;
+
+    for(i = 0; i < index->capacity; i++)
+        if(index->postings[i] != NULL)
+        {
+            for(slot = index->postings[i]->hash & (capacity - 1); postings[slot] != NULL; slot = (slot + 1) & (capacity - 1))
+                ;
+            postings[slot] = index->postings[i];
+        }
+
+    free(index->postings);
+    index->bytes += (capacity - index->capacity) * sizeof(struct posting*);
+    index->postings = postings;
+    index->capacity = capacity;
+
+    return 0;
+}
+
+
+/**
+ * @brief Frees the posting in a slot of a hashed index, once it holds no record.
+ */
+static void postings_erase(struct column_index* index, int hole)
+{
+    int slot, mask = index->capacity - 1;
+
+    index->bytes -= sizeof(struct posting) + strlen(index->postings[hole]->value) + 1 + index->postings[hole]->capacity * sizeof(struct record*);
+    free(index->postings[hole]->records);
+    free(index->postings[hole]);
+
+    for(slot = (hole + 1) & mask; index->postings[slot] != NULL; slot = (slot + 1) & mask)
+        if(fills_hole(index->postings[slot]->hash & mask, slot, hole, index->capacity))
+        {
+            index->postings[hole] = index->postings[slot];
+            hole = slot;
+        }
+
+    index->postings[hole] = NULL;
+    index->count--;
+
+    if(index->capacity > INDEX_MIN_CAPACITY && index->count * 8 < index->capacity)
+        postings_resize(index, index->capacity / 2);
+}
+
+
+/**
+ * @brief Adds a record to the posting of its value in a hashed index.
+ *
+ * @return Returns 0 on success, -1 otherwise in which case the index is unchanged.
+ */
+static int hashed_insert(struct column_index* index, const char* value, struct record* record)
+{
+    uint64_t hash = hash_string(value);
+    int slot = find_posting(index, value, hash);
+    struct posting* posting;
+
+    if(slot >= 0)
+        return records_add(index, index->postings[slot], record);
+
+    // A value held by no record yet gets its own posting
+    if((index->count + 1) * 4 > index->capacity * 3
+            && postings_resize(index, index->capacity == 0 ? INDEX_MIN_CAPACITY : index->capacity * 2) != 0)
+        return -1;
+
+    posting = (struct posting*) malloc(sizeof(struct posting) + strlen(value) + 1);
+    if(posting == NULL)
+        return -1;
+
+    posting->hash = hash;
+    posting->records = NULL;
+    posting->capacity = 0;
+    posting->count = 0;
+    strcpy(posting->value, value);
+
+    if(records_add(index, posting, record) != 0)
+    {
+        free(posting);
+        return -1;
+    }
+
+    for(slot = hash & (index->capacity - 1); index->postings[slot] != NULL; slot = (slot + 1) & (index->capacity - 1))
+        ;
+    index->postings[slot] = posting;
+    index->count++;
+    index->bytes += sizeof(struct posting) + strlen(value) + 1;
+
+    return 0;
+}
+
+
+/**
+ * @brief Removes a record from the posting of its value in a hashed index.
+ *
+ * @return Returns 0 on success, -1 if the record is not indexed under this value.
+ */
+static int hashed_remove(struct column_index* index, const char* value, struct record* record)
+{
+    int slot = find_posting(index, value, hash_string(value));
+
+    if(slot < 0 || records_remove(index, index->postings[slot], record) != 0)
+        return -1;
+
+    if(index->postings[slot]->count == 0)
+        postings_erase(index, slot);
+
+    return 0;
+}
+
+
+struct column_index* index_create(int column_id, bool hashed)
+{
+    struct column_index* index = (struct column_index*) malloc(sizeof(struct column_index));
+
+    if(index == NULL)
+        return NULL;
+
+    index->column_id = column_id;
+    index->hashed = hashed;
+    index->postings = NULL;
+    index->capacity = 0;
+    index->count = 0;
+    index->bytes = 0;
+
+    if(!hashed && btree_init(&index->tree, compare_index_keys) != 0)
+    {
+        free(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+
+void index_free(struct column_index* index)
+{
+    int i;
+
+    if(!index->hashed)
+        btree_destroy(&index->tree);
+
+    for(i = 0; i < index->capacity; i++)
+        if(index->postings[i] != NULL)
+        {
+            free(index->postings[i]->records);
+            free(index->postings[i]);
+        }
+
+    free(index->postings);
+    free(index);
+}
+
+
+int index_insert(struct column_index* index, const char* field, struct record* record)
+{
+    char key[BTREE_KEY_SIZE];
+
+    if(index->hashed)
+        return hashed_insert(index, field, record);
+
+    make_key(key, read_int(field), (uintptr_t) record);
+    return btree_insert(&index->tree, key);
+}
+
+
+int index_remove(struct column_index* index, const char* field, struct record* record)
+{
+    char key[BTREE_KEY_SIZE];
+
+    if(index->hashed)
+        return hashed_remove(index, field, record);
+
+    make_key(key, read_int(field), (uintptr_t) record);
+    return btree_remove(&index->tree, key);
+}
+
+
+void index_seek(const struct column_index* index, char operator, const void* argument, struct index_cursor* cursor)
+{
+    char key[BTREE_KEY_SIZE];
+
+    cursor->operator = operator;
+    cursor->backward = NULL;
+    cursor->posting = NULL;
+    cursor->slot = 0;
+
+    if(index->hashed)
+    {
+        int slot = find_posting(index, argument, hash_string(argument));
+        cursor->posting = slot < 0 ? NULL : index->postings[slot];
+        cursor->cursor.leaf = NULL;
+        return;
+    }
+
+    cursor->argument = read_int(argument);
+
+    // Bounding the address skips or includes every record holding the argument itself
+    if(operator == '<')
+        btree_seek(&index->tree, NULL, true, &cursor->cursor);
+    else if(operator == '>')
+    {
+        make_key(key, cursor->argument, UINTPTR_MAX);
+        btree_seek(&index->tree, key, false, &cursor->cursor);
+    }
+    else
+    {
+        make_key(key, cursor->argument, 0);
+        btree_seek(&index->tree, key, true, &cursor->cursor);
+    }
+}
+
+
+void index_seek_order(const struct column_index* index, bool descending, struct index_cursor* cursor)
+{
+    cursor->operator = 0;
+    cursor->backward = descending ? &index->tree : NULL;
+    cursor->previous = NULL;
+    cursor->posting = NULL;
+    cursor->slot = 0;
+
+    btree_seek(&index->tree, NULL, true, &cursor->cursor);
+    if(descending)
+        cursor->cursor.leaf = NULL;
+}
+
+
+/**
+ * @brief Checks whether a key past the start of a scan is still in its range.
+ *
+ * Records greater than the argument are all matched, and others end at the first mismatch.
+ */
+static bool in_range(const struct index_cursor* cursor, const struct index_key* fields)
+{
+    return (cursor->operator != '<' || fields->value < cursor->argument) && (cursor->operator != '=' || fields->value == cursor->argument);
+}
+
+
+struct record* index_next(struct index_cursor* cursor)
+{
+    const void* key;
+    struct index_key fields;
+
+    if(cursor->posting != NULL)
+    {
+        while(cursor->slot < cursor->posting->capacity)
+            if(cursor->posting->records[cursor->slot++] != NULL)
+                return cursor->posting->records[cursor->slot - 1];
+
+        cursor->posting = NULL;
+        return NULL;
+    }
+
+    // A walk in decreasing order searches the pair before the last one returned
+    if(cursor->backward != NULL)
+    {
+        if((key = btree_before(cursor->backward, cursor->previous)) == NULL)
+        {
+            cursor->backward = NULL;
+            return NULL;
+        }
+
+        cursor->previous = key;
+        return (struct record*) read_key(key).record;
+    }
+
+    if((key = btree_next(&cursor->cursor)) == NULL)
+        return NULL;
+
+    fields = read_key(key);
+    if(!in_range(cursor, &fields))
+    {
+        cursor->cursor.leaf = NULL;
+        return NULL;
+    }
+
+    return (struct record*) fields.record;
+}
+
+
+int index_count(const struct column_index* index, char operator, const void* argument, int limit)
+{
+    struct index_cursor cursor;
+    int count = 0;
+
+    index_seek(index, operator, argument, &cursor);
+
+    if(index->hashed)
+    {
+        count = cursor.posting == NULL ? 0 : cursor.posting->count;
+        return count < limit ? count : limit;
+    }
+
+    // A leaf whose last key is in range is counted whole, without reading its other keys
+    while(count < limit && cursor.cursor.leaf != NULL)
+    {
+        const struct btree_node* leaf = cursor.cursor.leaf;
+        bool whole = false;
+
+        if(cursor.cursor.index < leaf->num_keys)
+        {
+            struct index_key last = read_key(leaf->keys[leaf->num_keys - 1]);
+            whole = in_range(&cursor, &last);
+        }
+
+        if(whole)
+        {
+            count += leaf->num_keys - cursor.cursor.index;
+            cursor.cursor.leaf = leaf->next;
+            cursor.cursor.index = 0;
+        }
+        else if(index_next(&cursor) != NULL)
+            count++;
+    }
+
+    return count < limit ? count : limit;
+}
+
+
+int index_bounds(const struct column_index* index, int32_t* min, int32_t* max)
+{
+    struct btree_cursor cursor;
+    const void* last;
+
+    if(index->hashed || (last = btree_last(&index->tree)) == NULL)
+        return -1;
+
+    btree_seek(&index->tree, NULL, true, &cursor);
+    *min = read_key(btree_next(&cursor)).value;
+    *max = read_key(last).value;
+
+    return 0;
+}
+
+
+size_t index_bytes(const struct column_index* index)
+{
+    return index->hashed ? index->bytes : index->tree.bytes;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file
+ * @brief This file declares the secondary indexes on columns, declared with
+ * the "index=<column>" table option.
+ *
+ * An int column is indexed by a B+tree of (value, record) pairs ordered by
+ * value then by record address, so that records sharing a value are still
+ * distinct keys. A predicate such as "grade > 90" seeks the first pair of
+ * its range and walks the leaves until the range ends.
+ *
+ * A char[n] column, only ever compared with '=', is indexed by a hash map
+ * from each distinct value to the set of records holding it, so that
+ * "province = Ontario" visits only its matches and knows their number
+ * without visiting them.
+ *
+ * Records are never moved once allocated, so both kinds of index hold
+ * their addresses and survive the compaction of the table entries untouched.
+ */
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stdint.h>
+#include "btree.h"
+
+#define INDEX_MIN_CAPACITY 4 ///< Slots of the smallest hash map or record set.
+
+struct record;
+
+
+/**
+ * @brief The records holding one value of a hashed column.
+ *
+ * The records are an open addressing set of addresses with linear probing,
+ * at most 3/4 full and resized so its slots stay proportional to its
+ * records.
+ */
+struct posting {
+    uint64_t hash; ///< Hash of the value.
+    struct record** records; ///< NULL for an empty slot.
+    int capacity; ///< Number of slots, a power of two.
+    int count; ///< Records in the set.
+    char value[]; ///< The null terminated value.
+};
+
+
+/**
+ * @brief An index on a column of a table.
+ */
+struct column_index {
+    int column_id;
+    bool hashed; ///< Whether the column is a char[n] column indexed by a hash map.
+    struct btree tree; ///< The (value, record) pairs of an int column.
+    struct posting** postings; ///< The values of a char[n] column, an open addressing map with linear probing.
+    int capacity; ///< Slots of the postings, a power of two.
+    int count; ///< Distinct values in the postings.
+    size_t bytes; ///< Memory allocated for the postings.
+};
+
+
+/**
+ * @brief Position of a scan over the records matching a predicate.
+ */
+struct index_cursor {
+    struct btree_cursor cursor; ///< Next pair of an ordered index.
+    const struct btree* backward; ///< The tree of an ordered index walked in decreasing order, NULL once done or for other scans.
+    const void* previous; ///< Last pair returned by a walk in decreasing order, NULL before the first.
+    const struct posting* posting; ///< Matches of a hashed index, NULL once done.
+    int slot; ///< Next slot of the posting to visit.
+    char operator; ///< One of '<', '>' or '=', or 0 for a walk of a whole ordered index.
+    int32_t argument; ///< Argument of a predicate on an int column.
+};
+
+
+/**
+ * @brief Allocates an empty index.
+ *
+ * @param column_id The indexed column.
+ * @param hashed Whether the column is a char[n] column, only matched for equality.
+ * @return Returns the index on success, NULL otherwise.
+ */
+struct column_index* index_create(int column_id, bool hashed);
+
+
+/**
+ * @brief Frees an index, but not the records it references.
+ */
+void index_free(struct column_index* index);
+
+
+/**
+ * @brief Adds a record to an index.
+ *
+ * @param index The index to modify.
+ * @param field The indexed column in the row of the record, an int32_t or a null terminated string.
+ * @param record The record.
+ * @return Returns 0 on success, -1 otherwise in which case the index is unchanged.
+ */
+int index_insert(struct column_index* index, const char* field, struct record* record);
+
+
+/**
+ * @brief Removes a record from an index.
+ *
+ * @param index The index to modify.
+ * @param field The indexed column in the row the record was indexed under.
+ * @param record The record.
+ * @return Returns 0 on success, -1 if the record is not indexed under this value.
+ */
+int index_remove(struct column_index* index, const char* field, struct record* record);
+
+
+/**
+ * @brief Positions a cursor on the first record of an index matching a predicate.
+ *
+ * @param index The index to scan.
+ * @param operator One of '<', '>' or '=', only '=' for a hashed index.
+ * @param argument The argument of the predicate, an int32_t or a null terminated string.
+ * @param cursor The cursor to position.
+ */
+void index_seek(const struct column_index* index, char operator, const void* argument, struct index_cursor* cursor);
+
+
+/**
+ * @brief Positions a cursor at either end of an ordered index, to walk all its records in order.
+ *
+ * A walk in decreasing order searches each record from the root, as
+ * btree_before() does, so it suits queries stopping after a few records.
+ *
+ * @param index The index to walk, on an int column.
+ * @param descending Whether the records come in decreasing order of their value.
+ * @param cursor The cursor to position.
+ */
+void index_seek_order(const struct column_index* index, bool descending, struct index_cursor* cursor);
+
+
+/**
+ * @brief Returns the record under a cursor and advances it.
+ *
+ * Records of an ordered index come in increasing order of their value,
+ * unless walked in decreasing order, and those of a hashed index in no
+ * particular order. The index must not be
+ * modified while a cursor is in use.
+ *
+ * @return Returns the record, or NULL once past the last matching record.
+ */
+struct record* index_next(struct index_cursor* cursor);
+
+
+/**
+ * @brief Counts the records of an index matching a predicate, up to a limit.
+ *
+ * A hashed index knows the count of each value, and an ordered index only
+ * visits the matching records up to the limit, so the count costs no more
+ * than a query driven by the index would.
+ *
+ * @return Returns the number of matching records, or limit if there are more.
+ */
+int index_count(const struct column_index* index, char operator, const void* argument, int limit);
+
+
+/**
+ * @brief Finds the least and greatest values of an int column from its index.
+ *
+ * @param min Where the least value is stored.
+ * @param max Where the greatest value is stored.
+ * @return Returns 0 on success, -1 if the index is empty or on a char[n] column.
+ */
+int index_bounds(const struct column_index* index, int32_t* min, int32_t* max);
+
+
+/**
+ * @brief Returns the memory allocated for an index.
+ */
+size_t index_bytes(const struct column_index* index);
+
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * @file
+ * @brief This file implements the predicate kernels declared in kernel.h.
+ *
+ * The SSE2 kernels are always available on x86-64. The AVX2 kernels are
+ * compiled for AVX2 with a target attribute rather than for the whole
+ * file, so they are only called once the CPU is known to support them.
+ */
+
+#include <immintrin.h>
+#include "kernel.h"
+
+
+/**
+ * @brief Compares an int value with an argument.
+ */
+static inline int int_matches(int32_t value, char operator, int32_t argument)
+{
+    return operator == '<' ? value < argument : operator == '>' ? value > argument : value == argument;
+}
+
+
+/**
+ * @brief Builds the mask of the values of a block from the index of the first unmatched one.
+ */
+static inline uint64_t tail_ints(uint64_t mask, const int32_t* values, int i, int count, char operator, int32_t argument)
+{
+    for(; i < count; i++)
+        mask |= (uint64_t) int_matches(values[i], operator, argument) << i;
+
+    return mask;
+}
+
+
+/**
+ * @brief Compares ints one at a time, the reference for the other kernels.
+ */
+static uint64_t scalar_ints(const int32_t* values, int count, char operator, int32_t argument)
+{
+    return tail_ints(0, values, 0, count, operator, argument);
+}
+
+
+/**
+ * @brief Compares groups of 4 ints, the operator being tested once per block.
+ */
+static uint64_t sse2_ints(const int32_t* values, int count, char operator, int32_t argument)
+{
+    __m128i broadcast = _mm_set1_epi32(argument);
+    uint64_t mask = 0;
+    int i = 0;
+
+#define SSE2_LOOP(compare) \
+    for(; i + 4 <= count; i += 4) \
+    { \
+        __m128i group = _mm_loadu_si128((const __m128i*) (values + i)); \
+        mask |= (uint64_t) _mm_movemask_ps(_mm_castsi128_ps(compare)) << i; \
+    }
+
+    if(operator == '<')
+        SSE2_LOOP(_mm_cmplt_epi32(group, broadcast))
+    else if(operator == '>')
+        SSE2_LOOP(_mm_cmpgt_epi32(group, broadcast))
+    else
+        SSE2_LOOP(_mm_cmpeq_epi32(group, broadcast))
+
+#undef SSE2_LOOP
+
+    return tail_ints(mask, values, i, count, operator, argument);
+}
+
+
+/**
+ * @brief Compares groups of 8 ints, the operator being tested once per block.
+ */
+__attribute__((target("avx2")))
+static uint64_t avx2_ints(const int32_t* values, int count, char operator, int32_t argument)
+{
+    __m256i broadcast = _mm256_set1_epi32(argument);
+    uint64_t mask = 0;
+    int i = 0;
+
+#define AVX2_LOOP(compare) \
+    for(; i + 8 <= count; i += 8) \
+    { \
+        __m256i group = _mm256_loadu_si256((const __m256i*) (values + i)); \
+        mask |= (uint64_t) (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(compare)) << i; \
+    }
+
+    if(operator == '<')
+        AVX2_LOOP(_mm256_cmpgt_epi32(broadcast, group))
+    else if(operator == '>')
+        AVX2_LOOP(_mm256_cmpgt_epi32(group, broadcast))
+    else
+        AVX2_LOOP(_mm256_cmpeq_epi32(group, broadcast))
+
+#undef AVX2_LOOP
+
+    return tail_ints(mask, values, i, count, operator, argument);
+}
+
+
+/**
+ * @brief The kernels of each instruction set, by level.
+ */
+static const struct kernels KERNELS[] = {
+    {"scalar", scalar_ints},
+    {"sse2", sse2_ints},
+    {"avx2", avx2_ints},
+};
+
+/**
+ * @brief The kernels in use, chosen when first needed, and read atomically as scan threads share them.
+ */
+static const struct kernels* current = NULL;
+
+
+/**
+ * @brief Checks whether the CPU supports the kernels of a level.
+ */
+static int supported(int level)
+{
+    switch(level)
+    {
+        case KERNEL_SCALAR:
+        case KERNEL_SSE2:
+            return 1;
+        case KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+        default:
+            return 0;
+    }
+}
+
+
+const struct kernels* kernels_get(void)
+{
+    const struct kernels* kernels = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+
+    // Threads racing here all store the same kernels
+    if(kernels == NULL)
+    {
+        kernels = &KERNELS[supported(KERNEL_AVX2) ? KERNEL_AVX2 : KERNEL_SSE2];
+        __atomic_store_n(&current, kernels, __ATOMIC_RELEASE);
+    }
+
+    return kernels;
+}
+
+
+int kernels_select(int level)
+{
+    if(!supported(level))
+        return -1;
+
+    __atomic_store_n(&current, &KERNELS[level], __ATOMIC_RELEASE);
+    return 0;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file
+ * @brief This file declares the vectorized predicate kernels used to scan
+ * tables stored by columns.
+ *
+ * A kernel compares a block of up to KERNEL_BLOCK_ROWS consecutive values
+ * of an int column, or dictionary codes of a char[n] column (dict.h),
+ * with the argument of a predicate, and returns a selection bitmask whose
+ * bit i is set if row i of the block matches. The masks of all the
+ * predicates of a query are ANDed, so a block is skipped as soon as
+ * no row is left and keys are only read for the rows that match them all.
+ *
+ * Kernels exist for plain C, SSE2 and AVX2. The best one the CPU supports
+ * is chosen when first used, so the same binary runs on hosts without
+ * AVX2.
+ */
+
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <stdint.h>
+
+#define KERNEL_BLOCK_ROWS 64 ///< Rows compared by one kernel call, one bit each in a mask.
+
+#define KERNEL_SCALAR 0 ///< Kernels in plain C.
+#define KERNEL_SSE2 1 ///< Kernels comparing 4 ints at once.
+#define KERNEL_AVX2 2 ///< Kernels comparing 8 ints at once.
+
+
+/**
+ * @brief The kernels of one instruction set.
+ */
+struct kernels {
+    const char* name;
+
+    /**
+     * @brief Compares int values with an argument.
+     *
+     * @param values The values of the block.
+     * @param count Number of values, at most KERNEL_BLOCK_ROWS.
+     * @param operator One of '<', '>' or '='.
+     * @param argument The argument of the predicate.
+     * @return Returns the mask of the values satisfying the predicate.
+     */
+    uint64_t (*match_ints)(const int32_t* values, int count, char operator, int32_t argument);
+};
+
+
+/**
+ * @brief Returns the kernels in use, the best the CPU supports unless set otherwise.
+ */
+const struct kernels* kernels_get(void);
+
+
+/**
+ * @brief Selects the kernels of an instruction set, for benchmarks and tests.
+ *
+ * @param level One of KERNEL_SCALAR, KERNEL_SSE2 or KERNEL_AVX2.
+ * @return Returns 0 on success, -1 if the CPU does not support the instruction set.
+ */
+int kernels_select(int level);
+
+
+#endif
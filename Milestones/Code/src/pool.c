@@ -0,0 +1,178 @@
+/**
+ * @file
+ * @brief This file implements the pool of worker threads declared in pool.h.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "pool.h"
+
+
+/**
+ * @brief The workers and the job they run.
+ *
+ * Everything but next_morsel is guarded by lock. A job is joined by at
+ * most wanted workers, and is over once the thread running it has no
+ * morsel left and no worker is still active in it.
+ */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake; ///< Signaled when a job is submitted.
+    pthread_cond_t finished; ///< Signaled when the last active worker leaves a job.
+    bool started;
+    int num_workers;
+    int max_threads; ///< Limit set by pool_limit, 0 for none.
+
+    bool busy; ///< Whether a job is running.
+    unsigned long generation; ///< Number of jobs submitted, so that a worker joins each job once.
+    pool_task task;
+    void* arg;
+    int num_morsels;
+    int next_morsel; ///< Next morsel to claim, taken atomically.
+    int wanted; ///< Workers the job may be joined by.
+    int joined; ///< Workers that joined the job.
+    int active; ///< Workers still running morsels of the job.
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+
+/**
+ * @brief Runs morsels of the current job until none is left.
+ */
+static void run_morsels(pool_task task, void* arg, int num_morsels)
+{
+    int morsel;
+
+    while((morsel = __atomic_fetch_add(&pool.next_morsel, 1, __ATOMIC_RELAXED)) < num_morsels)
+        task(arg, morsel);
+}
+
+
+/**
+ * @brief Waits for jobs to join, forever.
+ */
+static void* worker(void* unused)
+{
+    unsigned long generation = 0;
+
+    (void) unused;
+
+    pthread_mutex_lock(&pool.lock);
+    while(true)
+    {
+        pool_task task;
+        void* arg;
+        int num_morsels;
+
+        while(!pool.busy || pool.generation == generation || pool.joined >= pool.wanted)
+            pthread_cond_wait(&pool.wake, &pool.lock);
+
+        generation = pool.generation;
+        pool.joined++;
+        pool.active++;
+        task = pool.task;
+        arg = pool.arg;
+        num_morsels = pool.num_morsels;
+        pthread_mutex_unlock(&pool.lock);
+
+        run_morsels(task, arg, num_morsels);
+
+        pthread_mutex_lock(&pool.lock);
+        if(--pool.active == 0)
+            pthread_cond_signal(&pool.finished);
+    }
+
+    return NULL;
+}
+
+
+int pool_start(int num_workers)
+{
+    pthread_t thread;
+    int result = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    if(!pool.started)
+    {
+        if(num_workers < 0)
+            num_workers = (int) sysconf(_SC_NPROCESSORS_ONLN) - 1;
+        if(num_workers > POOL_MAX_WORKERS)
+            num_workers = POOL_MAX_WORKERS;
+
+        // The workers live as long as the process
+        for(pool.num_workers = 0; pool.num_workers < num_workers; pool.num_workers++)
+        {
+            if(pthread_create(&thread, NULL, worker, NULL) != 0)
+                break;
+            pthread_detach(thread);
+        }
+
+        pool.started = true;
+        result = num_workers > 0 && pool.num_workers == 0 ? -1 : 0;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    return result;
+}
+
+
+int pool_parallelism(void)
+{
+    int num_threads;
+
+    pool_start(-1);
+
+    pthread_mutex_lock(&pool.lock);
+    num_threads = pool.num_workers + 1;
+    if(pool.max_threads > 0 && pool.max_threads < num_threads)
+        num_threads = pool.max_threads;
+    pthread_mutex_unlock(&pool.lock);
+
+    return num_threads;
+}
+
+
+void pool_limit(int max_threads)
+{
+    pthread_mutex_lock(&pool.lock);
+    pool.max_threads = max_threads;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+
+void pool_run(pool_task task, void* arg, int num_morsels, int num_threads)
+{
+    int morsel;
+
+    pthread_mutex_lock(&pool.lock);
+    if(num_threads <= 1 || num_morsels <= 1 || pool.busy || pool.num_workers == 0)
+    {
+        pthread_mutex_unlock(&pool.lock);
+
+        for(morsel = 0; morsel < num_morsels; morsel++)
+            task(arg, morsel);
+        return;
+    }
+
+    pool.busy = true;
+    pool.generation++;
+    pool.task = task;
+    pool.arg = arg;
+    pool.num_morsels = num_morsels;
+    pool.next_morsel = 0;
+    pool.wanted = num_threads - 1 < pool.num_workers ? num_threads - 1 : pool.num_workers;
+    pool.joined = 0;
+    pool.active = 0;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_morsels(task, arg, num_morsels);
+
+    // Workers yet to join would find no morsel left, so they are turned away
+    pthread_mutex_lock(&pool.lock);
+    pool.wanted = pool.joined;
+    while(pool.active > 0)
+        pthread_cond_wait(&pool.finished, &pool.lock);
+    pool.busy = false;
+    pthread_mutex_unlock(&pool.lock);
+}
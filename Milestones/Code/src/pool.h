@@ -0,0 +1,69 @@
+/**
+ * @file
+ * @brief This file declares the pool of worker threads running the morsels
+ * of parallel scans.
+ *
+ * A job is split into numbered morsels, and each thread taking part claims
+ * the next unclaimed morsel until none is left, so threads finishing early
+ * take over the rest instead of waiting for a fixed share. The thread
+ * running the job takes part as well, and only returns once every morsel
+ * is done, so the job may keep its results on the stack.
+ *
+ * The pool runs one job at a time. A job submitted while another is
+ * running is run by its own thread alone.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#define POOL_MAX_WORKERS 15 ///< Worker threads at most, besides the thread running a job.
+
+
+/**
+ * @brief Runs one morsel of a job.
+ *
+ * @param arg The argument of the job.
+ * @param morsel The number of the morsel, from 0.
+ */
+typedef void (*pool_task)(void* arg, int morsel);
+
+
+/**
+ * @brief Starts the worker threads, unless already started.
+ *
+ * @param num_workers Number of workers, at most POOL_MAX_WORKERS, or -1 for
+ * one less than the number of CPUs.
+ * @return Returns 0 on success, -1 if no thread could be started.
+ */
+int pool_start(int num_workers);
+
+
+/**
+ * @brief Returns the threads a job may run on, its own thread and the workers.
+ *
+ * The workers are started with one per CPU besides the first if not
+ * started yet, so a host with a single CPU runs every job alone.
+ */
+int pool_parallelism(void);
+
+
+/**
+ * @brief Limits the threads a job may run on, for benchmarks and tests.
+ *
+ * @param max_threads The limit, at least 1, or 0 to lift it.
+ */
+void pool_limit(int max_threads);
+
+
+/**
+ * @brief Runs all the morsels of a job, and returns once they are done.
+ *
+ * @param task The function running one morsel.
+ * @param arg The argument of the job.
+ * @param num_morsels Number of morsels.
+ * @param num_threads Threads to run the job on, the calling one included.
+ */
+void pool_run(pool_task task, void* arg, int num_morsels, int num_threads);
+
+
+#endif
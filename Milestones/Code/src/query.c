@@ -0,0 +1,1643 @@
+/**
+ * @file
+ * @brief This file implements the query predicates declared in query.h.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+#include "hash.h"
+#include "kernel.h"
+#include "bitmap.h"
+#include "pool.h"
+#include "stats.h"
+#include "zonemap.h"
+#include "dict.h"
+#include "set.h"
+
+
+/**
+ * @brief Finds a column by name.
+ *
+ * @return Returns the column id on success, -1 otherwise.
+ */
+static int find_column(const struct table_schema* schema, const char* column_name)
+{
+    int column_id;
+
+    for(column_id = 0; column_id < schema->num_columns; column_id++)
+        if(strcmp(schema->column_names[column_id], column_name) == 0)
+            return column_id;
+
+    return -1;
+}
+
+
+/**
+ * @brief Checks whether an int field is less than the argument.
+ */
+static bool int_less(const struct predicate* predicate, const char* field)
+{
+    int32_t value;
+    memcpy(&value, field, sizeof value);
+    return value < predicate->int_argument;
+}
+
+
+/**
+ * @brief Checks whether an int field is greater than the argument.
+ */
+static bool int_greater(const struct predicate* predicate, const char* field)
+{
+    int32_t value;
+    memcpy(&value, field, sizeof value);
+    return value > predicate->int_argument;
+}
+
+
+/**
+ * @brief Checks whether an int field is equal to the argument.
+ */
+static bool int_equal(const struct predicate* predicate, const char* field)
+{
+    int32_t value;
+    memcpy(&value, field, sizeof value);
+    return value == predicate->int_argument;
+}
+
+
+/**
+ * @brief Checks whether a string field is equal to the argument.
+ */
+static bool string_equal(const struct predicate* predicate, const char* field)
+{
+    return strcmp(field, predicate->argument) == 0;
+}
+
+
+/**
+ * @brief Checks whether a string field is less than the argument.
+ */
+static bool string_less(const struct predicate* predicate, const char* field)
+{
+    return strcmp(field, predicate->argument) < 0;
+}
+
+
+/**
+ * @brief Checks whether a string field is greater than the argument.
+ */
+static bool string_greater(const struct predicate* predicate, const char* field)
+{
+    return strcmp(field, predicate->argument) > 0;
+}
+
+
+/**
+ * @brief Checks whether a string field starts with the argument.
+ */
+static bool string_prefix(const struct predicate* predicate, const char* field)
+{
+    return strncmp(field, predicate->argument, predicate->argument_size - 1) == 0;
+}
+
+
+/**
+ * @brief Checks whether an int field is in the IN list of a predicate.
+ */
+static bool int_in(const struct predicate* predicate, const char* field)
+{
+    return set_contains(&predicate->list->values, field);
+}
+
+
+/**
+ * @brief Checks whether a string field is in the IN list of a predicate.
+ */
+static bool string_in(const struct predicate* predicate, const char* field)
+{
+    return set_contains(&predicate->list->values, field);
+}
+
+
+/**
+ * @brief Checks whether the code of a string field is that of a value in the IN list of a predicate.
+ */
+static bool code_in(const struct predicate* predicate, const char* field)
+{
+    return set_contains(&predicate->list->codes, field);
+}
+
+
+/**
+ * @brief Parses a comparison of a column with a constant, such as "age > 20" or "name ^= bo".
+ *
+ * @param predicate Where the compiled comparison is stored, its offset excepted.
+ * @return Returns 0 on success, -1 if the comparison is invalid.
+ */
+static int parse_comparison(const struct table_schema* schema, const char* text, struct predicate* predicate)
+{
+    char column_name[MAX_VALUE_LEN];
+    char str_data[MAX_VALUE_LEN];
+    char operator[3];
+    char trash[MAX_CONFIG_LINE_LEN];
+    int int_data, column_id;
+
+    // Expecting an integer predicate, while a string column compared with digits gets a string predicate
+    if(sscanf(text, " %[a-zA-Z0-9] %1[<=>] %d%s", column_name, operator, &int_data, trash) == 3
+            && (column_id = find_column(schema, column_name)) >= 0 && schema->data_types[column_id] == 0)
+    {
+        predicate->int_argument = int_data;
+        predicate->test = operator[0] == '<' ? int_less : operator[0] == '>' ? int_greater : int_equal;
+    }
+    else // Expecting a string predicate
+    {
+        if(sscanf(text, " %[a-zA-Z0-9] %2[<=>^] %[a-zA-Z0-9 ]", column_name, operator, str_data) != 3)
+            return -1;
+
+        // A prefix is written "^=" and compiled to '^', other operators are a single character
+        if(strcmp(operator, "^=") == 0)
+            operator[1] = 0;
+        else if(operator[1] != 0 || operator[0] == '^')
+            return -1;
+
+        // Trailing spaces are not part of the string, as in row_parse
+        size_t length = strlen(str_data);
+        while(length > 0 && str_data[length - 1] == ' ')
+            str_data[--length] = 0;
+
+        // Check if string length of parsed data is more than that allowed
+        if((column_id = find_column(schema, column_name)) < 0 || schema->data_types[column_id] == 0
+                || length + 1 > schema->data_types[column_id])
+            return -1;
+
+        strcpy(predicate->argument, str_data);
+        predicate->argument_size = length + 1;
+        predicate->test = operator[0] == '<' ? string_less : operator[0] == '>' ? string_greater
+                : operator[0] == '^' ? string_prefix : string_equal;
+    }
+
+    predicate->column_id = column_id;
+    predicate->operator = operator[0];
+    predicate->list = NULL;
+
+    return 0;
+}
+
+
+/**
+ * @brief Frees an IN list once no predicate holds it.
+ */
+static void release_list(struct in_list* list)
+{
+    if(list == NULL || --list->refs > 0)
+        return;
+
+    set_destroy(&list->values);
+    set_destroy(&list->codes);
+    free(list);
+}
+
+
+/**
+ * @brief Adds the values of an IN list, such as "Ontario, Quebec", to a set.
+ *
+ * @param values Comma separated values, modified by the parsing.
+ * @return Returns 0 on success, -1 if a value is invalid or out of memory.
+ */
+static int parse_values(const struct table_schema* schema, int column_id, char* values, struct value_set* set)
+{
+    char str_data[MAX_VALUE_LEN];
+    char trash[MAX_CONFIG_LINE_LEN];
+    char* value;
+    int32_t int_data;
+
+    for(value = strtok(values, ","); value != NULL; value = strtok(NULL, ","))
+    {
+        if(schema->data_types[column_id] == 0)
+        {
+            if(sscanf(value, " %d%s", &int_data, trash) != 1 || set_add(set, &int_data) != 0)
+                return -1;
+            continue;
+        }
+
+        if(strlen(value) >= MAX_VALUE_LEN || sscanf(value, " %[a-zA-Z0-9 ]%s", str_data, trash) != 1)
+            return -1;
+
+        // Trailing spaces are not part of the string, as in row_parse
+        size_t length = strlen(str_data);
+        while(length > 0 && str_data[length - 1] == ' ')
+            str_data[--length] = 0;
+
+        if(length + 1 > schema->data_types[column_id] || set_add(set, str_data) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Parses a predicate: a comparison, or the membership of a column in IN lists and values separated by " OR ".
+ *
+ * @param predicate Where the compiled predicate is stored, its offset excepted, holding its IN list if any.
+ * @return Returns 0 on success, -1 if the predicate is invalid or out of memory.
+ */
+static int parse_predicate(const struct table_schema* schema, char* text, struct predicate* predicate)
+{
+    struct predicate alternative;
+    struct in_list* list;
+    char first_column[strlen(text) + 1];
+    char* next;
+    int column_id = -1;
+
+    first_column[0] = 0;
+    sscanf(text, " %[a-zA-Z0-9]", first_column);
+    if(find_alternative(text, first_column) == NULL && strchr(text, '(') == NULL)
+        return parse_comparison(schema, text, predicate);
+
+    if((list = (struct in_list*) calloc(1, sizeof(struct in_list))) == NULL)
+        return -1;
+    list->refs = 1;
+    list->codes_version = ULLONG_MAX;
+
+    // Alternatives are equalities or IN lists on the same column, whose values all go in one set
+    for(; text != NULL; text = next)
+    {
+        if((next = find_alternative(text, first_column)) != NULL)
+        {
+            *next = 0;
+            next += strlen(" OR ");
+        }
+
+        // The values of a list are checked against the column once the column is known, end being 0 without its parenthesis
+        char column_name[strlen(text) + 1], values[strlen(text) + 1], trash[strlen(text) + 1];
+        int end = 0;
+        if(sscanf(text, " %[a-zA-Z0-9] IN (%[^)])%n%s", column_name, values, &end, trash) == 2 && end > 0)
+            alternative.column_id = find_column(schema, column_name);
+        else if(parse_comparison(schema, text, &alternative) != 0 || alternative.operator != '=')
+            alternative.column_id = -1;
+        else
+            *values = 0;
+
+        if(alternative.column_id < 0 || (column_id >= 0 && alternative.column_id != column_id))
+        {
+            release_list(list);
+            return -1;
+        }
+
+        // The set of the first alternative is sized for the strings of the column
+        if(column_id < 0)
+        {
+            column_id = alternative.column_id;
+            if(set_init(&list->values, schema->data_types[column_id] != 0, schema->data_types[column_id] != 0
+                    ? schema->data_types[column_id] : (int) sizeof(int32_t)) != 0 || set_init(&list->codes, false, sizeof(int32_t)) != 0)
+            {
+                release_list(list);
+                return -1;
+            }
+        }
+
+        if(*values != 0 ? parse_values(schema, column_id, values, &list->values) != 0
+                : set_add(&list->values, schema->data_types[column_id] == 0 ? (const void*) &alternative.int_argument
+                        : (const void*) alternative.argument) != 0)
+        {
+            release_list(list);
+            return -1;
+        }
+    }
+
+    // A table stored by columns looks up the codes of strings when queried, which then never allocates
+    if(schema->data_types[column_id] != 0 && set_reserve(&list->codes, list->values.num_values) != 0)
+    {
+        release_list(list);
+        return -1;
+    }
+
+    predicate->column_id = column_id;
+    predicate->operator = 'I';
+    predicate->test = schema->data_types[column_id] == 0 ? int_in : string_in;
+    predicate->list = list;
+
+    return 0;
+}
+
+
+int query_parse(const struct table_schema* schema, const struct row_layout* layout, char* predicates, struct predicate predicate_arr[])
+{
+    int num_predicates = 0, i;
+    char* cur_pred;
+
+    while((cur_pred = next_predicate(&predicates)) != NULL)
+    {
+        // Checking for extra predicates
+        if(num_predicates == schema->num_columns || parse_predicate(schema, cur_pred, &predicate_arr[num_predicates]) != 0)
+        {
+            query_release(predicate_arr, num_predicates);
+            return -1;
+        }
+
+        for(i = 0; i < num_predicates; i++)
+            if(predicate_arr[num_predicates].column_id == predicate_arr[i].column_id) // Checking for duplicate predicates
+            {
+                query_release(predicate_arr, num_predicates + 1);
+                return -1;
+            }
+
+        predicate_arr[num_predicates].offset = layout->offsets[predicate_arr[num_predicates].column_id];
+        num_predicates++;
+    }
+
+    return num_predicates;
+}
+
+
+void query_release(const struct predicate predicate_arr[], int num_predicates)
+{
+    int i;
+
+    for(i = 0; i < num_predicates; i++)
+        release_list(predicate_arr[i].list);
+}
+
+
+/**
+ * @brief Makes a predicate an int predicate on the codes of a dictionary.
+ */
+static void bind_code(struct predicate* predicate, char operator, int32_t code)
+{
+    predicate->operator = operator;
+    predicate->int_argument = code;
+    predicate->test = operator == '<' ? int_less : operator == '>' ? int_greater : int_equal;
+}
+
+
+/**
+ * @brief Looks up the codes of the strings of an IN list, unless looked up since the table last changed.
+ *
+ * A string missing from the dictionary has no code, as no row holds it.
+ * The set of codes has room for every string, so this never allocates.
+ */
+static void bind_list(const struct hash_table* table, const struct dictionary* dict, struct in_list* list)
+{
+    bool equal;
+    int32_t code;
+    int i;
+
+    if(list->codes_version == table->version)
+        return;
+
+    set_clear(&list->codes);
+    for(i = 0; i < list->values.num_values; i++)
+    {
+        code = dict_lower_bound(dict, set_value(&list->values, i), &equal);
+        if(equal)
+            set_add(&list->codes, &code);
+    }
+    list->codes_version = table->version;
+}
+
+
+/**
+ * @brief Binds the string predicates on a table stored by columns to the codes of their dictionaries.
+ *
+ * An equality becomes one with the code of its argument, or a predicate
+ * no code satisfies if the argument is not in the dictionary. "< X" keeps
+ * the codes below that of the first value not less than X, and "> X" the
+ * codes above that of the last value not greater than X. A prefix keeps
+ * the codes from the first value starting with it to the first value
+ * past them, which takes a second predicate, and an IN list probes the
+ * codes of its strings instead of the strings. Codes change when a
+ * dictionary is respaced, so predicates are bound again by every
+ * evaluation. Predicates on tables stored by rows are copied unchanged.
+ *
+ * @param bound Where the predicates are bound, room for 2 * MAX_COLUMNS_PER_TABLE of them. Predicate i is bound to
+ * bound[i], the second predicates of prefixes following the others.
+ * @return Returns the number of predicates bound.
+ */
+static int bind_codes(const struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, struct predicate bound[])
+{
+    char end[MAX_STRTYPE_SIZE];
+    int num_bound = num_predicates, p_index;
+    bool equal;
+    int32_t code;
+
+    memcpy(bound, predicate_arr, num_predicates * sizeof(struct predicate));
+
+    for(p_index = 0; table->columns != NULL && p_index < num_predicates; p_index++)
+    {
+        struct predicate* predicate = &bound[p_index];
+        const struct dictionary* dict = table->columns->dictionaries[predicate->column_id];
+
+        if(dict == NULL)
+            continue;
+
+        if(predicate->operator == 'I')
+        {
+            bind_list(table, dict, predicate->list);
+            predicate->test = code_in;
+            continue;
+        }
+
+        code = dict_lower_bound(dict, predicate->argument, &equal);
+        if(predicate->operator == '=')
+            bind_code(predicate, equal ? '=' : '<', equal ? code : DICT_NO_CODE);
+        else if(predicate->operator == '<')
+            bind_code(predicate, '<', code);
+        else if(predicate->operator == '>')
+            bind_code(predicate, '>', equal ? code : code - 1);
+        else
+        {
+            // The values starting with a prefix are those from the first not less than it to the first not less than its end
+            query_prefix_end(predicate->argument, end);
+            bound[num_bound] = *predicate;
+            bind_code(&bound[num_bound++], '<', dict_lower_bound(dict, end, &equal));
+            bind_code(predicate, '>', code - 1);
+        }
+    }
+
+    return num_bound;
+}
+
+
+/**
+ * @brief Checks a row of a table stored by columns against predicates.
+ *
+ * Only the columns referenced by the predicates are read, and string
+ * predicates must be bound to codes by bind_codes() first.
+ */
+static bool column_match(const struct column_store* store, const struct predicate predicate_arr[], int num_predicates, int row)
+{
+    int p_index;
+
+    for(p_index = 0; p_index < num_predicates; p_index++)
+    {
+        const struct predicate* predicate = &predicate_arr[p_index];
+
+        if(!predicate->test(predicate, store->columns[predicate->column_id] + (size_t) row * store->widths[predicate->column_id]))
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Compares a block of ints or codes with the set of an IN list.
+ *
+ * A list of at most IN_KERNEL_VALUES values is compared by the kernels,
+ * one equality per value. A longer one is probed for each value, those
+ * out of the bounds of the set being rejected without a probe.
+ *
+ * @return Returns the mask of the values in the set.
+ */
+static uint64_t match_set(const struct kernels* kernels, const struct value_set* set, const int32_t* values, int count)
+{
+    uint64_t mask = 0;
+    int i;
+
+    if(set->num_values <= IN_KERNEL_VALUES)
+    {
+        for(i = 0; i < set->num_values; i++)
+            mask |= kernels->match_ints(values, count, '=', ((const int32_t*) set->values)[i]);
+        return mask;
+    }
+
+    for(i = 0; i < count; i++)
+        if(values[i] >= set->min && values[i] <= set->max && set_contains_int(set, values[i]))
+            mask |= 1ull << i;
+
+    return mask;
+}
+
+
+/**
+ * @brief Compares a block of rows of a table stored by columns against predicates bound by bind_codes().
+ *
+ * @param first_row The first row of the block.
+ * @param count Number of rows in the block, at most KERNEL_BLOCK_ROWS.
+ * @return Returns the mask of the rows satisfying every predicate.
+ */
+static uint64_t block_match(const struct kernels* kernels, const struct column_store* store, const struct predicate predicate_arr[],
+        int num_predicates, int first_row, int count)
+{
+    uint64_t mask = count == KERNEL_BLOCK_ROWS ? ~0ull : (1ull << count) - 1;
+    int p_index;
+
+    // The remaining predicates are skipped once no row is left
+    for(p_index = 0; p_index < num_predicates && mask != 0; p_index++)
+    {
+        const struct predicate* predicate = &predicate_arr[p_index];
+        int width = store->widths[predicate->column_id];
+        const char* values = store->columns[predicate->column_id] + (size_t) first_row * width;
+
+        if(predicate->operator == 'I')
+            mask &= match_set(kernels, predicate->test == code_in ? &predicate->list->codes : &predicate->list->values, (const int32_t*) values,
+                    count);
+        else
+            mask &= kernels->match_ints((const int32_t*) values, count, predicate->operator, predicate->int_argument);
+    }
+
+    return mask;
+}
+
+
+/**
+ * @brief Appends a matching key to the keys of a query result.
+ *
+ * @param end End of the keys written so far.
+ * @param num_matched_keys Number of keys matched before this one.
+ * @return Returns the new end of the keys.
+ */
+static char* add_key(char* end, int num_matched_keys, const char* key)
+{
+    return end + sprintf(end, num_matched_keys == 0 ? "%s" : ", %s", key);
+}
+
+
+void query_prefix_end(const char* prefix, char* end)
+{
+    size_t length = strlen(prefix);
+
+    memcpy(end, prefix, length + 1);
+    end[length - 1]++;
+}
+
+
+bool query_match(const struct predicate predicate_arr[], int num_predicates, const char* row)
+{
+    int p_index;
+
+    // Stop at the first predicate the row fails
+    for(p_index = 0; p_index < num_predicates; p_index++)
+        if(!predicate_arr[p_index].test(&predicate_arr[p_index], row + predicate_arr[p_index].offset))
+            return false;
+
+    return true;
+}
+
+
+struct plan_cache* plan_cache_create(void)
+{
+    return (struct plan_cache*) calloc(1, sizeof(struct plan_cache));
+}
+
+
+void plan_cache_destroy(struct plan_cache* cache)
+{
+    int i;
+
+    for(i = 0; i < PLAN_CACHE_SIZE; i++)
+    {
+        query_release(cache->plans[i].predicate_arr, cache->plans[i].num_predicates);
+        free(cache->plans[i].text);
+    }
+    free(cache);
+}
+
+
+void query_normalize(char* predicates)
+{
+    char* read;
+    char* write = predicates;
+
+    for(read = predicates; *read != 0; read++)
+    {
+        if(*read == ' ')
+        {
+            const char* next = read + strspn(read, " ");
+            if(write == predicates || strchr(",<=>^()", write[-1]) != NULL || *next == 0 || strchr(",<=>^()", *next) != NULL)
+            {
+                read = (char*) next - 1;
+                continue;
+            }
+        }
+
+        *write++ = *read;
+    }
+
+    *write = 0;
+}
+
+
+int query_prepare(struct plan_cache* cache, const struct hash_table* table, char* predicates, struct predicate predicate_arr[])
+{
+    struct cached_plan* plan;
+    uint64_t hash;
+    char* text;
+
+    query_normalize(predicates);
+    hash = hash_string(predicates);
+    plan = &cache->plans[hash & (PLAN_CACHE_SIZE - 1)];
+
+    if(plan->text != NULL && plan->hash == hash && strcmp(plan->text, predicates) == 0)
+    {
+        cache->hits++;
+        if(plan->num_predicates > 0)
+            memcpy(predicate_arr, plan->predicate_arr, plan->num_predicates * sizeof(struct predicate));
+        return plan->num_predicates;
+    }
+
+    cache->misses++;
+
+    // Without memory for the text, the predicates are still compiled in the slot, holding their IN lists, but not cached
+    text = strdup(predicates);
+    query_release(plan->predicate_arr, plan->num_predicates);
+    free(plan->text);
+    plan->text = text;
+    plan->hash = hash;
+    plan->num_predicates = query_parse(table->schema, &table->layout, predicates, plan->predicate_arr);
+    if(plan->num_predicates > 0)
+        memcpy(predicate_arr, plan->predicate_arr, plan->num_predicates * sizeof(struct predicate));
+
+    return plan->num_predicates;
+}
+
+
+/**
+ * @brief Checks whether a zone may hold rows matching the int predicates, from its bounds alone.
+ *
+ * The predicates on the char[n] columns of a table stored by columns must
+ * be bound to codes by bind_codes() first, as their zones bound codes.
+ */
+static bool zone_may_match(const struct zone_map* map, const struct predicate predicate_arr[], int num_predicates, int zone)
+{
+    const struct zone* bounds;
+    const struct value_set* set;
+    int p_index;
+
+    for(p_index = 0; p_index < num_predicates; p_index++)
+    {
+        const struct predicate* predicate = &predicate_arr[p_index];
+
+        if(map->zones[predicate->column_id] == NULL)
+            continue;
+
+        // An empty zone has its min above its max, so no predicate passes it
+        bounds = &map->zones[predicate->column_id][zone];
+        set = predicate->operator != 'I' ? NULL : map->coded[predicate->column_id] ? &predicate->list->codes : &predicate->list->values;
+        if(predicate->operator == 'I' ? bounds->min > set->max || bounds->max < set->min
+                : predicate->operator == '<' ? bounds->min >= predicate->int_argument
+                : predicate->operator == '>' ? bounds->max <= predicate->int_argument
+                : bounds->min > predicate->int_argument || bounds->max < predicate->int_argument)
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Adds the zones of a scan to the statistics of a table.
+ *
+ * @param num_zones Zones reached by the scan.
+ * @param num_skipped Zones among them skipped from their bounds.
+ */
+static void count_zones(struct zone_map* map, int num_zones, int num_skipped)
+{
+    // Morsels of a parallel scan add their counts at once when they end
+    __atomic_fetch_add(&map->zones_read, num_zones - num_skipped, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&map->zones_skipped, num_skipped, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * @brief Compares a block of rows of a table with predicates.
+ *
+ * A block whose zone (zonemap.h) cannot hold a match is skipped without
+ * reading its rows. Tables stored by columns are compared by the kernels,
+ * their predicates bound by bind_codes(), and tables stored by rows a row
+ * at a time. Removed rows never match.
+ *
+ * @param first The first row of the block, a multiple of ZONE_ROWS.
+ * @param count Number of rows, at most KERNEL_BLOCK_ROWS.
+ * @param num_skipped Incremented if the block is skipped.
+ * @return Returns the mask of the matching rows, bit i for row first + i.
+ */
+static uint64_t rows_match(const struct hash_table* table, const struct kernels* kernels, const struct predicate predicate_arr[],
+        int num_predicates, int first, int count, int* num_skipped)
+{
+    uint64_t mask = 0, bits;
+    int row;
+
+    if(!zone_may_match(table->zones, predicate_arr, num_predicates, first / ZONE_ROWS))
+    {
+        (*num_skipped)++;
+        return 0;
+    }
+
+    if(table->columns != NULL)
+    {
+        mask = block_match(kernels, table->columns, predicate_arr, num_predicates, first, count);
+
+        // Removed rows are only looked for among the matches
+        if(table->num_keys != table->num_entries)
+            for(bits = mask; bits != 0; bits &= bits - 1)
+                if(table->entries[first + __builtin_ctzll(bits)].record == NULL)
+                    mask &= ~(bits & -bits);
+
+        return mask;
+    }
+
+    for(row = 0; row < count; row++)
+    {
+        struct record* record = table->entries[first + row].record;
+
+        if(record != NULL && query_match(predicate_arr, num_predicates, record_value(record)))
+            mask |= 1ull << row;
+    }
+
+    return mask;
+}
+
+
+/**
+ * @brief Finds the rows of a range of a table matching predicates.
+ *
+ * @param first The first row of the range, a multiple of KERNEL_BLOCK_ROWS.
+ * @param last The row after the range.
+ * @param matches Where the matching rows are added.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+static int scan_rows(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, int first, int last,
+        struct bitmap* matches)
+{
+    const struct kernels* kernels = kernels_get();
+    int count, num_zones = (last - first + ZONE_ROWS - 1) / ZONE_ROWS, num_skipped = 0;
+
+    for(; first < last; first += KERNEL_BLOCK_ROWS)
+    {
+        count = last - first < KERNEL_BLOCK_ROWS ? last - first : KERNEL_BLOCK_ROWS;
+
+        if(bitmap_add_word(matches, first, rows_match(table, kernels, predicate_arr, num_predicates, first, count, &num_skipped)) != 0)
+            return -1;
+    }
+
+    count_zones(table->zones, num_zones, num_skipped);
+
+    return 0;
+}
+
+
+/**
+ * @brief Chooses the number of threads scanning a table, from its size.
+ *
+ * @param num_morsels Where the number of morsels of MORSEL_ROWS rows of the table is stored.
+ * @return Returns the number of threads, 1 to scan the table serially.
+ */
+static int scan_threads(const struct hash_table* table, int* num_morsels)
+{
+    int num_threads;
+
+    *num_morsels = (table->num_entries + MORSEL_ROWS - 1) / MORSEL_ROWS;
+    num_threads = *num_morsels / MORSELS_PER_THREAD;
+    if(num_threads > 1 && pool_parallelism() < num_threads)
+        num_threads = pool_parallelism();
+
+    return num_threads > 1 ? num_threads : 1;
+}
+
+
+/**
+ * @brief A scan split into morsels of MORSEL_ROWS rows.
+ */
+struct scan_job {
+    struct hash_table* table;
+    const struct predicate* predicate_arr;
+    int num_predicates;
+    struct bitmap* matches; ///< The matches of each morsel.
+    int failed; ///< Set once a morsel runs out of memory.
+};
+
+
+/**
+ * @brief Finds the matching rows of one morsel of a scan.
+ */
+static void scan_morsel(void* arg, int morsel)
+{
+    struct scan_job* job = (struct scan_job*) arg;
+    int first = morsel * MORSEL_ROWS;
+    int last = job->table->num_entries - first < MORSEL_ROWS ? job->table->num_entries : first + MORSEL_ROWS;
+
+    if(scan_rows(job->table, job->predicate_arr, job->num_predicates, first, last, &job->matches[morsel]) != 0)
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * @brief Finds the rows of a table matching predicates, in parallel if the table is large.
+ *
+ * @param matches Where the matching rows are added, an empty bitmap.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+static int scan_table(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, struct bitmap* matches)
+{
+    struct scan_job job = {table, predicate_arr, num_predicates, NULL, 0};
+    int num_morsels, num_threads = scan_threads(table, &num_morsels);
+    int i;
+
+    if(num_threads <= 1)
+        return scan_rows(table, predicate_arr, num_predicates, 0, table->num_entries, matches);
+
+    if((job.matches = (struct bitmap*) calloc(num_morsels, sizeof *job.matches)) == NULL)
+        return -1;
+
+    pool_run(scan_morsel, &job, num_morsels, num_threads);
+
+    // Morsel i only holds the container of key i, so appending keeps the keys in order
+    for(i = 0; i < num_morsels; i++)
+    {
+        if(!job.failed && bitmap_append(matches, &job.matches[i]) != 0)
+            job.failed = 1;
+        bitmap_free(&job.matches[i]);
+    }
+    free(job.matches);
+
+    return job.failed ? -1 : 0;
+}
+
+
+/**
+ * @brief Writes the keys of the rows of a bitmap, in row order.
+ *
+ * @return Returns the number of rows in the bitmap.
+ */
+static int add_keys(const struct hash_table* table, const struct bitmap* rows, int max_keys, char* matched_keys)
+{
+    struct bitmap_iterator iterator;
+    int num_matched_keys = 0;
+    char* end = matched_keys;
+    uint32_t first;
+    uint64_t word;
+
+    // Only the keys written are read, the count comes from the bitmap
+    bitmap_iterator_init(&iterator, rows);
+    while(num_matched_keys < max_keys && bitmap_next_word(&iterator, &first, &word))
+        for(; word != 0 && num_matched_keys < max_keys; word &= word - 1)
+        {
+            end = add_key(end, num_matched_keys, table->entries[first + __builtin_ctzll(word)].record->key);
+            num_matched_keys++;
+        }
+
+    return (int) bitmap_cardinality(rows);
+}
+
+
+int query_scan(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, int max_keys, char* matched_keys)
+{
+    struct predicate bound[2 * MAX_COLUMNS_PER_TABLE];
+    int num_bound = bind_codes(table, predicate_arr, num_predicates, bound);
+    struct bitmap matches;
+    int num_matches;
+
+    bitmap_init(&matches);
+    num_matches = scan_table(table, bound, num_bound, &matches) == 0
+            ? add_keys(table, &matches, max_keys, matched_keys) : -1;
+    bitmap_free(&matches);
+
+    return num_matches;
+}
+
+
+/**
+ * @brief Returns the argument of a predicate as an index expects it, an int32_t or a string.
+ */
+static const void* predicate_argument(const struct table_schema* schema, const struct predicate* predicate)
+{
+    return schema->data_types[predicate->column_id] == 0 ? (const void*) &predicate->int_argument : (const void*) predicate->argument;
+}
+
+
+/**
+ * @brief Checks whether an index finds the records satisfying a predicate.
+ *
+ * A hashed index only finds the records of one value, and an IN list is
+ * never looked up through an index.
+ */
+static bool index_serves(const struct column_index* index, const struct predicate* predicate)
+{
+    return index != NULL && predicate->operator != 'I' && (!index->hashed || predicate->operator == '=');
+}
+
+
+void query_plan(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, struct query_plan* plan)
+{
+    const struct table_stats* stats = stats_get(table);
+    int limit = table->num_keys / (table->columns != NULL ? INDEX_ROW_COST * COLUMN_SCAN_SPEEDUP : INDEX_ROW_COST);
+    double estimate;
+    int p_index, i;
+
+    plan->num_predicates = num_predicates;
+    plan->estimated_rows = table->num_keys;
+    plan->driver = -1;
+
+    // Predicates are sorted by their estimates, those estimated alike keeping their order
+    for(p_index = 0; p_index < num_predicates; p_index++)
+    {
+        estimate = stats != NULL ? stats_selectivity(stats, table->schema, &predicate_arr[p_index]) * table->num_keys : table->num_keys;
+
+        for(i = p_index; i > 0 && plan->estimates[i - 1] > estimate; i--)
+        {
+            plan->predicate_arr[i] = plan->predicate_arr[i - 1];
+            plan->estimates[i] = plan->estimates[i - 1];
+        }
+        plan->predicate_arr[i] = predicate_arr[p_index];
+        plan->estimates[i] = estimate;
+        plan->estimated_rows *= table->num_keys > 0 ? estimate / table->num_keys : 0;
+    }
+
+    // The index of the most selective candidate confirms its count, counting no further than the scan it would save
+    for(i = 0; i < num_predicates && plan->estimates[i] < limit; i++)
+    {
+        const struct predicate* predicate = &plan->predicate_arr[i];
+        const struct column_index* index = table->indexes[predicate->column_id];
+
+        if(index_serves(index, predicate)
+                && index_count(index, predicate->operator, predicate_argument(table->schema, predicate), limit) < limit)
+        {
+            plan->driver = i;
+            break;
+        }
+    }
+}
+
+
+/**
+ * @brief Finds the rows of a table matching predicates through the index of one of them.
+ *
+ * @param driver The predicate whose index is visited.
+ * @param matches Where the matching rows are added.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+static int index_rows(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, int driver, struct bitmap* matches)
+{
+    const struct predicate* predicate = &predicate_arr[driver];
+    struct predicate bound[2 * MAX_COLUMNS_PER_TABLE];
+    int num_bound = bind_codes(table, predicate_arr, num_predicates, bound);
+    struct index_cursor cursor;
+    struct record* record;
+    uint32_t* rows = NULL;
+    int num_rows = 0, capacity = 0, status;
+
+    index_seek(table->indexes[predicate->column_id], predicate->operator, predicate_argument(table->schema, predicate), &cursor);
+
+    // The other predicates are tested on the records the index gives, and the rows left added to the bitmap at once
+    while((record = index_next(&cursor)) != NULL)
+    {
+        bool row_matches = table->columns != NULL
+                ? column_match(table->columns, bound, num_bound, record->row)
+                : query_match(predicate_arr, num_predicates, record_value(record));
+
+        if(!row_matches)
+            continue;
+
+        if(num_rows == capacity)
+        {
+            uint32_t* grown = (uint32_t*) realloc(rows, (capacity > 0 ? 2 * capacity : 64) * sizeof(uint32_t));
+
+            if(grown == NULL)
+            {
+                free(rows);
+                return -1;
+            }
+
+            rows = grown;
+            capacity = capacity > 0 ? 2 * capacity : 64;
+        }
+
+        rows[num_rows++] = record->row;
+    }
+
+    status = bitmap_add_many(matches, rows, num_rows);
+    free(rows);
+
+    return status;
+}
+
+
+int query_run(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, int max_keys, char* matched_keys)
+{
+    struct query_plan plan;
+    struct bitmap matches;
+    int num_matches;
+
+    query_plan(table, predicate_arr, num_predicates, &plan);
+    if(plan.driver < 0)
+        return query_scan(table, plan.predicate_arr, plan.num_predicates, max_keys, matched_keys);
+
+    bitmap_init(&matches);
+    num_matches = index_rows(table, plan.predicate_arr, plan.num_predicates, plan.driver, &matches) == 0
+            ? add_keys(table, &matches, max_keys, matched_keys) : -1;
+    bitmap_free(&matches);
+
+    return num_matches;
+}
+
+
+int query_parse_aggregate(const struct table_schema* schema, const char* function_name, const char* column_name, int* function, int* column_id)
+{
+    static const char* FUNCTION_NAMES[] = {"COUNT", "SUM", "MIN", "MAX", "AVG"};
+
+    for(*function = 0; *function < sizeof FUNCTION_NAMES / sizeof FUNCTION_NAMES[0]; (*function)++)
+        if(strcmp(FUNCTION_NAMES[*function], function_name) == 0)
+            break;
+
+    if(*function == sizeof FUNCTION_NAMES / sizeof FUNCTION_NAMES[0])
+        return -1;
+
+    // Only int columns are aggregated
+    if((*column_id = find_column(schema, column_name)) < 0 || schema->data_types[*column_id] != 0)
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * @brief Reads the int column of a row.
+ */
+static int32_t column_int(const struct hash_table* table, int column_id, int row)
+{
+    if(table->columns != NULL)
+        return ((const int32_t*) table->columns->columns[column_id])[row];
+
+    return row_int(&table->layout, record_value(table->entries[row].record), column_id);
+}
+
+
+/**
+ * @brief Adds a value to an aggregate.
+ */
+static void aggregate_add(struct aggregate* aggregate, int32_t value)
+{
+    if(aggregate->count == 0 || value < aggregate->min)
+        aggregate->min = value;
+    if(aggregate->count == 0 || value > aggregate->max)
+        aggregate->max = value;
+    aggregate->sum += value;
+    aggregate->count++;
+}
+
+
+/**
+ * @brief Adds the values of an aggregate to another.
+ */
+static void aggregate_merge(struct aggregate* aggregate, const struct aggregate* other)
+{
+    if(other->count == 0)
+        return;
+
+    if(aggregate->count == 0 || other->min < aggregate->min)
+        aggregate->min = other->min;
+    if(aggregate->count == 0 || other->max > aggregate->max)
+        aggregate->max = other->max;
+    aggregate->sum += other->sum;
+    aggregate->count += other->count;
+}
+
+
+/**
+ * @brief Aggregates a column over the rows of a range of a table matching predicates.
+ *
+ * @param first The first row of the range, a multiple of KERNEL_BLOCK_ROWS.
+ * @param last The row after the range.
+ * @param aggregate Where the matching rows are added.
+ */
+static void aggregate_rows(const struct hash_table* table, int column_id, const struct predicate predicate_arr[], int num_predicates,
+        int first, int last, struct aggregate* aggregate)
+{
+    const struct kernels* kernels = kernels_get();
+    uint64_t mask;
+    int count, num_zones = (last - first + ZONE_ROWS - 1) / ZONE_ROWS, num_skipped = 0;
+
+    for(; first < last; first += KERNEL_BLOCK_ROWS)
+    {
+        count = last - first < KERNEL_BLOCK_ROWS ? last - first : KERNEL_BLOCK_ROWS;
+
+        for(mask = rows_match(table, kernels, predicate_arr, num_predicates, first, count, &num_skipped); mask != 0; mask &= mask - 1)
+            aggregate_add(aggregate, column_int(table, column_id, first + __builtin_ctzll(mask)));
+    }
+
+    count_zones(table->zones, num_zones, num_skipped);
+}
+
+
+/**
+ * @brief An aggregate split into morsels of MORSEL_ROWS rows.
+ */
+struct aggregate_job {
+    const struct hash_table* table;
+    int column_id;
+    const struct predicate* predicate_arr;
+    int num_predicates;
+    struct aggregate* partials; ///< The aggregate of each morsel.
+};
+
+
+/**
+ * @brief Aggregates the matching rows of one morsel.
+ */
+static void aggregate_morsel(void* arg, int morsel)
+{
+    struct aggregate_job* job = (struct aggregate_job*) arg;
+    int first = morsel * MORSEL_ROWS;
+    int last = job->table->num_entries - first < MORSEL_ROWS ? job->table->num_entries : first + MORSEL_ROWS;
+
+    aggregate_rows(job->table, job->column_id, job->predicate_arr, job->num_predicates, first, last, &job->partials[morsel]);
+}
+
+
+/**
+ * @brief Answers an aggregate query from the indexes of a table, without visiting records.
+ *
+ * @return Returns true if the indexes answered the query, false otherwise.
+ */
+static bool aggregate_from_indexes(const struct hash_table* table, int function, int column_id, const struct predicate predicate_arr[],
+        int num_predicates, struct aggregate* aggregate)
+{
+    const struct column_index* index;
+
+    if(function == AGGREGATE_COUNT && num_predicates == 0)
+    {
+        aggregate->count = table->num_keys;
+        return true;
+    }
+
+    if(function == AGGREGATE_COUNT && num_predicates == 1 && index_serves(index = table->indexes[predicate_arr[0].column_id], &predicate_arr[0]))
+    {
+        aggregate->count = index_count(index, predicate_arr[0].operator, predicate_argument(table->schema, &predicate_arr[0]), INT_MAX);
+        return true;
+    }
+
+    // An empty index leaves the query to a scan, which finds no record
+    if((function == AGGREGATE_MIN || function == AGGREGATE_MAX) && num_predicates == 0 && (index = table->indexes[column_id]) != NULL
+            && index_bounds(index, &aggregate->min, &aggregate->max) == 0)
+    {
+        aggregate->count = table->num_keys;
+        return true;
+    }
+
+    return false;
+}
+
+
+void query_aggregate(struct hash_table* table, int function, int column_id, const struct predicate predicate_arr[], int num_predicates,
+        struct aggregate* aggregate)
+{
+    struct query_plan plan;
+    struct predicate bound[2 * MAX_COLUMNS_PER_TABLE];
+    struct aggregate_job job = {table, column_id, bound, 0, NULL};
+    int num_morsels, num_threads, i;
+
+    memset(aggregate, 0, sizeof *aggregate);
+
+    if(aggregate_from_indexes(table, function, column_id, predicate_arr, num_predicates, aggregate))
+        return;
+
+    query_plan(table, predicate_arr, num_predicates, &plan);
+    job.num_predicates = bind_codes(table, plan.predicate_arr, num_predicates, bound);
+    if(plan.driver >= 0)
+    {
+        const struct predicate* predicate = &plan.predicate_arr[plan.driver];
+        struct index_cursor cursor;
+        struct record* record;
+
+        index_seek(table->indexes[predicate->column_id], predicate->operator, predicate_argument(table->schema, predicate), &cursor);
+        while((record = index_next(&cursor)) != NULL)
+            if(table->columns != NULL
+                    ? column_match(table->columns, bound, job.num_predicates, record->row)
+                    : query_match(plan.predicate_arr, num_predicates, record_value(record)))
+                aggregate_add(aggregate, column_int(table, column_id, record->row));
+        return;
+    }
+
+    // Without memory for the partial aggregates, the table is scanned serially
+    num_threads = scan_threads(table, &num_morsels);
+    if(num_threads <= 1 || (job.partials = (struct aggregate*) calloc(num_morsels, sizeof *job.partials)) == NULL)
+    {
+        aggregate_rows(table, column_id, bound, job.num_predicates, 0, table->num_entries, aggregate);
+        return;
+    }
+
+    pool_run(aggregate_morsel, &job, num_morsels, num_threads);
+
+    for(i = 0; i < num_morsels; i++)
+        aggregate_merge(aggregate, &job.partials[i]);
+    free(job.partials);
+}
+
+
+int query_parse_order(const struct table_schema* schema, const char* column_name, const char* direction, int* column_id, bool* descending)
+{
+    if((*column_id = find_column(schema, column_name)) < 0)
+        return -1;
+
+    if(strcmp(direction, "ASC") == 0)
+        *descending = false;
+    else if(strcmp(direction, "DESC") == 0)
+        *descending = true;
+    else
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * @brief A record kept by a top-k query.
+ */
+struct top_entry {
+    const char* field; ///< The ordering column in the row of the record, possibly unaligned.
+    uint32_t row;
+};
+
+
+/**
+ * @brief The best records found so far by a top-k query, a binary heap whose root ranks last.
+ */
+struct top_heap {
+    struct top_entry* entries;
+    int size;
+    int capacity; ///< Records kept at most.
+    bool strings; ///< Whether the fields are strings, rather than ints or the codes of a char[n] column of a table stored by columns.
+    bool descending;
+};
+
+
+/**
+ * @brief Compares the ranks of two records in the order of a top-k query, ties broken by row.
+ *
+ * @return Returns a negative number if the first record is listed before the second, a positive number otherwise.
+ */
+static int compare_ranks(const struct top_heap* heap, const struct top_entry* a, const struct top_entry* b)
+{
+    int32_t x, y;
+    int order;
+
+    if(heap->strings)
+        order = strcmp(a->field, b->field);
+    else
+    {
+        memcpy(&x, a->field, sizeof x);
+        memcpy(&y, b->field, sizeof y);
+        order = x < y ? -1 : x > y;
+    }
+
+    if(heap->descending)
+        order = -order;
+
+    return order != 0 ? order : a->row < b->row ? -1 : a->row > b->row;
+}
+
+
+/**
+ * @brief Moves an entry of a top-k heap down until the entries below it rank before it.
+ */
+static void heap_sift_down(struct top_heap* heap, int i)
+{
+    struct top_entry entry = heap->entries[i];
+    int child;
+
+    for(; (child = 2 * i + 1) < heap->size; i = child)
+    {
+        if(child + 1 < heap->size && compare_ranks(heap, &heap->entries[child + 1], &heap->entries[child]) > 0)
+            child++;
+        if(compare_ranks(heap, &heap->entries[child], &entry) <= 0)
+            break;
+        heap->entries[i] = heap->entries[child];
+    }
+
+    heap->entries[i] = entry;
+}
+
+
+/**
+ * @brief Keeps a record in a top-k heap if it ranks before the worst one kept.
+ */
+static void heap_offer(struct top_heap* heap, const char* field, uint32_t row)
+{
+    struct top_entry entry = {field, row};
+    int i, parent;
+
+    if(heap->size == heap->capacity)
+    {
+        if(compare_ranks(heap, &entry, &heap->entries[0]) >= 0)
+            return;
+        heap->entries[0] = entry;
+        heap_sift_down(heap, 0);
+        return;
+    }
+
+    for(i = heap->size++; i > 0 && compare_ranks(heap, &heap->entries[parent = (i - 1) / 2], &entry) < 0; i = parent)
+        heap->entries[i] = heap->entries[parent];
+    heap->entries[i] = entry;
+}
+
+
+/**
+ * @brief Sorts the entries of a top-k heap in place, the first listed first.
+ */
+static void heap_sort(struct top_heap* heap)
+{
+    int size = heap->size;
+    struct top_entry last;
+
+    // The worst record left is moved past the heap, which shrinks by one
+    while(heap->size > 1)
+    {
+        last = heap->entries[--heap->size];
+        heap->entries[heap->size] = heap->entries[0];
+        heap->entries[0] = last;
+        heap_sift_down(heap, 0);
+    }
+
+    heap->size = size;
+}
+
+
+/**
+ * @brief Returns a column of a row, possibly unaligned.
+ */
+static const char* column_field(const struct hash_table* table, int column_id, int row)
+{
+    if(table->columns != NULL)
+        return table->columns->columns[column_id] + (size_t) row * table->columns->widths[column_id];
+
+    return record_value(table->entries[row].record) + table->layout.offsets[column_id];
+}
+
+
+/**
+ * @brief Offers the rows of a table matching predicates to a top-k heap, by a serial scan.
+ *
+ * Rows are offered in increasing order, so once the heap of ints or codes
+ * is full a later row with the value of its worst record ranks after it.
+ * A predicate on the column then only passes rows with a better value, and
+ * is narrowed after each block as the heap improves.
+ */
+static void top_rows(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, int column_id,
+        struct top_heap* heap)
+{
+    const struct kernels* kernels = kernels_get();
+    struct predicate bounded[2 * MAX_COLUMNS_PER_TABLE + 1];
+    int num_bounded = num_predicates, num_zones = (table->num_entries + ZONE_ROWS - 1) / ZONE_ROWS, num_skipped = 0;
+    int first, count, row;
+    uint64_t mask;
+
+    // The bound goes first, as it rejects the most rows once the heap holds good ones
+    memcpy(bounded + 1, predicate_arr, num_predicates * sizeof(struct predicate));
+    bounded[0].column_id = column_id;
+    bounded[0].offset = table->layout.offsets[column_id];
+    bounded[0].operator = heap->descending ? '>' : '<';
+    bounded[0].test = heap->descending ? int_greater : int_less;
+
+    for(first = 0; first < table->num_entries; first += KERNEL_BLOCK_ROWS)
+    {
+        count = table->num_entries - first < KERNEL_BLOCK_ROWS ? table->num_entries - first : KERNEL_BLOCK_ROWS;
+
+        for(mask = rows_match(table, kernels, bounded + (num_bounded == num_predicates), num_bounded, first, count, &num_skipped);
+                mask != 0; mask &= mask - 1)
+        {
+            row = first + __builtin_ctzll(mask);
+            heap_offer(heap, column_field(table, column_id, row), row);
+        }
+
+        if(!heap->strings && heap->size == heap->capacity)
+        {
+            memcpy(&bounded[0].int_argument, heap->entries[0].field, sizeof bounded[0].int_argument);
+            num_bounded = num_predicates + 1;
+        }
+    }
+
+    count_zones(table->zones, num_zones, num_skipped);
+}
+
+
+int query_top(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, int column_id, bool descending,
+        int max_keys, char* matched_keys)
+{
+    const struct column_index* index = table->indexes[column_id];
+    struct top_heap heap = {NULL, 0, max_keys < table->num_keys ? max_keys : table->num_keys,
+            table->schema->data_types[column_id] != 0 && table->columns == NULL, descending};
+    struct predicate bound[2 * MAX_COLUMNS_PER_TABLE];
+    struct query_plan plan;
+    struct index_cursor cursor;
+    struct record* record;
+    char* end = matched_keys;
+    int num_matched_keys = 0, num_bound, i;
+
+    *matched_keys = 0;
+    if(heap.capacity <= 0)
+        return 0;
+
+    query_plan(table, predicate_arr, num_predicates, &plan);
+    num_bound = bind_codes(table, plan.predicate_arr, num_predicates, bound);
+
+    // Matches are taken as spread evenly along the index, so a walk visits num_keys / estimated_rows records per match
+    if(index != NULL && !index->hashed)
+    {
+        double walked = (double) max_keys * table->num_keys / (plan.estimated_rows > 1 ? plan.estimated_rows : 1);
+        double limit = plan.driver >= 0 ? plan.estimates[plan.driver]
+                : (double) table->num_keys / (table->columns != NULL ? INDEX_ROW_COST * COLUMN_SCAN_SPEEDUP : INDEX_ROW_COST);
+
+        if(walked < limit)
+        {
+            index_seek_order(index, descending, &cursor);
+            while(num_matched_keys < max_keys && (record = index_next(&cursor)) != NULL)
+                if(table->columns != NULL
+                        ? column_match(table->columns, bound, num_bound, record->row)
+                        : query_match(plan.predicate_arr, num_predicates, record_value(record)))
+                    end = add_key(end, num_matched_keys++, record->key);
+
+            return num_matched_keys;
+        }
+    }
+
+    if((heap.entries = (struct top_entry*) malloc(heap.capacity * sizeof(struct top_entry))) == NULL)
+        return -1;
+
+    if(plan.driver >= 0)
+    {
+        const struct predicate* predicate = &plan.predicate_arr[plan.driver];
+
+        index_seek(table->indexes[predicate->column_id], predicate->operator, predicate_argument(table->schema, predicate), &cursor);
+        while((record = index_next(&cursor)) != NULL)
+            if(table->columns != NULL
+                    ? column_match(table->columns, bound, num_bound, record->row)
+                    : query_match(plan.predicate_arr, num_predicates, record_value(record)))
+                heap_offer(&heap, column_field(table, column_id, record->row), record->row);
+    }
+    else
+        top_rows(table, bound, num_bound, column_id, &heap);
+
+    heap_sort(&heap);
+    for(i = 0; i < heap.size; i++)
+        end = add_key(end, i, table->entries[heap.entries[i].row].record->key);
+    free(heap.entries);
+
+    return heap.size;
+}
+
+
+void query_cursor_open(struct hash_table* table, struct query_cursor* cursor, const struct predicate predicate_arr[], int num_predicates)
+{
+    int i;
+
+    // The plan the predicates come from may be replaced while the cursor is open
+    memcpy(cursor->predicate_arr, predicate_arr, num_predicates * sizeof(struct predicate));
+    cursor->num_predicates = num_predicates;
+    for(i = 0; i < num_predicates; i++)
+        if(predicate_arr[i].list != NULL)
+            predicate_arr[i].list->refs++;
+    table_cursor_open(table, &cursor->position);
+}
+
+
+int query_cursor_visit(struct hash_table* table, struct query_cursor* cursor, int max_records, query_visitor visit, void* arg)
+{
+    const struct kernels* kernels = kernels_get();
+    struct predicate bound[2 * MAX_COLUMNS_PER_TABLE];
+    int num_bound = bind_codes(table, cursor->predicate_arr, cursor->num_predicates, bound);
+    int num_records = 0, num_zones = 0, num_skipped = 0, first, count, row;
+    uint64_t mask;
+
+    while(num_records < max_records && cursor->position.entry < table->num_entries)
+    {
+        // A cursor resumed within a block compares the block of its zone, ignoring the rows before it
+        first = cursor->position.entry - cursor->position.entry % ZONE_ROWS;
+        count = table->num_entries - first < KERNEL_BLOCK_ROWS ? table->num_entries - first : KERNEL_BLOCK_ROWS;
+        mask = rows_match(table, kernels, bound, num_bound, first, count, &num_skipped)
+                & (~0ull << (cursor->position.entry - first));
+        num_zones++;
+
+        // A block left with matches is resumed at the first record not visited
+        cursor->position.entry = first + count;
+        for(; mask != 0; mask &= mask - 1)
+        {
+            row = first + __builtin_ctzll(mask);
+            if(num_records == max_records || visit(arg, table->entries[row].record) != 0)
+            {
+                cursor->position.entry = row;
+                count_zones(table->zones, num_zones, num_skipped);
+                return num_records;
+            }
+            num_records++;
+        }
+    }
+
+    count_zones(table->zones, num_zones, num_skipped);
+
+    return num_records;
+}
+
+
+/**
+ * @brief The keys listed by query_cursor_next().
+ */
+struct key_list {
+    char* end; ///< End of the keys written so far.
+    int num_keys;
+};
+
+
+/**
+ * @brief Appends the key of a record to a key_list.
+ */
+static int list_key(void* arg, const struct record* record)
+{
+    struct key_list* list = (struct key_list*) arg;
+
+    list->end = add_key(list->end, list->num_keys++, record->key);
+
+    return 0;
+}
+
+
+int query_cursor_next(struct hash_table* table, struct query_cursor* cursor, int max_keys, char* matched_keys)
+{
+    struct key_list list = {matched_keys, 0};
+
+    *matched_keys = 0;
+
+    return query_cursor_visit(table, cursor, max_keys, list_key, &list);
+}
+
+
+void query_cursor_close(struct hash_table* table, struct query_cursor* cursor)
+{
+    table_cursor_close(table, &cursor->position);
+    query_release(cursor->predicate_arr, cursor->num_predicates);
+}
+
+
+/**
+ * @brief Checks whether a key is in the range of a key scan.
+ */
+static bool key_in_range(const char* key, const char* after, const char* end, const char* prefix)
+{
+    return (after == NULL || strcmp(key, after) > 0) && (end == NULL || strcmp(key, end) < 0)
+            && (prefix == NULL || strncmp(key, prefix, strlen(prefix)) == 0);
+}
+
+
+/**
+ * @brief Orders keys for qsort.
+ */
+static int compare_keys(const void* a, const void* b)
+{
+    return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+
+int query_keys(struct hash_table* table, const char* after, const char* end, const char* prefix, int max_keys, char* matched_keys)
+{
+    int num_matched_keys = 0;
+    char* end_of_keys = matched_keys;
+    const char* key;
+
+    *matched_keys = 0;
+
+    if(table->ordered_keys != NULL)
+    {
+        struct btree_cursor cursor;
+
+        // Keys with the prefix are contiguous, so the scan starts at the prefix unless after is further
+        if(prefix != NULL && (after == NULL || strcmp(prefix, after) > 0))
+            btree_seek(table->ordered_keys, prefix, true, &cursor);
+        else
+            btree_seek(table->ordered_keys, after, false, &cursor);
+
+        while(num_matched_keys < max_keys && (key = btree_next(&cursor)) != NULL && key_in_range(key, after, end, prefix))
+            end_of_keys = add_key(end_of_keys, num_matched_keys++, key);
+
+        return num_matched_keys;
+    }
+
+    // Without an ordered index, all the keys in the range are sorted
+    const char** keys = (const char**) malloc((table->num_keys > 0 ? table->num_keys : 1) * sizeof(const char*));
+    struct table_iterator iterator;
+    struct record* record;
+    int num_keys = 0;
+
+    if(keys == NULL)
+        return -1;
+
+    table_iterator_init(&iterator);
+    while((record = table_next(table, &iterator)) != NULL)
+        if(key_in_range(record->key, after, end, prefix))
+            keys[num_keys++] = record->key;
+
+    qsort(keys, num_keys, sizeof keys[0], compare_keys);
+
+    while(num_matched_keys < max_keys && num_matched_keys < num_keys)
+    {
+        end_of_keys = add_key(end_of_keys, num_matched_keys, keys[num_matched_keys]);
+        num_matched_keys++;
+    }
+
+    free(keys);
+
+    return num_matched_keys;
+}
@@ -0,0 +1,445 @@
+/**
+ * @file
+ * @brief This file declares the parsing and evaluation of query predicates.
+ *
+ * Predicates are compiled when parsed: the column is resolved to its
+ * offset in a row, the argument to a typed constant and the operator to a
+ * comparison function, so matching a row is one indirect call per
+ * predicate. Compiled predicates are cached per table by their normalized
+ * text, so a query repeated by a client skips the parsing altogether.
+ *
+ * String columns are compared with '=', '<', '>' and "^=" for a prefix.
+ * The char[n] columns of a table stored by columns hold the codes of an
+ * order-preserving dictionary (dict.h), so their predicates are bound to
+ * ranges of codes before each evaluation and compared like int columns.
+ *
+ * A predicate may also test membership, as "province IN (Ontario, Quebec)"
+ * or "province = Ontario OR province = Quebec", the alternatives of an OR
+ * being equalities or IN lists on the same column. Its values are put in
+ * a hash set (set.h) when it is parsed, so a row costs one probe however
+ * many values are listed. Such predicates are never driven by an index.
+ */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "table.h"
+#include "set.h"
+
+
+#define PLAN_CACHE_SIZE 64 ///< Compiled predicates cached per table, a power of two.
+
+
+struct predicate;
+
+
+/**
+ * @brief The values of an IN predicate, shared by the copies of the predicate.
+ *
+ * A list belongs to the plan it was parsed into, and to each cursor whose
+ * predicates hold it, and is freed when the last of them releases it.
+ */
+struct in_list {
+    int refs; ///< Plans and cursors holding the list.
+    struct value_set values; ///< The ints or strings listed.
+    struct value_set codes; ///< The codes of the strings in the dictionary of a table stored by columns, with room for every value.
+    unsigned long long codes_version; ///< Version of the table the codes were looked up at, ULLONG_MAX before.
+};
+
+
+/**
+ * @brief Compares a field of a row with the argument of a predicate.
+ *
+ * @param predicate The predicate.
+ * @param field The column of the predicate in a row, possibly unaligned.
+ * @return Returns true if the field satisfies the predicate.
+ */
+typedef bool (*predicate_test)(const struct predicate* predicate, const char* field);
+
+
+/**
+ * @brief Predicate structure that stores the column, operator, argument.
+ */
+struct predicate {
+    int column_id;
+    int offset; ///< Offset of the column in a row.
+    predicate_test test; ///< Comparison of the column type and operator.
+    char operator; ///< One of '<', '>' or '=', '^' for a prefix of a string column, or 'I' for an IN list.
+    int32_t int_argument; ///< Argument of an int column.
+    char argument[MAX_STRTYPE_SIZE]; ///< Argument of a string column.
+    int argument_size; ///< Bytes of the argument of a string column, with its null terminator.
+    struct in_list* list; ///< The values of an IN list, NULL for other operators.
+};
+
+
+/**
+ * @brief The compiled predicates of a query, cached under their normalized text.
+ */
+struct cached_plan {
+    uint64_t hash; ///< Hash of the text.
+    char* text; ///< The normalized predicates, NULL for an empty slot.
+    int num_predicates; ///< -1 if the predicates are invalid.
+    struct predicate predicate_arr[MAX_COLUMNS_PER_TABLE];
+};
+
+
+/**
+ * @brief The compiled predicates of the last queries of a table.
+ *
+ * Plans are stored in the slot given by the hash of their text, replacing
+ * the plan that was there.
+ */
+struct plan_cache {
+    struct cached_plan plans[PLAN_CACHE_SIZE];
+    unsigned long long hits; ///< Queries whose predicates were found compiled.
+    unsigned long long misses; ///< Queries whose predicates were parsed.
+};
+
+
+/**
+ * @brief Parses and compiles the predicates of a query.
+ *
+ * Each column may appear in at most one predicate, so the array needs room
+ * for the number of columns of the table. The commas of IN lists do not
+ * separate predicates.
+ *
+ * @param schema The schema of the queried table.
+ * @param layout The row layout of the queried table.
+ * @param predicates Comma separated predicates, modified by the parsing.
+ * @param predicate_arr Where the compiled predicates are stored, to be released by query_release().
+ * @return Returns the number of predicates on success, -1 if they are invalid or out of memory.
+ */
+int query_parse(const struct table_schema* schema, const struct row_layout* layout, char* predicates, struct predicate predicate_arr[]);
+
+
+/**
+ * @brief Releases the IN lists of compiled predicates, freeing those no plan or cursor holds any more.
+ */
+void query_release(const struct predicate predicate_arr[], int num_predicates);
+
+
+/**
+ * @brief Allocates an empty plan cache.
+ *
+ * @return Returns the cache on success, NULL otherwise.
+ */
+struct plan_cache* plan_cache_create(void);
+
+
+/**
+ * @brief Frees a plan cache and its plans.
+ */
+void plan_cache_destroy(struct plan_cache* cache);
+
+
+/**
+ * @brief Drops the spaces next to commas, operators and parentheses, and at both ends of predicates.
+ *
+ * Other spaces are kept, as they may be part of a string argument.
+ *
+ * @param predicates Comma separated predicates, normalized in place.
+ */
+void query_normalize(char* predicates);
+
+
+/**
+ * @brief Compiles the predicates of a query, or finds them in a cache.
+ *
+ * The text is first normalized by dropping the spaces around commas and
+ * operators, which the parsing ignores, so "age > 90" and "age>90" share
+ * a plan.
+ *
+ * @param cache The plan cache of the queried table.
+ * @param table The queried table.
+ * @param predicates Comma separated predicates, modified by the normalization and parsing.
+ * @param predicate_arr Where the compiled predicates are stored. Their IN lists belong to the cache, and
+ * are only valid until the next call with the same cache.
+ * @return Returns the number of predicates on success, -1 if they are invalid.
+ */
+int query_prepare(struct plan_cache* cache, const struct hash_table* table, char* predicates, struct predicate predicate_arr[]);
+
+
+/**
+ * @brief Writes the least string greater than every string starting with a prefix, its last byte incremented.
+ *
+ * @param prefix A non empty prefix.
+ * @param end Where the string is written, as many bytes as the prefix.
+ */
+void query_prefix_end(const char* prefix, char* end);
+
+
+/**
+ * @brief Checks a row against compiled predicates.
+ *
+ * @return Returns true if the row satisfies every predicate.
+ */
+bool query_match(const struct predicate predicate_arr[], int num_predicates, const char* row);
+
+
+#define INDEX_ROW_COST 8 ///< A record visited through an index costs as much as this many rows compared by a scan.
+#define COLUMN_SCAN_SPEEDUP 8 ///< The kernels compare this many rows of a table stored by columns in the time of one stored by rows.
+#define IN_KERNEL_VALUES 12 ///< The kernels compare a table stored by columns with an IN list of at most this many values one value at a time, faster than probing its set.
+#define MORSEL_ROWS 65536 ///< Rows compared by one morsel of a parallel scan, those of one bitmap container.
+#define MORSELS_PER_THREAD 2 ///< A scan runs on one thread per this many morsels at most, so small tables are scanned serially.
+
+#define AGGREGATE_COUNT 0 ///< Number of matching records.
+#define AGGREGATE_SUM 1 ///< Sum of a column over the matching records.
+#define AGGREGATE_MIN 2 ///< Least value of a column among the matching records.
+#define AGGREGATE_MAX 3 ///< Greatest value of a column among the matching records.
+#define AGGREGATE_AVG 4 ///< Mean of a column over the matching records.
+
+
+/**
+ * @brief Compares all records of a table against predicates and finds matching keys.
+ *
+ * Records are visited in insertion order, without using the column indexes.
+ * Tables stored by columns are compared KERNEL_BLOCK_ROWS rows at a time by
+ * the vectorized kernels of kernel.h. The matching rows are gathered in a
+ * bitmap (bitmap.h), from which the first max_keys keys are read.
+ *
+ * Tables of several MORSEL_ROWS rows are split into morsels run by the
+ * pool of pool.h, each morsel gathering its matches in a bitmap of its
+ * own. As a morsel covers the rows of a single container, the bitmaps are
+ * merged by moving their containers in row order.
+ *
+ * @param table The table to query.
+ * @param predicate_arr Array containing all predicates.
+ * @param num_predicates Number of predicates to match records with.
+ * @param max_keys Maximum number of keys written to matched_keys.
+ * @param matched_keys Where the first max_keys matching keys are written, separated by ", ".
+ * @return Returns the number of matching records, or -1 if out of memory.
+ */
+int query_scan(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, int max_keys, char* matched_keys);
+
+
+/**
+ * @brief The plan of a query: the order its predicates are tested in, and how its records are reached.
+ */
+struct query_plan {
+    int num_predicates;
+    struct predicate predicate_arr[MAX_COLUMNS_PER_TABLE]; ///< The predicates, the most selective first.
+    double estimates[MAX_COLUMNS_PER_TABLE]; ///< Estimated records matching each predicate alone.
+    double estimated_rows; ///< Estimated records matching every predicate, the columns taken as independent.
+    int driver; ///< The predicate whose index drives the query, -1 to scan the table.
+};
+
+
+/**
+ * @brief Plans a query from the column statistics of its table (stats.h).
+ *
+ * The predicates are ordered by their estimated matches, so that a row is
+ * rejected by the fewest comparisons. The most selective indexed predicate
+ * drives the query if visiting its records through the index costs less
+ * than comparing every row, a record visited through an index costing
+ * INDEX_ROW_COST rows of a table stored by rows, or COLUMN_SCAN_SPEEDUP
+ * times as many of a table stored by columns. As an estimate may be off,
+ * the index counts its matches, up to that break-even count, before it is
+ * chosen.
+ *
+ * @param table The table to query, sampled first if its statistics are stale.
+ * @param predicate_arr Array containing all predicates.
+ * @param num_predicates Number of predicates to match records with.
+ * @param plan Where the plan is stored.
+ */
+void query_plan(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, struct query_plan* plan);
+
+
+/**
+ * @brief Finds the records of a table matching predicates.
+ *
+ * The query follows the plan of query_plan(): it is driven by the chosen
+ * index, whose records are tested against the other predicates, or else
+ * by a full scan, the predicates being tested in the planned order.
+ * Either way the matching rows are gathered in a bitmap (bitmap.h), so the
+ * count is exact and keys are only read for the first max_keys rows, in
+ * insertion order.
+ *
+ * @param table The table to query.
+ * @param predicate_arr Array containing all predicates.
+ * @param num_predicates Number of predicates to match records with.
+ * @param max_keys Maximum number of keys written to matched_keys.
+ * @param matched_keys Where the first max_keys matching keys are written, separated by ", ".
+ * @return Returns the number of matching records, or -1 if out of memory.
+ */
+int query_run(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, int max_keys, char* matched_keys);
+
+
+/**
+ * @brief The aggregates of an int column over the records matching predicates.
+ */
+struct aggregate {
+    long long count; ///< Matching records.
+    long long sum; ///< Sum of the column, if the function needs it.
+    int32_t min; ///< Least value of the column, if the function needs it and count > 0.
+    int32_t max; ///< Greatest value of the column, if the function needs it and count > 0.
+};
+
+
+/**
+ * @brief Resolves the function and column of an aggregate query.
+ *
+ * @param schema The schema of the queried table.
+ * @param function_name One of "COUNT", "SUM", "MIN", "MAX" or "AVG".
+ * @param column_name The aggregated column, which must be an int column.
+ * @param function Where the AGGREGATE_ constant of the function is stored.
+ * @param column_id Where the column id is stored.
+ * @return Returns 0 on success, -1 if the function or column is invalid.
+ */
+int query_parse_aggregate(const struct table_schema* schema, const char* function_name, const char* column_name, int* function, int* column_id);
+
+
+/**
+ * @brief Aggregates an int column over the records of a table matching predicates.
+ *
+ * Where the indexes answer the query without visiting records, they do:
+ * a COUNT with no predicate is the number of records, a COUNT with a
+ * single indexed predicate is counted by its index, and the MIN or MAX of
+ * a whole column indexed by a B+tree are its first or last value. Other
+ * queries visit the records of the index query_plan() picks, or else scan
+ * the table by morsels as query_scan() does, each morsel aggregating its
+ * rows apart before the partial aggregates are merged. No key is read.
+ *
+ * @param table The table to query.
+ * @param function The AGGREGATE_ constant of the function, which decides the fields computed.
+ * @param column_id The aggregated int column.
+ * @param predicate_arr Array containing all predicates.
+ * @param num_predicates Number of predicates to match records with.
+ * @param aggregate Where the aggregates are stored.
+ */
+void query_aggregate(struct hash_table* table, int function, int column_id, const struct predicate predicate_arr[], int num_predicates,
+        struct aggregate* aggregate);
+
+
+/**
+ * @brief Resolves the column and direction of the ordering clause of a query.
+ *
+ * @param schema The schema of the queried table.
+ * @param column_name The column the records are ordered by, of any type.
+ * @param direction Either "ASC" or "DESC".
+ * @param column_id Where the column id is stored.
+ * @param descending Where whether the order is decreasing is stored.
+ * @return Returns 0 on success, -1 if the column or direction is invalid.
+ */
+int query_parse_order(const struct table_schema* schema, const char* column_name, const char* direction, int* column_id, bool* descending);
+
+
+/**
+ * @brief Lists the keys of the first records matching predicates, in the order of a column.
+ *
+ * Int columns are ordered by value and char[n] columns by strcmp(). The
+ * records are found without sorting every match, in memory proportional
+ * to max_keys. If the column has an ordered index, and query_plan()
+ * estimates that walking it from the right end visits fewer records than
+ * the query would otherwise, the index is walked until max_keys records
+ * match. Otherwise the records reached through the driving index, or by
+ * a scan, are kept in a heap of the max_keys best. Once the heap is full, a
+ * scan ordered by an int column also skips the rows not better than the
+ * worst of the heap, so its zones (zonemap.h) are pruned as it goes.
+ * Records sharing a value of the column are listed in no particular order.
+ *
+ * @param table The table to query.
+ * @param predicate_arr Array containing all predicates.
+ * @param num_predicates Number of predicates to match records with.
+ * @param column_id The column the records are ordered by.
+ * @param descending Whether the records are listed from the greatest value.
+ * @param max_keys Maximum number of keys written to matched_keys.
+ * @param matched_keys Where the keys are written, separated by ", ".
+ * @return Returns the number of keys listed, at most max_keys, or -1 if out of memory.
+ */
+int query_top(struct hash_table* table, const struct predicate predicate_arr[], int num_predicates, int column_id, bool descending,
+        int max_keys, char* matched_keys);
+
+
+/**
+ * @brief A query whose matching keys are listed a few at a time.
+ *
+ * A cursor holds its compiled predicates and the position of its scan,
+ * not its matches, so it costs the same memory whatever the size of the
+ * table. Each call resumes the scan where the last one stopped. Records
+ * are visited in insertion order through a table_cursor, so keys set or
+ * removed between calls are listed as a scan reaching them then would.
+ */
+struct query_cursor {
+    struct table_cursor position; ///< Next row to compare.
+    int num_predicates;
+    struct predicate predicate_arr[MAX_COLUMNS_PER_TABLE];
+};
+
+
+/**
+ * @brief Opens a cursor over the records of a table matching predicates.
+ *
+ * @param table The table to query.
+ * @param cursor The cursor, which must stay at the same address until closed.
+ * @param predicate_arr Array containing all predicates, copied into the cursor, which holds their IN lists until closed.
+ * @param num_predicates Number of predicates to match records with.
+ */
+void query_cursor_open(struct hash_table* table, struct query_cursor* cursor, const struct predicate predicate_arr[], int num_predicates);
+
+
+/**
+ * @brief Lists the next keys of a query cursor.
+ *
+ * @param table The table of the cursor.
+ * @param cursor The cursor.
+ * @param max_keys Maximum number of keys listed.
+ * @param matched_keys Where the keys are written, separated by ", ".
+ * @return Returns the number of keys listed, fewer than max_keys only once
+ * every row was visited.
+ */
+int query_cursor_next(struct hash_table* table, struct query_cursor* cursor, int max_keys, char* matched_keys);
+
+
+/**
+ * @brief Visits a record matched by a query cursor.
+ *
+ * @param arg The argument given to query_cursor_visit().
+ * @param record The matching record, straight from its table entry.
+ * @return Returns 0 to go on, -1 to stop before this record, which is then
+ * the first visited by the next call.
+ */
+typedef int (*query_visitor)(void* arg, const struct record* record);
+
+
+/**
+ * @brief Visits the next records of a query cursor.
+ *
+ * The records come from the entries the predicates were compared on, so
+ * a caller needing their values does not look their keys up again.
+ *
+ * @param table The table of the cursor.
+ * @param cursor The cursor.
+ * @param max_records Maximum number of records visited.
+ * @param visit The function called on each matching record.
+ * @param arg The argument given to visit.
+ * @return Returns the number of records visited, fewer than max_records
+ * only once every row was visited or visit stopped.
+ */
+int query_cursor_visit(struct hash_table* table, struct query_cursor* cursor, int max_records, query_visitor visit, void* arg);
+
+
+/**
+ * @brief Closes a query cursor.
+ */
+void query_cursor_close(struct hash_table* table, struct query_cursor* cursor);
+
+
+/**
+ * @brief Lists the keys of a table in a range, in ascending order.
+ *
+ * Tables with an ordered key index seek the first key of the range and
+ * stop after max_keys keys. Other tables are scanned in full, and the keys
+ * in the range sorted.
+ *
+ * @param table The table to scan.
+ * @param after Only keys greater than this one are listed, or NULL.
+ * @param end Only keys less than this one are listed, or NULL.
+ * @param prefix Only keys starting with this prefix are listed, or NULL.
+ * @param max_keys Maximum number of keys listed.
+ * @param matched_keys Where the keys are written, separated by ", ".
+ * @return Returns the number of keys listed, at most max_keys, or -1 if out of memory.
+ */
+int query_keys(struct hash_table* table, const char* after, const char* end, const char* prefix, int max_keys, char* matched_keys);
+
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * @file
+ * @brief This file implements the binary row format declared in row.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "row.h"
+
+
+void row_layout_init(struct row_layout* layout, const struct table_schema* schema)
+{
+    int i, offset = 0;
+
+    for(i = 0; i < schema->num_columns; i++)
+        if(schema->data_types[i] == 0)
+        {
+            layout->offsets[i] = offset;
+            offset += sizeof(int32_t);
+        }
+
+    for(i = 0; i < schema->num_columns; i++)
+        if(schema->data_types[i] != 0)
+        {
+            layout->offsets[i] = offset;
+            offset += schema->data_types[i];
+        }
+
+    layout->size = offset;
+}
+
+
+int row_parse(const struct table_schema* schema, const struct row_layout* layout, const char* value, char* row)
+{
+    char buf[MAX_VALUE_LEN] = {0};
+    char column_name[MAX_VALUE_LEN];
+    char str_data[MAX_VALUE_LEN];
+    int int_data, column_id = 0;
+    char* cur_column;
+
+    if(strlen(value) >= sizeof buf)
+        return -1;
+
+    strcpy(buf, value);
+    memset(row, 0, layout->size);
+
+    // Format from design specifications (spaces before and after commas are allowed)
+    for(cur_column = strtok(buf, ","); cur_column != NULL; cur_column = strtok(NULL, ","), column_id++)
+    {
+        if(column_id == schema->num_columns) // More columns than in the table
+            return -1;
+
+        if(schema->data_types[column_id] == 0) // Expecting an integer
+        {
+            if(sscanf(cur_column, " %[a-zA-Z0-9] %d", column_name, &int_data) != 2)
+                return -1;
+
+            int32_t field = int_data;
+            memcpy(row + layout->offsets[column_id], &field, sizeof field);
+        }
+        else // Expecting a string
+        {
+            str_data[0] = 0;
+            if(sscanf(cur_column, " %[a-zA-Z0-9] %[a-zA-Z0-9 ]", column_name, str_data) < 1)
+                return -1;
+
+            // Trailing spaces are not part of the string
+            size_t length = strlen(str_data);
+            while(length > 0 && str_data[length - 1] == ' ')
+                str_data[--length] = 0;
+
+            if(length + 1 > schema->data_types[column_id]) // String too long for its column
+                return -1;
+
+            memcpy(row + layout->offsets[column_id], str_data, length + 1);
+        }
+
+        // Column name in value does not match column name in table at current position
+        if(strcmp(schema->column_names[column_id], column_name) != 0)
+            return -1;
+    }
+
+    if(column_id != schema->num_columns) // Less columns than in the table
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * @brief Encodes a column of a row as a "name value" pair.
+ *
+ * @return Returns the end of the pair written.
+ */
+static char* format_column(const struct table_schema* schema, const struct row_layout* layout, const char* row, int column, char* value)
+{
+    if(schema->data_types[column] == 0)
+        return value + sprintf(value, "%s %d", schema->column_names[column], row_int(layout, row, column));
+
+    return value + sprintf(value, "%s %s", schema->column_names[column], row_string(layout, row, column));
+}
+
+
+void row_format(const struct table_schema* schema, const struct row_layout* layout, const char* row, char* value)
+{
+    int i;
+
+    for(i = 0; i < schema->num_columns; i++)
+    {
+        if(i > 0)
+            *value++ = ',';
+        value = format_column(schema, layout, row, i, value);
+    }
+
+    *value = 0;
+}
+
+
+int row_parse_columns(const struct table_schema* schema, const char* names, int column_ids[])
+{
+    char buf[MAX_CMD_LEN];
+    char* name;
+    int num_columns = 0, i, j;
+
+    if(strlen(names) >= sizeof buf)
+        return -1;
+
+    strcpy(buf, names);
+    for(name = strtok(buf, ", "); name != NULL; name = strtok(NULL, ", "))
+    {
+        for(i = 0; i < schema->num_columns && strcmp(schema->column_names[i], name) != 0; i++)
+            ;
+
+        // Each column is listed at most once
+        for(j = 0; j < num_columns && column_ids[j] != i; j++)
+            ;
+
+        if(i == schema->num_columns || j < num_columns)
+            return -1;
+
+        column_ids[num_columns++] = i;
+    }
+
+    return num_columns > 0 ? num_columns : -1;
+}
+
+
+void row_project(const struct table_schema* schema, const struct row_layout* layout, const char* row, const int column_ids[],
+        int num_columns, char* value)
+{
+    int i;
+
+    for(i = 0; i < num_columns; i++)
+    {
+        if(i > 0)
+            *value++ = ',';
+        value = format_column(schema, layout, row, column_ids[i], value);
+    }
+
+    *value = 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file
+ * @brief This file declares the binary row format of records.
+ *
+ * A value such as "name bob,age 22" is decoded once when it is SET into a
+ * fixed size row laid out from the table schema: int columns are int32_t
+ * fields and char[n] columns n byte null terminated fields, each at an
+ * offset computed when the table is created. Queries read the fields in
+ * place, and the text form is only rebuilt when a record is sent back to a
+ * client.
+ */
+
+#ifndef ROW_H
+#define ROW_H
+
+#include <stdint.h>
+#include <string.h>
+#include "utils.h"
+
+
+/**
+ * @brief Offsets of the columns of a table in its rows.
+ *
+ * Int columns come first so that they are aligned without padding.
+ */
+struct row_layout {
+    int offsets[MAX_COLUMNS_PER_TABLE];
+    int size; ///< Size of a row in bytes.
+};
+
+
+/**
+ * @brief Computes the layout of the rows of a table.
+ *
+ * @param layout The layout to initialize.
+ * @param schema The schema of the table.
+ */
+void row_layout_init(struct row_layout* layout, const struct table_schema* schema);
+
+
+/**
+ * @brief Decodes a value sent by a client into a row.
+ *
+ * The value must list every column of the schema in order, as comma
+ * separated "name value" pairs. Ints are parsed with %d and strings, whose
+ * trailing spaces are dropped, must fit in their char[n] column.
+ *
+ * @param schema The schema of the table.
+ * @param layout The row layout of the table.
+ * @param value The value to decode.
+ * @param row Where the row is stored, layout->size bytes.
+ * @return Returns 0 on success, -1 if the value does not match the schema.
+ */
+int row_parse(const struct table_schema* schema, const struct row_layout* layout, const char* value, char* row);
+
+
+/**
+ * @brief Encodes a row as the value sent to clients.
+ *
+ * @param schema The schema of the table.
+ * @param layout The row layout of the table.
+ * @param row The row to encode.
+ * @param value Where the value is stored, at least MAX_VALUE_LEN bytes.
+ */
+void row_format(const struct table_schema* schema, const struct row_layout* layout, const char* row, char* value);
+
+
+/**
+ * @brief Resolves the columns of a projection.
+ *
+ * @param schema The schema of the table.
+ * @param names Column names separated by commas or spaces, each listed at most once.
+ * @param column_ids Where the column ids are stored, in the order listed.
+ * @return Returns the number of columns on success, -1 if a column is unknown, repeated, or none is listed.
+ */
+int row_parse_columns(const struct table_schema* schema, const char* names, int column_ids[]);
+
+
+/**
+ * @brief Encodes some columns of a row as a value, as row_format() encodes them all.
+ *
+ * @param schema The schema of the table.
+ * @param layout The row layout of the table.
+ * @param row The row to encode.
+ * @param column_ids The columns to encode, in order.
+ * @param num_columns Number of columns.
+ * @param value Where the value is stored, at least MAX_VALUE_LEN bytes.
+ */
+void row_project(const struct table_schema* schema, const struct row_layout* layout, const char* row, const int column_ids[],
+        int num_columns, char* value);
+
+
+/**
+ * @brief Returns an int column of a row.
+ */
+static inline int32_t row_int(const struct row_layout* layout, const char* row, int column)
+{
+    int32_t value;
+    memcpy(&value, row + layout->offsets[column], sizeof value);
+    return value;
+}
+
+
+/**
+ * @brief Returns a null terminated char[n] column of a row.
+ */
+static inline const char* row_string(const struct row_layout* layout, const char* row, int column)
+{
+    return row + layout->offsets[column];
+}
+
+
+#endif
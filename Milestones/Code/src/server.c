@@ -20,12 +20,17 @@
 #include <assert.h>
 #include <signal.h>
 #include <time.h>
+#include <limits.h>
 #include "utils.h"
+#include "table.h"
+#include "hash.h"
+#include "query.h"
+#include "cache.h"
+#include "stats.h"
+#include "pool.h"
 #include <pthread.h>
 
 #define MAX_LISTENQUEUELEN 20	///< The maximum number of queued connections.
-#define NO_COLLISION 0 ///< Initial collision level is 0.
-#define NO_TABLE_INDEX -1 ///< Parameter for hashing table_index
 //#define LOGGING 1 ///< Server-side logging output stream config, 0 = Disable, 1 = STDOUT, 2 = Defined File.
 
 /**
@@ -44,39 +49,41 @@ char log_buffer[BUFFER_SIZE] = {0};
 
 
 /**
- *@brief Declaring a record with a specific value and key
+ * @brief Array of hash_table structures representing the database.
  */
-struct record {
-    char key[MAX_KEY_LEN];
-    char value[MAX_VALUE_LEN];
-    uintptr_t metadata[MAX_METADATA_LEN];
-};
+struct hash_table* tables[MAX_TABLES];///An array of struct of hashtable pointers
+
+/**
+ * @brief The compiled predicates of the last queries of each table, at the index of the table.
+ */
+struct plan_cache* plan_caches[MAX_TABLES];
 
+/**
+ * @brief The replies to the last queries of each table, at the index of the table.
+ */
+struct result_cache* result_caches[MAX_TABLES];
+
+#define MAX_CURSORS 64 ///< Query cursors open at once, across all connections.
 
 /**
- *@brief Declaring a hashtable for storage tables
+ * @brief A query cursor opened by a client.
  */
-struct hash_table {
-    struct table_schema* schema; //The table schema processed from the config file
-    struct record* records[MAX_RECORDS_PER_TABLE];
-    int hashed_keys[MAX_RECORDS_PER_TABLE];
-    int num_keys;
+struct open_cursor {
+    int id; ///< Number the client names the cursor by, 0 for a free slot.
+    int sock; ///< The connection that opened the cursor, the only one that may use it.
+    int table_index; ///< Index of the queried table in tables.
+    struct query_cursor query;
 };
 
 /**
- * @brief Array of hash_table structures representing the database.
+ * @brief The query cursors of all connections, closed when their connection is.
  */
-struct hash_table* tables[MAX_TABLES];///An array of struct of hashtable pointers
+struct open_cursor open_cursors[MAX_CURSORS];
 
 /**
- * @brief Predicate structure that stores the column, operator, argument.
+ * @brief The id of the last cursor opened.
  */
-struct predicate {
-    char* column_name;
-    char operator;
-    char argument[MAX_VALUE_LEN];
-    int column_id;
-};
+int last_cursor_id = 0;
 
 /**
  * @brief File pointer to processing times log.
@@ -120,122 +127,26 @@ pthread_mutex_t conditionMutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t  conditionCond  = PTHREAD_COND_INITIALIZER;
 
 /**
- * @brief Recursive function that converts string to index
+ * @brief Finds the index of a table in tables by probing from the hash of its name
  *
- * @param hash_string The string that needs to be hashed into an index
- * @param max_index The maximum number of tables/records.
- * @param collisions Initialized to zero and tries to find if there are any collisions in the array
- * @return Returns integer on success
+ * @param table_name The name of the table
+ * @return Returns the index holding the table, or else the empty index where it
+ * would be stored. Returns -1 if neither exists.
  */
-int hash(char* hash_string, int max_index, int table_index, int collisions)
+int hash(const char* table_name)
 {
-    int i;
-    int hashed_index = 0;
-    
-    for(i = 0; i < strlen(hash_string); i++)
-        hashed_index += hash_string[i] * (strlen(hash_string) - i - 1);
-    
-    hashed_index = (hashed_index + collisions) % max_index;
-    
-    // Checking for collisions
-    // Check if hashing table names
-    if(max_index == MAX_TABLES)
-    {
-        // Check if generated index is empty and not the table we are hashing
-        if(tables[hashed_index] != NULL && strcmp(tables[hashed_index]->schema->table_name, hash_string) != 0)
-            return hash(hash_string, max_index, table_index, collisions + 1);
-    }
+    int collisions;
+    int hashed_index = hash_string(table_name) % MAX_TABLES;
     
-    // Check if hashing keys
-    else if(max_index == MAX_RECORDS_PER_TABLE && tables[table_index] != NULL)
+    // Probing until the table or an empty index is found
+    for(collisions = 0; collisions < MAX_TABLES; collisions++)
     {
-        // Check if generated index is empty and not the key we are looking for
-        if(tables[table_index]->records[hashed_index] != NULL && strcmp(tables[table_index]->records[hashed_index]->key, hash_string) != 0)
-            return hash(hash_string, max_index, table_index, collisions + 1);
+        if(tables[hashed_index] == NULL || strcmp(tables[hashed_index]->schema->table_name, table_name) == 0)
+            return hashed_index;
+        hashed_index = (hashed_index + 1) % MAX_TABLES;
     }
     
-    
-    return hashed_index;
-}
-
-
-/**
- * @brief Compares all values against predicates and find matching keys
- *
- * @param predicate_arr Array containing all predicates
- * @param num_predicates Number of predicates to match values with
- * @param matched_keys All keys that match every predicate.
- * @return Returns 0 on success, -1 otherwise.
- */
-int run_predicates(const struct predicate predicate_arr[], const int num_predicates, const int max_keys, const int table_index, char* matched_keys)
-{
-    // Temp array of all values indexed by column id
-    char values[tables[table_index]->schema->num_columns][MAX_VALUE_LEN];
-    memset(values, 0, sizeof values);
-    
-    char buf[MAX_VALUE_LEN] = {0};
-    char column_name[MAX_COLNAME_LEN] = {0};
-    int num_matched_keys = 0;
-    
-    int k; // Counter going through all the exisiting keys
-    for(k = 0; k < tables[table_index]->num_keys; k++)
-    {
-        // Make copy of the value at key k
-        strcpy(buf, tables[table_index]->records[tables[table_index]->hashed_keys[k]]->value);
-        
-        int column_id = 0; // Counter going though all columns in predicate array and values array
-        char* cur_column = strtok(buf, ",");
-        // Loop though all the values and store them in values array
-        while(cur_column != NULL && column_id < tables[table_index]->schema->num_columns)
-        {
-            sscanf(cur_column, "%s %[^,]", column_name, values[column_id]);
-            cur_column = strtok(NULL, ",");
-            column_id++;
-        } // Finished populating values array
-        
-        int p_index; // Counter going through all the predicates
-        bool matched = true; // Flag to find if value matches predicate
-        
-        // Break loop if any value fails to satisfy predicate for that column
-        for(p_index = 0; p_index < num_predicates && matched == true; p_index++)
-        {
-            if(tables[table_index]->schema->data_types[predicate_arr[p_index].column_id] == 0) // Integer data type predicate
-            {
-                switch(predicate_arr[p_index].operator) // Three types of comparison for integers
-                {
-                    case '<':
-                        matched = (atoi(values[predicate_arr[p_index].column_id]) < atoi(predicate_arr[p_index].argument));
-                        break;
-                        
-                    case '>':
-                        matched = (atoi(values[predicate_arr[p_index].column_id]) > atoi(predicate_arr[p_index].argument));
-                        break;
-                        
-                    case '=':
-                        matched = (atoi(values[predicate_arr[p_index].column_id]) == atoi(predicate_arr[p_index].argument));
-                        break;
-                }
-            }
-            else // String data type predicate
-                matched = (strcmp(values[predicate_arr[p_index].column_id], predicate_arr[p_index].argument) == 0);
-        } // Loop of predicates comparison. Finished matching current value against predicates
-        
-        if(matched == true) // No mismatching predicates
-        {
-            if(num_matched_keys < max_keys)
-            {
-                if(matched_keys[0] == 0) // Adding first matched key
-                    sprintf(matched_keys, "%s", tables[table_index]->records[tables[table_index]->hashed_keys[k]]->key);
-                else
-                    sprintf(matched_keys, "%s, %s", matched_keys, tables[table_index]->records[tables[table_index]->hashed_keys[k]]->key);
-            }
-            
-            num_matched_keys++;
-        } // Finished populating matched keys with current key if matched
-        
-    } // Loop of records in table
-    
-    return num_matched_keys;
+    return -1;
 }
 
 
@@ -277,16 +188,19 @@ int server_get(char *cmd)
     char temp_table_name[MAX_TABLE_LEN] = {0}, temp_key[MAX_KEY_LEN] = {0};
     sscanf(cmd, "GET #%s #%s\n", temp_table_name, temp_key);
     
-    int table_index = hash(temp_table_name, MAX_TABLES, NO_TABLE_INDEX, NO_COLLISION);
-    int key_index = hash(temp_key, MAX_RECORDS_PER_TABLE, table_index, NO_COLLISION);
+    int table_index = hash(temp_table_name);
+    struct record* record = NULL;
+    char value[MAX_VALUE_LEN], row[MAX_VALUE_LEN];
     
-    if (tables[table_index] == NULL)
+    if (table_index < 0 || tables[table_index] == NULL)
         sprintf(cmd, "GET");
-    else if(tables[table_index]->records[key_index] == NULL)//checking if key exists
+    else if((record = table_find(tables[table_index], temp_key)) == NULL)//checking if key exists
         sprintf(cmd, "GET #%s", tables[table_index]->schema->table_name);
     else
     {
-        sprintf(cmd, "GET #%s #%s #%ld #%s", tables[table_index]->schema->table_name, tables[table_index]->records[key_index]->key, *(tables[table_index]->records[key_index]->metadata), tables[table_index]->records[key_index]->value);
+        // Rows are only turned back into text at the protocol boundary
+        row_format(tables[table_index]->schema, &tables[table_index]->layout, table_get_row(tables[table_index], record, row), value);
+        sprintf(cmd, "GET #%s #%s #%ld #%s", tables[table_index]->schema->table_name, record->key, record->metadata, value);
         return 0;
     }
     
@@ -309,104 +223,69 @@ int server_set(char *cmd)
     char temp_table_name[MAX_TABLE_LEN] = {0};
     char temp_key[MAX_KEY_LEN] = {0};
     char temp_value[MAX_VALUE_LEN] = {0};
-    char* cur_column;
-    char column_name[MAX_COLNAME_LEN] = {0};
-    char str_data[MAX_VALUE_LEN] = {0};
-    int int_data;
+    char row[MAX_VALUE_LEN];
     uintptr_t temp_metadata[MAX_METADATA_LEN];
     
     sscanf(cmd, "SET #%s #%s #%ld #%[^\n]\n", temp_table_name, temp_key, temp_metadata, temp_value); // Modified to add metadata
     
-    int table_index = hash(temp_table_name, MAX_TABLES, NO_TABLE_INDEX, NO_COLLISION);
-    int key_index = hash(temp_key, MAX_RECORDS_PER_TABLE, table_index, NO_COLLISION);
+    int table_index = hash(temp_table_name);
+    struct hash_table* table;
+    struct record* record = NULL;
     
-    if (tables[table_index] == NULL) // Table does not exist
+    if (table_index < 0 || (table = tables[table_index]) == NULL) // Table does not exist
         sprintf(cmd, "SET");
     else if(strcmp(temp_value, "NULL") == 0) // Deleting a record?
     {
-        if(tables[table_index]->records[key_index] == NULL) // Key/Record do not exist
-            sprintf(cmd, "SET #%s", tables[table_index]->schema->table_name);
+        if(table_remove(table, temp_key) != 0) // Key/Record do not exist
+            sprintf(cmd, "SET #%s", table->schema->table_name);
         else
         {
-            free(tables[table_index]->records[key_index]); // Delete record
-            tables[table_index]->records[key_index] = NULL;
-            
-            int k;
-            for(k = 0; k < tables[table_index]->num_keys; k++)
-                if(tables[table_index]->hashed_keys[k] == key_index)
-                {
-                    tables[table_index]->hashed_keys[k] = tables[table_index]->hashed_keys[tables[table_index]->num_keys];
-                    tables[table_index]->hashed_keys[tables[table_index]->num_keys] = -1;
-                    tables[table_index]->num_keys--;
-                    break;
-                }
-            
             sprintf(cmd, "SET #%s #%s #%ld #%s", temp_table_name, temp_key, *temp_metadata, temp_value);
             return 0;
         }
     }
-    else // Table exists and we are not deleting a record
+    // Table exists and we are not deleting a record, so the value is decoded once here
+    else if(row_parse(table->schema, &table->layout, temp_value, row) != 0) // Value does not match the schema
+        sprintf(cmd, "SET #%s #%s #%ld #invalid", temp_table_name, temp_key, *temp_metadata);
+    else
     {
-        int column_id = 0; // Counting through number of arguments (comma separated) in value
-        char buf[MAX_VALUE_LEN] = {0};
-        strcpy(buf, temp_value);
-        cur_column = strtok(buf, ","); // Get tokens from a string delimited with commas
-        bool invalid = false;
-        while (invalid == false && cur_column != NULL && column_id < tables[table_index]->schema->num_columns)
+        record = table_find(table, temp_key);
+        bool inserted = false;
+        
+        // Key/Record do not exist and no GET performed before SET (to create record)
+        if(record == NULL && *temp_metadata == 0)
         {
-            // Format from design specifications (spaces before and after commas are allowed)
-            if(tables[table_index]->schema->data_types[column_id] == 0) //Expecting an integer
+            record = table_insert(table, temp_key);
+            if(record != NULL)
             {
-                if(sscanf(cur_column, " %[a-zA-Z0-9] %d", column_name, &int_data) != 2)
-                    invalid = true;
+                record->metadata = table_index; // Initialising metadata
+                inserted = true;
             }
-            else
-                sscanf(cur_column, " %[a-zA-Z0-9] %[a-zA-Z0-9 ]", column_name, str_data);
-            
-            // Column name in value does not match column name in table at current position
-            if(invalid == false && strcmp(tables[table_index]->schema->column_names[column_id], column_name) != 0)
-                invalid = true;
-            else if(tables[table_index]->schema->data_types[column_id] != 0) // Expecting a string
-                if((strlen(str_data) + 1) > tables[table_index]->schema->data_types[column_id]) // String size does not match
-                    invalid = true;
-            
-            column_id++;
-            cur_column = strtok(NULL, ",");
         }
         
-        if(invalid == true || column_id != tables[table_index]->schema->num_columns || cur_column != NULL) // Less/more column names specified in value
-            sprintf(cmd, "SET #%s #%s #%ld #invalid", temp_table_name, temp_key, *temp_metadata);
-        else
+        if(record != NULL)
         {
-            // Key/Record do not exist and no GET performed before SET (to create record)
-            if(tables[table_index]->records[key_index] == NULL && *temp_metadata == 0)
-            {
-                tables[table_index]->records[key_index] = (struct record*) malloc(sizeof(struct record));
-                strcpy(tables[table_index]->records[key_index]->key, temp_key);
-                tables[table_index]->hashed_keys[tables[table_index]->num_keys] = key_index; // Add new key_index to hashed_array
-                tables[table_index]->num_keys++; // Increment number of keys
-                *(tables[table_index]->records[key_index]->metadata) = table_index; // Initialising metadata
-            }
-            
-            if(tables[table_index]->records[key_index] != NULL)
+            // Forced update or metadata matches
+            if((*temp_metadata == 0 || record->metadata == *temp_metadata) && table_set_value(table, record, row, table->layout.size) == 0)
             {
-                // Forced update or metadata matches
-                if(*temp_metadata == 0 || *(tables[table_index]->records[key_index]->metadata) == *temp_metadata)
-                {
-                    strcpy(tables[table_index]->records[key_index]->value, temp_value);
-                    srand(time(NULL));
-                    *(tables[table_index]->records[key_index]->metadata) += rand() % MAX_PATH_LEN; // Increment metadata after setting
-                    sprintf(cmd, "SET #%s #%s #%ld #%s", tables[table_index]->schema->table_name, tables[table_index]->records[key_index]->key, *(tables[table_index]->records[key_index]->metadata), tables[table_index]->records[key_index]->value);
-                }
-                else
-                    sprintf(cmd, "SET #%s #%s #0 #abort", temp_table_name, temp_key);
-                
+                srand(time(NULL));
+                record->metadata += rand() % MAX_PATH_LEN; // Increment metadata after setting
+                row_format(table->schema, &table->layout, row, temp_value);
+                sprintf(cmd, "SET #%s #%s #%ld #%s", table->schema->table_name, record->key, record->metadata, temp_value);
             }
             else
+            {
+                // Do not leave behind a new record whose value could not be stored
+                if(inserted == true)
+                    table_remove(table, temp_key);
                 sprintf(cmd, "SET #%s #%s #0 #abort", temp_table_name, temp_key);
+            }
             
-            return 0;
         }
+        else
+            sprintf(cmd, "SET #%s #%s #0 #abort", temp_table_name, temp_key);
+        
+        return 0;
     }
     return 1;
 }
@@ -415,109 +294,66 @@ int server_set(char *cmd)
 /**
  * @brief Query the table for records, and retrieve the matching keys.
  *
+ * Replies are cached per table under the normalized predicates and
+ * max_keys, so a query repeated while its table is unchanged is answered
+ * without running it again.
+ *
  * @param cmd The command given to the client
  *
  */
 int server_query(char *cmd)
 {
     int max_keys;
-    int int_data;
-    char operator;
-    char column_name[MAX_COLNAME_LEN] = {0};
     char temp_table_name[MAX_TABLE_LEN] = {0};
-    char str_data[MAX_VALUE_LEN] = {0};
     char predicates[MAX_PREDICATE_LEN] = {0};
-    char trash[MAX_CONFIG_LINE_LEN] = {0};
     
     // Read from protocol
     sscanf(cmd, "QUERY #%s #%d #%[^\n]", temp_table_name, &max_keys, predicates);
     
-    int table_index = hash(temp_table_name, MAX_TABLES, NO_TABLE_INDEX, NO_COLLISION);
+    int table_index = hash(temp_table_name);
     
-    if (tables[table_index] == NULL) // Table does not exist
+    if (table_index < 0 || tables[table_index] == NULL) // Table does not exist
         sprintf(cmd, "QUERY");
     else // Given valid table name and predicates
     {
-        bool invalid = false; // Flag to break from parsing predicates
-        struct predicate predicate_arr[tables[table_index]->schema->num_columns]; // Array of all valid predicates
-        int num_predicates = 0; // Total number of valid predicates
-        int column_id;
-        // Parse each predicate and if valid, store into the predicates array
-        char* cur_pred = strtok(predicates, ",");
-        while(cur_pred != NULL && invalid == false) // Get tokens from predicates
+        struct hash_table* table = tables[table_index];
+        const struct cached_result* cached;
+
+        // A reply lists at most as many keys as fit in a command, a cursor listing the others
+        if(max_keys > MAX_SCAN_KEYS)
+            max_keys = MAX_SCAN_KEYS;
+
+        query_normalize(predicates);
+        if((cached = result_cache_find(result_caches[table_index], predicates, max_keys, table->version)) != NULL)
         {
-            // Expecting an integer predicate
-            if(sscanf(cur_pred, " %[a-zA-Z0-9] %1[<=>] %d%s", column_name, &operator, &int_data, trash) == 3)
-            {
-                // Loop through all column names
-                // Find the column_id in the table with same column name as scanned from predicate
-                for(column_id = 0; column_id < tables[table_index]->schema->num_columns; column_id++)
-                    // Found column id of the column name scanned
-                    if(strcmp(tables[table_index]->schema->column_names[column_id], column_name) == 0)
-                        break;
-                
-                // Check if reached end of the loop, meaning couldn't find column_name in the table
-                if(column_id == tables[table_index]->schema->num_columns)
-                    invalid = true;
-                
-                // Check if data_type of column matches our original expected data_type
-                else if(tables[table_index]->schema->data_types[column_id] != 0)
-                    invalid = true;
-            }
-            
-            else // Expecting a string predicate
-            {
-                sscanf(cur_pred, " %[a-zA-Z0-9] %1[=] %[a-zA-Z0-9 ]", column_name, &operator, str_data);
-                
-                // Loop through all column names
-                // Find the column_id in the table with same name as scanned column_name
-                for(column_id = 0; column_id < tables[table_index]->schema->num_columns; column_id++)
-                    // Found column id of the column name scanned
-                    if(strcmp(tables[table_index]->schema->column_names[column_id], column_name) == 0)
-                        break;
-                
-                // Check if reached end of the for loop, meaning couldn't find column_name in the table
-                if(column_id == tables[table_index]->schema->num_columns)
-                    invalid = true;
-                
-                // Check if string length of parsed data is more than that allowed
-                else if((strlen(str_data) + 1) > tables[table_index]->schema->data_types[column_id])
-                    invalid = true;
-            }
-            
-            int i;
-            for(i = 0; i < num_predicates; i++)
-                if(column_id == predicate_arr[i].column_id) // Checking for duplicate predicates
-                    invalid = true;
-            
-            if(num_predicates == tables[table_index]->schema->num_columns) // Checking for extra predicates
-                invalid = true;
-            
-            if(invalid == false) // Found a valid predicate, so put into predicate struct array
-            {
-                predicate_arr[num_predicates].column_id = column_id;
-                predicate_arr[num_predicates].column_name = tables[table_index]->schema->column_names[column_id];
-                predicate_arr[num_predicates].operator = operator;
-                
-                if(tables[table_index]->schema->data_types[column_id] == 0) // Integer data type
-                    sprintf(predicate_arr[num_predicates].argument, "%d", int_data);
-                else // String data type
-                    strcpy(predicate_arr[num_predicates].argument, str_data);
-                
-                num_predicates++; // Increment number of valid predicates read
-            }
-            cur_pred = strtok(NULL, ",");
+            sprintf(cmd, "QUERY #%s #%d #%s", table->schema->table_name, cached->num_matches, cached->matched_keys);
+            return 0;
         }
-        // End of parsing valid predicates from protocol into array of predicate structs
+
+        struct predicate predicate_arr[table->schema->num_columns]; // Array of all valid predicates
+        char text[MAX_CMD_LEN];
+        strcpy(text, predicates); // The parsing modifies the predicates
+        int num_predicates = query_prepare(plan_caches[table_index], table, predicates, predicate_arr);
         
-        if(invalid == true) // -1 signifies invalid predicates in client library
+        if(num_predicates < 0) // -1 signifies invalid predicates in client library
             sprintf(cmd, "QUERY #%s #-1", temp_table_name);
         else // Valid predicates and actually finding records that satify them
         {
-            char matched_keys[max_keys * MAX_KEY_LEN];
-            memset(matched_keys, 0, sizeof matched_keys);
-            int num_matched_keys = run_predicates(predicate_arr, num_predicates, max_keys, table_index, matched_keys);
-            sprintf(cmd, "QUERY #%s #%d #%s", tables[table_index]->schema->table_name, num_matched_keys, matched_keys);
+            // Room for the ", " separators, and never a zero length array
+            char matched_keys[(max_keys > 0 ? max_keys : 1) * (MAX_KEY_LEN + 2)];
+            matched_keys[0] = 0;
+            int num_matched_keys = query_run(table, predicate_arr, num_predicates, max_keys, matched_keys);
+
+            if(num_matched_keys < 0) // Out of memory for the bitmaps of the query
+            {
+                sprintf(cmd, "QUERY #%s #-1", table->schema->table_name);
+                return 1;
+            }
+
+            // Without memory for the result, the next query is run again
+            result_cache_add(result_caches[table_index], text, max_keys, table->version, num_matched_keys, matched_keys);
+
+            sprintf(cmd, "QUERY #%s #%d #%s", table->schema->table_name, num_matched_keys, matched_keys);
             return 0;
         }
     }
@@ -525,6 +361,536 @@ int server_query(char *cmd)
     return 1;
 }
 
+/**
+ * @brief Aggregates an int column over the records of a table matching predicates.
+ *
+ * The command is "AGGREGATE #table #function #column #predicates", with
+ * function one of COUNT, SUM, MIN, MAX or AVG and possibly no predicates,
+ * and the reply "AGGREGATE #table #count #value" with the number of
+ * matching records and the aggregate, 0 if none matches. A count of -1
+ * means the function, column or predicates are invalid.
+ *
+ * @param cmd The command given to the client
+ * @return Returns 0 on success, 1 otherwise.
+ */
+int server_aggregate(char *cmd)
+{
+    char temp_table_name[MAX_TABLE_LEN] = {0};
+    char function_name[MAX_COLNAME_LEN] = {0};
+    char column_name[MAX_COLNAME_LEN] = {0};
+    char predicates[MAX_CMD_LEN] = {0};
+    struct aggregate aggregate;
+    int table_index, function, column_id, num_predicates;
+
+    sscanf(cmd, "AGGREGATE #%19s #%19s #%19s #%[^\n]", temp_table_name, function_name, column_name, predicates);
+
+    if((table_index = hash(temp_table_name)) < 0 || tables[table_index] == NULL)
+    {
+        sprintf(cmd, "AGGREGATE");
+        return 1;
+    }
+
+    struct hash_table* table = tables[table_index];
+    struct predicate predicate_arr[table->schema->num_columns];
+
+    if(query_parse_aggregate(table->schema, function_name, column_name, &function, &column_id) != 0
+            || (num_predicates = query_prepare(plan_caches[table_index], table, predicates, predicate_arr)) < 0)
+    {
+        sprintf(cmd, "AGGREGATE #%s #-1", table->schema->table_name);
+        return 1;
+    }
+
+    query_aggregate(table, function, column_id, predicate_arr, num_predicates, &aggregate);
+
+    if(function == AGGREGATE_AVG)
+        sprintf(cmd, "AGGREGATE #%s #%lld #%.17g", table->schema->table_name, aggregate.count,
+                aggregate.count == 0 ? 0.0 : (double) aggregate.sum / aggregate.count);
+    else
+        sprintf(cmd, "AGGREGATE #%s #%lld #%lld", table->schema->table_name, aggregate.count,
+                aggregate.count == 0 ? 0 : function == AGGREGATE_COUNT ? aggregate.count : function == AGGREGATE_SUM ? aggregate.sum
+                : function == AGGREGATE_MIN ? (long long) aggregate.min : (long long) aggregate.max);
+
+    return 0;
+}
+
+/**
+ * @brief Lists the first records of a table matching predicates, in the order of a column.
+ *
+ * The command is "QUERY_ORDER #table #max_keys #column #direction
+ * #predicates", with direction ASC or DESC and possibly no predicates,
+ * and the reply "QUERY_ORDER #table #count #keys" with the keys in order,
+ * at most MAX_SCAN_KEYS of them. A count of -1 means the column,
+ * direction or predicates are invalid, or the server is out of memory.
+ *
+ * @param cmd The command given to the client
+ * @return Returns 0 on success, 1 otherwise.
+ */
+int server_query_order(char *cmd)
+{
+    char temp_table_name[MAX_TABLE_LEN] = {0};
+    char column_name[MAX_COLNAME_LEN] = {0};
+    char direction[MAX_COLNAME_LEN] = {0};
+    char predicates[MAX_CMD_LEN] = {0};
+    int table_index, max_keys = 0, column_id, num_predicates, num_matched_keys;
+    bool descending;
+
+    sscanf(cmd, "QUERY_ORDER #%19s #%d #%19s #%19s #%[^\n]", temp_table_name, &max_keys, column_name, direction, predicates);
+
+    if((table_index = hash(temp_table_name)) < 0 || tables[table_index] == NULL)
+    {
+        sprintf(cmd, "QUERY_ORDER");
+        return 1;
+    }
+
+    struct hash_table* table = tables[table_index];
+    struct predicate predicate_arr[table->schema->num_columns];
+
+    if(max_keys > MAX_SCAN_KEYS)
+        max_keys = MAX_SCAN_KEYS;
+
+    // Room for the ", " separators, and never a zero length array
+    char matched_keys[(max_keys > 0 ? max_keys : 1) * (MAX_KEY_LEN + 2)];
+
+    if(max_keys < 0 || query_parse_order(table->schema, column_name, direction, &column_id, &descending) != 0
+            || (num_predicates = query_prepare(plan_caches[table_index], table, predicates, predicate_arr)) < 0
+            || (num_matched_keys = query_top(table, predicate_arr, num_predicates, column_id, descending, max_keys, matched_keys)) < 0)
+    {
+        sprintf(cmd, "QUERY_ORDER #%s #-1", table->schema->table_name);
+        return 1;
+    }
+
+    sprintf(cmd, "QUERY_ORDER #%s #%d #%s", table->schema->table_name, num_matched_keys, matched_keys);
+
+    return 0;
+}
+
+/**
+ * @brief Finds an open cursor of a connection.
+ *
+ * @return Returns the cursor, or NULL if the connection has no cursor with this id.
+ */
+static struct open_cursor* find_cursor(int sock, int id)
+{
+    int i;
+
+    for(i = 0; i < MAX_CURSORS; i++)
+        if(id != 0 && open_cursors[i].id == id && open_cursors[i].sock == sock)
+            return &open_cursors[i];
+
+    return NULL;
+}
+
+
+/**
+ * @brief Closes a cursor, freeing its slot.
+ */
+static void close_cursor(struct open_cursor* cursor)
+{
+    query_cursor_close(tables[cursor->table_index], &cursor->query);
+    cursor->id = 0;
+}
+
+
+/**
+ * @brief Closes all the cursors of a connection, once it is closed.
+ */
+void close_cursors(int sock)
+{
+    int i;
+
+    for(i = 0; i < MAX_CURSORS; i++)
+        if(open_cursors[i].id != 0 && open_cursors[i].sock == sock)
+            close_cursor(&open_cursors[i]);
+}
+
+
+/**
+ * @brief Opens a cursor over the records of a table matching predicates.
+ *
+ * The command is "QUERY_OPEN #table #predicates", and the reply
+ * "QUERY_OPEN #table #id" with the id naming the cursor in the commands
+ * that follow, -1 if the predicates are invalid or -2 if MAX_CURSORS
+ * cursors are already open.
+ *
+ * @param sock The connection the cursor belongs to.
+ * @param cmd The command given to the client
+ * @return Returns 0 on success, 1 otherwise.
+ */
+int server_query_open(int sock, char *cmd)
+{
+    char temp_table_name[MAX_TABLE_LEN] = {0};
+    char predicates[MAX_CMD_LEN] = {0};
+    int table_index, num_predicates, i;
+
+    sscanf(cmd, "QUERY_OPEN #%19s #%[^\n]", temp_table_name, predicates);
+
+    if((table_index = hash(temp_table_name)) < 0 || tables[table_index] == NULL)
+    {
+        sprintf(cmd, "QUERY_OPEN");
+        return 1;
+    }
+
+    struct predicate predicate_arr[tables[table_index]->schema->num_columns];
+    if((num_predicates = query_prepare(plan_caches[table_index], tables[table_index], predicates, predicate_arr)) < 0)
+    {
+        sprintf(cmd, "QUERY_OPEN #%s #-1", tables[table_index]->schema->table_name);
+        return 1;
+    }
+
+    for(i = 0; i < MAX_CURSORS && open_cursors[i].id != 0; i++)
+        ;
+
+    if(i == MAX_CURSORS)
+    {
+        sprintf(cmd, "QUERY_OPEN #%s #-2", tables[table_index]->schema->table_name);
+        return 1;
+    }
+
+    // Ids are not reused soon, so a stale id does not name a newer cursor
+    last_cursor_id = last_cursor_id % INT_MAX + 1;
+    open_cursors[i].id = last_cursor_id;
+    open_cursors[i].sock = sock;
+    open_cursors[i].table_index = table_index;
+    query_cursor_open(tables[table_index], &open_cursors[i].query, predicate_arr, num_predicates);
+
+    sprintf(cmd, "QUERY_OPEN #%s #%d", tables[table_index]->schema->table_name, last_cursor_id);
+
+    return 0;
+}
+
+
+/**
+ * @brief Lists the next keys of a cursor.
+ *
+ * The command is "QUERY_NEXT #id #max_keys", and the reply lists the keys
+ * as "QUERY_NEXT #id #count #key1, key2", with fewer than max_keys keys
+ * only once the cursor reached the end of the table. A count of -1 means
+ * the connection has no such cursor.
+ *
+ * @param sock The connection the cursor belongs to.
+ * @param cmd The command given to the client
+ * @return Returns 0 on success, 1 otherwise.
+ */
+int server_query_next(int sock, char *cmd)
+{
+    struct open_cursor* cursor;
+    int id = 0, max_keys = -1;
+
+    if(sscanf(cmd, "QUERY_NEXT #%d #%d", &id, &max_keys) != 2 || max_keys < 0 || (cursor = find_cursor(sock, id)) == NULL)
+    {
+        sprintf(cmd, "QUERY_NEXT #%d #-1", id);
+        return 1;
+    }
+
+    // The client asks again for more keys than fit in a reply
+    if(max_keys > MAX_SCAN_KEYS)
+        max_keys = MAX_SCAN_KEYS;
+
+    char matched_keys[MAX_SCAN_KEYS * (MAX_KEY_LEN + 2)];
+    int num_matched_keys = query_cursor_next(tables[cursor->table_index], &cursor->query, max_keys, matched_keys);
+
+    sprintf(cmd, "QUERY_NEXT #%d #%d #%s", id, num_matched_keys, matched_keys);
+
+    return 0;
+}
+
+
+/**
+ * @brief The records of a QUERY_FETCH reply.
+ */
+struct fetch_reply {
+    struct hash_table* table;
+    const int* column_ids; ///< The projected columns, NULL for full values.
+    int num_columns;
+    char* records; ///< The records written so far.
+    size_t len; ///< Length of records.
+    size_t max_len; ///< Room for records, without their terminating null.
+};
+
+
+/**
+ * @brief Appends a record to a fetch_reply, unless it would not fit.
+ *
+ * @return Returns 0 on success, -1 if the reply is full.
+ */
+static int fetch_record(void* arg, const struct record* record)
+{
+    struct fetch_reply* reply = (struct fetch_reply*) arg;
+    char value[MAX_VALUE_LEN], row[MAX_VALUE_LEN], text[MAX_KEY_LEN + MAX_VALUE_LEN + 32];
+    const char* fields = table_get_row(reply->table, record, row);
+    int len;
+
+    if(reply->column_ids == NULL)
+        row_format(reply->table->schema, &reply->table->layout, fields, value);
+    else
+        row_project(reply->table->schema, &reply->table->layout, fields, reply->column_ids, reply->num_columns, value);
+
+    len = sprintf(text, " #%s #%ld #%s", record->key, record->metadata, value);
+    if(reply->len + len > reply->max_len)
+        return -1;
+
+    memcpy(reply->records + reply->len, text, len + 1);
+    reply->len += len;
+
+    return 0;
+}
+
+
+/**
+ * @brief Lists the next records of a cursor with their values.
+ *
+ * The command is "QUERY_FETCH #id #max_records #columns", with the columns
+ * separated by commas, or left empty for full values. The reply is
+ * "QUERY_FETCH #id #count #done" followed by " #key #metadata #value" for
+ * each record, as many as fit in a reply. Done is 1 once the cursor
+ * reached the end of the table. A count of -1 means the connection has no
+ * such cursor or a column is unknown.
+ *
+ * The values are read from the rows the predicates matched, not looked up
+ * again by key.
+ *
+ * @param sock The connection the cursor belongs to.
+ * @param cmd The command given to the client
+ * @return Returns 0 on success, 1 otherwise.
+ */
+int server_query_fetch(int sock, char *cmd)
+{
+    struct open_cursor* cursor;
+    char columns[MAX_CMD_LEN] = {0};
+    char records[MAX_CMD_LEN];
+    int column_ids[MAX_COLUMNS_PER_TABLE];
+    struct fetch_reply reply = {NULL, NULL, 0, records, 0, MAX_CMD_LEN - 64};
+    int id = 0, max_records = -1, num_records;
+
+    if(sscanf(cmd, "QUERY_FETCH #%d #%d #%[^\n]", &id, &max_records, columns) < 2 || max_records < 0
+            || (cursor = find_cursor(sock, id)) == NULL)
+    {
+        sprintf(cmd, "QUERY_FETCH #%d #-1", id);
+        return 1;
+    }
+
+    reply.table = tables[cursor->table_index];
+    if(columns[0] != 0)
+    {
+        if((reply.num_columns = row_parse_columns(reply.table->schema, columns, column_ids)) < 0)
+        {
+            sprintf(cmd, "QUERY_FETCH #%d #-1", id);
+            return 1;
+        }
+        reply.column_ids = column_ids;
+    }
+
+    records[0] = 0;
+    num_records = query_cursor_visit(reply.table, &cursor->query, max_records, fetch_record, &reply);
+
+    sprintf(cmd, "QUERY_FETCH #%d #%d #%d%s", id, num_records, cursor->query.position.entry >= reply.table->num_entries, records);
+
+    return 0;
+}
+
+
+/**
+ * @brief Closes a cursor.
+ *
+ * The command is "QUERY_CLOSE #id", and the reply "QUERY_CLOSE #id", or
+ * "QUERY_CLOSE" alone if the connection has no such cursor.
+ *
+ * @param sock The connection the cursor belongs to.
+ * @param cmd The command given to the client
+ * @return Returns 0 on success, 1 otherwise.
+ */
+int server_query_close(int sock, char *cmd)
+{
+    struct open_cursor* cursor;
+    int id = 0;
+
+    if(sscanf(cmd, "QUERY_CLOSE #%d", &id) != 1 || (cursor = find_cursor(sock, id)) == NULL)
+    {
+        sprintf(cmd, "QUERY_CLOSE");
+        return 1;
+    }
+
+    close_cursor(cursor);
+    sprintf(cmd, "QUERY_CLOSE #%d", id);
+
+    return 0;
+}
+
+
+/**
+ * @brief Lists the keys of a table in a range, in ascending order.
+ *
+ * The command is "SCAN #table #max_keys #after #end #prefix", where each of
+ * the last three bounds is a key or "*" for no bound, and the reply lists
+ * the keys as "SCAN #table #count #key1, key2".
+ *
+ * @param cmd The command given to the client
+ * @return Returns 0 on success, 1 otherwise.
+ */
+int server_scan(char *cmd)
+{
+    char temp_table_name[MAX_TABLE_LEN] = {0};
+    char bounds[3][MAX_KEY_LEN] = {{0}};
+    const char* after, *end, *prefix;
+    int max_keys, table_index;
+
+    if(sscanf(cmd, "SCAN #%19s #%d #%19s #%19s #%19s", temp_table_name, &max_keys, bounds[0], bounds[1], bounds[2]) != 5
+            || (table_index = hash(temp_table_name)) < 0 || tables[table_index] == NULL)
+    {
+        sprintf(cmd, "SCAN");
+        return 1;
+    }
+
+    after = strcmp(bounds[0], "*") == 0 ? NULL : bounds[0];
+    end = strcmp(bounds[1], "*") == 0 ? NULL : bounds[1];
+    prefix = strcmp(bounds[2], "*") == 0 ? NULL : bounds[2];
+
+    // The client asks again for more keys than fit in a reply
+    if(max_keys > MAX_SCAN_KEYS)
+        max_keys = MAX_SCAN_KEYS;
+
+    char matched_keys[MAX_SCAN_KEYS * (MAX_KEY_LEN + 2)];
+    int num_matched_keys = max_keys < 0 ? -1 : query_keys(tables[table_index], after, end, prefix, max_keys, matched_keys);
+
+    if(num_matched_keys < 0)
+    {
+        sprintf(cmd, "SCAN #%s #-1", tables[table_index]->schema->table_name);
+        return 1;
+    }
+
+    sprintf(cmd, "SCAN #%s #%d #%s", tables[table_index]->schema->table_name, num_matched_keys, matched_keys);
+
+    return 0;
+}
+
+
+/**
+ * @brief Explains how a query is run, and runs it.
+ *
+ * The command is "EXPLAIN #table #predicates", and the reply
+ * "EXPLAIN #table #plan", the plan being a value of "name value" pairs
+ * separated by commas: the access path ("scan", or "index" and the
+ * driving column), the estimated and actual matching records, and the
+ * predicates in the order they are tested with the estimated matches of
+ * each, separated by semicolons, e.g. "access index age,estimatedRows 12,
+ * actualRows 10,order age<20;name=bob,estimates 40;300", an IN list
+ * being shown as "name IN(3 values)". The reply is
+ * "EXPLAIN #table" alone if the predicates are invalid, or "EXPLAIN" if
+ * the table does not exist.
+ *
+ * @param cmd The command given to the client
+ * @return Returns 0 on success, 1 otherwise.
+ */
+int server_explain(char *cmd)
+{
+    char temp_table_name[MAX_TABLE_LEN] = {0};
+    char predicates[MAX_CMD_LEN] = {0};
+    char order[MAX_CMD_LEN], estimates[MAX_CMD_LEN], matched_keys[MAX_KEY_LEN + 2];
+    char* order_end = order;
+    char* estimates_end = estimates;
+    struct query_plan plan;
+    struct hash_table* table;
+    int table_index, num_predicates, num_matches, i;
+
+    sscanf(cmd, "EXPLAIN #%19s #%[^\n]", temp_table_name, predicates);
+
+    if((table_index = hash(temp_table_name)) < 0 || (table = tables[table_index]) == NULL)
+    {
+        sprintf(cmd, "EXPLAIN");
+        return 1;
+    }
+
+    struct predicate predicate_arr[table->schema->num_columns];
+    if((num_predicates = query_prepare(plan_caches[table_index], table, predicates, predicate_arr)) < 0)
+    {
+        sprintf(cmd, "EXPLAIN #%s", table->schema->table_name);
+        return 1;
+    }
+
+    // The query is planned again when run, from the same statistics
+    query_plan(table, predicate_arr, num_predicates, &plan);
+    num_matches = query_run(table, predicate_arr, num_predicates, 0, matched_keys);
+
+    *order = *estimates = 0;
+    for(i = 0; i < plan.num_predicates; i++)
+    {
+        const struct predicate* predicate = &plan.predicate_arr[i];
+        const char* separator = i == 0 ? "" : ";";
+
+        // An IN list, which may be as long as the command, is shown by its number of values
+        if(predicate->operator == 'I')
+            order_end += sprintf(order_end, "%s%s IN(%d values)", separator, table->schema->column_names[predicate->column_id],
+                    predicate->list->values.num_values);
+        else if(table->schema->data_types[predicate->column_id] == 0)
+            order_end += sprintf(order_end, "%s%s%c%d", separator, table->schema->column_names[predicate->column_id],
+                    predicate->operator, predicate->int_argument);
+        else
+            order_end += sprintf(order_end, "%s%s%c%s%s", separator, table->schema->column_names[predicate->column_id],
+                    predicate->operator, predicate->operator == '^' ? "=" : "", predicate->argument);
+        estimates_end += sprintf(estimates_end, "%s%.0f", separator, plan.estimates[i]);
+    }
+
+    sprintf(cmd, "EXPLAIN #%s #access %s%s,estimatedRows %.0f,actualRows %d,order %s,estimates %s", table->schema->table_name,
+            plan.driver < 0 ? "scan" : "index ", plan.driver < 0 ? "" : table->schema->column_names[plan.predicate_arr[plan.driver].column_id],
+            plan.estimated_rows, num_matches, order, estimates);
+
+    return 0;
+}
+
+
+/**
+ * @brief Reports statistics of a table.
+ *
+ * The statistics are sent as a value of "name number" pairs separated by
+ * commas, e.g. "keys 12,slots 64,...". The memory statistics come from the
+ * slab allocator holding the records of the table, plus the column arrays
+ * (columnBytes) of a table stored by columns and the ordered key and
+ * column indexes (indexBytes) of a table with any. The plan cache reports
+ * the queries whose compiled predicates it held (planHits) or not
+ * (planMisses), and the percentage of hits (planHitRate). The result cache
+ * reports the queries it answered (resultHits) or not (resultMisses), and
+ * the results it dropped to make room for others (resultEvictions). The
+ * planner reports how many times it sampled the table (statsSamples), and
+ * scans the blocks of rows they compared (blocksRead) or skipped from the
+ * bounds of their zone (blocksSkipped).
+ *
+ * @param cmd The command given to the client
+ * @return Returns 0 on success, 1 otherwise.
+ */
+int server_stats(char *cmd)
+{
+    char temp_table_name[MAX_TABLE_LEN] = {0};
+    sscanf(cmd, "STATS #%s\n", temp_table_name);
+
+    int table_index = hash(temp_table_name);
+    struct hash_table* table;
+    struct slab_stats stats;
+    struct plan_cache* plans;
+    struct result_cache* results;
+
+    if(table_index < 0 || (table = tables[table_index]) == NULL)
+    {
+        sprintf(cmd, "STATS");
+        return 1;
+    }
+
+    slab_get_stats(&table->records, &stats);
+    plans = plan_caches[table_index];
+    results = result_caches[table_index];
+    sprintf(cmd, "STATS #%s #keys %d,slots %d,probes %llu,slabs %zu,objects %zu,slabBytes %zu,liveBytes %zu,fragmentation %d,columnBytes %zu,indexBytes %zu"
+            ",planHits %llu,planMisses %llu,planHitRate %d,resultHits %llu,resultMisses %llu,resultEvictions %llu,statsSamples %llu"
+            ",blocksRead %llu,blocksSkipped %llu",
+            table->schema->table_name, table->num_keys, table->arrays[0].capacity + table->arrays[1].capacity, table->probes,
+            stats.slabs, stats.live_objects, stats.slab_bytes, stats.live_bytes, stats.fragmentation, table_column_bytes(table),
+            table_index_bytes(table), plans->hits, plans->misses,
+            plans->hits + plans->misses == 0 ? 0 : (int) (100 * plans->hits / (plans->hits + plans->misses)),
+            results->hits, results->misses, results->evictions, table->stats != NULL ? table->stats->refreshes : 0ull,
+            table->zones->zones_read, table->zones->zones_skipped);
+
+    return 0;
+}
+
+
 /**
  * @brief Creates table for tables
  *
@@ -533,23 +899,25 @@ int server_query(char *cmd)
  */
 int create_tables()
 {
-    int i, j, table_index;
+    int i, table_index;
     
     for(i = 0; i < MAX_TABLES; i++)
+    {
         tables[i] = NULL;
+        plan_caches[i] = NULL;
+        result_caches[i] = NULL;
+    }
     
     for(i = 0; i < params.num_tables; i++)
     {
-        table_index = hash(params.table_schemas[i].table_name, MAX_TABLES, NO_TABLE_INDEX, NO_COLLISION);//making a hash key -> converting string table name to integer index
-        tables[table_index] = (struct hash_table*) malloc(sizeof (struct hash_table));//making a hash_table pointer
-        tables[table_index]->schema = &(params.table_schemas[i]); //Store the config file settings into this table
-        tables[table_index]->num_keys = 0;
-        
-        for(j = 0; j < MAX_RECORDS_PER_TABLE; j++)
-        {
-            tables[table_index]->records[j] = NULL;
-            tables[table_index]->hashed_keys[j] = -1;
-        }
+        table_index = hash(params.table_schemas[i].table_name);//making a hash key -> converting string table name to integer index
+        if(table_index < 0)
+            return -1;
+        tables[table_index] = table_create(&(params.table_schemas[i])); //Store the config file settings into this table
+        plan_caches[table_index] = plan_cache_create();
+        result_caches[table_index] = result_cache_create();
+        if(tables[table_index] == NULL || plan_caches[table_index] == NULL || result_caches[table_index] == NULL)
+            return -1;
     }
     
     return 0;
@@ -562,20 +930,26 @@ int create_tables()
  */
 int delete_tables()
 {
-    int i, j;
+    int i;
     
     for(i = 0; i < MAX_TABLES; i++)
+    {
         if(tables[i] != NULL)
         {
-            for(j = 0; j < MAX_RECORDS_PER_TABLE; j++)
-                if(tables[i]->records[j] != NULL)
-                {
-                    free(tables[i]->records[j]);
-                    tables[i]->records[j] = NULL;
-                }
-            free(tables[i]);
+            table_destroy(tables[i]);
             tables[i] = NULL;
         }
+        if(plan_caches[i] != NULL)
+        {
+            plan_cache_destroy(plan_caches[i]);
+            plan_caches[i] = NULL;
+        }
+        if(result_caches[i] != NULL)
+        {
+            result_cache_destroy(result_caches[i]);
+            result_caches[i] = NULL;
+        }
+    }
     
     return 0;
 }
@@ -657,6 +1031,24 @@ int handle_command(int sock, char *cmd)
     }
     else if(strcmp(buf, "QUERY") == 0)
         server_query(cmd);
+    else if(strcmp(buf, "STATS") == 0)
+        server_stats(cmd);
+    else if(strcmp(buf, "AGGREGATE") == 0)
+        server_aggregate(cmd);
+    else if(strcmp(buf, "QUERY_ORDER") == 0)
+        server_query_order(cmd);
+    else if(strcmp(buf, "EXPLAIN") == 0)
+        server_explain(cmd);
+    else if(strcmp(buf, "SCAN") == 0)
+        server_scan(cmd);
+    else if(strcmp(buf, "QUERY_OPEN") == 0)
+        server_query_open(sock, cmd);
+    else if(strcmp(buf, "QUERY_NEXT") == 0)
+        server_query_next(sock, cmd);
+    else if(strcmp(buf, "QUERY_FETCH") == 0)
+        server_query_fetch(sock, cmd);
+    else if(strcmp(buf, "QUERY_CLOSE") == 0)
+        server_query_close(sock, cmd);
     else
         return 1;
     
@@ -735,6 +1127,11 @@ void* threadCallFunction(void *arg)
     }
     while (wait_for_commands);
 
+  // The socket number may be reused by the next connection
+  pthread_mutex_lock(&handle_commandMutex);
+  close_cursors(tiInfo->clientsock);
+  pthread_mutex_unlock(&handle_commandMutex);
+
   if(close(tiInfo->clientsock) < 0)
   {
     pthread_mutex_lock(&printMutex); 
@@ -780,6 +1177,9 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
     
+    // Seed the table name and key hash before any table is created.
+    hash_seed_init();
+    
     char *config_file = argv[1];
     // Read the config file.
     status = read_config(config_file, &params);
@@ -788,6 +1188,10 @@ int main(int argc, char *argv[])
         printf("Error processing config file\n");
         exit(EXIT_FAILURE);
     }
+
+    // Scans run on one thread per CPU unless the config file says otherwise
+    if(params.scan_threads > 0)
+        pool_start(params.scan_threads - 1);
     
     
     // Create a socket.
@@ -975,7 +1379,8 @@ int main(int argc, char *argv[])
             }
             while (wait_for_commands);
             
-            // Close the connection with the client.
+            // Close the connection with the client, and the cursors it left open.
+            close_cursors(clientsock);
             close(clientsock);
             
             
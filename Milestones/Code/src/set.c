@@ -0,0 +1,172 @@
+/**
+ * @file
+ * @brief This file implements the hash sets declared in set.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "set.h"
+#include "hash.h"
+
+
+/**
+ * @brief Hashes a value of a set.
+ */
+static uint64_t hash_value(const struct value_set* set, const void* value)
+{
+    uint32_t bits;
+
+    if(set->strings)
+        return hash_string((const char*) value);
+
+    memcpy(&bits, value, sizeof bits);
+    return set_hash_int((int32_t) bits);
+}
+
+
+/**
+ * @brief Checks whether value i of a set is a given value.
+ */
+static bool value_equal(const struct value_set* set, int i, const void* value)
+{
+    return set->strings ? strcmp(set_value(set, i), (const char*) value) == 0 : memcmp(set_value(set, i), value, sizeof(int32_t)) == 0;
+}
+
+
+/**
+ * @brief Finds the slot holding a value, or the empty slot ending its probe sequence.
+ *
+ * @param hash The hash of the value.
+ */
+static int find_slot(const struct value_set* set, uint64_t hash, const void* value)
+{
+    int slot = hash & (set->capacity - 1);
+
+    while(set->slots[slot] != 0 && !value_equal(set, set->slots[slot] - 1, value))
+        slot = (slot + 1) & (set->capacity - 1);
+
+    return slot;
+}
+
+
+/**
+ * @brief Slots value i of a set, and sets its bit of the filter.
+ */
+static void place_value(struct value_set* set, int i)
+{
+    uint64_t hash = hash_value(set, set_value(set, i));
+    uint64_t bit = hash & ((uint64_t) set->capacity * SET_FILTER_BITS - 1);
+
+    set->slots[find_slot(set, hash, set_value(set, i))] = i + 1;
+    set->filter[bit / 64] |= 1ull << bit % 64;
+}
+
+
+/**
+ * @brief Reallocates the slots, filter and values of a set for a capacity, and places the values again.
+ *
+ * @return Returns 0 on success, -1 otherwise in which case the set is unchanged.
+ */
+static int resize(struct value_set* set, int capacity)
+{
+    int32_t* slots = (int32_t*) calloc(capacity, sizeof(int32_t));
+    uint64_t* filter = (uint64_t*) calloc((size_t) capacity * SET_FILTER_BITS / 64, sizeof(uint64_t));
+    char* values = slots != NULL && filter != NULL ? (char*) realloc(set->values, (size_t) capacity / 2 * set->width) : NULL;
+    int i;
+
+    if(values == NULL)
+    {
+        free(slots);
+        free(filter);
+        return -1;
+    }
+
+    free(set->slots);
+    free(set->filter);
+    set->slots = slots;
+    set->filter = filter;
+    set->values = values;
+    set->capacity = capacity;
+    for(i = 0; i < set->num_values; i++)
+        place_value(set, i);
+
+    return 0;
+}
+
+
+int set_init(struct value_set* set, bool strings, int width)
+{
+    memset(set, 0, sizeof *set);
+    set->strings = strings;
+    set->width = width;
+    set->min = INT32_MAX;
+    set->max = INT32_MIN;
+
+    return resize(set, SET_MIN_CAPACITY);
+}
+
+
+void set_destroy(struct value_set* set)
+{
+    free(set->slots);
+    free(set->filter);
+    free(set->values);
+}
+
+
+int set_reserve(struct value_set* set, int num_values)
+{
+    int capacity = set->capacity;
+
+    while(capacity / 2 < num_values)
+        capacity *= 2;
+
+    return capacity == set->capacity ? 0 : resize(set, capacity);
+}
+
+
+void set_clear(struct value_set* set)
+{
+    memset(set->slots, 0, set->capacity * sizeof(int32_t));
+    memset(set->filter, 0, (size_t) set->capacity * SET_FILTER_BITS / 8);
+    set->num_values = 0;
+    set->min = INT32_MAX;
+    set->max = INT32_MIN;
+}
+
+
+int set_add(struct value_set* set, const void* value)
+{
+    char* copy;
+    int32_t number;
+
+    if(set_contains(set, value))
+        return 0;
+
+    if(set_reserve(set, set->num_values + 1) != 0)
+        return -1;
+
+    // Strings are copied with their padding zeroed, so each value takes width bytes
+    copy = set->values + (size_t) set->num_values * set->width;
+    if(set->strings)
+        strncpy(copy, (const char*) value, set->width);
+    else
+    {
+        memcpy(&number, value, sizeof number);
+        memcpy(copy, &number, sizeof number);
+        set->min = number < set->min ? number : set->min;
+        set->max = number > set->max ? number : set->max;
+    }
+    place_value(set, set->num_values++);
+
+    return 0;
+}
+
+
+bool set_contains(const struct value_set* set, const void* value)
+{
+    uint64_t hash = hash_value(set, value);
+    uint64_t bit = hash & ((uint64_t) set->capacity * SET_FILTER_BITS - 1);
+
+    return (set->filter[bit / 64] & (1ull << bit % 64)) != 0 && set->slots[find_slot(set, hash, value)] != 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @brief This file declares the hash sets holding the values of IN lists.
+ *
+ * A predicate such as "province IN (Ontario, Quebec)" keeps its values in
+ * a set built once when it is parsed, so each row compared against it
+ * costs a single probe however long the list. Values are either int32_t
+ * or strings of a fixed maximum size, and are kept densely in the order
+ * they were added, while an open addressing array of slots, probed
+ * linearly, holds the index of each value. As few rows of a scan usually
+ * match, a filter of SET_FILTER_BITS bits per slot, with the bit at the
+ * hash of each value set, first rejects most values not in the set
+ * without a mispredicted probe of the slots.
+ *
+ * Ints are hashed by a multiplication, which costs less than the row it
+ * is probed for, and strings by hash_string() of hash.h.
+ */
+
+#ifndef SET_H
+#define SET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SET_MIN_CAPACITY 16 ///< Slots allocated for a new set, a power of two.
+#define SET_FILTER_BITS 16 ///< Bits of the filter per slot, a power of two.
+
+
+/**
+ * @brief A set of ints or strings.
+ */
+struct value_set {
+    bool strings; ///< Whether the values are strings rather than int32_t.
+    int width; ///< Bytes of each value, 4 for ints, the size of a char[n] column for strings.
+    int num_values;
+    int capacity; ///< Slots, a power of two, at least twice num_values.
+    int32_t* slots; ///< One more than the index of the value in each used slot, 0 in an empty one.
+    uint64_t* filter; ///< capacity * SET_FILTER_BITS bits, set at the hash of each value.
+    char* values; ///< The values in the order they were added, width bytes each.
+    int32_t min; ///< Least int value, INT32_MAX while the set is empty.
+    int32_t max; ///< Greatest int value, INT32_MIN while the set is empty.
+};
+
+
+/**
+ * @brief Initializes an empty set.
+ *
+ * @param strings Whether the values are strings.
+ * @param width Bytes of each value, 4 for ints, the size of the column with its null terminator for strings.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int set_init(struct value_set* set, bool strings, int width);
+
+
+/**
+ * @brief Frees the slots and values of a set.
+ */
+void set_destroy(struct value_set* set);
+
+
+/**
+ * @brief Makes room for a number of values, so that adding that many never allocates.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int set_reserve(struct value_set* set, int num_values);
+
+
+/**
+ * @brief Removes every value of a set, keeping its memory.
+ */
+void set_clear(struct value_set* set);
+
+
+/**
+ * @brief Adds a value to a set, unless it already holds it.
+ *
+ * @param value The int32_t or the null terminated string, shorter than width.
+ * @return Returns 0 on success, -1 if out of memory.
+ */
+int set_add(struct value_set* set, const void* value);
+
+
+/**
+ * @brief Checks whether a set holds a value.
+ *
+ * @param value The int32_t, possibly unaligned, or the null terminated string.
+ */
+bool set_contains(const struct value_set* set, const void* value);
+
+
+/**
+ * @brief Hashes an int of a set.
+ */
+static inline uint32_t set_hash_int(int32_t value)
+{
+    return (uint32_t) (((uint32_t) value * UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+}
+
+
+/**
+ * @brief Checks whether a set of ints holds a value.
+ *
+ * Scans probe a set for every row, so ints are probed inline.
+ */
+static inline bool set_contains_int(const struct value_set* set, int32_t value)
+{
+    const int32_t* values = (const int32_t*) set->values;
+    uint32_t hash = set_hash_int(value), bit = hash & (set->capacity * SET_FILTER_BITS - 1), mask = set->capacity - 1, slot = hash & mask;
+    int32_t index;
+
+    if((set->filter[bit / 64] & (1ull << bit % 64)) == 0)
+        return false;
+
+    for(; (index = set->slots[slot]) != 0; slot = (slot + 1) & mask)
+        if(values[index - 1] == value)
+            return true;
+
+    return false;
+}
+
+
+/**
+ * @brief Returns value i of a set, in the order the values were added.
+ */
+static inline const char* set_value(const struct value_set* set, int i)
+{
+    return set->values + (size_t) i * set->width;
+}
+
+
+#endif
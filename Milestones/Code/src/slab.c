@@ -0,0 +1,278 @@
+/**
+ * @file
+ * @brief This file implements the slab allocator declared in slab.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "slab.h"
+
+
+/**
+ * @brief Object sizes of the size classes.
+ *
+ * Four classes per power of two keep the space lost to rounding below 25%.
+ */
+static const size_t class_sizes[SLAB_NUM_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 896, 1024, 1280, 1536, 1792, 2048
+};
+
+static pthread_once_t slot_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slot_key; ///< Releases the cache slot of a thread when it exits.
+static pthread_mutex_t slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static int slot_used[SLAB_MAX_THREADS]; ///< Cache slots taken by running threads.
+static __thread int thread_slot = -1; ///< Cache slot of this thread, -1 if not assigned yet and -2 if none was free.
+
+
+/**
+ * @brief Gives back the cache slot of an exiting thread.
+ *
+ * Objects left in the caches of this slot stay valid, and are used by the
+ * next thread taking it.
+ */
+static void release_slot(void* value)
+{
+    pthread_mutex_lock(&slot_lock);
+    slot_used[(intptr_t) value - 1] = 0;
+    pthread_mutex_unlock(&slot_lock);
+}
+
+
+static void create_slot_key(void)
+{
+    pthread_key_create(&slot_key, release_slot);
+}
+
+
+/**
+ * @brief Returns the cache slot of the calling thread.
+ *
+ * @return Returns the slot on success, -1 if all slots are taken.
+ */
+static int get_thread_slot(void)
+{
+    int i;
+
+    if(thread_slot != -1)
+        return thread_slot < 0 ? -1 : thread_slot;
+
+    pthread_once(&slot_once, create_slot_key);
+
+    thread_slot = -2;
+    pthread_mutex_lock(&slot_lock);
+    for(i = 0; i < SLAB_MAX_THREADS; i++)
+        if(!slot_used[i])
+        {
+            slot_used[i] = 1;
+            thread_slot = i;
+            break;
+        }
+    pthread_mutex_unlock(&slot_lock);
+
+    if(thread_slot < 0)
+        return -1;
+
+    // The key value must not be NULL for release_slot to be called
+    pthread_setspecific(slot_key, (void*) (intptr_t) (thread_slot + 1));
+
+    return thread_slot;
+}
+
+
+/**
+ * @brief Returns the smallest size class holding objects of a size.
+ *
+ * @return Returns the class on success, -1 if the size is too large.
+ */
+static int size_class(size_t size)
+{
+    int i;
+
+    for(i = 0; i < SLAB_NUM_CLASSES; i++)
+        if(size <= class_sizes[i])
+            return i;
+
+    return -1;
+}
+
+
+/**
+ * @brief Takes a free object of a size class from the shared lists, carving
+ * a new slab if needed.
+ *
+ * The allocator lock must be held.
+ *
+ * @return Returns the object on success, NULL otherwise.
+ */
+static struct slab_object* class_take(struct slab_allocator* allocator, int class)
+{
+    struct slab_class* sc = &allocator->classes[class];
+    struct slab_object* object = sc->free_list;
+
+    if(object != NULL)
+    {
+        sc->free_list = object->next;
+        return object;
+    }
+
+    if(sc->unused + class_sizes[class] > sc->unused_end)
+    {
+        char* slab = (char*) malloc(SLAB_SIZE);
+        if(slab == NULL)
+            return NULL;
+
+        // The first word of each slab links it in the list of all slabs
+        *(void**) slab = allocator->slabs;
+        allocator->slabs = slab;
+        allocator->num_slabs++;
+
+        sc->unused = slab + class_sizes[0];
+        sc->unused_end = slab + SLAB_SIZE;
+    }
+
+    object = (struct slab_object*) sc->unused;
+    sc->unused += class_sizes[class];
+
+    return object;
+}
+
+
+int slab_init(struct slab_allocator* allocator)
+{
+    memset(allocator, 0, sizeof *allocator);
+
+    if(pthread_mutex_init(&allocator->lock, NULL) != 0)
+        return -1;
+
+    return 0;
+}
+
+
+void slab_destroy(struct slab_allocator* allocator)
+{
+    void* slab = allocator->slabs;
+
+    while(slab != NULL)
+    {
+        void* next = *(void**) slab;
+        free(slab);
+        slab = next;
+    }
+
+    pthread_mutex_destroy(&allocator->lock);
+    memset(allocator, 0, sizeof *allocator);
+}
+
+
+void* slab_alloc(struct slab_allocator* allocator, size_t size)
+{
+    int class = size_class(size);
+    int slot = get_thread_slot();
+    struct slab_object* object;
+
+    if(class < 0)
+        return NULL;
+
+    if(slot < 0)
+    {
+        pthread_mutex_lock(&allocator->lock);
+        object = class_take(allocator, class);
+        pthread_mutex_unlock(&allocator->lock);
+    }
+    else
+    {
+        struct slab_cache* cache = &allocator->caches[slot][class];
+
+        // Refill an empty cache with half its size in one trip to the shared lists
+        if(cache->head == NULL)
+        {
+            pthread_mutex_lock(&allocator->lock);
+            while(cache->count < SLAB_CACHE_SIZE / 2 && (object = class_take(allocator, class)) != NULL)
+            {
+                object->next = cache->head;
+                cache->head = object;
+                cache->count++;
+            }
+            pthread_mutex_unlock(&allocator->lock);
+        }
+
+        object = cache->head;
+        if(object != NULL)
+        {
+            cache->head = object->next;
+            cache->count--;
+        }
+    }
+
+    if(object != NULL)
+    {
+        __atomic_add_fetch(&allocator->live_objects, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&allocator->live_bytes, size, __ATOMIC_RELAXED);
+    }
+
+    return object;
+}
+
+
+void slab_free(struct slab_allocator* allocator, void* object, size_t size)
+{
+    int class = size_class(size);
+    int slot = get_thread_slot();
+    struct slab_object* freed = (struct slab_object*) object;
+
+    if(object == NULL)
+        return;
+
+    __atomic_sub_fetch(&allocator->live_objects, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&allocator->live_bytes, size, __ATOMIC_RELAXED);
+
+    if(slot < 0)
+    {
+        pthread_mutex_lock(&allocator->lock);
+        freed->next = allocator->classes[class].free_list;
+        allocator->classes[class].free_list = freed;
+        pthread_mutex_unlock(&allocator->lock);
+        return;
+    }
+
+    struct slab_cache* cache = &allocator->caches[slot][class];
+
+    freed->next = cache->head;
+    cache->head = freed;
+    cache->count++;
+
+    // Return half of an overflowing cache so other threads can use it
+    if(cache->count > SLAB_CACHE_SIZE)
+    {
+        pthread_mutex_lock(&allocator->lock);
+        while(cache->count > SLAB_CACHE_SIZE / 2)
+        {
+            freed = cache->head;
+            cache->head = freed->next;
+            cache->count--;
+            freed->next = allocator->classes[class].free_list;
+            allocator->classes[class].free_list = freed;
+        }
+        pthread_mutex_unlock(&allocator->lock);
+    }
+}
+
+
+void slab_get_stats(struct slab_allocator* allocator, struct slab_stats* stats)
+{
+    pthread_mutex_lock(&allocator->lock);
+    stats->slabs = allocator->num_slabs;
+    pthread_mutex_unlock(&allocator->lock);
+
+    stats->live_objects = __atomic_load_n(&allocator->live_objects, __ATOMIC_RELAXED);
+    stats->live_bytes = __atomic_load_n(&allocator->live_bytes, __ATOMIC_RELAXED);
+    stats->slab_bytes = stats->slabs * SLAB_SIZE;
+
+    if(stats->slab_bytes == 0)
+        stats->fragmentation = 0;
+    else
+        stats->fragmentation = (int) (100 - stats->live_bytes * 100 / stats->slab_bytes);
+}
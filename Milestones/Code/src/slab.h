@@ -0,0 +1,126 @@
+/**
+ * @file
+ * @brief This file declares the slab allocator holding the records of a
+ * table.
+ *
+ * Objects are carved from SLAB_SIZE byte slabs, one free list per size
+ * class. Each thread keeps a small cache of free objects per size class
+ * inside the allocator, so allocating and freeing only take the allocator
+ * lock when a cache runs empty or overflows. Slabs are never returned one
+ * at a time: destroying the allocator frees them all without visiting the
+ * objects they hold.
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define SLAB_SIZE (64 * 1024) ///< Bytes allocated at once for objects of one size class.
+#define SLAB_NUM_CLASSES 24 ///< Number of object size classes.
+#define SLAB_MAX_OBJECT 2048 ///< Largest object size, in bytes.
+#define SLAB_MAX_THREADS 16 ///< Threads with their own free object caches. Others always take the lock.
+#define SLAB_CACHE_SIZE 32 ///< A thread cache holding more free objects returns half of them.
+
+
+/**
+ * @brief A free object, linked in a free list.
+ */
+struct slab_object {
+    struct slab_object* next;
+};
+
+
+/**
+ * @brief Free objects of one size class owned by one thread.
+ */
+struct slab_cache {
+    struct slab_object* head;
+    int count;
+};
+
+
+/**
+ * @brief Objects of one size class shared by all threads.
+ */
+struct slab_class {
+    struct slab_object* free_list;
+    char* unused; ///< Start of the never allocated tail of the newest slab of this class.
+    char* unused_end;
+};
+
+
+/**
+ * @brief A slab allocator.
+ */
+struct slab_allocator {
+    pthread_mutex_t lock; ///< Guards classes and slabs.
+    struct slab_class classes[SLAB_NUM_CLASSES];
+    struct slab_cache caches[SLAB_MAX_THREADS][SLAB_NUM_CLASSES];
+    void* slabs; ///< All slabs, linked by their first word.
+    size_t num_slabs;
+    size_t live_objects; ///< Objects allocated and not freed.
+    size_t live_bytes; ///< Bytes requested by the live objects.
+};
+
+
+/**
+ * @brief Memory usage of a slab allocator.
+ */
+struct slab_stats {
+    size_t slabs; ///< Slabs allocated.
+    size_t live_objects; ///< Objects allocated and not freed.
+    size_t live_bytes; ///< Bytes requested by the live objects.
+    size_t slab_bytes; ///< Bytes held by all slabs.
+    int fragmentation; ///< Percentage of slab bytes not requested by live objects.
+};
+
+
+/**
+ * @brief Initializes an allocator with no slabs.
+ *
+ * @param allocator The allocator to initialize.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+int slab_init(struct slab_allocator* allocator);
+
+
+/**
+ * @brief Frees all the slabs of an allocator, and so all its objects.
+ *
+ * @param allocator The allocator to destroy.
+ */
+void slab_destroy(struct slab_allocator* allocator);
+
+
+/**
+ * @brief Allocates an object.
+ *
+ * @param allocator The allocator to use.
+ * @param size Size of the object in bytes, at most SLAB_MAX_OBJECT.
+ * @return Returns the uninitialized object on success, NULL otherwise.
+ */
+void* slab_alloc(struct slab_allocator* allocator, size_t size);
+
+
+/**
+ * @brief Frees an object.
+ *
+ * @param allocator The allocator the object was allocated from.
+ * @param object The object to free.
+ * @param size The size the object was allocated with.
+ */
+void slab_free(struct slab_allocator* allocator, void* object, size_t size);
+
+
+/**
+ * @brief Reports the memory usage of an allocator.
+ *
+ * @param allocator The allocator.
+ * @param stats Where the statistics are stored.
+ */
+void slab_get_stats(struct slab_allocator* allocator, struct slab_stats* stats);
+
+
+#endif
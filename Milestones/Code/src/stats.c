@@ -0,0 +1,324 @@
+/**
+ * @file
+ * @brief This file implements the column statistics declared in stats.h.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+#include "hash.h"
+#include "index.h"
+#include "row.h"
+
+
+/**
+ * @brief Orders int32_t values.
+ */
+static int compare_ints(const void* a, const void* b)
+{
+    int32_t x = *(const int32_t*) a, y = *(const int32_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+
+/**
+ * @brief Orders the null terminated strings of a sample.
+ */
+static int compare_strings(const void* a, const void* b)
+{
+    return strcmp((const char*) a, (const char*) b);
+}
+
+
+/**
+ * @brief Orders uint64_t hashes.
+ */
+static int compare_hashes(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+
+/**
+ * @brief Estimates the distinct values of a column from its sorted sampled values.
+ *
+ * As in the Guaranteed-Error Estimator of Charikar et al., a value seen
+ * once in the sample stands for sqrt(num_rows / sample_rows) values of the
+ * table, and a value seen more often for itself alone.
+ *
+ * @param values The sampled values, sorted so that equal values are adjacent.
+ * @param size Bytes of a value.
+ */
+static double estimate_distinct(const char* values, size_t size, int sample_rows, int num_rows)
+{
+    int seen = 0, seen_once = 0, i, run;
+    double distinct;
+
+    for(i = 0; i < sample_rows; i += run)
+    {
+        for(run = 1; i + run < sample_rows && memcmp(values + i * size, values + (i + run) * size, size) == 0; run++)
+            ;
+        seen++;
+        seen_once += run == 1;
+    }
+
+    distinct = sqrt((double) num_rows / sample_rows) * seen_once + (seen - seen_once);
+
+    return distinct < seen ? seen : distinct > num_rows ? num_rows : distinct;
+}
+
+
+/**
+ * @brief Finds the values sampled most often among the sorted hashes of a char[n] column.
+ */
+static void find_common(struct column_stats* column, const uint64_t hashes[], int sample_rows)
+{
+    int i, run, slot;
+
+    column->num_common = 0;
+    for(i = 0; i < sample_rows; i += run)
+    {
+        for(run = 1; i + run < sample_rows && hashes[i + run] == hashes[i]; run++)
+            ;
+        if(run == 1 || (column->num_common == STATS_COMMON_VALUES && run <= column->common_counts[STATS_COMMON_VALUES - 1]))
+            continue;
+
+        // Kept sorted by count, the least common value dropped when full
+        slot = column->num_common < STATS_COMMON_VALUES ? column->num_common++ : STATS_COMMON_VALUES - 1;
+        for(; slot > 0 && column->common_counts[slot - 1] < run; slot--)
+        {
+            column->common_hashes[slot] = column->common_hashes[slot - 1];
+            column->common_counts[slot] = column->common_counts[slot - 1];
+        }
+        column->common_hashes[slot] = hashes[i];
+        column->common_counts[slot] = run;
+    }
+}
+
+
+/**
+ * @brief Builds the statistics of a table from a sample of its records.
+ */
+static void sample_table(struct hash_table* table, struct table_stats* stats)
+{
+    const struct table_schema* schema = table->schema;
+    const struct record* sample[STATS_SAMPLE_ROWS];
+    int32_t ints[STATS_SAMPLE_ROWS];
+    uint64_t hashes[STATS_SAMPLE_ROWS];
+    char strings[STATS_SAMPLE_ROWS][MAX_STRTYPE_SIZE];
+    char buf[MAX_VALUE_LEN];
+    int stride = table->num_entries > STATS_SAMPLE_ROWS ? table->num_entries / STATS_SAMPLE_ROWS : 1;
+    int num_sampled = 0, entry, column, i;
+
+    // Holes left by removed records are skipped rather than replaced
+    for(entry = 0; entry < table->num_entries && num_sampled < STATS_SAMPLE_ROWS; entry += stride)
+        if(table->entries[entry].record != NULL)
+            sample[num_sampled++] = table->entries[entry].record;
+
+    stats->version = table->version;
+    stats->num_rows = table->num_keys;
+    stats->sample_rows = num_sampled;
+    stats->refreshes++;
+    if(num_sampled == 0)
+        return;
+
+    for(column = 0; column < schema->num_columns; column++)
+    {
+        struct column_stats* column_stats = &stats->columns[column];
+
+        if(schema->data_types[column] != 0)
+        {
+            for(i = 0; i < num_sampled; i++)
+            {
+                strcpy(strings[i], row_string(&table->layout, table_get_row(table, sample[i], buf), column));
+                hashes[i] = hash_string(strings[i]);
+            }
+
+            qsort(hashes, num_sampled, sizeof hashes[0], compare_hashes);
+            column_stats->distinct = estimate_distinct((const char*) hashes, sizeof hashes[0], num_sampled, table->num_keys);
+            find_common(column_stats, hashes, num_sampled);
+
+            qsort(strings, num_sampled, sizeof strings[0], compare_strings);
+            for(i = 0; i <= STATS_BUCKETS; i++)
+                strcpy(column_stats->string_bounds[i], strings[(long) i * (num_sampled - 1) / STATS_BUCKETS]);
+            continue;
+        }
+
+        for(i = 0; i < num_sampled; i++)
+            ints[i] = row_int(&table->layout, table_get_row(table, sample[i], buf), column);
+
+        qsort(ints, num_sampled, sizeof ints[0], compare_ints);
+        column_stats->distinct = estimate_distinct((const char*) ints, sizeof ints[0], num_sampled, table->num_keys);
+        for(i = 0; i <= STATS_BUCKETS; i++)
+            column_stats->bounds[i] = ints[(long) i * (num_sampled - 1) / STATS_BUCKETS];
+
+        // An ordered index knows the true extremes, which the outer buckets are stretched to
+        column_stats->min = ints[0];
+        column_stats->max = ints[num_sampled - 1];
+        if(table->indexes[column] != NULL && index_bounds(table->indexes[column], &column_stats->min, &column_stats->max) == 0)
+        {
+            column_stats->bounds[0] = column_stats->min;
+            column_stats->bounds[STATS_BUCKETS] = column_stats->max;
+        }
+    }
+}
+
+
+const struct table_stats* stats_get(struct hash_table* table)
+{
+    struct table_stats* stats = table->stats;
+
+    if(stats == NULL && (stats = table->stats = (struct table_stats*) calloc(1, sizeof(struct table_stats))) == NULL)
+        return NULL;
+
+    if(stats->refreshes == 0 || (table->version - stats->version) * STATS_STALE_RATIO > (unsigned long long) stats->num_rows)
+        sample_table(table, stats);
+
+    return stats;
+}
+
+
+/**
+ * @brief Estimates the fraction of the values of an int column less than a value.
+ */
+static double fraction_less(const struct column_stats* column, int32_t value)
+{
+    int bucket;
+
+    if(value <= column->bounds[0])
+        return 0;
+    if(value > column->bounds[STATS_BUCKETS])
+        return 1;
+
+    // The bucket holding the value, its lower bound being less than the value
+    for(bucket = STATS_BUCKETS - 1; column->bounds[bucket] >= value; bucket--)
+        ;
+
+    return (bucket + (double) ((int64_t) value - column->bounds[bucket])
+            / ((int64_t) column->bounds[bucket + 1] - column->bounds[bucket])) / STATS_BUCKETS;
+}
+
+
+/**
+ * @brief Estimates the fraction of the values of an int column equal to a value.
+ */
+static double fraction_equal(const struct column_stats* column, int32_t value)
+{
+    int bucket, whole_buckets = 0;
+
+    if(value < column->bounds[0] || value > column->bounds[STATS_BUCKETS])
+        return 0;
+
+    // A value frequent enough to fill whole buckets is counted by them
+    for(bucket = 0; bucket < STATS_BUCKETS; bucket++)
+        if(column->bounds[bucket] == value && column->bounds[bucket + 1] == value)
+            whole_buckets++;
+
+    return whole_buckets > 0 ? (double) whole_buckets / STATS_BUCKETS : 1 / column->distinct;
+}
+
+
+/**
+ * @brief Estimates the fraction of the values of a char[n] column equal to a value.
+ */
+static double fraction_string(const struct column_stats* column, int sample_rows, const char* value)
+{
+    uint64_t hash = hash_string(value);
+    int common_rows = 0, i;
+
+    for(i = 0; i < column->num_common; i++)
+    {
+        if(column->common_hashes[i] == hash)
+            return (double) column->common_counts[i] / sample_rows;
+        common_rows += column->common_counts[i];
+    }
+
+    // The rows left are shared by the values left
+    if(column->distinct <= column->num_common)
+        return 0;
+
+    return (1 - (double) common_rows / sample_rows) / (column->distinct - column->num_common);
+}
+
+
+/**
+ * @brief Estimates the fraction of the values of a char[n] column less than a string.
+ *
+ * Strings are not interpolated within a bucket, so the string is taken as
+ * halfway through the bucket holding it.
+ */
+static double fraction_before(const struct column_stats* column, const char* string)
+{
+    int bucket;
+
+    if(strcmp(string, column->string_bounds[0]) <= 0)
+        return 0;
+    if(strcmp(string, column->string_bounds[STATS_BUCKETS]) > 0)
+        return 1;
+
+    // The bucket holding the string, its lower bound being less than the string
+    for(bucket = STATS_BUCKETS - 1; strcmp(column->string_bounds[bucket], string) >= 0; bucket--)
+        ;
+
+    return (bucket + 0.5) / STATS_BUCKETS;
+}
+
+
+double stats_selectivity(const struct table_stats* stats, const struct table_schema* schema, const struct predicate* predicate)
+{
+    const struct column_stats* column = &stats->columns[predicate->column_id];
+    char end[MAX_STRTYPE_SIZE];
+    double fraction;
+
+    if(stats->sample_rows == 0)
+        return 0;
+
+    // The values of an IN list match disjoint rows
+    if(predicate->operator == 'I')
+    {
+        const struct value_set* values = &predicate->list->values;
+        int32_t value;
+        int i;
+
+        for(i = 0, fraction = 0; i < values->num_values; i++)
+        {
+            if(values->strings)
+                fraction += fraction_string(column, stats->sample_rows, set_value(values, i));
+            else
+            {
+                memcpy(&value, set_value(values, i), sizeof value);
+                fraction += fraction_equal(column, value);
+            }
+        }
+        return fraction < 1 ? fraction : 1;
+    }
+
+    if(schema->data_types[predicate->column_id] != 0)
+    {
+        if(predicate->operator == '=')
+            return fraction_string(column, stats->sample_rows, predicate->argument);
+        if(predicate->operator == '<')
+            return fraction_before(column, predicate->argument);
+
+        if(predicate->operator == '^')
+        {
+            query_prefix_end(predicate->argument, end);
+            fraction = fraction_before(column, end) - fraction_before(column, predicate->argument);
+            return fraction > 1 / column->distinct ? fraction : 1 / column->distinct;
+        }
+
+        fraction = 1 - fraction_before(column, predicate->argument) - fraction_string(column, stats->sample_rows, predicate->argument);
+        return fraction > 0 ? fraction : 0;
+    }
+
+    if(predicate->operator == '<')
+        return fraction_less(column, predicate->int_argument);
+    if(predicate->operator == '=')
+        return fraction_equal(column, predicate->int_argument);
+
+    fraction = 1 - fraction_less(column, predicate->int_argument) - fraction_equal(column, predicate->int_argument);
+
+    return fraction > 0 ? fraction : 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file
+ * @brief This file declares the column statistics the query planner
+ * estimates the selectivity of predicates with.
+ *
+ * The statistics of a table are built from a sample of at most
+ * STATS_SAMPLE_ROWS rows spread evenly over its entries: an equi-depth
+ * histogram of each column, whose bucket bounds split the sampled values
+ * into STATS_BUCKETS runs of as many values, the most common values of
+ * each char[n] column, and an estimate of the distinct values of every
+ * column. They are rebuilt when a query is planned on a table that changed
+ * by more than 1 / STATS_STALE_RATIO of its records since it was sampled,
+ * so their cost does not grow with the table. The number of records is
+ * kept by the table itself, and the least and greatest values of a column
+ * indexed by a B+tree are read from the index rather than the sample.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "query.h"
+
+#define STATS_SAMPLE_ROWS 1024 ///< Rows sampled to build the statistics of a table.
+#define STATS_BUCKETS 32 ///< Buckets of the histogram of an int column.
+#define STATS_STALE_RATIO 8 ///< Statistics are rebuilt once more than 1 / STATS_STALE_RATIO of the records changed.
+#define STATS_COMMON_VALUES 8 ///< Most common values counted for a char[n] column.
+
+
+/**
+ * @brief The statistics of a column, from a sample of the table.
+ */
+struct column_stats {
+    int32_t min; ///< Least value of an int column.
+    int32_t max; ///< Greatest value of an int column.
+    int32_t bounds[STATS_BUCKETS + 1]; ///< Sampled values of ranks 0, n / STATS_BUCKETS, ..., n - 1 of an int column.
+    char string_bounds[STATS_BUCKETS + 1][MAX_STRTYPE_SIZE]; ///< Sampled values of the same ranks of a char[n] column.
+    double distinct; ///< Estimated number of distinct values in the table.
+    int num_common; ///< Values of a char[n] column sampled more than once, at most STATS_COMMON_VALUES.
+    uint64_t common_hashes[STATS_COMMON_VALUES]; ///< Hashes of the most common values, the most sampled first.
+    int common_counts[STATS_COMMON_VALUES]; ///< Times each common value was sampled.
+};
+
+
+/**
+ * @brief The statistics of a table.
+ *
+ * The structure holds no pointer, so the table frees it with free().
+ */
+struct table_stats {
+    unsigned long long version; ///< Version of the table when sampled.
+    int num_rows; ///< Records of the table when sampled.
+    int sample_rows; ///< Records sampled, 0 for an empty table.
+    unsigned long long refreshes; ///< Times the table was sampled.
+    struct column_stats columns[MAX_COLUMNS_PER_TABLE];
+};
+
+
+/**
+ * @brief Returns the statistics of a table, sampling it first if they are missing or stale.
+ *
+ * @return Returns the statistics, or NULL if out of memory.
+ */
+const struct table_stats* stats_get(struct hash_table* table);
+
+
+/**
+ * @brief Estimates the fraction of the records of a table matching a predicate.
+ *
+ * An int predicate is estimated from the histogram of its column: a range
+ * by the buckets below or above its argument, interpolated within the
+ * bucket holding it, and an equality by the buckets made of its argument
+ * alone, or else as one of the distinct values. A string equality is
+ * estimated by the share of the sample its argument had if it is a common
+ * value, or else as one of the values left. A string range or prefix is
+ * estimated from the histogram of its column, taking each argument as
+ * halfway through the bucket holding it, and a prefix as at least one of
+ * the distinct values. An IN list is estimated as the sum of the
+ * equalities with each of its values.
+ *
+ * @param stats The statistics of the table.
+ * @param schema The schema of the table.
+ * @param predicate The predicate.
+ * @return Returns the fraction, from 0 to 1.
+ */
+double stats_selectivity(const struct table_stats* stats, const struct table_schema* schema, const struct predicate* predicate);
+
+
+#endif
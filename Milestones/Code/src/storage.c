@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -432,7 +433,7 @@ int storage_query(const char *table, const char *predicates, char **keys, const
     char buf[MAX_CMD_LEN] = {0};
     memset(buf, 0, sizeof buf);
     //make_predicates(predicates);
-    sprintf(buf, "QUERY #%.19s #%d #%s\n", table, max_keys, predicates);
+    snprintf(buf, sizeof buf, "QUERY #%.19s #%d #%s\n", table, max_keys, predicates);
     
     
     if(max_keys < 0 || (max_keys > 0 && keys == NULL))
@@ -449,10 +450,10 @@ int storage_query(const char *table, const char *predicates, char **keys, const
         logger(client_log, log_buffer);
     }
     
-    else if(predicates == NULL || check_predicates(predicates) == false)
+    else if(predicates == NULL || strlen(predicates) > MAX_CMD_LEN - MAX_TABLE_LEN - 16 || check_predicates(predicates) == false)
     {
         errno = ERR_INVALID_PARAM;
-        sprintf(log_buffer, "storage_query: Incorrect predicates entered: %s\n", predicates);
+        sprintf(log_buffer, "storage_query: Incorrect predicates entered\n");
         logger(client_log, log_buffer);
     }
     else if(connected == false)
@@ -495,6 +496,667 @@ int storage_query(const char *table, const char *predicates, char **keys, const
 }
 
 
+/**
+ * @brief Checks that a connection is ready to use a query cursor.
+ *
+ * @param caller Name of the storage function, for the log.
+ * @return Returns true if the connection is open and authenticated, false otherwise with errno set.
+ */
+static bool check_conn(const char *caller, void *conn)
+{
+    if(conn == NULL)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "%s: Invalid connection", caller);
+    }
+    else if(connected == false)
+    {
+        errno = ERR_CONNECTION_FAIL;
+        sprintf(log_buffer, "%s: Not connected to a server\n", caller);
+    }
+    else if(authenticated == false)
+    {
+        errno = ERR_NOT_AUTHENTICATED;
+        sprintf(log_buffer, "%s: Connected to a server, but not yet authenticated\n", caller);
+    }
+    else
+        return true;
+
+    logger(client_log, log_buffer);
+    return false;
+}
+
+
+int storage_query_cursor(const char *table, const char *predicates, void *conn)
+{
+    char check[MAX_CONFIG_LINE_LEN], trash[MAX_CONFIG_LINE_LEN];
+    char temp_table[MAX_TABLE_LEN] = {0};
+    char buf[MAX_CMD_LEN] = {0};
+    int cursor;
+    
+    // Connection is really just a socket file descriptor.
+    int sock = (int)(intptr_t)conn;
+    
+    if(table == NULL || sscanf(table, "%[a-zA-Z0-9] %s", check, trash) != 1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_cursor: Incorrect table entered: %s\n", table);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(predicates == NULL || strlen(predicates) > MAX_CMD_LEN - MAX_TABLE_LEN - 16 || check_predicates(predicates) == false)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_cursor: Incorrect predicates entered\n");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(check_conn("storage_query_cursor", conn) == false)
+        return -1;
+    
+    sprintf(buf, "QUERY_OPEN #%s #%s\n", table, predicates);
+    
+    if(sendall(sock, buf, strlen(buf)) != 0 || recvline(sock, buf, sizeof buf) != 0)
+    {
+        errno = ERR_UNKNOWN;
+        sprintf(log_buffer, "storage_query_cursor: Failed to communicate with the server.\n");
+    }
+    else if(sscanf(buf, "QUERY_OPEN #%s #%d", temp_table, &cursor) != 2)
+    {
+        errno = ERR_TABLE_NOT_FOUND;
+        sprintf(log_buffer, "storage_query_cursor: Table not found: %s\n", table);
+    }
+    else if(cursor == -1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_cursor: Predicates rejected by the server: %s\n", predicates);
+    }
+    else if(cursor <= 0)
+    {
+        errno = ERR_UNKNOWN;
+        sprintf(log_buffer, "storage_query_cursor: The server has too many cursors open.\n");
+    }
+    else
+        return cursor;
+    
+    logger(client_log, log_buffer);
+    return -1;
+}
+
+
+int storage_query_next(int cursor, char **keys, const int max_keys, void *conn)
+{
+    char temp_keys[MAX_SCAN_KEYS * (MAX_KEY_LEN + 2) + 1];
+    char buf[MAX_CMD_LEN] = {0};
+    int num_keys = 0, requested, received, temp_cursor;
+    
+    // Connection is really just a socket file descriptor.
+    int sock = (int)(intptr_t)conn;
+    
+    if(cursor <= 0 || max_keys < 0 || (max_keys > 0 && keys == NULL))
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_next: Invalid cursor or max keys/keys array combination\n");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(check_conn("storage_query_next", conn) == false)
+        return -1;
+    
+    // Each reply lists at most MAX_SCAN_KEYS keys, so a larger keys array takes several
+    do
+    {
+        requested = max_keys - num_keys < MAX_SCAN_KEYS ? max_keys - num_keys : MAX_SCAN_KEYS;
+        sprintf(buf, "QUERY_NEXT #%d #%d\n", cursor, requested);
+        temp_keys[0] = 0;
+        
+        if(sendall(sock, buf, strlen(buf)) != 0 || recvline(sock, buf, sizeof buf) != 0)
+        {
+            errno = ERR_UNKNOWN;
+            sprintf(log_buffer, "storage_query_next: Failed to communicate with the server.\n");
+            logger(client_log, log_buffer);
+            return -1;
+        }
+        else if(sscanf(buf, "QUERY_NEXT #%d #%d #%[^\n]", &temp_cursor, &received, temp_keys) < 2 || received < 0)
+        {
+            errno = ERR_INVALID_PARAM;
+            sprintf(log_buffer, "storage_query_next: Cursor not found: %d\n", cursor);
+            logger(client_log, log_buffer);
+            return -1;
+        }
+        else if(received > requested)
+        {
+            errno = ERR_UNKNOWN;
+            sprintf(log_buffer, "storage_query_next: The server failed to list the keys.\n");
+            logger(client_log, log_buffer);
+            return -1;
+        }
+        
+        populate_keys(keys + num_keys, received, temp_keys);
+        num_keys += received;
+    }
+    while(received == requested && num_keys < max_keys);
+    
+    return num_keys;
+}
+
+
+int storage_query_fetch(int cursor, const char *columns, char **keys, struct storage_record *records, const int max_records, void *conn)
+{
+    char buf[MAX_CMD_LEN] = {0};
+    char temp_key[MAX_KEY_LEN + 1];
+    int num_records = 0, received, done = 0, temp_cursor, i, offset, len;
+    const char *next;
+    long temp_metadata;
+    
+    // Connection is really just a socket file descriptor.
+    int sock = (int)(intptr_t)conn;
+    
+    if(cursor <= 0 || max_records < 0 || (max_records > 0 && (keys == NULL || records == NULL))
+            || (columns != NULL && (strlen(columns) > MAX_CMD_LEN / 2 || strpbrk(columns, "#\n") != NULL)))
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_fetch: Invalid cursor, columns or max records/arrays combination\n");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(check_conn("storage_query_fetch", conn) == false)
+        return -1;
+    
+    // Each reply holds as many records as fit in MAX_CMD_LEN, so a larger array takes several
+    while(num_records < max_records && done == 0)
+    {
+        sprintf(buf, "QUERY_FETCH #%d #%d #%s\n", cursor, max_records - num_records, columns == NULL ? "" : columns);
+        
+        if(sendall(sock, buf, strlen(buf)) != 0 || recvline(sock, buf, sizeof buf) != 0)
+        {
+            errno = ERR_UNKNOWN;
+            sprintf(log_buffer, "storage_query_fetch: Failed to communicate with the server.\n");
+            logger(client_log, log_buffer);
+            return -1;
+        }
+        else if(sscanf(buf, "QUERY_FETCH #%d #%d #%d%n", &temp_cursor, &received, &done, &offset) < 2 || received < 0)
+        {
+            errno = ERR_INVALID_PARAM;
+            sprintf(log_buffer, "storage_query_fetch: Cursor not found or invalid columns: %d\n", cursor);
+            logger(client_log, log_buffer);
+            return -1;
+        }
+        else if(received > max_records - num_records || (received == 0 && done == 0))
+        {
+            errno = ERR_UNKNOWN;
+            sprintf(log_buffer, "storage_query_fetch: The server failed to list the records.\n");
+            logger(client_log, log_buffer);
+            return -1;
+        }
+        
+        next = buf + offset;
+        for(i = 0; i < received; i++, num_records++)
+        {
+            struct storage_record *record = &records[num_records];
+            
+            if(sscanf(next, " #%20s #%ld #%799[^#]%n", temp_key, &temp_metadata, record->value, &len) != 3)
+            {
+                errno = ERR_UNKNOWN;
+                sprintf(log_buffer, "storage_query_fetch: The server sent an invalid record.\n");
+                logger(client_log, log_buffer);
+                return -1;
+            }
+            next += len;
+            
+            // The value runs up to the separator of the next record
+            len = strlen(record->value);
+            while(len > 0 && record->value[len - 1] == ' ')
+                record->value[--len] = 0;
+            
+            strcpy(keys[num_records], temp_key);
+            record->metadata[0] = temp_metadata;
+        }
+    }
+    
+    return num_records;
+}
+
+
+int storage_query_close(int cursor, void *conn)
+{
+    char buf[MAX_CMD_LEN] = {0};
+    int temp_cursor;
+    
+    // Connection is really just a socket file descriptor.
+    int sock = (int)(intptr_t)conn;
+    
+    if(cursor <= 0)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_close: Invalid cursor: %d\n", cursor);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(check_conn("storage_query_close", conn) == false)
+        return -1;
+    
+    sprintf(buf, "QUERY_CLOSE #%d\n", cursor);
+    
+    if(sendall(sock, buf, strlen(buf)) != 0 || recvline(sock, buf, sizeof buf) != 0)
+    {
+        errno = ERR_UNKNOWN;
+        sprintf(log_buffer, "storage_query_close: Failed to communicate with the server.\n");
+    }
+    else if(sscanf(buf, "QUERY_CLOSE #%d", &temp_cursor) != 1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_close: Cursor not found: %d\n", cursor);
+    }
+    else
+        return 0;
+    
+    logger(client_log, log_buffer);
+    return -1;
+}
+
+
+int storage_aggregate(const char *table, const char *function, const char *column, const char *predicates, double *result, void *conn)
+{
+    char check[MAX_CONFIG_LINE_LEN], trash[MAX_CONFIG_LINE_LEN];
+    char temp_table[MAX_TABLE_LEN] = {0};
+    char buf[MAX_CMD_LEN] = {0};
+    long long count;
+    double value;
+    
+    // Connection is really just a socket file descriptor.
+    int sock = (int)(intptr_t)conn;
+    
+    if(table == NULL || sscanf(table, "%[a-zA-Z0-9] %s", check, trash) != 1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_aggregate: Incorrect table entered: %s\n", table);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(function == NULL || column == NULL || result == NULL || strlen(function) >= MAX_COLNAME_LEN || strlen(column) >= MAX_COLNAME_LEN
+            || sscanf(function, "%[A-Z] %s", check, trash) != 1 || sscanf(column, "%[a-zA-Z0-9] %s", check, trash) != 1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_aggregate: Incorrect function, column or result entered\n");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(predicates == NULL || strlen(predicates) > MAX_CMD_LEN - MAX_TABLE_LEN - 2 * MAX_COLNAME_LEN - 16 || check_predicates(predicates) == false)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_aggregate: Incorrect predicates entered\n");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(check_conn("storage_aggregate", conn) == false)
+        return -1;
+    
+    sprintf(buf, "AGGREGATE #%s #%s #%s #%s\n", table, function, column, predicates);
+    
+    if(sendall(sock, buf, strlen(buf)) != 0 || recvline(sock, buf, sizeof buf) != 0)
+    {
+        errno = ERR_UNKNOWN;
+        sprintf(log_buffer, "storage_aggregate: Failed to communicate with the server.\n");
+    }
+    else if(sscanf(buf, "AGGREGATE #%s #%lld", temp_table, &count) != 2)
+    {
+        errno = ERR_TABLE_NOT_FOUND;
+        sprintf(log_buffer, "storage_aggregate: Table not found: %s\n", table);
+    }
+    else if(count < 0 || sscanf(buf, "AGGREGATE #%*s #%*s #%lf", &value) != 1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_aggregate: Aggregate rejected by the server: %s of %s\n", function, column);
+    }
+    else
+    {
+        *result = value;
+        return count < INT_MAX ? (int) count : INT_MAX;
+    }
+    
+    logger(client_log, log_buffer);
+    return -1;
+}
+
+
+int storage_query_order(const char *table, const char *predicates, const char *order, char **keys, const int max_keys, void *conn)
+{
+    char check[MAX_CONFIG_LINE_LEN], trash[MAX_CONFIG_LINE_LEN];
+    char column[MAX_CONFIG_LINE_LEN] = {0}, direction[MAX_CONFIG_LINE_LEN] = "ASC";
+    char temp_table[MAX_TABLE_LEN] = {0};
+    char temp_keys[MAX_SCAN_KEYS * (MAX_KEY_LEN + 2) + 1] = {0};
+    char buf[MAX_CMD_LEN] = {0};
+    int fields, num_keys;
+    
+    // Connection is really just a socket file descriptor.
+    int sock = (int)(intptr_t)conn;
+    
+    if(table == NULL || sscanf(table, "%[a-zA-Z0-9] %s", check, trash) != 1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_order: Incorrect table entered: %s\n", table);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(order == NULL || strlen(order) >= MAX_CONFIG_LINE_LEN || (fields = sscanf(order, "%s %s %s", column, direction, trash)) < 1
+            || fields > 2 || strlen(column) >= MAX_COLNAME_LEN || sscanf(column, "%[a-zA-Z0-9] %s", check, trash) != 1
+            || (strcmp(direction, "ASC") != 0 && strcmp(direction, "DESC") != 0))
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_order: Incorrect order entered\n");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(max_keys < 0 || max_keys > MAX_SCAN_KEYS || (max_keys > 0 && keys == NULL))
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_order: Invalid max keys/keys array combination\n");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(predicates == NULL || strlen(predicates) > MAX_CMD_LEN - MAX_TABLE_LEN - 2 * MAX_COLNAME_LEN - 24 || check_predicates(predicates) == false)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_order: Incorrect predicates entered\n");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(check_conn("storage_query_order", conn) == false)
+        return -1;
+    
+    sprintf(buf, "QUERY_ORDER #%s #%d #%s #%s #%s\n", table, max_keys, column, direction, predicates);
+    
+    if(sendall(sock, buf, strlen(buf)) != 0 || recvline(sock, buf, sizeof buf) != 0)
+    {
+        errno = ERR_UNKNOWN;
+        sprintf(log_buffer, "storage_query_order: Failed to communicate with the server.\n");
+    }
+    else if(sscanf(buf, "QUERY_ORDER #%s #%d #%[^\n]", temp_table, &num_keys, temp_keys) < 2)
+    {
+        errno = ERR_TABLE_NOT_FOUND;
+        sprintf(log_buffer, "storage_query_order: Table not found: %s\n", table);
+    }
+    else if(num_keys < 0)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_query_order: Query rejected by the server: %s\n", order);
+    }
+    else if(num_keys > max_keys)
+    {
+        errno = ERR_UNKNOWN;
+        sprintf(log_buffer, "storage_query_order: The server failed to list the keys.\n");
+    }
+    else
+    {
+        populate_keys(keys, num_keys, temp_keys);
+        return num_keys;
+    }
+    
+    logger(client_log, log_buffer);
+    return -1;
+}
+
+
+int storage_explain(const char *table, const char *predicates, struct storage_record *record, void *conn)
+{
+    char check[MAX_CONFIG_LINE_LEN], trash[MAX_CONFIG_LINE_LEN];
+    char temp_table[MAX_TABLE_LEN] = {0}, temp_value[MAX_VALUE_LEN] = {0};
+    char buf[MAX_CMD_LEN] = {0};
+    int fields;
+    
+    // Connection is really just a socket file descriptor.
+    int sock = (int)(intptr_t)conn;
+    
+    if(table == NULL || sscanf(table, "%[a-zA-Z0-9] %s", check, trash) != 1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_explain: Incorrect table entered: %s\n", table);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(record == NULL || predicates == NULL || strlen(predicates) > MAX_CMD_LEN - MAX_TABLE_LEN - 16 || check_predicates(predicates) == false)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_explain: Incorrect predicates or record entered\n");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(check_conn("storage_explain", conn) == false)
+        return -1;
+    
+    sprintf(buf, "EXPLAIN #%s #%s\n", table, predicates);
+    
+    if(sendall(sock, buf, strlen(buf)) != 0 || recvline(sock, buf, sizeof buf) != 0)
+    {
+        errno = ERR_UNKNOWN;
+        sprintf(log_buffer, "storage_explain: Failed to communicate with the server.\n");
+    }
+    else if((fields = sscanf(buf, "EXPLAIN #%s #%799[^\n]", temp_table, temp_value)) < 1)
+    {
+        errno = ERR_TABLE_NOT_FOUND;
+        sprintf(log_buffer, "storage_explain: Table not found: %s\n", table);
+    }
+    else if(fields == 1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_explain: Predicates rejected by the server: %s\n", predicates);
+    }
+    else
+    {
+        strcpy(record->value, temp_value);
+        return 0;
+    }
+    
+    logger(client_log, log_buffer);
+    return -1;
+}
+
+
+/**
+ * @brief Checks a key bounding a scan.
+ *
+ * @return Returns true if the key is NULL or a single alphanumeric word shorter than MAX_KEY_LEN.
+ */
+static bool check_bound(const char *key)
+{
+    char check[MAX_CONFIG_LINE_LEN], trash[MAX_CONFIG_LINE_LEN];
+    
+    return key == NULL || (strlen(key) < MAX_KEY_LEN && sscanf(key, "%[a-zA-Z0-9] %s", check, trash) == 1);
+}
+
+
+/**
+ * @brief Retrieves the keys of a table in a range, as many SCAN commands as needed.
+ *
+ * Each SCAN reply lists at most MAX_SCAN_KEYS keys, so a larger keys array
+ * is filled by asking again from the last key received.
+ *
+ * @param caller Name of the storage function, for the log.
+ * @return Returns the number of keys retrieved on success, -1 otherwise.
+ */
+static int scan_keys(const char *caller, const char *table, const char *after_key, const char *end_key,
+        const char *prefix, char **keys, const int max_keys, void *conn)
+{
+    char check[MAX_CONFIG_LINE_LEN], trash[MAX_CONFIG_LINE_LEN];
+    char temp_table[MAX_TABLE_LEN] = {0}, last_key[MAX_KEY_LEN] = {0};
+    char temp_keys[MAX_SCAN_KEYS * (MAX_KEY_LEN + 2) + 1];
+    int num_keys = 0, requested, received;
+    
+    // Connection is really just a socket file descriptor.
+    int sock = (int)(intptr_t)conn;
+    char buf[MAX_CMD_LEN] = {0};
+    
+    if(conn == NULL)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "%s: Invalid connection", caller);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(max_keys < 0 || (max_keys > 0 && keys == NULL))
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "%s: Invalid max keys/keys array combination\n", caller);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(table == NULL || sscanf(table, "%[a-zA-Z0-9] %s", check, trash) != 1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "%s: Incorrect table entered: %s\n", caller, table);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(check_bound(after_key) == false || check_bound(end_key) == false || check_bound(prefix) == false)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "%s: Incorrect key bounds entered\n", caller);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(connected == false)
+    {
+        errno = ERR_CONNECTION_FAIL;
+        sprintf(log_buffer, "%s: Not connected to a server\n", caller);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(authenticated == false)
+    {
+        errno = ERR_NOT_AUTHENTICATED;
+        sprintf(log_buffer, "%s: Connected to a server, but not yet authenticated\n", caller);
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    
+    // Always ask at least once, so that a missing table is reported
+    do
+    {
+        requested = max_keys - num_keys < MAX_SCAN_KEYS ? max_keys - num_keys : MAX_SCAN_KEYS;
+        sprintf(buf, "SCAN #%s #%d #%s #%s #%s\n", table, requested, after_key == NULL ? "*" : after_key,
+                end_key == NULL ? "*" : end_key, prefix == NULL ? "*" : prefix);
+        temp_keys[0] = 0;
+        
+        if(sendall(sock, buf, strlen(buf)) != 0 || recvline(sock, buf, sizeof buf) != 0)
+        {
+            errno = ERR_UNKNOWN;
+            sprintf(log_buffer, "%s: Failed to communicate with the server.\n", caller);
+            logger(client_log, log_buffer);
+            return -1;
+        }
+        else if(sscanf(buf, "SCAN #%s #%d #%[^\n]", temp_table, &received, temp_keys) < 2)
+        {
+            errno = ERR_TABLE_NOT_FOUND;
+            sprintf(log_buffer, "%s: Table not found: %s\n", caller, table);
+            logger(client_log, log_buffer);
+            return -1;
+        }
+        else if(received < 0 || received > requested)
+        {
+            errno = ERR_UNKNOWN;
+            sprintf(log_buffer, "%s: The server failed to list the keys.\n", caller);
+            logger(client_log, log_buffer);
+            return -1;
+        }
+        
+        populate_keys(keys + num_keys, received, temp_keys);
+        num_keys += received;
+        
+        // The next request continues after the last key received
+        if(received > 0)
+        {
+            strcpy(last_key, keys[num_keys - 1]);
+            after_key = last_key;
+        }
+    }
+    while(received == requested && num_keys < max_keys);
+    
+    return num_keys;
+}
+
+
+int storage_scan(const char *table, const char *after_key, const char *end_key, char **keys, const int max_keys, void *conn)
+{
+    return scan_keys("storage_scan", table, after_key, end_key, NULL, keys, max_keys, conn);
+}
+
+
+int storage_scan_prefix(const char *table, const char *prefix, const char *after_key, char **keys, const int max_keys, void *conn)
+{
+    if(prefix == NULL)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_scan_prefix: No prefix entered\n");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    
+    return scan_keys("storage_scan_prefix", table, after_key, NULL, prefix, keys, max_keys, conn);
+}
+
+
+int storage_stats(const char *table, struct storage_record *record, void *conn)
+{
+    char check[MAX_CONFIG_LINE_LEN], trash[MAX_CONFIG_LINE_LEN];
+    
+    // Connection is really just a socket file descriptor.
+    int sock = (int)(intptr_t)conn;
+    char temp_table[MAX_TABLE_LEN] = {0}, temp_value[MAX_VALUE_LEN] = {0};
+    
+    // Send some data.
+    char buf[MAX_CMD_LEN] = {0};
+    memset(buf, 0, sizeof buf);
+    sprintf(buf, "STATS #%.19s\n", table);
+    
+    if(conn == NULL || record == NULL)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_stats: Invalid connection");
+        logger(client_log, log_buffer);
+        return -1;
+    }
+    else if(table == NULL || sscanf(table, "%[a-zA-Z0-9] %s", check, trash) != 1)
+    {
+        errno = ERR_INVALID_PARAM;
+        sprintf(log_buffer, "storage_stats: Incorrect table entered: %s\n", table);
+        logger(client_log, log_buffer);
+    }
+    else if(connected == false)
+    {
+        errno = ERR_CONNECTION_FAIL;
+        sprintf(log_buffer, "storage_stats: Not connected to a server\n");
+        logger(client_log, log_buffer);
+    }
+    else if(authenticated == false)
+    {
+        errno = ERR_NOT_AUTHENTICATED;
+        sprintf(log_buffer, "storage_stats: Connected to a server, but not yet authenticated\n");
+        logger(client_log, log_buffer);
+    }
+    else if (sendall(sock, buf, strlen(buf)) == 0 && recvline(sock, buf, sizeof buf) == 0)
+    {
+        if(sscanf(buf, "STATS #%s #%[^\n]", temp_table, temp_value) == 2)
+        {
+            strcpy(record->value, temp_value);
+            return 0;
+        }
+        
+        errno = ERR_TABLE_NOT_FOUND;
+        sprintf(log_buffer, "storage_stats: Table not found: %s\n", table);
+        logger(client_log, log_buffer);
+    }
+    else
+    {
+        errno = ERR_UNKNOWN;
+        sprintf(log_buffer, "storage_stats: Failed to communicate with the server.\n");
+        logger(client_log, log_buffer);
+    }
+    
+    return -1;
+}
+
+
 /**
  * @brief This is just a minimal stub implementation.  You should modify it
  * according to your design.
@@ -145,13 +145,276 @@ int storage_set(const char *table, const char *key, struct storage_record
  * ERR_KEY_NOT_FOUND, ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
  *
  * Each predicate consists of a column name, an operator, and a value, each
- * separated by optional whitespace. The operator may be a "=" for string
- * types, or one of "<, >, =" for int and float types. An example of query
- * predicates is "name = bob, mark > 90".
+ * separated by optional whitespace. The operator may be one of "<, >, ="
+ * for any type, or "^=" for string types, which matches the strings
+ * starting with the value. Strings are compared byte by byte. An example
+ * of query predicates is "name ^= bo, mark > 90".
+ *
+ * A predicate may instead list the values a column may hold, as
+ * "name IN (bob, alice)", or join equalities and lists on the same column
+ * with " OR ", as "name = bob OR name = alice". The commas of a list do
+ * not separate predicates. An example is "name IN (bob, alice), mark > 90".
+ * An " OR " not followed by "name =" or "name IN (" is part of a string,
+ * so "name = bob OR alice" is an equality with "bob OR alice".
+ *
+ * At most 256 keys are copied, as many as one reply of the server holds,
+ * even if max_keys is larger. All the matching keys are listed by a
+ * cursor, see storage_query_cursor().
  */
 int storage_query(const char *table, const char *predicates, char **keys, 
 		const int max_keys, void *conn);
 
+/**
+ * @brief Open a cursor over the keys of a table whose records match predicates.
+ *
+ * @param table A table in the database.
+ * @param predicates A comma separated list of predicates, as for
+ * storage_query().
+ * @param conn A connection to the server.
+ * @return Return the id of the cursor, a positive number, if successful,
+ * and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, ERR_TABLE_NOT_FOUND, 
+ * ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN if the server has too many
+ * cursors open.
+ *
+ * The keys are then retrieved with storage_query_next(), in insertion
+ * order, and the cursor closed with storage_query_close(). The server
+ * keeps the position of the cursor rather than its matches, so a cursor
+ * costs the same whatever the number of keys. Records that exist from the
+ * opening of the cursor to its end are listed exactly once, while records
+ * set or deleted meanwhile may or may not be. Cursors belong to their
+ * connection, and are closed with it.
+ */
+int storage_query_cursor(const char *table, const char *predicates, void *conn);
+
+/**
+ * @brief Retrieve the next matching keys of a query cursor.
+ *
+ * @param cursor A cursor returned by storage_query_cursor().
+ * @param keys An array of strings where the keys are copied.  The array
+ * must have room for at least max_keys elements.  The caller must allocate
+ * memory for this array.
+ * @param max_keys The size of the keys array.
+ * @param conn The connection the cursor was opened on.
+ * @return Return the number of keys retrieved, at most max_keys, if
+ * successful, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM (also for an unknown or closed cursor), 
+ * ERR_CONNECTION_FAIL, ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
+ *
+ * Fewer than max_keys keys are retrieved only once the cursor reached the
+ * end of the table.
+ */
+int storage_query_next(int cursor, char **keys, const int max_keys, void *conn);
+
+/**
+ * @brief Retrieve the next matching records of a query cursor, with their values.
+ *
+ * @param cursor A cursor returned by storage_query_cursor().
+ * @param columns The columns of the values, separated by commas, or NULL
+ * or "" for all the columns of the table.
+ * @param keys An array of strings where the keys are copied.  The array
+ * must have room for at least max_records elements.  The caller must
+ * allocate memory for this array.
+ * @param records An array where the values and metadata are copied, with
+ * room for at least max_records records.
+ * @param max_records The size of the keys and records arrays.
+ * @param conn The connection the cursor was opened on.
+ * @return Return the number of records retrieved, at most max_records, if
+ * successful, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM (also for an unknown or closed cursor, or an unknown
+ * column), ERR_CONNECTION_FAIL, ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
+ *
+ * This saves a storage_get() per key listed by storage_query_next(): the
+ * server reads the values from the rows it matched, and sends as many
+ * records per reply as fit. A value holds the columns asked for, in that
+ * order, as "name value" pairs separated by commas like a value from
+ * storage_get(), and its metadata may be given to a conditional
+ * storage_set(). Fewer than max_records records are retrieved only once
+ * the cursor reached the end of the table.
+ */
+int storage_query_fetch(int cursor, const char *columns, char **keys, struct storage_record *records, const int max_records, void *conn);
+
+/**
+ * @brief Close a query cursor.
+ *
+ * @param cursor A cursor returned by storage_query_cursor().
+ * @param conn The connection the cursor was opened on.
+ * @return Return 0 if successful, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM (also for an unknown or closed cursor), 
+ * ERR_CONNECTION_FAIL, ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
+ */
+int storage_query_close(int cursor, void *conn);
+
+/**
+ * @brief Aggregate an int column over the records of a table matching predicates.
+ *
+ * @param table A table in the database.
+ * @param function One of "COUNT", "SUM", "MIN", "MAX" or "AVG".
+ * @param column An int column of the table.
+ * @param predicates A comma separated list of predicates, as for
+ * storage_query(), or "" to aggregate every record.
+ * @param result Where the aggregate is stored, 0 if no record matches.
+ * @param conn A connection to the server.
+ * @return Return the number of matching records if successful, and -1
+ * otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM (also for an unknown function or a column that is
+ * not an int column), ERR_CONNECTION_FAIL, ERR_TABLE_NOT_FOUND, 
+ * ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
+ *
+ * The aggregate is computed by the server in one pass over the matching
+ * records, or from the column indexes when they hold the answer, so no
+ * key or value crosses the connection. Sums are exact up to 2^53.
+ */
+int storage_aggregate(const char *table, const char *function, const char *column, const char *predicates,
+		double *result, void *conn);
+
+/**
+ * @brief Query the first records of a table matching predicates, in the order of a column.
+ *
+ * @param table A table in the database.
+ * @param predicates A comma separated list of predicates, as for
+ * storage_query(), or "" to order every record.
+ * @param order The column the records are ordered by, followed by ASC or
+ * DESC, ASC if omitted, e.g. "price DESC".
+ * @param keys An array of strings where the keys are copied in order.
+ * The array must have room for at least max_keys elements.  The caller
+ * must allocate memory for this array.
+ * @param max_keys The size of the keys array, at most 256.
+ * @param conn A connection to the server.
+ * @return Return the number of keys retrieved, at most max_keys, if
+ * successful, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM (also for an unknown column or direction), 
+ * ERR_CONNECTION_FAIL, ERR_TABLE_NOT_FOUND, ERR_NOT_AUTHENTICATED, or 
+ * ERR_UNKNOWN.
+ *
+ * Int columns are ordered by value and string columns by their bytes.
+ * The server keeps only max_keys records as it runs the query, or walks
+ * the index of the column when one exists, rather than sorting every
+ * match. Records sharing a value are retrieved in no particular order.
+ */
+int storage_query_order(const char *table, const char *predicates, const char *order, char **keys,
+		const int max_keys, void *conn);
+
+/**
+ * @brief Explain how the server runs a query, and count its matching records.
+ *
+ * @param table A table in the database.
+ * @param predicates A comma separated list of predicates, as for
+ * storage_query().
+ * @param record A pointer to a record structure whose value receives the
+ * plan of the query.
+ * @param conn A connection to the server.
+ * @return Return 0 if successful, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, ERR_TABLE_NOT_FOUND, 
+ * ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
+ *
+ * The plan is stored in the record value as comma separated "name value"
+ * pairs: how the records are reached (access, "scan" or "index" followed
+ * by the column whose index drives the query), the number of matching
+ * records estimated from the column statistics of the table
+ * (estimatedRows) and counted by running the query (actualRows), the
+ * predicates in the order the server tests them (order) and the records
+ * each is estimated to match alone (estimates), both separated by
+ * semicolons, e.g. "access scan,estimatedRows 4,actualRows 5,order
+ * name=bob;age>20,estimates 40;300".
+ */
+int storage_explain(const char *table, const char *predicates, struct storage_record *record, void *conn);
+
+/**
+ * @brief Retrieve the keys of a table in a range, in ascending order.
+ *
+ * @param table A table in the database.
+ * @param after_key Only keys greater than this one are retrieved, or NULL
+ * to start from the first key.
+ * @param end_key Only keys less than this one are retrieved, or NULL to
+ * continue up to the last key.
+ * @param keys An array of strings where the keys are copied.  The array
+ * must have room for at least max_keys elements.  The caller must allocate
+ * memory for this array.
+ * @param max_keys The size of the keys array.
+ * @param conn A connection to the server.
+ * @return Return the number of keys retrieved, at most max_keys, if
+ * successful, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, ERR_TABLE_NOT_FOUND, 
+ * ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
+ *
+ * Fewer than max_keys keys are retrieved only once the end of the range is
+ * reached, so a whole range is paged through by passing the last key
+ * retrieved as the after_key of the next call. Tables declared with the
+ * "keys=ordered" option answer without visiting the keys outside the
+ * range.
+ */
+int storage_scan(const char *table, const char *after_key, const char *end_key,
+		char **keys, const int max_keys, void *conn);
+
+/**
+ * @brief Retrieve the keys of a table starting with a prefix, in ascending order.
+ *
+ * @param table A table in the database.
+ * @param prefix The prefix of the keys to retrieve.
+ * @param after_key Only keys greater than this one are retrieved, or NULL
+ * to start from the first key with the prefix.
+ * @param keys An array of strings where the keys are copied.  The array
+ * must have room for at least max_keys elements.  The caller must allocate
+ * memory for this array.
+ * @param max_keys The size of the keys array.
+ * @param conn A connection to the server.
+ * @return Return the number of keys retrieved, at most max_keys, if
+ * successful, and -1 otherwise.
+ *
+ * On error, errno will be set as for storage_scan(), and the keys are
+ * paged through in the same way.
+ */
+int storage_scan_prefix(const char *table, const char *prefix, const char *after_key,
+		char **keys, const int max_keys, void *conn);
+
+/**
+ * @brief Retrieve statistics of a table from the server.
+ *
+ * @param table A table in the database.
+ * @param record A pointer to a record structure whose value receives the
+ * statistics.
+ * @param conn A connection to the server.
+ * @return Return 0 if successful, and -1 otherwise.
+ *
+ * On error, errno will be set to one of the following, as appropriate: 
+ * ERR_INVALID_PARAM, ERR_CONNECTION_FAIL, ERR_TABLE_NOT_FOUND, 
+ * ERR_NOT_AUTHENTICATED, or ERR_UNKNOWN.
+ *
+ * The statistics are stored in the record value as comma separated
+ * "name number" pairs, e.g. "keys 12,slots 64,slabs 1,fragmentation 83".
+ * They include the memory held by the records of the table (slabs,
+ * objects, slabBytes, liveBytes), the percentage of that memory not
+ * used by live records (fragmentation), the column arrays of a table
+ * stored by columns (columnBytes) and the ordered key index and column
+ * indexes of a table declared with "keys=ordered" or "index=<column>"
+ * (indexBytes), and how often queries found their compiled predicates in
+ * the plan cache of the table (planHits, planMisses and the percentage
+ * planHitRate), and how often storage_query() replies came from the result
+ * cache of the table (resultHits, resultMisses) or were dropped from it
+ * (resultEvictions), how many times the query planner sampled the
+ * table to estimate the selectivity of predicates (statsSamples), and how
+ * many blocks of rows scans compared (blocksRead) or skipped as the bounds
+ * of their int columns ruled out every match (blocksSkipped).
+ */
+int storage_stats(const char *table, struct storage_record *record, void *conn);
+
 /**
  * @brief Close the connection to the server.
  *
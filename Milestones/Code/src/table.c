@@ -0,0 +1,1148 @@
+/**
+ * @file
+ * @brief This file implements the in-memory tables used by the storage
+ * server as declared in table.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "table.h"
+#include "hash.h"
+
+
+/**
+ * @brief Returns the 7-bit tag of a hash stored in the control bytes.
+ */
+static inline int8_t hash_tag(uint64_t hash)
+{
+    return (int8_t) (hash & 0x7f);
+}
+
+
+/**
+ * @brief Returns the group where probing for a hash starts.
+ */
+static inline int hash_group(uint64_t hash, int num_groups)
+{
+    return (int) ((hash >> 7) & (num_groups - 1));
+}
+
+
+/**
+ * @brief Finds the slots of a group whose control byte equals a value.
+ *
+ * @param ctrl The control bytes of the group.
+ * @param value The control byte to look for.
+ * @return Returns a bit mask with bit i set if slot i matches.
+ */
+static inline unsigned int group_match(const int8_t* ctrl, int8_t value)
+{
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i*) ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+    unsigned int i, mask = 0;
+    for(i = 0; i < GROUP_WIDTH; i++)
+        if(ctrl[i] == value)
+            mask |= 1u << i;
+    return mask;
+#endif
+}
+
+
+/**
+ * @brief Finds the slots of a group not holding a record.
+ *
+ * Empty and deleted control bytes are the only negative ones.
+ *
+ * @return Returns a bit mask with bit i set if slot i is free.
+ */
+static inline unsigned int group_match_free(const int8_t* ctrl)
+{
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) ctrl));
+#else
+    unsigned int i, mask = 0;
+    for(i = 0; i < GROUP_WIDTH; i++)
+        if(ctrl[i] < 0)
+            mask |= 1u << i;
+    return mask;
+#endif
+}
+
+
+/**
+ * @brief Computes the number of slots needed to hold some records below
+ * the maximum load factor.
+ *
+ * @param num_records Number of records the slots must hold.
+ * @return Returns a power of two no less than MIN_TABLE_CAPACITY.
+ */
+static int capacity_for(int num_records)
+{
+    int capacity = MIN_TABLE_CAPACITY;
+
+    // Keep the load factor below 7/8, compared in 64 bits as num_records * 8 may not fit in an int
+    while(capacity < INT_MAX / 2 && (int64_t) num_records * 8 >= (int64_t) capacity * 7)
+        capacity *= 2;
+
+    return capacity;
+}
+
+
+/**
+ * @brief Allocates empty slots.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int array_alloc(struct slot_array* array, int capacity)
+{
+    array->ctrl = (int8_t*) malloc(capacity);
+    array->slots = (int32_t*) malloc(capacity * sizeof(int32_t));
+    array->capacity = capacity;
+    array->used = 0;
+    array->deleted = 0;
+
+    if(array->ctrl == NULL || array->slots == NULL)
+    {
+        free(array->ctrl);
+        free(array->slots);
+        memset(array, 0, sizeof *array);
+        return -1;
+    }
+
+    memset(array->ctrl, CTRL_EMPTY, capacity);
+
+    return 0;
+}
+
+
+/**
+ * @brief Frees the slots of an array, but not their records.
+ */
+static void array_free(struct slot_array* array)
+{
+    free(array->ctrl);
+    free(array->slots);
+    memset(array, 0, sizeof *array);
+}
+
+
+/**
+ * @brief Checks whether an entry holds a key.
+ */
+static inline bool entry_matches(const struct entry* entry, const char* key, uint32_t key_len, uint64_t hash)
+{
+    return entry->hash == hash && entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0;
+}
+
+
+/**
+ * @brief Finds the slot holding a key.
+ *
+ * @param table The table owning the array, whose probe count is updated.
+ * @param array The array to search.
+ * @param key The key to find.
+ * @param key_len The length of the key.
+ * @param hash The hash of the key.
+ * @return Returns the slot index on success, -1 otherwise.
+ */
+static int array_lookup(struct hash_table* table, const struct slot_array* array, const char* key, uint32_t key_len, uint64_t hash)
+{
+    int num_groups = array->capacity / GROUP_WIDTH;
+    int group = hash_group(hash, num_groups);
+    int8_t tag = hash_tag(hash);
+    int step;
+
+    for(step = 0; step < num_groups; step++)
+    {
+        const int8_t* ctrl = array->ctrl + group * GROUP_WIDTH;
+        unsigned int match = group_match(ctrl, tag);
+
+        table->probes++;
+
+        // Only slots with the same tag are worth checking against their entry
+        while(match != 0)
+        {
+            int slot = group * GROUP_WIDTH + __builtin_ctz(match);
+
+            if(entry_matches(&table->entries[array->slots[slot]], key, key_len, hash))
+                return slot;
+            match &= match - 1;
+        }
+
+        // No record was ever pushed past a group with an empty slot
+        if(group_match(ctrl, CTRL_EMPTY) != 0)
+            return -1;
+
+        group = (group + step + 1) & (num_groups - 1);
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief Stores an entry offset in the first free slot of its probe sequence.
+ *
+ * The array must have at least one free slot.
+ */
+static void array_put(struct slot_array* array, int32_t entry, uint64_t hash)
+{
+    int num_groups = array->capacity / GROUP_WIDTH;
+    int group = hash_group(hash, num_groups);
+    unsigned int free_slots;
+    int step = 0;
+
+    while((free_slots = group_match_free(array->ctrl + group * GROUP_WIDTH)) == 0)
+        group = (group + ++step) & (num_groups - 1);
+
+    int slot = group * GROUP_WIDTH + __builtin_ctz(free_slots);
+
+    if(array->ctrl[slot] == CTRL_DELETED)
+        array->deleted--;
+
+    array->ctrl[slot] = hash_tag(hash);
+    array->slots[slot] = entry;
+    array->used++;
+}
+
+
+/**
+ * @brief Frees the slot of a deleted or migrated record.
+ *
+ * The slot can go back to empty if its group still has an empty slot,
+ * since no probe sequence ever continued past such a group.
+ */
+static void array_erase(struct slot_array* array, int slot)
+{
+    const int8_t* group = array->ctrl + (slot & ~(GROUP_WIDTH - 1));
+
+    if(group_match(group, CTRL_EMPTY) != 0)
+        array->ctrl[slot] = CTRL_EMPTY;
+    else
+    {
+        array->ctrl[slot] = CTRL_DELETED;
+        array->deleted++;
+    }
+
+    array->used--;
+}
+
+
+/**
+ * @brief Returns the array new records are added to.
+ */
+static struct slot_array* newest_array(struct hash_table* table)
+{
+    return table->rehash_index < 0 ? &table->arrays[0] : &table->arrays[1];
+}
+
+
+/**
+ * @brief Migrates some slots of the old array while a resize is in progress.
+ *
+ * Migrated slots are erased like deleted ones, so that records further
+ * along their probe sequences can still be found in the old array.
+ *
+ * @param table The table being resized.
+ * @param steps Maximum number of old slots to visit.
+ */
+static void rehash_step(struct hash_table* table, int steps)
+{
+    struct slot_array* old = &table->arrays[0];
+
+    while(table->rehash_index >= 0 && steps-- > 0)
+    {
+        int slot = table->rehash_index;
+
+        if(old->ctrl[slot] >= 0)
+        {
+            int32_t entry = old->slots[slot];
+            array_put(&table->arrays[1], entry, table->entries[entry].hash);
+            array_erase(old, slot);
+        }
+
+        // Old array fully drained, so the new one takes its place
+        if(++table->rehash_index == old->capacity)
+        {
+            array_free(old);
+            table->arrays[0] = table->arrays[1];
+            memset(&table->arrays[1], 0, sizeof table->arrays[1]);
+            table->rehash_index = -1;
+        }
+    }
+}
+
+
+/**
+ * @brief Starts migrating the slots of a table to an array of a new size.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int start_resize(struct hash_table* table, int capacity)
+{
+    // Never two resizes at once, so finish the current one first
+    rehash_step(table, INT_MAX);
+
+    if(array_alloc(&table->arrays[1], capacity) != 0)
+        return -1;
+
+    table->rehash_index = 0;
+
+    return 0;
+}
+
+
+/**
+ * @brief Resizes the table if the newest array is too full or too empty.
+ *
+ * Growing happens at a load factor of 7/8 (counting deleted slots), while
+ * shrinking happens at 1/8. Since every operation migrates REHASH_STEP old
+ * slots, the old array is drained well before the new one fills up.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int maybe_resize(struct hash_table* table)
+{
+    struct slot_array* array = newest_array(table);
+
+    if((array->used + array->deleted + 1) * 8 > array->capacity * 7)
+    {
+        // Mostly deleted slots are cleaned up without growing
+        if(array->used * 2 >= array->capacity)
+            return start_resize(table, array->capacity * 2);
+        else
+            return start_resize(table, array->capacity);
+    }
+    else if(table->rehash_index < 0 && array->used * 8 < array->capacity && array->capacity > table->min_capacity)
+        return start_resize(table, array->capacity / 2);
+
+    return 0;
+}
+
+
+/**
+ * @brief Finds the array and slot holding a key.
+ *
+ * @return Returns the slot index and sets array on success, -1 otherwise.
+ */
+static int table_lookup(struct hash_table* table, const char* key, struct slot_array** array)
+{
+    size_t key_len = strlen(key);
+    uint64_t hash = hash_bytes(key, key_len);
+    int i, slot;
+
+    // Longer keys are never stored
+    if(key_len >= MAX_KEY_LEN)
+        return -1;
+
+    rehash_step(table, REHASH_STEP);
+
+    // A record is in exactly one of the arrays while resizing
+    for(i = 0; i < 2 && table->arrays[i].ctrl != NULL; i++)
+        if((slot = array_lookup(table, &table->arrays[i], key, key_len, hash)) >= 0)
+        {
+            *array = &table->arrays[i];
+            return slot;
+        }
+
+    return -1;
+}
+
+
+/**
+ * @brief Reallocates the entries of a table, and its columns if stored by columns.
+ *
+ * Failing to shrink an array keeps it at its larger size, so shrinking
+ * always succeeds. The zone map only ever grows.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int entries_resize(struct hash_table* table, int capacity)
+{
+    struct column_store* store = table->columns;
+    void* resized;
+    int i;
+
+    // Arrays grown before a failure stay valid, only larger than needed
+    if((resized = realloc(table->entries, capacity * sizeof(struct entry))) != NULL)
+        table->entries = (struct entry*) resized;
+    else if(capacity > table->entries_capacity)
+        return -1;
+
+    for(i = 0; store != NULL && i < table->schema->num_columns; i++)
+    {
+        if((resized = realloc(store->columns[i], (size_t) capacity * store->widths[i])) != NULL)
+            store->columns[i] = (char*) resized;
+        else if(capacity > table->entries_capacity)
+            return -1;
+    }
+
+    if(zone_map_reserve(table->zones, capacity) != 0)
+        return -1;
+
+    table->entries_capacity = capacity;
+
+    return 0;
+}
+
+
+/**
+ * @brief Widens the zone of a row to its int values, and to its codes if the table is stored by columns.
+ *
+ * @param value The value of the row, in the format of row.h.
+ */
+static void zones_widen(struct hash_table* table, int row, const char* value)
+{
+    int i;
+
+    zone_map_widen(table->zones, &table->layout, row, value);
+    for(i = 0; table->columns != NULL && i < table->schema->num_columns; i++)
+        if(table->columns->dictionaries[i] != NULL)
+            zone_map_widen_code(table->zones, i, row, ((int32_t*) table->columns->columns[i])[row]);
+}
+
+
+/**
+ * @brief Removes the holes left in the entries of a table by deleted records.
+ *
+ * Entries keep their order, so the slots of the index are rewritten with
+ * the new offsets instead of rehashing any key, and open cursors moved to
+ * the new offset of their entry. The zone map is rebuilt from the rows
+ * left. A table holding few entries for its capacity is also shrunk.
+ */
+static void entries_compact(struct hash_table* table)
+{
+    struct column_store* store = table->columns;
+    struct table_cursor* cursor;
+    int32_t* moved_to = (int32_t*) malloc(table->num_entries * sizeof(int32_t));
+    char buf[MAX_VALUE_LEN];
+    int i, j, live = 0;
+
+    // Without memory for the new offsets, the holes stay until the next try
+    if(moved_to == NULL)
+        return;
+
+    // A hole maps to the offset of the next live entry, where a cursor on the hole goes
+    for(i = 0; i < table->num_entries; i++)
+    {
+        struct record* record = table->entries[i].record;
+
+        moved_to[i] = live;
+        if(record == NULL)
+            continue;
+
+        if(i != live)
+        {
+            table->entries[live] = table->entries[i];
+
+            if(store != NULL)
+                for(j = 0; j < table->schema->num_columns; j++)
+                    memcpy(store->columns[j] + (size_t) live * store->widths[j], store->columns[j] + (size_t) i * store->widths[j], store->widths[j]);
+            record->row = live;
+        }
+        live++;
+    }
+
+    // Both arrays index entries while a resize is in progress
+    for(i = 0; i < 2; i++)
+    {
+        struct slot_array* array = &table->arrays[i];
+
+        for(j = 0; j < array->capacity; j++)
+            if(array->ctrl[j] >= 0)
+                array->slots[j] = moved_to[array->slots[j]];
+    }
+
+    for(cursor = table->cursors; cursor != NULL; cursor = cursor->next)
+        cursor->entry = cursor->entry < table->num_entries ? moved_to[cursor->entry] : live;
+
+    free(moved_to);
+    table->num_entries = live;
+
+    // Rows moved to other zones, whose bounds are recomputed as tight as the rows left allow
+    zone_map_clear(table->zones, 0, live);
+    for(i = 0; i < live; i++)
+        if(store != NULL || table->entries[i].record->value_len == table->layout.size)
+            zones_widen(table, i, table_get_row(table, table->entries[i].record, buf));
+
+    if(table->entries_capacity > table->min_capacity && live * 4 <= table->entries_capacity)
+        entries_resize(table, table->entries_capacity / 2);
+}
+
+
+/**
+ * @brief Makes room for one more entry at the end of the entries.
+ *
+ * Full entries are compacted rather than grown if a quarter of them are holes.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int entries_reserve(struct hash_table* table)
+{
+    if(table->num_entries < table->entries_capacity)
+        return 0;
+
+    if((table->num_entries - table->num_keys) * 4 >= table->num_entries)
+    {
+        entries_compact(table);
+        if(table->num_entries < table->entries_capacity)
+            return 0;
+    }
+
+    return entries_resize(table, table->entries_capacity == 0 ? table->min_capacity : table->entries_capacity * 2);
+}
+
+
+/**
+ * @brief Frees the column arrays of a table, but not its records.
+ */
+static void columns_free(struct column_store* store)
+{
+    int i;
+
+    for(i = 0; i < MAX_COLUMNS_PER_TABLE; i++)
+    {
+        free(store->columns[i]);
+        if(store->dictionaries[i] != NULL)
+        {
+            dict_destroy(store->dictionaries[i]);
+            free(store->dictionaries[i]);
+        }
+    }
+    free(store);
+}
+
+
+/**
+ * @brief Allocates the empty column arrays of a table stored by columns.
+ *
+ * @return Returns the columns on success, NULL otherwise.
+ */
+static struct column_store* columns_create(const struct table_schema* schema)
+{
+    struct column_store* store = (struct column_store*) calloc(1, sizeof(struct column_store));
+    struct dictionary* dict;
+    int i;
+
+    if(store == NULL)
+        return NULL;
+
+    // A char[n] column holds the codes of its dictionary, as wide as an int column
+    for(i = 0; i < schema->num_columns; i++)
+    {
+        store->widths[i] = sizeof(int32_t);
+        if(schema->data_types[i] == 0)
+            continue;
+
+        if((dict = (struct dictionary*) malloc(sizeof(struct dictionary))) == NULL || dict_init(dict) != 0)
+        {
+            free(dict);
+            columns_free(store);
+            return NULL;
+        }
+        store->dictionaries[i] = dict;
+    }
+
+    return store;
+}
+
+
+/**
+ * @brief Writes a new value to the row of a record of a table stored by columns.
+ *
+ * The char[n] values are all counted in the dictionaries of their columns
+ * before any field is written, so on failure the row keeps its old value.
+ *
+ * @param row The row of the record.
+ * @param value The new value, in the format of row.h.
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int columns_write(struct hash_table* table, int row, const char* value)
+{
+    struct column_store* store = table->columns;
+    unsigned long long reencodes[MAX_COLUMNS_PER_TABLE];
+    int32_t codes[MAX_COLUMNS_PER_TABLE];
+    int i, failed = -1;
+
+    for(i = 0; i < table->schema->num_columns; i++)
+        reencodes[i] = store->dictionaries[i] != NULL ? store->dictionaries[i]->reencodes : 0;
+
+    for(i = 0; failed < 0 && i < table->schema->num_columns; i++)
+        if(store->dictionaries[i] != NULL && dict_encode(store->dictionaries[i], row_string(&table->layout, value, i),
+                (int32_t*) store->columns[i], table->num_entries, &codes[i]) != 0)
+            failed = i;
+
+    // A column given new codes, even by an encoding that failed, has its zones recomputed from them
+    for(i = 0; i < table->schema->num_columns; i++)
+        if(store->dictionaries[i] != NULL && store->dictionaries[i]->reencodes != reencodes[i])
+            zone_map_recode(table->zones, i, (const int32_t*) store->columns[i], table->num_entries);
+
+    if(failed >= 0)
+    {
+        for(i = 0; i < failed; i++)
+            if(store->dictionaries[i] != NULL)
+                dict_release(store->dictionaries[i], codes[i]);
+        return -1;
+    }
+
+    // Encoding may respace the codes of a column, the old code of the row included, so old codes are read afterwards
+    for(i = 0; i < table->schema->num_columns; i++)
+    {
+        if(store->dictionaries[i] == NULL)
+        {
+            memcpy(store->columns[i] + (size_t) row * store->widths[i], value + table->layout.offsets[i], store->widths[i]);
+            continue;
+        }
+
+        dict_release(store->dictionaries[i], ((int32_t*) store->columns[i])[row]);
+        ((int32_t*) store->columns[i])[row] = codes[i];
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Releases the char[n] values of the row of a removed record of a table stored by columns.
+ */
+static void columns_release(struct hash_table* table, int row)
+{
+    struct column_store* store = table->columns;
+    int i;
+
+    for(i = 0; i < table->schema->num_columns; i++)
+        if(store->dictionaries[i] != NULL)
+        {
+            dict_release(store->dictionaries[i], ((int32_t*) store->columns[i])[row]);
+            ((int32_t*) store->columns[i])[row] = DICT_NO_CODE;
+        }
+}
+
+
+/**
+ * @brief Orders the null terminated keys of the ordered key index.
+ */
+static int compare_strings(const void* a, const void* b)
+{
+    return strcmp((const char*) a, (const char*) b);
+}
+
+
+/**
+ * @brief Allocates the empty ordered key index of a table.
+ *
+ * @return Returns the index on success, NULL otherwise.
+ */
+static struct btree* ordered_keys_create()
+{
+    struct btree* tree = (struct btree*) malloc(sizeof(struct btree));
+
+    if(tree != NULL && btree_init(tree, compare_strings) != 0)
+    {
+        free(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+
+/**
+ * @brief Frees the ordered key index of a table.
+ */
+static void ordered_keys_free(struct btree* tree)
+{
+    btree_destroy(tree);
+    free(tree);
+}
+
+
+/**
+ * @brief Frees the column indexes of a table, but not its records.
+ */
+static void indexes_free(struct hash_table* table)
+{
+    int i;
+
+    for(i = 0; i < MAX_COLUMNS_PER_TABLE; i++)
+        if(table->indexes[i] != NULL)
+            index_free(table->indexes[i]);
+}
+
+
+/**
+ * @brief Allocates the empty column indexes declared by the schema of a table.
+ *
+ * @return Returns 0 on success, -1 otherwise.
+ */
+static int indexes_create(struct hash_table* table)
+{
+    int i;
+
+    memset(table->indexes, 0, sizeof table->indexes);
+    table->num_indexes = 0;
+
+    for(i = 0; i < table->schema->num_columns; i++)
+        if(table->schema->indexed[i])
+        {
+            if((table->indexes[i] = index_create(i, table->schema->data_types[i] != 0)) == NULL)
+            {
+                indexes_free(table);
+                return -1;
+            }
+            table->num_indexes++;
+        }
+
+    return 0;
+}
+
+
+/**
+ * @brief Returns the row a record is indexed under, NULL if it has none yet.
+ *
+ * Records of tables stored by rows only get a row once a value of the row size is set.
+ *
+ * @param buf Where the row is copied, at least MAX_VALUE_LEN bytes.
+ */
+static const char* indexed_row(struct hash_table* table, const struct record* record, char* buf)
+{
+    if(table->columns != NULL)
+        return table_get_row(table, record, buf);
+    if(record->value_len != table->layout.size)
+        return NULL;
+
+    // The row is copied, as the value it is read from may be overwritten
+    return memcpy(buf, record_value(record), table->layout.size);
+}
+
+
+/**
+ * @brief Checks whether a record must be indexed under a new value of a column.
+ *
+ * @param old_row The row the record is indexed under, or NULL.
+ * @param new_row The row the record is indexed under next, or NULL.
+ */
+static bool index_changed(const struct hash_table* table, int column, const char* old_row, const char* new_row)
+{
+    if(table->indexes[column] == NULL || new_row == NULL)
+        return false;
+    if(old_row == NULL)
+        return true;
+
+    if(table->schema->data_types[column] == 0)
+        return row_int(&table->layout, old_row, column) != row_int(&table->layout, new_row, column);
+    return strcmp(row_string(&table->layout, old_row, column), row_string(&table->layout, new_row, column)) != 0;
+}
+
+
+/**
+ * @brief Indexes a record under the values of a new row that differ from its old row.
+ *
+ * @return Returns 0 on success, -1 otherwise in which case the indexes are unchanged.
+ */
+static int indexes_add(struct hash_table* table, struct record* record, const char* old_row, const char* new_row)
+{
+    int i;
+
+    for(i = 0; i < table->schema->num_columns; i++)
+        if(index_changed(table, i, old_row, new_row) && index_insert(table->indexes[i], new_row + table->layout.offsets[i], record) != 0)
+        {
+            while(i-- > 0)
+                if(index_changed(table, i, old_row, new_row))
+                    index_remove(table->indexes[i], new_row + table->layout.offsets[i], record);
+            return -1;
+        }
+
+    return 0;
+}
+
+
+/**
+ * @brief Removes a record from the indexes of the values of its old row that differ from its new row.
+ */
+static void indexes_drop(struct hash_table* table, struct record* record, const char* old_row, const char* new_row)
+{
+    int i;
+
+    for(i = 0; i < table->schema->num_columns; i++)
+        if(index_changed(table, i, new_row, old_row))
+            index_remove(table->indexes[i], old_row + table->layout.offsets[i], record);
+}
+
+
+struct hash_table* table_create(struct table_schema* schema)
+{
+    struct hash_table* table = (struct hash_table*) malloc(sizeof(struct hash_table));
+    if(table == NULL)
+        return NULL;
+
+    table->schema = schema;
+    row_layout_init(&table->layout, schema);
+    table->entries = NULL;
+    table->num_entries = 0;
+    table->entries_capacity = 0;
+    table->num_keys = 0;
+    table->probes = 0;
+    table->rehash_index = -1;
+    table->cursors = NULL;
+    table->version = 0;
+    table->stats = NULL;
+    memset(&table->arrays[1], 0, sizeof table->arrays[1]);
+
+    // Pre-size the table if the config file asks for it
+    if(schema->initial_capacity > 0)
+        table->min_capacity = capacity_for(schema->initial_capacity);
+    else
+        table->min_capacity = DEFAULT_TABLE_CAPACITY;
+
+    if(slab_init(&table->records) != 0)
+    {
+        free(table);
+        return NULL;
+    }
+
+    table->columns = NULL;
+    if(schema->layout == TABLE_LAYOUT_COLUMNS && (table->columns = columns_create(schema)) == NULL)
+    {
+        slab_destroy(&table->records);
+        free(table);
+        return NULL;
+    }
+
+    table->ordered_keys = NULL;
+    if(schema->key_order == TABLE_KEYS_ORDERED && (table->ordered_keys = ordered_keys_create()) == NULL)
+    {
+        if(table->columns != NULL)
+            columns_free(table->columns);
+        slab_destroy(&table->records);
+        free(table);
+        return NULL;
+    }
+
+    if(indexes_create(table) != 0)
+    {
+        if(table->ordered_keys != NULL)
+            ordered_keys_free(table->ordered_keys);
+        if(table->columns != NULL)
+            columns_free(table->columns);
+        slab_destroy(&table->records);
+        free(table);
+        return NULL;
+    }
+
+    if((table->zones = zone_map_create(schema, table->columns != NULL)) == NULL)
+    {
+        indexes_free(table);
+        if(table->ordered_keys != NULL)
+            ordered_keys_free(table->ordered_keys);
+        if(table->columns != NULL)
+            columns_free(table->columns);
+        slab_destroy(&table->records);
+        free(table);
+        return NULL;
+    }
+
+    if(array_alloc(&table->arrays[0], table->min_capacity) != 0)
+    {
+        zone_map_destroy(table->zones);
+        indexes_free(table);
+        if(table->ordered_keys != NULL)
+            ordered_keys_free(table->ordered_keys);
+        if(table->columns != NULL)
+            columns_free(table->columns);
+        slab_destroy(&table->records);
+        free(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+
+void table_destroy(struct hash_table* table)
+{
+    // Records all live in the slabs, so they are not freed one at a time
+    array_free(&table->arrays[0]);
+    array_free(&table->arrays[1]);
+    free(table->entries);
+    if(table->columns != NULL)
+        columns_free(table->columns);
+    if(table->ordered_keys != NULL)
+        ordered_keys_free(table->ordered_keys);
+    indexes_free(table);
+    zone_map_destroy(table->zones);
+    free(table->stats);
+    slab_destroy(&table->records);
+
+    free(table);
+}
+
+
+struct record* table_find(struct hash_table* table, const char* key)
+{
+    struct slot_array* array;
+    int slot = table_lookup(table, key, &array);
+
+    return slot < 0 ? NULL : table->entries[array->slots[slot]].record;
+}
+
+
+struct record* table_insert(struct hash_table* table, const char* key)
+{
+    rehash_step(table, REHASH_STEP);
+
+    if(maybe_resize(table) != 0 || entries_reserve(table) != 0)
+        return NULL;
+
+    struct record* record = (struct record*) slab_alloc(&table->records, sizeof(struct record));
+    if(record == NULL)
+        return NULL;
+
+    memset(record, 0, sizeof *record);
+    strncpy(record->key, key, MAX_KEY_LEN - 1);
+
+    if(table->ordered_keys != NULL && btree_insert(table->ordered_keys, record->key) != 0)
+    {
+        slab_free(&table->records, record, sizeof(struct record));
+        return NULL;
+    }
+
+    // The zeroed row of a table stored by columns is indexed right away
+    static const char zero_row[MAX_VALUE_LEN];
+
+    if(table->columns != NULL && table->num_indexes > 0 && indexes_add(table, record, NULL, zero_row) != 0)
+    {
+        if(table->ordered_keys != NULL)
+            btree_remove(table->ordered_keys, record->key);
+        slab_free(&table->records, record, sizeof(struct record));
+        return NULL;
+    }
+
+    // New records are appended to the entries, and take the matching row when stored by columns
+    int i, entry = table->num_entries++;
+
+    // The row only widens the bounds of its zone once its value is set
+    record->row = entry;
+    if(entry % ZONE_ROWS == 0)
+        zone_map_clear(table->zones, entry, entry + 1);
+    if(table->columns != NULL)
+    {
+        struct column_store* store = table->columns;
+
+        for(i = 0; i < table->schema->num_columns; i++)
+            if(store->dictionaries[i] != NULL)
+                ((int32_t*) store->columns[i])[entry] = DICT_NO_CODE;
+            else
+                memset(store->columns[i] + (size_t) entry * store->widths[i], 0, store->widths[i]);
+    }
+
+    table->entries[entry].key_len = strlen(record->key);
+    table->entries[entry].hash = hash_bytes(record->key, table->entries[entry].key_len);
+    memcpy(table->entries[entry].key, record->key, MAX_KEY_LEN);
+    table->entries[entry].record = record;
+    array_put(newest_array(table), entry, table->entries[entry].hash);
+    table->num_keys++;
+    table->version++;
+
+    return record;
+}
+
+
+const char* table_get_row(struct hash_table* table, const struct record* record, char* buf)
+{
+    struct column_store* store = table->columns;
+    int i;
+
+    if(store == NULL)
+        return record_value(record);
+
+    for(i = 0; i < table->schema->num_columns; i++)
+        if(store->dictionaries[i] != NULL)
+            strncpy(buf + table->layout.offsets[i], dict_decode(store->dictionaries[i], ((const int32_t*) store->columns[i])[record->row]),
+                    table->schema->data_types[i]);
+        else
+            memcpy(buf + table->layout.offsets[i], store->columns[i] + (size_t) record->row * store->widths[i], store->widths[i]);
+
+    return buf;
+}
+
+
+int table_set_value(struct hash_table* table, struct record* record, const char* value, size_t length)
+{
+    char* old_value = record->value_len <= RECORD_INLINE_LEN ? NULL : record->data.value;
+    char buf[MAX_VALUE_LEN];
+    const char* old_row = NULL;
+    const char* new_row = length == table->layout.size ? value : NULL;
+
+    if(length >= MAX_VALUE_LEN || (table->columns != NULL && length != table->layout.size))
+        return -1;
+
+    // The record is indexed under its new values first, so it can keep its old value on failure
+    if(table->num_indexes > 0)
+    {
+        old_row = indexed_row(table, record, buf);
+        if(indexes_add(table, record, old_row, new_row) != 0)
+            return -1;
+    }
+
+    // Values of tables stored by columns are scattered to the row of the record
+    if(table->columns != NULL)
+    {
+        if(columns_write(table, record->row, value) != 0)
+        {
+            if(table->num_indexes > 0)
+                indexes_drop(table, record, new_row, old_row);
+            return -1;
+        }
+    }
+    else if(length <= RECORD_INLINE_LEN)
+        memcpy(record->data.inline_value, value, length);
+    else if(old_value != NULL && length == record->value_len)
+    {
+        // Same length, so the value is overwritten in place
+        memcpy(old_value, value, length);
+        old_value = NULL;
+    }
+    else
+    {
+        char* new_value = (char*) slab_alloc(&table->records, length);
+        if(new_value == NULL)
+        {
+            if(table->num_indexes > 0)
+                indexes_drop(table, record, new_row, old_row);
+            return -1;
+        }
+
+        memcpy(new_value, value, length);
+        record->data.value = new_value;
+    }
+
+    if(old_value != NULL)
+        slab_free(&table->records, old_value, record->value_len);
+
+    if(table->columns == NULL)
+        record->value_len = (uint16_t) length;
+
+    if(table->num_indexes > 0)
+        indexes_drop(table, record, old_row, new_row);
+    if(new_row != NULL)
+        zones_widen(table, record->row, new_row);
+    table->version++;
+
+    return 0;
+}
+
+
+int table_remove(struct hash_table* table, const char* key)
+{
+    struct slot_array* array;
+    int slot = table_lookup(table, key, &array);
+
+    if(slot < 0)
+        return -1;
+
+    struct entry* entry = &table->entries[array->slots[slot]];
+    struct record* record = entry->record;
+    char buf[MAX_VALUE_LEN];
+
+    if(table->ordered_keys != NULL)
+        btree_remove(table->ordered_keys, record->key);
+    if(table->num_indexes > 0)
+        indexes_drop(table, record, indexed_row(table, record, buf), NULL);
+
+    // The row of a table stored by columns stays as a hole until compaction
+    if(table->columns != NULL)
+        columns_release(table, record->row);
+    else if(record->value_len > RECORD_INLINE_LEN)
+        slab_free(&table->records, record->data.value, record->value_len);
+    slab_free(&table->records, record, sizeof(struct record));
+    entry->record = NULL;
+    array_erase(array, slot);
+    table->num_keys--;
+    table->version++;
+
+    if((table->num_entries - table->num_keys) * 2 > table->num_entries)
+        entries_compact(table);
+
+    // Failing to shrink leaves a valid, only oversized, table
+    maybe_resize(table);
+
+    return 0;
+}
+
+
+size_t table_column_bytes(const struct hash_table* table)
+{
+    struct column_store* store = table->columns;
+    size_t bytes = 0;
+    int i;
+
+    for(i = 0; store != NULL && i < table->schema->num_columns; i++)
+    {
+        bytes += (size_t) table->entries_capacity * store->widths[i];
+        if(store->dictionaries[i] != NULL)
+            bytes += dict_bytes(store->dictionaries[i]);
+    }
+
+    return bytes;
+}
+
+
+size_t table_index_bytes(const struct hash_table* table)
+{
+    size_t bytes = table->ordered_keys == NULL ? 0 : table->ordered_keys->bytes;
+    int i;
+
+    for(i = 0; i < MAX_COLUMNS_PER_TABLE; i++)
+        if(table->indexes[i] != NULL)
+            bytes += index_bytes(table->indexes[i]);
+
+    return bytes;
+}
+
+
+void table_iterator_init(struct table_iterator* iterator)
+{
+    iterator->entry = 0;
+}
+
+
+struct record* table_next(struct hash_table* table, struct table_iterator* iterator)
+{
+    // Holes left by deleted records are skipped
+    while(iterator->entry < table->num_entries)
+    {
+        struct record* record = table->entries[iterator->entry++].record;
+        if(record != NULL)
+            return record;
+    }
+
+    return NULL;
+}
+
+
+void table_cursor_open(struct hash_table* table, struct table_cursor* cursor)
+{
+    cursor->entry = 0;
+    cursor->next = table->cursors;
+    table->cursors = cursor;
+}
+
+
+void table_cursor_close(struct hash_table* table, struct table_cursor* cursor)
+{
+    struct table_cursor** link;
+
+    for(link = &table->cursors; *link != NULL; link = &(*link)->next)
+        if(*link == cursor)
+        {
+            *link = cursor->next;
+            return;
+        }
+}
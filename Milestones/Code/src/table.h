@@ -0,0 +1,327 @@
+/**
+ * @file
+ * @brief This file declares the in-memory tables used by the storage server.
+ *
+ * Like a Python dict, each table keeps its records in a dense array of
+ * entries in insertion order, and an open addressing hash index whose
+ * slots only hold the offset of an entry. Scans walk the entries
+ * sequentially, while the index stays a few bytes per slot. Deleting a
+ * record leaves a hole in the entries, and the entries are compacted
+ * (keeping their order) once holes make up half of them.
+ *
+ * The index grows and shrinks with its load factor. Resizing is
+ * incremental: a new slot array is allocated and the offsets of the old
+ * one are migrated a few slots at a time by the operations that follow, so
+ * no single command pays for a full rehash.
+ *
+ * Slots are probed in groups of GROUP_WIDTH, as in Abseil's SwissTable.
+ * Each slot has a control byte holding either CTRL_EMPTY, CTRL_DELETED or
+ * the low 7 bits of its key's hash, so a single SSE2 comparison finds the
+ * few slots of a group that may hold a key. Those candidates are checked
+ * against the full 64-bit hash, length and key copied in their entry, and
+ * migrating a slot never rehashes its key.
+ *
+ * Records are allocated from a slab allocator owned by the table, so
+ * dropping a table frees its slabs without visiting each record.
+ *
+ * A table declared with "layout=columns" keeps the values of its records
+ * in one array per column instead, so that a query only streams through
+ * the columns its predicates reference. Row r of the columns is the value
+ * of entry r, and its records only hold their key, metadata and row id.
+ *
+ * A table declared with "keys=ordered" also keeps its keys in a B+tree,
+ * so that keys can be listed in order from any point, and each column
+ * declared with "index=<column>" is indexed (index.h) by another B+tree
+ * for an int column or a hash map for a char[n] column, kept up to date as
+ * values are set and records removed.
+ *
+ * Every table also keeps the bounds of its int columns, and of the codes
+ * of its char[n] columns if stored by columns, over each block of rows in
+ * a zone map (zonemap.h), widened as values are set, so that scans skip
+ * the blocks no row of which can match.
+ */
+
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "utils.h"
+#include "slab.h"
+#include "row.h"
+#include "btree.h"
+#include "index.h"
+#include "zonemap.h"
+#include "dict.h"
+
+#define DEFAULT_TABLE_CAPACITY 64 ///< Slots allocated for a table not sized in the config file.
+#define GROUP_WIDTH 16 ///< Slots whose control bytes are compared at once.
+#define MIN_TABLE_CAPACITY GROUP_WIDTH ///< A table never shrinks below this many slots.
+#define REHASH_STEP 8 ///< Old slots migrated by each operation while a table is being resized.
+
+
+#define RECORD_INLINE_LEN 24 ///< Values of up to this many bytes are stored inside their record.
+
+
+/**
+ * @brief Declaring a record with a specific value and key
+ *
+ * The value of a record is a row in the binary format of row.h. Short
+ * values are stored in the record itself, while longer ones are allocated
+ * separately with their exact length. A record thus costs a small header
+ * plus the length of its value, not MAX_VALUE_LEN bytes.
+ *
+ * Each record also knows the offset of its entry, its row id, which only
+ * changes when the entries are compacted. Queries gather the row ids of
+ * matching records in bitmaps (bitmap.h).
+ */
+struct record {
+    uintptr_t metadata; ///< Version of the record, checked by conditional SETs.
+    uint32_t row; ///< Row id of the record, the offset of its entry, and of its value in a table stored by columns.
+    uint16_t value_len; ///< Length of the value in bytes.
+    char key[MAX_KEY_LEN];
+    union {
+        char inline_value[RECORD_INLINE_LEN];
+        char* value; ///< The value when it does not fit in inline_value.
+    } data;
+};
+
+
+#define CTRL_EMPTY ((int8_t) -128) ///< Control byte of a slot never used since the array was allocated.
+#define CTRL_DELETED ((int8_t) -2) ///< Control byte of a slot whose record was deleted or migrated.
+
+
+/**
+ * @brief A record with a copy of its key, in insertion order.
+ *
+ * Keys are short enough to be copied whole with their length and hash, so
+ * a lookup compares two words and at most MAX_KEY_LEN bytes without ever
+ * reading the record, whether it hits or misses.
+ */
+struct entry {
+    uint64_t hash;
+    uint32_t key_len; ///< Length of the key, without its null terminator.
+    char key[MAX_KEY_LEN];
+    struct record* record; ///< NULL once the record is deleted, until the entries are compacted.
+};
+
+
+/**
+ * @brief An array of entry offsets probed a group at a time.
+ *
+ * Groups are visited in triangular order (group, group + 1, group + 3, ...)
+ * which reaches every group of a power of two sized array. A lookup stops
+ * at the first group holding an empty slot, so deleted slots are marked
+ * CTRL_DELETED unless their group still has an empty slot.
+ */
+struct slot_array {
+    int8_t* ctrl; ///< One control byte per slot.
+    int32_t* slots; ///< Offset in the entries of the record of each used slot.
+    int capacity; ///< Number of slots, a power of two and a multiple of GROUP_WIDTH.
+    int used; ///< Number of slots holding an entry offset.
+    int deleted; ///< Number of CTRL_DELETED slots.
+};
+
+
+/**
+ * @brief The values of a table stored by columns.
+ *
+ * Row r of the table is made of element r of every column, and belongs to
+ * the record of entry r. The columns have as many elements as there are
+ * entries allocated, and are compacted along with the entries. A char[n]
+ * column holds the int32_t codes of its values in the dictionary of the
+ * column (dict.h), DICT_NO_CODE until the value of the record is set and
+ * once it is removed.
+ */
+struct column_store {
+    char* columns[MAX_COLUMNS_PER_TABLE]; ///< Elements of widths[i] bytes for column i.
+    int widths[MAX_COLUMNS_PER_TABLE]; ///< 4 bytes, the codes of a char[n] column included.
+    struct dictionary* dictionaries[MAX_COLUMNS_PER_TABLE]; ///< The dictionary of each char[n] column, NULL for int columns.
+};
+
+
+/**
+ * @brief Declaring a hashtable for storage tables
+ *
+ * While a resize is in progress, arrays[0] is the array being drained and
+ * arrays[1] the array receiving its slots. New records are always indexed
+ * in the newest array.
+ */
+struct hash_table {
+    struct table_schema* schema; ///< The table schema processed from the config file.
+    struct row_layout layout; ///< Layout of the rows stored as record values.
+    struct entry* entries; ///< The records in insertion order, with holes left by deletes.
+    int num_entries; ///< Entries used, including holes.
+    int entries_capacity;
+    struct slot_array arrays[2];
+    int rehash_index; ///< Next slot of arrays[0] to migrate, or -1 when not resizing.
+    int min_capacity; ///< The table does not shrink below its configured capacity.
+    int num_keys; ///< Records in the table, num_entries minus the holes.
+    unsigned long long probes; ///< Groups of slots visited by all key lookups, for statistics.
+    struct slab_allocator records; ///< Allocator of the records of the table.
+    struct column_store* columns; ///< The record values if the table is stored by columns, NULL otherwise.
+    struct btree* ordered_keys; ///< The keys in order if the table has an ordered index, NULL otherwise.
+    struct column_index* indexes[MAX_COLUMNS_PER_TABLE]; ///< The index of each indexed column, NULL for the others.
+    int num_indexes;
+    struct table_cursor* cursors; ///< The open cursors of the table, moved along when the entries are compacted.
+    unsigned long long version; ///< Bumped by every insert, update and removal, so that results read from the table can tell they are stale.
+    struct table_stats* stats; ///< The column statistics of stats.h, NULL until a query is planned.
+    struct zone_map* zones; ///< The bounds of the int and coded columns over each block of rows.
+};
+
+
+/**
+ * @brief Position of an iteration over the records of a table.
+ */
+struct table_iterator {
+    int entry; ///< Next entry to visit.
+};
+
+
+/**
+ * @brief Position of an iteration over the records of a table that lasts across modifications.
+ *
+ * Unlike a table_iterator, a cursor is registered with its table, which
+ * moves it along with the entries when they are compacted. Records present
+ * from the opening of the cursor to its end are thus visited exactly once,
+ * in insertion order, while records added meanwhile are visited as well.
+ */
+struct table_cursor {
+    int entry; ///< Next entry to visit.
+    struct table_cursor* next; ///< The next open cursor of the same table.
+};
+
+
+/**
+ * @brief Allocates an empty table.
+ *
+ * @param schema The schema of the table, which must outlive the table.
+ * @return Returns the table on success, NULL otherwise.
+ */
+struct hash_table* table_create(struct table_schema* schema);
+
+
+/**
+ * @brief Frees a table and all its records.
+ *
+ * @param table The table to free.
+ */
+void table_destroy(struct hash_table* table);
+
+
+/**
+ * @brief Looks up the record stored under a key.
+ *
+ * @param table The table to search.
+ * @param key The key of the record.
+ * @return Returns the record if found, NULL otherwise.
+ */
+struct record* table_find(struct hash_table* table, const char* key);
+
+
+/**
+ * @brief Allocates a new record for a key that is not in the table yet.
+ *
+ * @param table The table where the record is added.
+ * @param key The key of the new record.
+ * @return Returns the record holding the key and an empty value (a zeroed row if the
+ * table is stored by columns) on success, NULL otherwise.
+ */
+struct record* table_insert(struct hash_table* table, const char* key);
+
+
+/**
+ * @brief Returns the value of a record of a table stored by rows.
+ */
+static inline const char* record_value(const struct record* record)
+{
+    return record->value_len <= RECORD_INLINE_LEN ? record->data.inline_value : record->data.value;
+}
+
+
+/**
+ * @brief Returns the row holding the value of a record.
+ *
+ * @param table The table holding the record.
+ * @param record The record.
+ * @param buf Where the row is gathered if the table is stored by columns, layout.size bytes.
+ * @return Returns the row, either stored in the record or in buf.
+ */
+const char* table_get_row(struct hash_table* table, const struct record* record, char* buf);
+
+
+/**
+ * @brief Replaces the value of a record.
+ *
+ * @param table The table holding the record.
+ * @param record The record to modify.
+ * @param value The new value.
+ * @param length Length of the new value in bytes, less than MAX_VALUE_LEN. It must
+ * be the row size of the table if it is stored by columns, and only values of
+ * that size are indexed.
+ * @return Returns 0 on success, -1 otherwise in which case the record keeps its old value.
+ */
+int table_set_value(struct hash_table* table, struct record* record, const char* value, size_t length);
+
+
+/**
+ * @brief Deletes and frees the record stored under a key.
+ *
+ * @param table The table to modify.
+ * @param key The key of the record.
+ * @return Returns 0 on success, -1 if the key does not exist.
+ */
+int table_remove(struct hash_table* table, const char* key);
+
+
+/**
+ * @brief Returns the memory held by the column arrays of a table.
+ *
+ * @return Returns the bytes allocated for the columns and their dictionaries, 0 if the table is stored by rows.
+ */
+size_t table_column_bytes(const struct hash_table* table);
+
+
+/**
+ * @brief Returns the memory held by the indexes of a table besides its hash index.
+ *
+ * @return Returns the bytes allocated for the ordered key index and the column indexes, 0 if the table has none.
+ */
+size_t table_index_bytes(const struct hash_table* table);
+
+
+/**
+ * @brief Starts an iteration over all the records of a table.
+ *
+ * Records are visited in insertion order. The table must not be modified
+ * until the iteration is finished.
+ *
+ * @param iterator The iterator to initialize.
+ */
+void table_iterator_init(struct table_iterator* iterator);
+
+
+/**
+ * @brief Advances an iteration over the records of a table.
+ *
+ * @param table The table being iterated.
+ * @param iterator The iteration position.
+ * @return Returns the next record, or NULL once every record was visited.
+ */
+struct record* table_next(struct hash_table* table, struct table_iterator* iterator);
+
+
+/**
+ * @brief Opens a cursor at the first entry of a table.
+ *
+ * @param table The table to iterate.
+ * @param cursor The cursor, which must stay at the same address until closed.
+ */
+void table_cursor_open(struct hash_table* table, struct table_cursor* cursor);
+
+
+/**
+ * @brief Closes a cursor of a table, which stops moving it.
+ */
+void table_cursor_close(struct hash_table* table, struct table_cursor* cursor);
+
+
+#endif
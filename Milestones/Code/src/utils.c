@@ -13,6 +13,7 @@
 #include <sys/socket.h>
 #include <unistd.h>
 #include "utils.h"
+#include "pool.h"
 
 
 int sendall(const int sock, const char *buf, const size_t len)
@@ -72,6 +73,80 @@ int recvline(const int sock, char *buf, const size_t buflen)
 }
 
 
+/**
+ * @brief Parse the name=value options following the columns of a table.
+ *
+ * The options are "capacity", the number of records to pre-size the table
+ * for, at most MAX_TABLE_CAPACITY, "layout", either "rows" or "columns" for tables mostly queried,
+ * "keys", either "hashed" or "ordered" for tables scanned by key ranges, and
+ * "index", a column to index for queries, which may be repeated. The
+ * columns must be parsed first.
+ */
+int process_table_options(char *options, struct table_schema *schema)
+{
+    char name[MAX_CONFIG_LINE_LEN] = {0};
+    char value[MAX_CONFIG_LINE_LEN] = {0};
+    char trash[MAX_CONFIG_LINE_LEN] = {0};
+    int length, number, i;
+    
+    while(sscanf(options, " %[^= \t\n]=%s%n", name, value, &length) == 2)
+    {
+        if(strcmp(name, "capacity") == 0)
+        {
+            // Checking if capacity already entered or not a positive number within bounds
+            if(schema->initial_capacity != 0 || sscanf(value, "%d%s", &number, trash) != 1 || number < 1 || number > MAX_TABLE_CAPACITY)
+                return 1;
+            schema->initial_capacity = number;
+        }
+        else if(strcmp(name, "layout") == 0)
+        {
+            // Checking if layout already entered
+            if(schema->layout != 0)
+                return 1;
+            else if(strcmp(value, "rows") == 0)
+                schema->layout = TABLE_LAYOUT_ROWS;
+            else if(strcmp(value, "columns") == 0)
+                schema->layout = TABLE_LAYOUT_COLUMNS;
+            else
+                return 1;
+        }
+        else if(strcmp(name, "keys") == 0)
+        {
+            // Checking if key order already entered
+            if(schema->key_order != 0)
+                return 1;
+            else if(strcmp(value, "hashed") == 0)
+                schema->key_order = TABLE_KEYS_HASHED;
+            else if(strcmp(value, "ordered") == 0)
+                schema->key_order = TABLE_KEYS_ORDERED;
+            else
+                return 1;
+        }
+        else if(strcmp(name, "index") == 0)
+        {
+            for(i = 0; i < schema->num_columns; i++)
+                if(strcmp(schema->column_names[i], value) == 0)
+                    break;
+            
+            // Checking if the column exists and is not already indexed
+            if(i == schema->num_columns || schema->indexed[i])
+                return 1;
+            schema->indexed[i] = true;
+        }
+        else
+            return 1;
+        
+        options += length;
+    }
+    
+    // Anything left is not a valid option
+    if(sscanf(options, " %s", trash) == 1)
+        return 1;
+    
+    return 0;
+}
+
+
 /**
  * @brief Parse and process a line in the config file.
  */
@@ -106,6 +181,10 @@ int process_config_line(char *line, struct config_params *params)
                 return 1;
         
         params->table_schemas[params->num_tables].num_columns = 0; // Initialize number of columns for current table
+        params->table_schemas[params->num_tables].initial_capacity = 0;
+        params->table_schemas[params->num_tables].layout = 0;
+        params->table_schemas[params->num_tables].key_order = 0;
+        memset(params->table_schemas[params->num_tables].indexed, 0, sizeof params->table_schemas[params->num_tables].indexed);
         
         // Add to list of table names
         strcpy(params->table_schemas[params->num_tables].table_name, value);
@@ -118,6 +197,17 @@ int process_config_line(char *line, struct config_params *params)
         else if(columns[0] == ',') // First character is a comma
             return 1;
         
+        // Table options (name=value) follow the column list
+        char* options = strchr(columns, '=');
+        if(options != NULL)
+        {
+            while(options > columns && !isspace(options[-1]))
+                options--;
+            if(options == columns) // No column names before the options
+                return 1;
+            options[-1] = 0;
+        }
+        
         cur_column = strtok(columns, ","); // Get tokens from a string delimited with commas
         while (cur_column != NULL)
         {
@@ -153,6 +243,10 @@ int process_config_line(char *line, struct config_params *params)
             cur_column = strtok (NULL, ",");
         }
         
+        // Options are processed once the columns they may name are known
+        if(options != NULL && process_table_options(options, &params->table_schemas[params->num_tables]) != 0)
+            return 1;
+        
         // Increment number of tables
         params->num_tables++;
         
@@ -194,6 +288,14 @@ int process_config_line(char *line, struct config_params *params)
         else
             return 1;
     }
+    else if (strcmp(parameter, "scan_threads") == 0)
+    {
+        // Checking if scan_threads already entered or more threads than the scan pool runs
+        if(params->scan_threads == 0 && atoi(value) >= 1 && atoi(value) <= POOL_MAX_WORKERS + 1)
+            params->scan_threads = atoi(value);
+        else
+            return 1;
+    }
     else if (strcmp(parameter, "concurrency") == 0)
     {
         // Checking if server_password already entered, then invalid config file
@@ -338,28 +440,97 @@ int make_value(char* buf)
 }
 
 
+char* next_predicate(char** rest)
+{
+    char* predicate = *rest + strspn(*rest, ",");
+    char* end;
+    int depth = 0;
+
+    if(*predicate == 0)
+        return NULL;
+
+    for(end = predicate; *end != 0 && (*end != ',' || depth > 0); end++)
+        depth += *end == '(' ? 1 : *end == ')' ? -1 : 0;
+
+    *rest = *end != 0 ? end + 1 : end;
+    *end = 0;
+    return predicate;
+}
+
+
+char* find_alternative(char* predicate, const char* column_name)
+{
+    char name[strlen(predicate) + 1];
+    char* separator;
+    int end;
+
+    for(separator = strstr(predicate, " OR "); separator != NULL; separator = strstr(separator + 1, " OR "))
+    {
+        char* alternative = separator + strlen(" OR ");
+
+        if(sscanf(alternative, " %[a-zA-Z0-9] %n", name, &end) != 1 || strcmp(name, column_name) != 0)
+            continue;
+
+        alternative += end;
+        if(*alternative == '=' || (strncmp(alternative, "IN", 2) == 0 && alternative[2 + strspn(alternative + 2, " ")] == '('))
+            return separator;
+    }
+
+    return NULL;
+}
+
+
 bool check_predicates(const char* check)
 {
     if(check[0] == ',') // First character is a comma
         return false;
     
-    char buf[MAX_VALUE_LEN] = {0};
-    strcpy(buf, check);
-    
-    char column_name[MAX_COLNAME_LEN] = {0};
-    char operator;
-    char str_data[MAX_VALUE_LEN] = {0};
+    // An IN list makes a predicate longer than any value
+    size_t size = strlen(check) + 1;
+    char buf[size], column_name[size], first_column[size], str_data[size], values[size], trash[size];
+    char operator[3];
     int int_data;
+    strcpy(buf, check);
     
-    char trash[MAX_CONFIG_LINE_LEN] = {0};
-    
-    char* cur_pred = strtok(buf, ",");
-    while(cur_pred != NULL)
+    char* rest = buf;
+    char* cur_pred;
+    while((cur_pred = next_predicate(&rest)) != NULL)
     {
-        if(sscanf(cur_pred, " %[a-zA-Z0-9] %1[<=>] %d%s", column_name, &operator, &int_data, trash) != 3)
-            if(sscanf(cur_pred, " %[a-zA-Z0-9] %1[=] %[a-zA-Z0-9 ]%s", column_name, &operator, str_data, trash) != 3)
+        // Alternatives and IN lists only test the equality of a single column with their values
+        first_column[0] = 0;
+        sscanf(cur_pred, " %[a-zA-Z0-9]", first_column);
+        bool membership = find_alternative(cur_pred, first_column) != NULL || strchr(cur_pred, '(') != NULL;
+        char* alternative = cur_pred;
+        char* next;
+        
+        for(; alternative != NULL; alternative = next)
+        {
+            if((next = find_alternative(alternative, first_column)) != NULL)
+            {
+                *next = 0;
+                next += strlen(" OR ");
+            }
+            
+            int end = 0;
+            bool listed = membership && sscanf(alternative, " %[a-zA-Z0-9] IN (%[^)])%n%s", column_name, values, &end, trash) == 2 && end > 0;
+            if(listed)
+            {
+                char* value;
+                for(value = strtok(values, ","); value != NULL; value = strtok(NULL, ","))
+                    if(sscanf(value, " %d%s", &int_data, trash) != 1 && sscanf(value, " %[a-zA-Z0-9 ]%s", str_data, trash) != 1)
+                        return false;
+            }
+            // Strings are also compared with "<", ">" and "^=" for a prefix
+            else if(sscanf(alternative, " %[a-zA-Z0-9] %1[<=>] %d%s", column_name, operator, &int_data, trash) != 3)
+            {
+                if(sscanf(alternative, " %[a-zA-Z0-9] %2[<=>^] %[a-zA-Z0-9 ]%s", column_name, operator, str_data, trash) != 3
+                        || (strcmp(operator, "^=") != 0 && (operator[1] != 0 || operator[0] == '^')))
+                    return false;
+            }
+            
+            if(membership && ((!listed && strcmp(operator, "=") != 0) || strcmp(first_column, column_name) != 0))
                 return false;
-        cur_pred = strtok(NULL, ",");
+        }
     }
     
     return true;
@@ -368,7 +539,7 @@ bool check_predicates(const char* check)
 
 void populate_keys(char** key_array, const int max_keys, const char* protocoled_keys)
 {
-    char buf[max_keys * MAX_KEY_LEN];
+    char buf[max_keys * (MAX_KEY_LEN + 2) + 1]; // Room for the ", " separators
     memset(buf, 0, sizeof buf);
     strcpy(buf, protocoled_keys);
     
@@ -29,6 +29,12 @@ static const char CONFIG_COMMENT_CHAR = '#';
 #define MAX_CMD_LEN (1024 * 8)
 
 
+/**
+ * @brief The max number of keys listed by one SCAN, QUERY or QUERY_NEXT reply, so that it fits in MAX_CMD_LEN.
+ */
+#define MAX_SCAN_KEYS 256
+
+
 /**
  * @brief The max length in bytes of metadata of each record.
  */
@@ -76,9 +82,24 @@ struct table_schema
     /// If entry = 0, it signifies int data type. Otherwise, it signifies the size of the char array (string).
     int data_types[MAX_COLUMNS_PER_TABLE];
     int num_columns;
+    /// Number of records the table is sized for, from the "capacity=N" table option. 0 if not given.
+    int initial_capacity;
+    /// How records are stored, from the "layout=rows|columns" table option. 0 if not given, meaning rows.
+    int layout;
+    /// How keys are indexed, from the "keys=hashed|ordered" table option. 0 if not given, meaning hashed.
+    int key_order;
+    /// Columns indexed for queries, from the "index=<column>" table options.
+    bool indexed[MAX_COLUMNS_PER_TABLE];
 };
 
 
+#define TABLE_LAYOUT_ROWS 1 ///< Each record value is stored as one binary row.
+#define TABLE_LAYOUT_COLUMNS 2 ///< Each column of a table is stored in its own array.
+#define TABLE_KEYS_HASHED 1 ///< Keys are only indexed by the hash table.
+#define TABLE_KEYS_ORDERED 2 ///< Keys are also indexed in order, for range and prefix scans.
+#define MAX_TABLE_CAPACITY (1 << 26) ///< Largest "capacity=N" accepted, whose slots and entries still fit in int offsets.
+
+
 /**
  * @brief A struct to store config parameters.
  */
@@ -103,6 +124,9 @@ struct config_params
     int num_tables;
 
     int concurrency;
+
+    /// The threads a query scan may run on, 0 for one per CPU.
+    int scan_threads;
     
     // The directory where tables are stored.
     //	char data_directory[MAX_PATH_LEN];
@@ -138,6 +162,16 @@ int sendall(const int sock, const char *buf, const size_t len);
 int recvline(const int sock, char *buf, const size_t buflen);
 
 
+/**
+ * @brief Parse and process a line in the config file.
+ *
+ * @param line The line to process, modified by the parsing.
+ * @param params The structure where config parameters are loaded.
+ * @return Return 0 on success, 1 otherwise.
+ */
+int process_config_line(char *line, struct config_params *params);
+
+
 /**
  * @brief Read and load configuration parameters.
  *
@@ -213,9 +247,38 @@ int make_key(char* buf);
 int make_value(char* buf);
 
 
+/**
+ * @brief Splits the next predicate off comma separated predicates, the commas within parentheses excepted.
+ *
+ * As with strtok(), empty predicates are skipped.
+ *
+ * @param rest The predicates left, advanced past the predicate returned.
+ * @return Returns the predicate, terminated in place, or NULL once none is left.
+ */
+char* next_predicate(char** rest);
+
+
+/**
+ * @brief Finds the " OR " starting the next alternative of a predicate on a column.
+ *
+ * As strings may hold " OR ", it only separates alternatives when followed
+ * by "column =" or "column IN (", so "name = bob OR alice" stays an
+ * equality with "bob OR alice".
+ *
+ * @param predicate The predicate, or the alternatives left of it.
+ * @param column_name The column of the first alternative.
+ * @return Returns the " OR " separating the next alternative, or NULL if none is left.
+ */
+char* find_alternative(char* predicate, const char* column_name);
+
+
 /**
  * @brief Checks for proper predicates format in a string.
  *
+ * Besides comparisons, a predicate may be "column IN (value, ...)" or
+ * alternatives separated by " OR ", each an equality or IN list on the
+ * same column.
+ *
  * @param buf String being checked
  * @return Returns true on success, false otherwise.
  */
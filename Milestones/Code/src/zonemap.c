@@ -0,0 +1,124 @@
+/**
+ * @file
+ * @brief This file implements the zone maps declared in zonemap.h.
+ */
+
+#include <stdlib.h>
+#include "zonemap.h"
+
+
+/**
+ * @brief Widens a zone to a value.
+ */
+static void widen(struct zone* zone, int32_t field)
+{
+    if(field < zone->min)
+        zone->min = field;
+    if(field > zone->max)
+        zone->max = field;
+}
+
+
+struct zone_map* zone_map_create(const struct table_schema* schema, bool coded)
+{
+    struct zone_map* map;
+    int i;
+
+    if((map = (struct zone_map*) calloc(1, sizeof(struct zone_map))) == NULL)
+        return NULL;
+
+    // Columns without zones are told apart by a NULL array, so every zoned column gets one from the start, even if the table stays empty
+    for(i = 0; i < schema->num_columns; i++)
+    {
+        map->coded[i] = coded && schema->data_types[i] != 0;
+        if((schema->data_types[i] == 0 || coded) && (map->zones[i] = (struct zone*) malloc(sizeof(struct zone))) == NULL)
+        {
+            zone_map_destroy(map);
+            return NULL;
+        }
+    }
+    map->capacity = 1;
+    zone_map_clear(map, 0, ZONE_ROWS);
+
+    return map;
+}
+
+
+void zone_map_destroy(struct zone_map* map)
+{
+    int i;
+
+    for(i = 0; i < MAX_COLUMNS_PER_TABLE; i++)
+        free(map->zones[i]);
+    free(map);
+}
+
+
+int zone_map_reserve(struct zone_map* map, int rows)
+{
+    int capacity = (rows + ZONE_ROWS - 1) / ZONE_ROWS;
+    struct zone* resized;
+    int i;
+
+    if(capacity <= map->capacity)
+        return 0;
+
+    // Arrays grown before a failure stay valid, only larger than needed
+    for(i = 0; i < MAX_COLUMNS_PER_TABLE; i++)
+    {
+        if(map->zones[i] == NULL)
+            continue;
+        if((resized = (struct zone*) realloc(map->zones[i], capacity * sizeof(struct zone))) == NULL)
+            return -1;
+        map->zones[i] = resized;
+    }
+
+    map->capacity = capacity;
+
+    return 0;
+}
+
+
+void zone_map_clear(struct zone_map* map, int first, int last)
+{
+    int i, zone;
+
+    for(i = 0; i < MAX_COLUMNS_PER_TABLE; i++)
+        for(zone = first / ZONE_ROWS; map->zones[i] != NULL && zone < (last + ZONE_ROWS - 1) / ZONE_ROWS; zone++)
+        {
+            map->zones[i][zone].min = INT32_MAX;
+            map->zones[i][zone].max = INT32_MIN;
+        }
+}
+
+
+void zone_map_widen(struct zone_map* map, const struct row_layout* layout, int row, const char* value)
+{
+    int i;
+
+    for(i = 0; i < MAX_COLUMNS_PER_TABLE; i++)
+        if(map->zones[i] != NULL && !map->coded[i])
+            widen(&map->zones[i][row / ZONE_ROWS], row_int(layout, value, i));
+}
+
+
+void zone_map_widen_code(struct zone_map* map, int column_id, int row, int32_t code)
+{
+    if(code != DICT_NO_CODE)
+        widen(&map->zones[column_id][row / ZONE_ROWS], code);
+}
+
+
+void zone_map_recode(struct zone_map* map, int column_id, const int32_t* codes, int num_rows)
+{
+    int zone, row;
+
+    for(zone = 0; zone < (num_rows + ZONE_ROWS - 1) / ZONE_ROWS; zone++)
+    {
+        map->zones[column_id][zone].min = INT32_MAX;
+        map->zones[column_id][zone].max = INT32_MIN;
+    }
+
+    for(row = 0; row < num_rows; row++)
+        zone_map_widen_code(map, column_id, row, codes[row]);
+}
@@ -0,0 +1,120 @@
+/**
+ * @file
+ * @brief This file declares the zone maps that let scans skip blocks of rows.
+ *
+ * The rows of a table are split into zones of ZONE_ROWS consecutive rows,
+ * the blocks the kernels of kernel.h compare at once, and the zone map
+ * keeps the least and greatest value of every int column within each
+ * zone. A scan skips a zone whose bounds no row can satisfy a predicate
+ * with, such as the old rows of an append-only table for "id > X".
+ *
+ * The char[n] columns of a table stored by columns hold order-preserving
+ * dictionary codes (dict.h), so their zones bound the codes, which string
+ * predicates are bound to before each scan. A dictionary that gives its
+ * values new codes rewrites the whole column, whose zones are then
+ * recomputed from the new codes.
+ *
+ * Bounds are only widened as values are set, never narrowed when a value
+ * is overwritten or its record removed, so they may be looser than the
+ * rows but never exclude one. A new record joins the bounds of its zone
+ * when its value is first set, not with the zeroed row of a table stored
+ * by columns, which the server overwrites in the command inserting it.
+ * They are recomputed from the rows left when the entries are compacted,
+ * as the rows move to other zones anyway.
+ */
+
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include "row.h"
+#include "kernel.h"
+#include "dict.h"
+
+#define ZONE_ROWS KERNEL_BLOCK_ROWS ///< Rows summarized by a zone.
+
+
+/**
+ * @brief The bounds of an int column, or of the codes of a char[n] column, within a zone.
+ *
+ * The min of a zone without rows is greater than its max.
+ */
+struct zone {
+    int32_t min;
+    int32_t max;
+};
+
+
+/**
+ * @brief The zones of a table.
+ */
+struct zone_map {
+    struct zone* zones[MAX_COLUMNS_PER_TABLE]; ///< The zones of each int or coded column, NULL for the other char[n] columns.
+    bool coded[MAX_COLUMNS_PER_TABLE]; ///< Whether each column holds dictionary codes, widened by zone_map_widen_code().
+    int capacity; ///< Zones allocated per column.
+    unsigned long long zones_read; ///< Zones compared by scans.
+    unsigned long long zones_skipped; ///< Zones skipped by scans.
+};
+
+
+/**
+ * @brief Allocates the empty zone map of a table.
+ *
+ * @param schema The schema of the table.
+ * @param coded Whether the char[n] columns hold dictionary codes, the table being stored by columns.
+ * @return Returns the zone map on success, NULL otherwise.
+ */
+struct zone_map* zone_map_create(const struct table_schema* schema, bool coded);
+
+
+/**
+ * @brief Frees a zone map.
+ */
+void zone_map_destroy(struct zone_map* map);
+
+
+/**
+ * @brief Makes room for the zones of a number of rows.
+ *
+ * @param rows The rows of the table, its entries allocated.
+ * @return Returns 0 on success, -1 otherwise in which case the zones allocated are unchanged.
+ */
+int zone_map_reserve(struct zone_map* map, int rows);
+
+
+/**
+ * @brief Empties the zones of a range of rows.
+ *
+ * @param first The first row of the range, which starts a zone.
+ * @param last The row after the range, within the zones allocated.
+ */
+void zone_map_clear(struct zone_map* map, int first, int last);
+
+
+/**
+ * @brief Widens the zone of a row to the int values of a new value of the row.
+ *
+ * @param layout The row layout of the table.
+ * @param row The row id.
+ * @param value The new value, in the format of row.h.
+ */
+void zone_map_widen(struct zone_map* map, const struct row_layout* layout, int row, const char* value);
+
+
+/**
+ * @brief Widens the zone of a row of a coded column to the code of its value.
+ *
+ * @param code The code, ignored if DICT_NO_CODE.
+ */
+void zone_map_widen_code(struct zone_map* map, int column_id, int row, int32_t code);
+
+
+/**
+ * @brief Recomputes the zones of a coded column from its codes, once its dictionary gave its values new codes.
+ *
+ * @param codes The codes of the column.
+ * @param num_rows Number of codes, within the zones allocated.
+ */
+void zone_map_recode(struct zone_map* map, int column_id, const int32_t* codes, int num_rows);
+
+
+#endif
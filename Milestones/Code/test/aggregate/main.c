@@ -0,0 +1,471 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	10		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables.
+
+#define BADTABLE	"spaced $table"	// A bad table name.
+
+#define ROWTABLE		"rowtbl"	// A table stored by rows, with an index on col.
+#define COLTABLE		"coltbl"	// A table stored by columns.
+
+#define MISSINGTABLE	"missingtable"	// A non-existing table.
+
+#define NUMKEYS		100	// Keys stored in each table.
+#define BADPREDICATES	"col ! 2"	// Predicates with a bad operator.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/**
+ * @brief Text fixture setup.  Start the server.
+ */
+void test_setup_simple()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server and populate the tables.
+ *
+ * Both tables hold the keys "key000" to "key099", the value of key i
+ * being "col i,name even" or "col i,name odd".
+ */
+void test_setup_simple_populate()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpledata.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0;
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "key%03d", i);
+		sprintf(record.value, "col %d,name %s", i, i % 2 == 0 ? "even" : "odd");
+		storage_set(ROWTABLE, key, &record, test_conn);
+		storage_set(COLTABLE, key, &record, test_conn);
+	}
+}
+
+
+void test_setup_not_authenticated()
+{
+	test_conn = start_connect_not_authenticated(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+START_TEST (test_null_conn)
+{
+	double result;
+	int count = storage_aggregate(ROWTABLE, "SUM", "col", "", &result, NULL);
+	fail_unless(count == -1, "storage_aggregate with null connection should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_aggregate with null connection not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_null_table)
+{
+	double result;
+	int count = storage_aggregate(NULL, "SUM", "col", "", &result, test_conn);
+	fail_unless(count == -1, "storage_aggregate with no table name provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_aggregate with no table name provided (null) not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_table)
+{
+	double result;
+	int count = storage_aggregate(BADTABLE, "SUM", "col", "", &result, test_conn);
+	fail_unless(count == -1, "storage_aggregate with bad table name should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_aggregate with bad table name not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_function)
+{
+	double result;
+	int count = storage_aggregate(ROWTABLE, NULL, "col", "", &result, test_conn);
+	fail_unless(count == -1, "storage_aggregate with no function provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_aggregate with no function provided (null) not setting errno properly.");
+
+	count = storage_aggregate(ROWTABLE, "MEDIAN", "col", "", &result, test_conn);
+	fail_unless(count == -1, "storage_aggregate with an unknown function should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_aggregate with an unknown function not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_column)
+{
+	double result;
+	int count = storage_aggregate(ROWTABLE, "SUM", "missing", "", &result, test_conn);
+	fail_unless(count == -1, "storage_aggregate with a missing column should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_aggregate with a missing column not setting errno properly.");
+
+	count = storage_aggregate(ROWTABLE, "SUM", "name", "", &result, test_conn);
+	fail_unless(count == -1, "storage_aggregate of a char column should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_aggregate of a char column not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_predicates)
+{
+	double result;
+	int count = storage_aggregate(ROWTABLE, "SUM", "col", NULL, &result, test_conn);
+	fail_unless(count == -1, "storage_aggregate with no predicates provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_aggregate with no predicates provided (null) not setting errno properly.");
+
+	count = storage_aggregate(ROWTABLE, "SUM", "col", BADPREDICATES, &result, test_conn);
+	fail_unless(count == -1, "storage_aggregate with bad predicates should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_aggregate with bad predicates not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_null_result)
+{
+	int count = storage_aggregate(ROWTABLE, "SUM", "col", "", NULL, test_conn);
+	fail_unless(count == -1, "storage_aggregate with no result provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_aggregate with no result provided (null) not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_not_authenticated)
+{
+	double result;
+	int count = storage_aggregate(ROWTABLE, "SUM", "col", "", &result, test_conn);
+	fail_unless(count == -1, "storage_aggregate without authenticating should fail.");
+	fail_unless(errno == ERR_NOT_AUTHENTICATED, "storage_aggregate without authenticating not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_missing_table)
+{
+	double result;
+	int count = storage_aggregate(MISSINGTABLE, "SUM", "col", "", &result, test_conn);
+	fail_unless(count == -1, "storage_aggregate with missing table should fail.");
+	fail_unless(errno == ERR_TABLE_NOT_FOUND, "storage_aggregate with missing table not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_empty_table)
+{
+	double result = -1;
+	int count = storage_aggregate(ROWTABLE, "MIN", "col", "", &result, test_conn);
+	fail_unless(count == 0, "storage_aggregate over an empty table should match no record.");
+	fail_unless(result == 0, "storage_aggregate over an empty table should return 0.");
+
+	count = storage_aggregate(COLTABLE, "AVG", "col", "col > 0", &result, test_conn);
+	fail_unless(count == 0, "storage_aggregate over an empty table should match no record.");
+	fail_unless(result == 0, "storage_aggregate over an empty table should return 0.");
+}
+END_TEST
+
+
+START_TEST (test_aggregate_all)
+{
+	static const char *tables[] = {ROWTABLE, COLTABLE};
+	double result;
+	int t;
+
+	for (t = 0; t < 2; t++) {
+		fail_unless(storage_aggregate(tables[t], "COUNT", "col", "", &result, test_conn) == NUMKEYS && result == NUMKEYS,
+				"storage_aggregate should count every record.");
+		fail_unless(storage_aggregate(tables[t], "SUM", "col", "", &result, test_conn) == NUMKEYS && result == 4950,
+				"storage_aggregate should sum the column over every record.");
+		fail_unless(storage_aggregate(tables[t], "MIN", "col", "", &result, test_conn) == NUMKEYS && result == 0,
+				"storage_aggregate should find the least value of the column.");
+		fail_unless(storage_aggregate(tables[t], "MAX", "col", "", &result, test_conn) == NUMKEYS && result == 99,
+				"storage_aggregate should find the greatest value of the column.");
+		fail_unless(storage_aggregate(tables[t], "AVG", "col", "", &result, test_conn) == NUMKEYS && fabs(result - 49.5) < 1e-9,
+				"storage_aggregate should average the column over every record.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_aggregate_predicates)
+{
+	static const char *tables[] = {ROWTABLE, COLTABLE};
+	double result;
+	int t;
+
+	for (t = 0; t < 2; t++) {
+		fail_unless(storage_aggregate(tables[t], "COUNT", "col", "col > 89", &result, test_conn) == 10 && result == 10,
+				"storage_aggregate should count the matching records.");
+		fail_unless(storage_aggregate(tables[t], "SUM", "col", "col > 89", &result, test_conn) == 10 && result == 945,
+				"storage_aggregate should sum the column over the matching records.");
+		fail_unless(storage_aggregate(tables[t], "MAX", "col", "name = even", &result, test_conn) == 50 && result == 98,
+				"storage_aggregate should find the greatest value among the matching records.");
+		fail_unless(storage_aggregate(tables[t], "MIN", "col", "name = odd, col > 50", &result, test_conn) == 25 && result == 51,
+				"storage_aggregate should find the least value among the records matching every predicate.");
+		fail_unless(storage_aggregate(tables[t], "AVG", "col", "col < 10", &result, test_conn) == 10 && fabs(result - 4.5) < 1e-9,
+				"storage_aggregate should average the column over the matching records.");
+		fail_unless(storage_aggregate(tables[t], "SUM", "col", "col > 1000", &result, test_conn) == 0 && result == 0,
+				"storage_aggregate should return 0 when no record matches.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_aggregate_after_delete)
+{
+	double result;
+
+	// The extremes of an indexed column come from its index, which must follow the deletes
+	fail_unless(storage_set(ROWTABLE, "key000", NULL, test_conn) == 0, "Error deleting a key/value pair.");
+	fail_unless(storage_set(ROWTABLE, "key099", NULL, test_conn) == 0, "Error deleting a key/value pair.");
+
+	fail_unless(storage_aggregate(ROWTABLE, "MIN", "col", "", &result, test_conn) == NUMKEYS - 2 && result == 1,
+			"storage_aggregate should not find the least value among deleted records.");
+	fail_unless(storage_aggregate(ROWTABLE, "MAX", "col", "", &result, test_conn) == NUMKEYS - 2 && result == 98,
+			"storage_aggregate should not find the greatest value among deleted records.");
+	fail_unless(storage_aggregate(ROWTABLE, "COUNT", "col", "col > 89", &result, test_conn) == 9,
+			"storage_aggregate should not count deleted records.");
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of the aggregate queries.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("aggregate");
+	TCase *tc;
+
+	// Aggregate tests with invalid parameters
+	tc = tcase_create("aggregate_invalid_parameters");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_null_conn);
+	tcase_add_test(tc, test_null_table);
+	tcase_add_test(tc, test_invalid_table);
+	tcase_add_test(tc, test_invalid_function);
+	tcase_add_test(tc, test_invalid_column);
+	tcase_add_test(tc, test_invalid_predicates);
+	tcase_add_test(tc, test_null_result);
+	suite_add_tcase(s, tc);
+
+	// Aggregate tests without authentication
+	tc = tcase_create("aggregate_without_authentication");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_not_authenticated, test_teardown);
+	tcase_add_test(tc, test_not_authenticated);
+	suite_add_tcase(s, tc);
+
+	// Aggregate tests with missing table
+	tc = tcase_create("aggregate_missing_table");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_missing_table);
+	tcase_add_test(tc, test_empty_table);
+	suite_add_tcase(s, tc);
+
+	// Aggregate tests with populated tables
+	tc = tcase_create("aggregate_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple_populate, test_teardown);
+	tcase_add_test(tc, test_aggregate_all);
+	tcase_add_test(tc, test_aggregate_predicates);
+	tcase_add_test(tc, test_aggregate_after_delete);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
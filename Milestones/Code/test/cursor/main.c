@@ -0,0 +1,567 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	10		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables.
+
+#define BADTABLE	"spaced $table"	// A bad table name.
+
+#define ROWTABLE		"rowtbl"	// A table stored by rows.
+#define COLTABLE		"coltbl"	// A table stored by columns.
+
+#define MISSINGTABLE	"missingtable"	// A non-existing table.
+
+#define NUMKEYS		600	// Keys stored in each table, more than one QUERY_NEXT reply holds.
+#define BADPREDICATES	"col ! 2"	// Predicates with a bad operator.
+#define BADCURSOR	12345	// A cursor that was never opened.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/**
+ * @brief Text fixture setup.  Start the server.
+ */
+void test_setup_simple()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Returns the number of the i-th key stored, 7 apart so that they are out of order.
+ */
+int inserted(int i)
+{
+	return (i * 7) % NUMKEYS;
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server and populate the tables.
+ *
+ * Both tables hold the keys "key000" to "key599", stored out of order, the
+ * value of key i being "col i".
+ */
+void test_setup_simple_populate()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpledata.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0;
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "key%03d", inserted(i));
+		sprintf(record.value, "col %d", inserted(i));
+		storage_set(ROWTABLE, key, &record, test_conn);
+		storage_set(COLTABLE, key, &record, test_conn);
+	}
+}
+
+
+void test_setup_not_authenticated()
+{
+	test_conn = start_connect_not_authenticated(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+/// Keys array with room for all the keys of a table.
+char key_storage[NUMKEYS][MAX_KEY_LEN];
+char *keys[NUMKEYS];
+
+
+/**
+ * @brief Points the keys array to its storage.
+ */
+void init_keys()
+{
+	int i;
+	for (i = 0; i < NUMKEYS; i++)
+		keys[i] = key_storage[i];
+}
+
+
+/**
+ * @brief Checks that retrieved keys are consecutive keys in insertion order.
+ * @return 1 if keys[i] is the key stored (first + i)-th for all i < count, 0 otherwise.
+ */
+int keys_inserted_from(int first, int count)
+{
+	char key[MAX_KEY_LEN];
+	int i;
+	for (i = 0; i < count; i++) {
+		sprintf(key, "key%03d", inserted(first + i));
+		if (strcmp(keys[i], key) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+
+START_TEST (test_null_conn)
+{
+	int cursor = storage_query_cursor(ROWTABLE, "col > 0", NULL);
+	fail_unless(cursor == -1, "storage_query_cursor with null connection should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_cursor with null connection not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_null_table)
+{
+	int cursor = storage_query_cursor(NULL, "col > 0", test_conn);
+	fail_unless(cursor == -1, "storage_query_cursor with no table name provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_cursor with no table name provided (null) not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_table)
+{
+	int cursor = storage_query_cursor(BADTABLE, "col > 0", test_conn);
+	fail_unless(cursor == -1, "storage_query_cursor with bad table name should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_cursor with bad table name not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_predicates)
+{
+	int cursor = storage_query_cursor(ROWTABLE, NULL, test_conn);
+	fail_unless(cursor == -1, "storage_query_cursor with no predicates provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_cursor with no predicates provided (null) not setting errno properly.");
+
+	cursor = storage_query_cursor(ROWTABLE, BADPREDICATES, test_conn);
+	fail_unless(cursor == -1, "storage_query_cursor with bad predicates should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_cursor with bad predicates not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_cursor)
+{
+	init_keys();
+	int status = storage_query_next(BADCURSOR, keys, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_query_next with a cursor never opened should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_next with a cursor never opened not setting errno properly.");
+
+	status = storage_query_close(BADCURSOR, test_conn);
+	fail_unless(status == -1, "storage_query_close with a cursor never opened should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_close with a cursor never opened not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_max_keys)
+{
+	init_keys();
+	int cursor = storage_query_cursor(ROWTABLE, "col > 0", test_conn);
+	fail_unless(cursor > 0, "storage_query_cursor should open a cursor over an empty table.");
+
+	int status = storage_query_next(cursor, keys, -1, test_conn);
+	fail_unless(status == -1, "storage_query_next with negative max keys should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_next with negative max keys not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_not_authenticated)
+{
+	int cursor = storage_query_cursor(ROWTABLE, "col > 0", test_conn);
+	fail_unless(cursor == -1, "storage_query_cursor without authenticating should fail.");
+	fail_unless(errno == ERR_NOT_AUTHENTICATED, "storage_query_cursor without authenticating not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_missing_table)
+{
+	int cursor = storage_query_cursor(MISSINGTABLE, "col > 0", test_conn);
+	fail_unless(cursor == -1, "storage_query_cursor with missing table should fail.");
+	fail_unless(errno == ERR_TABLE_NOT_FOUND, "storage_query_cursor with missing table not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_empty_table)
+{
+	init_keys();
+	int cursor = storage_query_cursor(COLTABLE, "col > 0", test_conn);
+	fail_unless(cursor > 0, "storage_query_cursor should open a cursor over an empty table.");
+
+	int status = storage_query_next(cursor, keys, NUMKEYS, test_conn);
+	fail_unless(status == 0, "storage_query_next over an empty table should retrieve no keys.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+}
+END_TEST
+
+
+START_TEST (test_cursor_all)
+{
+	init_keys();
+	int cursor = storage_query_cursor(ROWTABLE, "col > -1", test_conn);
+	fail_unless(cursor > 0, "storage_query_cursor should open a cursor.");
+
+	int status = storage_query_next(cursor, keys, NUMKEYS, test_conn);
+	fail_unless(status == NUMKEYS, "storage_query_next should retrieve all the matching keys, more than one reply holds.");
+	fail_unless(keys_inserted_from(0, NUMKEYS), "storage_query_next should retrieve the keys in insertion order.");
+
+	status = storage_query_next(cursor, keys, NUMKEYS, test_conn);
+	fail_unless(status == 0, "storage_query_next should retrieve no more keys at the end of the table.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+
+	cursor = storage_query_cursor(COLTABLE, "col > -1", test_conn);
+	status = storage_query_next(cursor, keys, NUMKEYS, test_conn);
+	fail_unless(status == NUMKEYS, "storage_query_next should retrieve all the matching keys of a table stored by columns.");
+	fail_unless(keys_inserted_from(0, NUMKEYS), "storage_query_next should retrieve the keys of a table stored by columns in insertion order.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+}
+END_TEST
+
+
+START_TEST (test_cursor_pages)
+{
+	init_keys();
+	int cursor = storage_query_cursor(COLTABLE, "col > -1", test_conn);
+	int status, total = 0;
+
+	do {
+		status = storage_query_next(cursor, keys, 7, test_conn);
+		fail_unless(status >= 0 && status <= 7, "storage_query_next should retrieve at most max_keys keys.");
+		fail_unless(keys_inserted_from(total, status), "storage_query_next should continue after the keys already retrieved.");
+		total += status;
+	} while (status == 7);
+
+	fail_unless(total == NUMKEYS, "storage_query_next should retrieve every key once over all the pages.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+}
+END_TEST
+
+
+START_TEST (test_cursor_predicates)
+{
+	init_keys();
+	int cursor = storage_query_cursor(ROWTABLE, "col < 70", test_conn);
+	int status = storage_query_next(cursor, keys, NUMKEYS, test_conn);
+	int i;
+
+	fail_unless(status == 70, "storage_query_next should only retrieve the matching keys.");
+	for (i = 0; i < status; i++)
+		fail_unless(atoi(keys[i] + strlen("key")) < 70, "storage_query_next should retrieve keys whose records match.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+
+	cursor = storage_query_cursor(COLTABLE, "col = 42", test_conn);
+	status = storage_query_next(cursor, keys, NUMKEYS, test_conn);
+	fail_unless(status == 1 && strcmp(keys[0], "key042") == 0, "storage_query_next should retrieve the single matching key.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+}
+END_TEST
+
+
+START_TEST (test_cursor_while_deleting)
+{
+	char key[MAX_KEY_LEN];
+	int seen[NUMKEYS] = {0};
+	int i, status, total;
+	const char *tables[] = {ROWTABLE, COLTABLE};
+	int t;
+
+	init_keys();
+	for (t = 0; t < 2; t++) {
+		memset(seen, 0, sizeof seen);
+		int cursor = storage_query_cursor(tables[t], "col > -1", test_conn);
+		total = storage_query_next(cursor, keys, 100, test_conn);
+		fail_unless(total == 100, "storage_query_next should retrieve the first page of keys.");
+		for (i = 0; i < total; i++)
+			seen[atoi(keys[i] + strlen("key"))]++;
+
+		// Deleting most keys on both sides of the cursor compacts the table
+		for (i = 0; i < NUMKEYS; i++)
+			if (i % 4 != 0) {
+				sprintf(key, "key%03d", inserted(i));
+				storage_set(tables[t], key, NULL, test_conn);
+			}
+
+		do {
+			status = storage_query_next(cursor, keys, 50, test_conn);
+			for (i = 0; i < status; i++)
+				seen[atoi(keys[i] + strlen("key"))]++;
+		} while (status == 50);
+
+		// Keys never deleted are each retrieved once, and deleted keys not yet reached are skipped
+		for (i = 0; i < NUMKEYS; i++) {
+			if (i % 4 == 0)
+				fail_unless(seen[inserted(i)] == 1, "storage_query_next should retrieve each key kept exactly once.");
+			else if (i >= 100)
+				fail_unless(seen[inserted(i)] == 0, "storage_query_next should not retrieve keys deleted before reaching them.");
+		}
+		fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_cursor_close)
+{
+	init_keys();
+	int cursor = storage_query_cursor(ROWTABLE, "col > -1", test_conn);
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+
+	int status = storage_query_next(cursor, keys, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_query_next with a closed cursor should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_next with a closed cursor not setting errno properly.");
+
+	status = storage_query_close(cursor, test_conn);
+	fail_unless(status == -1, "storage_query_close with a closed cursor should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_close with a closed cursor not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_query_max_keys)
+{
+	init_keys();
+	int status = storage_query(ROWTABLE, "col > -1", keys, NUMKEYS, test_conn);
+	fail_unless(status == NUMKEYS, "storage_query should count all the matching keys.");
+	fail_unless(keys_inserted_from(0, 256), "storage_query should retrieve as many keys as one reply holds.");
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of the query cursors.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("cursor");
+	TCase *tc;
+
+	// Cursor tests with invalid parameters
+	tc = tcase_create("cursor_invalid_parameters");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_null_conn);
+	tcase_add_test(tc, test_null_table);
+	tcase_add_test(tc, test_invalid_table);
+	tcase_add_test(tc, test_invalid_predicates);
+	tcase_add_test(tc, test_invalid_cursor);
+	tcase_add_test(tc, test_invalid_max_keys);
+	suite_add_tcase(s, tc);
+
+	// Cursor tests without authentication
+	tc = tcase_create("cursor_without_authentication");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_not_authenticated, test_teardown);
+	tcase_add_test(tc, test_not_authenticated);
+	suite_add_tcase(s, tc);
+
+	// Cursor tests with missing table
+	tc = tcase_create("cursor_missing_table");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_missing_table);
+	tcase_add_test(tc, test_empty_table);
+	suite_add_tcase(s, tc);
+
+	// Cursor tests with populated tables
+	tc = tcase_create("cursor_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple_populate, test_teardown);
+	tcase_add_test(tc, test_cursor_all);
+	tcase_add_test(tc, test_cursor_pages);
+	tcase_add_test(tc, test_cursor_predicates);
+	tcase_add_test(tc, test_cursor_while_deleting);
+	tcase_add_test(tc, test_cursor_close);
+	tcase_add_test(tc, test_query_max_keys);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,438 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	10		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables.
+
+#define BADTABLE	"spaced $table"	// A bad table name.
+
+#define ROWTABLE		"rowtbl"	// A table stored by rows, with an index on col.
+#define COLTABLE		"coltbl"	// A table stored by columns, with an index on col.
+
+#define MISSINGTABLE	"missingtable"	// A non-existing table.
+
+#define NUMKEYS		1000	// Keys stored in each table.
+#define BADPREDICATES	"col ! 2"	// Predicates with a bad operator.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/**
+ * @brief Text fixture setup.  Start the server.
+ */
+void test_setup_simple()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server and populate the tables.
+ *
+ * Both tables hold the keys "key000" to "key999", the value of key i
+ * being "col i,name even" or "col i,name odd".
+ */
+void test_setup_simple_populate()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpledata.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0;
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "key%03d", i);
+		sprintf(record.value, "col %d,name %s", i, i % 2 == 0 ? "even" : "odd");
+		storage_set(ROWTABLE, key, &record, test_conn);
+		storage_set(COLTABLE, key, &record, test_conn);
+	}
+}
+
+
+void test_setup_not_authenticated()
+{
+	test_conn = start_connect_not_authenticated(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+/**
+ * @brief Reads a number of a plan.
+ * @return The number following the name, or -1 if the plan has no such pair.
+ */
+int plan_number(const char *plan, const char *name)
+{
+	char pair[MAX_COLNAME_LEN + 2];
+	const char *found;
+
+	sprintf(pair, "%s ", name);
+	for (found = strstr(plan, pair); found != NULL; found = strstr(found + 1, pair))
+		if (found == plan || found[-1] == ',')
+			return atoi(found + strlen(pair));
+	return -1;
+}
+
+
+START_TEST (test_null_conn)
+{
+	struct storage_record record;
+	int status = storage_explain(ROWTABLE, "col > 0", &record, NULL);
+	fail_unless(status == -1, "storage_explain with null connection should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_explain with null connection not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_parameters)
+{
+	struct storage_record record;
+	int status = storage_explain(NULL, "col > 0", &record, test_conn);
+	fail_unless(status == -1, "storage_explain with no table name provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_explain with no table name provided (null) not setting errno properly.");
+
+	status = storage_explain(BADTABLE, "col > 0", &record, test_conn);
+	fail_unless(status == -1, "storage_explain with bad table name should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_explain with bad table name not setting errno properly.");
+
+	status = storage_explain(ROWTABLE, NULL, &record, test_conn);
+	fail_unless(status == -1, "storage_explain with no predicates provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_explain with no predicates provided (null) not setting errno properly.");
+
+	status = storage_explain(ROWTABLE, BADPREDICATES, &record, test_conn);
+	fail_unless(status == -1, "storage_explain with bad predicates should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_explain with bad predicates not setting errno properly.");
+
+	status = storage_explain(ROWTABLE, "col > 0", NULL, test_conn);
+	fail_unless(status == -1, "storage_explain with no record provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_explain with no record provided (null) not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_not_authenticated)
+{
+	struct storage_record record;
+	int status = storage_explain(ROWTABLE, "col > 0", &record, test_conn);
+	fail_unless(status == -1, "storage_explain without authenticating should fail.");
+	fail_unless(errno == ERR_NOT_AUTHENTICATED, "storage_explain without authenticating not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_missing_table)
+{
+	struct storage_record record;
+	int status = storage_explain(MISSINGTABLE, "col > 0", &record, test_conn);
+	fail_unless(status == -1, "storage_explain with missing table should fail.");
+	fail_unless(errno == ERR_TABLE_NOT_FOUND, "storage_explain with missing table not setting errno properly.");
+
+	status = storage_explain(ROWTABLE, "age > 0", &record, test_conn);
+	fail_unless(status == -1, "storage_explain with a missing column should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_explain with a missing column not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_empty_table)
+{
+	struct storage_record record;
+	int status = storage_explain(ROWTABLE, "col > 0", &record, test_conn);
+	fail_unless(status == 0, "storage_explain over an empty table should succeed.");
+	fail_unless(plan_number(record.value, "actualRows") == 0, "storage_explain over an empty table should count no record.");
+	fail_unless(plan_number(record.value, "estimatedRows") == 0, "storage_explain over an empty table should estimate no record.");
+}
+END_TEST
+
+
+START_TEST (test_explain_index)
+{
+	struct storage_record record;
+	int status = storage_explain(ROWTABLE, "col < 10", &record, test_conn);
+	fail_unless(status == 0, "storage_explain should explain a query.");
+	fail_unless(strncmp(record.value, "access index col,", strlen("access index col,")) == 0, "A selective indexed predicate should drive the query.");
+	fail_unless(plan_number(record.value, "actualRows") == 10, "storage_explain should count the matching records.");
+}
+END_TEST
+
+
+START_TEST (test_explain_scan)
+{
+	struct storage_record record;
+	int status = storage_explain(ROWTABLE, "name = odd", &record, test_conn);
+	fail_unless(status == 0, "storage_explain should explain a query.");
+	fail_unless(strncmp(record.value, "access scan,", strlen("access scan,")) == 0, "A query without an indexed predicate should scan the table.");
+	fail_unless(plan_number(record.value, "actualRows") == NUMKEYS / 2, "storage_explain should count the matching records.");
+	fail_unless(plan_number(record.value, "estimatedRows") == NUMKEYS / 2, "A table smaller than the sample should be estimated from all its values.");
+
+	status = storage_explain(ROWTABLE, "col > 100", &record, test_conn);
+	fail_unless(strncmp(record.value, "access scan,", strlen("access scan,")) == 0, "An indexed predicate matching most records should not drive the query.");
+	fail_unless(plan_number(record.value, "actualRows") == NUMKEYS - 101, "storage_explain should count the matching records.");
+}
+END_TEST
+
+
+START_TEST (test_explain_order)
+{
+	struct storage_record record;
+	int status = storage_explain(ROWTABLE, "name = odd, col < 10", &record, test_conn);
+	fail_unless(status == 0, "storage_explain should explain a query.");
+	fail_unless(strstr(record.value, ",order col<10;name=odd,") != NULL, "The most selective predicate should be tested first.");
+	fail_unless(plan_number(record.value, "actualRows") == 5, "storage_explain should count the records matching all predicates.");
+
+	int estimated = plan_number(record.value, "estimatedRows");
+	fail_unless(estimated >= 3 && estimated <= 7, "storage_explain should estimate the records matching all predicates.");
+}
+END_TEST
+
+
+START_TEST (test_explain_layout)
+{
+	struct storage_record record;
+
+	// A scan of a table stored by columns is cheaper, so its index must be more selective to drive a query
+	int status = storage_explain(ROWTABLE, "col < 100", &record, test_conn);
+	fail_unless(status == 0 && strncmp(record.value, "access index col,", strlen("access index col,")) == 0,
+			"An indexed predicate matching a tenth of a table stored by rows should drive the query.");
+
+	status = storage_explain(COLTABLE, "col < 100", &record, test_conn);
+	fail_unless(status == 0 && strncmp(record.value, "access scan,", strlen("access scan,")) == 0,
+			"An indexed predicate matching a tenth of a table stored by columns should not drive the query.");
+	fail_unless(plan_number(record.value, "actualRows") == 100, "storage_explain should count the matching records.");
+
+	status = storage_explain(COLTABLE, "col < 10", &record, test_conn);
+	fail_unless(status == 0 && strncmp(record.value, "access index col,", strlen("access index col,")) == 0,
+			"A selective indexed predicate should drive a query on a table stored by columns.");
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of the query plans.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("explain");
+	TCase *tc;
+
+	// Explain tests with invalid parameters
+	tc = tcase_create("explain_invalid_parameters");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_null_conn);
+	tcase_add_test(tc, test_invalid_parameters);
+	suite_add_tcase(s, tc);
+
+	// Explain tests without authentication
+	tc = tcase_create("explain_without_authentication");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_not_authenticated, test_teardown);
+	tcase_add_test(tc, test_not_authenticated);
+	suite_add_tcase(s, tc);
+
+	// Explain tests with missing table
+	tc = tcase_create("explain_missing_table");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_missing_table);
+	tcase_add_test(tc, test_empty_table);
+	suite_add_tcase(s, tc);
+
+	// Explain tests with populated tables
+	tc = tcase_create("explain_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple_populate, test_teardown);
+	tcase_add_test(tc, test_explain_index);
+	tcase_add_test(tc, test_explain_scan);
+	tcase_add_test(tc, test_explain_order);
+	tcase_add_test(tc, test_explain_layout);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,514 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	10		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables.
+
+#define BADTABLE	"spaced $table"	// A bad table name.
+
+#define ROWTABLE		"rowtbl"	// A table stored by rows.
+#define COLTABLE		"coltbl"	// A table stored by columns.
+
+#define MISSINGTABLE	"missingtable"	// A non-existing table.
+
+#define NUMKEYS		600	// Keys stored in each table, more than one QUERY_FETCH reply holds.
+#define BADCURSOR	12345	// A cursor that was never opened.
+#define BADCOLUMNS	"col,age"	// Columns one of which is not in the tables.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/**
+ * @brief Text fixture setup.  Start the server.
+ */
+void test_setup_simple()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Returns the number of the i-th key stored, 7 apart so that they are out of order.
+ */
+int inserted(int i)
+{
+	return (i * 7) % NUMKEYS;
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server and populate the tables.
+ *
+ * Both tables hold the keys "key000" to "key599", stored out of order, the
+ * value of key i being "col i,name ni".
+ */
+void test_setup_simple_populate()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpledata.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0;
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "key%03d", inserted(i));
+		sprintf(record.value, "col %d,name n%d", inserted(i), inserted(i));
+		record.metadata[0] = 0;
+		storage_set(ROWTABLE, key, &record, test_conn);
+		storage_set(COLTABLE, key, &record, test_conn);
+	}
+}
+
+
+void test_setup_not_authenticated()
+{
+	test_conn = start_connect_not_authenticated(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+/// Keys and records arrays with room for all the records of a table.
+char key_storage[NUMKEYS][MAX_KEY_LEN];
+char *keys[NUMKEYS];
+struct storage_record records[NUMKEYS];
+
+
+/**
+ * @brief Points the keys array to its storage.
+ */
+void init_keys()
+{
+	int i;
+	for (i = 0; i < NUMKEYS; i++)
+		keys[i] = key_storage[i];
+}
+
+
+/**
+ * @brief Checks that retrieved records are consecutive records in insertion order, with their full values.
+ * @return 1 if keys[i] and records[i] are those stored (first + i)-th for all i < count, 0 otherwise.
+ */
+int records_inserted_from(int first, int count)
+{
+	char key[MAX_KEY_LEN], value[MAX_VALUE_LEN];
+	int i;
+	for (i = 0; i < count; i++) {
+		sprintf(key, "key%03d", inserted(first + i));
+		sprintf(value, "col %d,name n%d", inserted(first + i), inserted(first + i));
+		if (strcmp(keys[i], key) != 0 || strcmp(records[i].value, value) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+
+START_TEST (test_null_conn)
+{
+	init_keys();
+	int status = storage_query_fetch(1, NULL, keys, records, NUMKEYS, NULL);
+	fail_unless(status == -1, "storage_query_fetch with null connection should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_fetch with null connection not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_cursor)
+{
+	init_keys();
+	int status = storage_query_fetch(BADCURSOR, NULL, keys, records, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_query_fetch with a cursor never opened should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_fetch with a cursor never opened not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_arrays)
+{
+	init_keys();
+	int cursor = storage_query_cursor(ROWTABLE, "col > 0", test_conn);
+	fail_unless(cursor > 0, "storage_query_cursor should open a cursor over an empty table.");
+
+	int status = storage_query_fetch(cursor, NULL, keys, records, -1, test_conn);
+	fail_unless(status == -1, "storage_query_fetch with negative max records should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_fetch with negative max records not setting errno properly.");
+
+	status = storage_query_fetch(cursor, NULL, keys, NULL, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_query_fetch with no records array should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_fetch with no records array not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_columns)
+{
+	init_keys();
+	int cursor = storage_query_cursor(ROWTABLE, "col > 0", test_conn);
+
+	int status = storage_query_fetch(cursor, BADCOLUMNS, keys, records, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_query_fetch with an unknown column should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_fetch with an unknown column not setting errno properly.");
+
+	status = storage_query_fetch(cursor, "col,col", keys, records, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_query_fetch with a repeated column should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_query_fetch with a repeated column not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_not_authenticated)
+{
+	init_keys();
+	int status = storage_query_fetch(1, NULL, keys, records, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_query_fetch without authenticating should fail.");
+	fail_unless(errno == ERR_NOT_AUTHENTICATED, "storage_query_fetch without authenticating not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_empty_table)
+{
+	init_keys();
+	int cursor = storage_query_cursor(COLTABLE, "col > 0", test_conn);
+	int status = storage_query_fetch(cursor, NULL, keys, records, NUMKEYS, test_conn);
+	fail_unless(status == 0, "storage_query_fetch over an empty table should retrieve no records.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+}
+END_TEST
+
+
+START_TEST (test_fetch_all)
+{
+	const char *tables[] = {ROWTABLE, COLTABLE};
+	int t;
+
+	init_keys();
+	for (t = 0; t < 2; t++) {
+		int cursor = storage_query_cursor(tables[t], "col > -1", test_conn);
+		fail_unless(cursor > 0, "storage_query_cursor should open a cursor.");
+
+		int status = storage_query_fetch(cursor, NULL, keys, records, NUMKEYS, test_conn);
+		fail_unless(status == NUMKEYS, "storage_query_fetch should retrieve all the matching records, more than one reply holds.");
+		fail_unless(records_inserted_from(0, NUMKEYS), "storage_query_fetch should retrieve the records in insertion order with their values.");
+
+		status = storage_query_fetch(cursor, NULL, keys, records, NUMKEYS, test_conn);
+		fail_unless(status == 0, "storage_query_fetch should retrieve no more records at the end of the table.");
+		fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_fetch_pages)
+{
+	init_keys();
+	int cursor = storage_query_cursor(ROWTABLE, "col > -1", test_conn);
+	int status, total = 0;
+
+	do {
+		status = storage_query_fetch(cursor, "", keys, records, 7, test_conn);
+		fail_unless(status >= 0 && status <= 7, "storage_query_fetch should retrieve at most max_records records.");
+		fail_unless(records_inserted_from(total, status), "storage_query_fetch should continue after the records already retrieved.");
+		total += status;
+	} while (status == 7);
+
+	fail_unless(total == NUMKEYS, "storage_query_fetch should retrieve every record once over all the pages.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+}
+END_TEST
+
+
+START_TEST (test_fetch_mixed)
+{
+	init_keys();
+	int cursor = storage_query_cursor(COLTABLE, "col > -1", test_conn);
+
+	// Keys and records taken from the same cursor follow one another
+	int status = storage_query_next(cursor, keys, 10, test_conn);
+	fail_unless(status == 10, "storage_query_next should retrieve the first keys.");
+
+	status = storage_query_fetch(cursor, NULL, keys, records, 10, test_conn);
+	fail_unless(status == 10, "storage_query_fetch should retrieve the next records.");
+	fail_unless(records_inserted_from(10, 10), "storage_query_fetch should continue after the keys retrieved by storage_query_next.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+}
+END_TEST
+
+
+START_TEST (test_fetch_columns)
+{
+	char value[MAX_VALUE_LEN];
+	int i;
+
+	init_keys();
+	int cursor = storage_query_cursor(ROWTABLE, "col < 70", test_conn);
+	int status = storage_query_fetch(cursor, "name", keys, records, NUMKEYS, test_conn);
+
+	fail_unless(status == 70, "storage_query_fetch should only retrieve the matching records.");
+	for (i = 0; i < status; i++) {
+		sprintf(value, "name n%d", atoi(keys[i] + strlen("key")));
+		fail_unless(strcmp(records[i].value, value) == 0, "storage_query_fetch should only retrieve the columns asked for.");
+	}
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+
+	cursor = storage_query_cursor(COLTABLE, "col = 42", test_conn);
+	status = storage_query_fetch(cursor, "name, col", keys, records, NUMKEYS, test_conn);
+	fail_unless(status == 1 && strcmp(keys[0], "key042") == 0, "storage_query_fetch should retrieve the single matching record.");
+	fail_unless(strcmp(records[0].value, "name n42,col 42") == 0, "storage_query_fetch should retrieve the columns in the order asked for.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+}
+END_TEST
+
+
+START_TEST (test_fetch_metadata)
+{
+	struct storage_record record;
+
+	init_keys();
+	int cursor = storage_query_cursor(ROWTABLE, "col = 42", test_conn);
+	int status = storage_query_fetch(cursor, NULL, keys, records, NUMKEYS, test_conn);
+	fail_unless(status == 1, "storage_query_fetch should retrieve the single matching record.");
+
+	status = storage_get(ROWTABLE, keys[0], &record, test_conn);
+	fail_unless(status == 0 && record.metadata[0] == records[0].metadata[0], "storage_query_fetch should retrieve the metadata storage_get does.");
+
+	// The metadata is that of the record as fetched, so a second update with it is aborted
+	uintptr_t metadata = records[0].metadata[0];
+	strcpy(records[0].value, "col 42,name m42");
+	status = storage_set(ROWTABLE, keys[0], &records[0], test_conn);
+	fail_unless(status == 0, "storage_set with the metadata retrieved by storage_query_fetch should succeed.");
+
+	records[0].metadata[0] = metadata;
+	status = storage_set(ROWTABLE, keys[0], &records[0], test_conn);
+	fail_unless(status == -1, "storage_set with stale metadata should fail.");
+	fail_unless(errno == ERR_TRANSACTION_ABORT, "storage_set with stale metadata not setting errno properly.");
+	fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should close an open cursor.");
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of the records fetched through query cursors.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("fetch");
+	TCase *tc;
+
+	// Fetch tests with invalid parameters
+	tc = tcase_create("fetch_invalid_parameters");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_null_conn);
+	tcase_add_test(tc, test_invalid_cursor);
+	tcase_add_test(tc, test_invalid_arrays);
+	tcase_add_test(tc, test_invalid_columns);
+	tcase_add_test(tc, test_empty_table);
+	suite_add_tcase(s, tc);
+
+	// Fetch tests without authentication
+	tc = tcase_create("fetch_without_authentication");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_not_authenticated, test_teardown);
+	tcase_add_test(tc, test_not_authenticated);
+	suite_add_tcase(s, tc);
+
+	// Fetch tests with populated tables
+	tc = tcase_create("fetch_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple_populate, test_teardown);
+	tcase_add_test(tc, test_fetch_all);
+	tcase_add_test(tc, test_fetch_pages);
+	tcase_add_test(tc, test_fetch_mixed);
+	tcase_add_test(tc, test_fetch_columns);
+	tcase_add_test(tc, test_fetch_metadata);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,487 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	10		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables.
+
+#define BADTABLE	"spaced $table"	// A bad table name.
+
+#define ROWTABLE		"rowtbl"	// A table stored by rows, with an index on province.
+#define COLTABLE		"coltbl"	// A table stored by columns, with an index on province.
+#define PLAINTABLE		"plaintbl"	// A table stored by columns, without index.
+
+#define MISSINGTABLE	"missingtable"	// A non-existing table.
+
+#define NUMKEYS		600	// Keys stored in each table.
+#define NUMPROVINCES	5	// Provinces the keys are spread over.
+#define NUMSTEMS	4	// City names the keys are spread over.
+#define PREDICATESLEN	2048	// Room for the predicates built by the tests.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/// Keys array with room for all the keys a query returns.
+char key_storage[MAX_RECORDS_PER_TABLE][MAX_KEY_LEN];
+char *keys[MAX_RECORDS_PER_TABLE];
+
+
+/**
+ * @brief Points the keys array to its storage.
+ */
+void init_keys()
+{
+	int i;
+	for (i = 0; i < MAX_RECORDS_PER_TABLE; i++)
+		keys[i] = key_storage[i];
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server.
+ */
+void test_setup_simple()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	init_keys();
+}
+
+
+/// The province of each city, by its number modulo NUMPROVINCES.
+const char *provinces[NUMPROVINCES] = {"Ontario", "Quebec", "Alberta", "Manitoba", "BC"};
+
+/// The start of the name of each city, by its number modulo NUMSTEMS.
+const char *stems[NUMSTEMS] = {"Toronto", "Tor", "Ottawa", "Laval"};
+
+/// The tables holding the same cities.
+const char *tables[] = {ROWTABLE, COLTABLE, PLAINTABLE};
+
+
+/**
+ * @brief Text fixture setup.  Start the server and populate the tables.
+ *
+ * The tables hold the keys "city000" to "city599", the value of key i
+ * being "city <stems[i % NUMSTEMS]><i>,province <provinces[i % NUMPROVINCES]>,pop <i>".
+ */
+void test_setup_simple_populate()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpledata.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	init_keys();
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0, t;
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "city%03d", i);
+		record.metadata[0] = 0;
+		sprintf(record.value, "city %s%d,province %s,pop %d", stems[i % NUMSTEMS], i, provinces[i % NUMPROVINCES], i);
+		for (t = 0; t < 3; t++)
+			storage_set(tables[t], key, &record, test_conn);
+	}
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+/**
+ * @brief Counts the records of every table matching predicates.
+ * @return The number of matches if every table agrees, -2 otherwise.
+ */
+int count_matches(const char *predicates)
+{
+	int t, count = storage_query(tables[0], predicates, NULL, 0, test_conn);
+
+	for (t = 1; t < 3; t++)
+		if (storage_query(tables[t], predicates, NULL, 0, test_conn) != count)
+			return -2;
+
+	return count;
+}
+
+
+/**
+ * @brief Builds an IN list of the pops of every third city.
+ */
+void pops_list(char *predicates)
+{
+	int i;
+
+	strcpy(predicates, "pop IN (");
+	for (i = 0; i < NUMKEYS; i += 3)
+		sprintf(predicates + strlen(predicates), i == 0 ? "%d" : ", %d", i);
+	strcat(predicates, ")");
+}
+
+
+START_TEST (test_invalid_params)
+{
+	const char *predicates[] = {"province IN ()", "province IN (Ontario", "province IN (On-tario)", "province IN Ontario",
+			"province = Ontario OR pop = 5", "province < Ontario OR province = BC", "province IN (BC) OR", "province IN (BC) OR pop IN (1)"};
+	int i;
+
+	for (i = 0; i < sizeof predicates / sizeof predicates[0]; i++) {
+		int foundkeys = storage_query(ROWTABLE, predicates[i], keys, 10, test_conn);
+		fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query with a bad list or alternative should fail.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_rejected_by_server)
+{
+	const char *predicates[] = {"pop IN (1, x)", "province IN (BC, ABCDEFGHIJKL)", "country IN (Canada)", "province IN (BC), province = BC",
+			"pop = 1 OR pop = two"};
+	int t, i;
+
+	for (t = 0; t < 3; t++)
+		for (i = 0; i < sizeof predicates / sizeof predicates[0]; i++) {
+			int foundkeys = storage_query(tables[t], predicates[i], keys, 10, test_conn);
+			fail_unless(foundkeys == -1, "storage_query with a list invalid for the table should fail.");
+		}
+}
+END_TEST
+
+
+START_TEST (test_empty_table)
+{
+	fail_unless(count_matches("province IN (Ontario, BC)") == 0, "storage_query on an empty table should find no key.");
+	fail_unless(count_matches("pop = 1 OR pop = 2") == 0, "storage_query on an empty table should find no key.");
+}
+END_TEST
+
+
+START_TEST (test_lists)
+{
+	char predicates[PREDICATESLEN];
+
+	fail_unless(count_matches("province IN (Ontario, BC)") == 240, "storage_query should find the cities of listed provinces.");
+	fail_unless(count_matches("province IN (Ontario, Ontario)") == 120, "storage_query should find the cities of a value listed twice once.");
+	fail_unless(count_matches("province IN (Yukon)") == 0, "storage_query should find no city of a missing province.");
+	fail_unless(count_matches("province IN (Yukon, Quebec)") == 120, "storage_query should skip the missing values of a list.");
+	fail_unless(count_matches("province IN(  Ontario ,BC  )") == 240, "storage_query should ignore the spaces around values.");
+	fail_unless(count_matches("city IN (Toronto0, Tor1, Laval3, Laval4)") == 3, "storage_query should find the cities listed.");
+	fail_unless(count_matches("pop IN (1, 2, 3, 700, -5)") == 3, "storage_query should find the ints listed.");
+	fail_unless(count_matches("province IN (Ontario, BC), pop < 100") == 40, "storage_query should combine a list with other predicates.");
+	fail_unless(count_matches("pop < 100, province IN (Ontario, BC), city ^= Tor") == 20, "storage_query should combine a list with other predicates.");
+
+	// A list of many values is probed rather than compared value by value
+	pops_list(predicates);
+	fail_unless(count_matches(predicates) == NUMKEYS / 3, "storage_query should find the ints of a long list.");
+	strcat(predicates, ", province IN (Quebec)");
+	fail_unless(count_matches(predicates) == NUMKEYS / 15, "storage_query should combine long and short lists.");
+}
+END_TEST
+
+
+START_TEST (test_alternatives)
+{
+	fail_unless(count_matches("province = Ontario OR province = BC") == 240, "storage_query should find the cities of either province.");
+	fail_unless(count_matches("province = Ontario OR province IN (BC, Quebec)") == 360, "storage_query should join equalities and lists.");
+	fail_unless(count_matches("pop = 5 OR pop = 10 OR pop = 11, province = Ontario") == 2, "storage_query should combine alternatives with other predicates.");
+	fail_unless(count_matches("city = Toronto0 OR city = Tor") == 1, "storage_query should only find the values of the alternatives.");
+}
+END_TEST
+
+
+START_TEST (test_value_with_or)
+{
+	struct storage_record record;
+	int t;
+
+	for (t = 0; t < 3; t++) {
+		record.metadata[0] = 0;
+		strcpy(record.value, "city Tor OR Laval,province Yukon,pop 1000");
+		int status = storage_set(tables[t], "cityor", &record, test_conn);
+		fail_unless(status == 0, "Error setting a key/value pair.");
+	}
+
+	// " OR " only starts an alternative when followed by an equality or list on the same column
+	fail_unless(count_matches("city = Tor OR Laval") == 1, "storage_query should find a string holding OR.");
+	fail_unless(count_matches("city = Tor OR Laval OR city = Toronto0") == 2, "storage_query should find a string holding OR among alternatives.");
+	fail_unless(count_matches("city IN (Laval3, Tor OR Laval)") == 2, "storage_query should find a listed string holding OR.");
+	fail_unless(count_matches("city ^= Tor OR") == 1, "storage_query should find the prefix of a string holding OR.");
+	fail_unless(count_matches("city = Tor OR province = Yukon") == -1, "storage_query should reject a string holding an operator.");
+}
+END_TEST
+
+
+START_TEST (test_other_commands)
+{
+	char predicates[PREDICATESLEN];
+	double result;
+	int t, i, cursor, foundkeys, total;
+
+	for (t = 0; t < 3; t++) {
+		// The index of the province is not used for the count of a list
+		int count = storage_aggregate(tables[t], "COUNT", "pop", "province IN (Ontario, BC)", &result, test_conn);
+		fail_unless(count == 240 && result == 240, "storage_aggregate should count the cities of listed provinces.");
+		count = storage_aggregate(tables[t], "SUM", "pop", "pop IN (1, 2, 3)", &result, test_conn);
+		fail_unless(count == 3 && result == 6, "storage_aggregate should sum the ints listed.");
+
+		foundkeys = storage_query_order(tables[t], "province IN (Quebec, Manitoba)", "pop DESC", keys, 3, test_conn);
+		fail_unless(foundkeys == 3 && strcmp(keys[0], "city598") == 0 && strcmp(keys[1], "city596") == 0 && strcmp(keys[2], "city593") == 0,
+				"storage_query_order should order the cities of listed provinces.");
+
+		// The cursor keeps its list while other queries replace the plans cached by the server
+		cursor = storage_query_cursor(tables[t], "province IN (Ontario, BC)", test_conn);
+		fail_unless(cursor > 0, "storage_query_cursor with a list should succeed.");
+		for (i = 0; i < 100; i++) {
+			sprintf(predicates, "pop IN (%d, %d)", i, i + 1000);
+			fail_unless(storage_query(tables[t], predicates, keys, 1, test_conn) == 1, "storage_query should find a listed int.");
+		}
+		for (total = 0; (foundkeys = storage_query_next(cursor, keys, 100, test_conn)) > 0; total += foundkeys)
+			;
+		fail_unless(foundkeys == 0 && total == 240, "storage_query_next should list the cities of listed provinces.");
+		fail_unless(storage_query_close(cursor, test_conn) == 0, "storage_query_close should succeed.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_updates)
+{
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int t, i;
+
+	// Cached lists find the values set after they were first run
+	fail_unless(count_matches("province IN (Nunavut, BC)") == 120, "storage_query should find the cities of listed provinces.");
+
+	for (t = 0; t < 3; t++) {
+		for (i = 0; i < 10; i++) {
+			sprintf(key, "city%03d", i);
+			record.metadata[0] = 0;
+			sprintf(record.value, "city Nuuk%d,province Nunavut,pop %d", i, i);
+			int status = storage_set(tables[t], key, &record, test_conn);
+			fail_unless(status == 0, "Error setting a key/value pair.");
+		}
+		for (i = 10; i < 20; i++) {
+			sprintf(key, "city%03d", i);
+			int status = storage_set(tables[t], key, NULL, test_conn);
+			fail_unless(status == 0, "Error deleting a key.");
+		}
+	}
+
+	fail_unless(count_matches("province IN (Nunavut, BC)") == 10 + 120 - 4, "storage_query should find the cities of a new province.");
+	fail_unless(count_matches("province = Nunavut OR province = BC") == 10 + 120 - 4, "storage_query should find the cities of a new province.");
+	fail_unless(count_matches("city IN (Nuuk3, Toronto0, Laval3)") == 1, "storage_query should not find the cities moved.");
+	fail_unless(count_matches("pop IN (3, 13, 23)") == 2, "storage_query should not find the cities removed.");
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of IN lists and alternatives.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("lists");
+	TCase *tc;
+
+	// List tests with empty tables
+	tc = tcase_create("lists_empty");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_invalid_params);
+	tcase_add_test(tc, test_rejected_by_server);
+	tcase_add_test(tc, test_empty_table);
+	suite_add_tcase(s, tc);
+
+	// List tests with populated tables
+	tc = tcase_create("lists_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple_populate, test_teardown);
+	tcase_add_test(tc, test_lists);
+	tcase_add_test(tc, test_alternatives);
+	tcase_add_test(tc, test_value_with_or);
+	tcase_add_test(tc, test_other_commands);
+	tcase_add_test(tc, test_updates);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,466 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	10		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables.
+
+#define BADTABLE	"spaced $table"	// A bad table name.
+
+#define ROWTABLE		"rowtbl"	// A table stored by rows, with an index on price.
+#define COLTABLE		"coltbl"	// A table stored by columns, with an index on price.
+#define PLAINTABLE		"plaintbl"	// A table stored by rows, without index.
+
+#define MISSINGTABLE	"missingtable"	// A non-existing table.
+
+#define NUMKEYS		1000	// Keys stored in each table.
+#define NUMBRANDS	4	// Brands the keys are spread over.
+#define BADPREDICATES	"price ! 2"	// Predicates with a bad operator.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/// Keys array with room for all the keys a query returns.
+char key_storage[MAX_RECORDS_PER_TABLE][MAX_KEY_LEN];
+char *keys[MAX_RECORDS_PER_TABLE];
+
+
+/**
+ * @brief Points the keys array to its storage.
+ */
+void init_keys()
+{
+	int i;
+	for (i = 0; i < MAX_RECORDS_PER_TABLE; i++)
+		keys[i] = key_storage[i];
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server.
+ */
+void test_setup_simple()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	init_keys();
+}
+
+
+/// The brand of each car, by its number modulo NUMBRANDS.
+const char *brands[NUMBRANDS] = {"opel", "audi", "fiat", "bmw"};
+
+
+/**
+ * @brief Returns the price of car i, every price from 0 to NUMKEYS - 1 being used once.
+ */
+int price_of(int i)
+{
+	return i * 7 % NUMKEYS;
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server and populate the tables.
+ *
+ * The tables hold the keys "car000" to "car999", the value of key i
+ * being "price <price_of(i)>,brand <brands[i % NUMBRANDS]>", so the
+ * prices are not in insertion order.
+ */
+void test_setup_simple_populate()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpledata.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	init_keys();
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0;
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "car%03d", i);
+		record.metadata[0] = 0;
+		sprintf(record.value, "price %d,brand %s", price_of(i), brands[i % NUMBRANDS]);
+		storage_set(ROWTABLE, key, &record, test_conn);
+		storage_set(COLTABLE, key, &record, test_conn);
+		storage_set(PLAINTABLE, key, &record, test_conn);
+	}
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+/**
+ * @brief Checks that the keys of a query are the cars of the given prices, in order.
+ * @return 1 if they are, 0 otherwise.
+ */
+int keys_have_prices(int foundkeys, const int prices[], int num_prices)
+{
+	char key[MAX_KEY_LEN];
+	int i, car;
+
+	if (foundkeys != num_prices)
+		return 0;
+
+	for (i = 0; i < num_prices; i++) {
+		for (car = 0; price_of(car) != prices[i]; car++)
+			;
+		sprintf(key, "car%03d", car);
+		if (strcmp(keys[i], key) != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+
+START_TEST (test_invalid_params)
+{
+	int foundkeys = storage_query_order(BADTABLE, "", "price", keys, 10, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query_order with bad table name should fail.");
+	foundkeys = storage_query_order(ROWTABLE, "", NULL, keys, 10, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query_order with NULL order should fail.");
+	foundkeys = storage_query_order(ROWTABLE, "", "price UP", keys, 10, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query_order with bad direction should fail.");
+	foundkeys = storage_query_order(ROWTABLE, "", "price ASC, brand", keys, 10, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query_order with several columns should fail.");
+	foundkeys = storage_query_order(ROWTABLE, "", "price", keys, MAX_RECORDS_PER_TABLE + 1, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query_order with too many keys should fail.");
+	foundkeys = storage_query_order(ROWTABLE, "", "price", NULL, 10, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query_order with NULL keys should fail.");
+	foundkeys = storage_query_order(ROWTABLE, BADPREDICATES, "price", keys, 10, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query_order with bad predicates should fail.");
+	foundkeys = storage_query_order(ROWTABLE, NULL, "price", keys, 10, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query_order with NULL predicates should fail.");
+}
+END_TEST
+
+
+START_TEST (test_rejected_by_server)
+{
+	int foundkeys = storage_query_order(MISSINGTABLE, "", "price", keys, 10, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_TABLE_NOT_FOUND, "storage_query_order with missing table should fail.");
+	foundkeys = storage_query_order(ROWTABLE, "", "weight", keys, 10, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query_order with unknown column should fail.");
+	foundkeys = storage_query_order(ROWTABLE, "weight > 3", "price", keys, 10, test_conn);
+	fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query_order with unknown predicate column should fail.");
+}
+END_TEST
+
+
+START_TEST (test_empty_table)
+{
+	int foundkeys = storage_query_order(ROWTABLE, "", "price", keys, 10, test_conn);
+	fail_unless(foundkeys == 0, "storage_query_order on an empty table should find no key.");
+	foundkeys = storage_query_order(PLAINTABLE, "brand = audi", "price DESC", keys, 10, test_conn);
+	fail_unless(foundkeys == 0, "storage_query_order on an empty table should find no key.");
+}
+END_TEST
+
+
+START_TEST (test_cheapest)
+{
+	const int cheapest[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+	const char *tables[] = {ROWTABLE, COLTABLE, PLAINTABLE};
+	int t;
+
+	for (t = 0; t < 3; t++) {
+		int foundkeys = storage_query_order(tables[t], "", "price", keys, 10, test_conn);
+		fail_unless(keys_have_prices(foundkeys, cheapest, 10), "storage_query_order should list the cheapest cars in order.");
+		foundkeys = storage_query_order(tables[t], "", "price ASC", keys, 3, test_conn);
+		fail_unless(keys_have_prices(foundkeys, cheapest, 3), "storage_query_order should list the cheapest cars in order.");
+		foundkeys = storage_query_order(tables[t], "", "price", keys, 0, test_conn);
+		fail_unless(foundkeys == 0, "storage_query_order with no room should list no key.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_descending_with_predicates)
+{
+	// Car i is a fiat if i % 4 == 2, so its price i * 7 % 1000 is 2 modulo 4
+	const int fiats[] = {998, 994, 990, 986, 982};
+	const int cheap[] = {499, 498, 497};
+	const int dearest[] = {996, 997, 998, 999};
+	const char *tables[] = {ROWTABLE, COLTABLE, PLAINTABLE};
+	int t;
+
+	for (t = 0; t < 3; t++) {
+		int foundkeys = storage_query_order(tables[t], "brand = fiat", "price DESC", keys, 5, test_conn);
+		fail_unless(keys_have_prices(foundkeys, fiats, 5), "storage_query_order should list the dearest matching cars first.");
+		foundkeys = storage_query_order(tables[t], "price < 500", "price DESC", keys, 3, test_conn);
+		fail_unless(keys_have_prices(foundkeys, cheap, 3), "storage_query_order should list the dearest matching cars first.");
+		// Fewer cars match than there is room for
+		foundkeys = storage_query_order(tables[t], "price > 995", "price", keys, 10, test_conn);
+		fail_unless(keys_have_prices(foundkeys, dearest, 4), "storage_query_order should list every match if fewer than max_keys.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_order_by_string)
+{
+	const char *tables[] = {ROWTABLE, COLTABLE, PLAINTABLE};
+	struct storage_record record;
+	int t, i;
+
+	for (t = 0; t < 3; t++) {
+		// Brands in order are audi, bmw, fiat and opel, and the prices of audis from 903 to 999 are those equal to 3 modulo 4
+		int foundkeys = storage_query_order(tables[t], "price > 900", "brand", keys, 20, test_conn);
+		fail_unless(foundkeys == 20, "storage_query_order should find the matching keys.");
+		for (i = 0; i < foundkeys; i++) {
+			int status = storage_get(tables[t], keys[i], &record, test_conn);
+			fail_unless(status == 0, "Error getting a listed key.");
+			fail_unless(strstr(record.value, "brand audi") != NULL, "storage_query_order should list the first brand first.");
+		}
+
+		foundkeys = storage_query_order(tables[t], "", "brand DESC", keys, 1, test_conn);
+		fail_unless(foundkeys == 1, "storage_query_order should find one key.");
+		int status = storage_get(tables[t], keys[0], &record, test_conn);
+		fail_unless(status == 0 && strstr(record.value, "brand opel") != NULL, "storage_query_order should list the last brand first.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_updates)
+{
+	const char *tables[] = {ROWTABLE, COLTABLE, PLAINTABLE};
+	const int cheapest[] = {1, 2};
+	struct storage_record record;
+	int t;
+
+	for (t = 0; t < 3; t++) {
+		// A car made the cheapest is listed first, and no longer once removed
+		record.metadata[0] = 0;
+		strncpy(record.value, "price -5,brand bmw", sizeof record.value);
+		int status = storage_set(tables[t], "car500", &record, test_conn);
+		fail_unless(status == 0, "Error setting a key/value pair.");
+
+		int foundkeys = storage_query_order(tables[t], "", "price", keys, 2, test_conn);
+		fail_unless(foundkeys == 2 && strcmp(keys[0], "car500") == 0 && strcmp(keys[1], "car000") == 0,
+			"storage_query_order should list the updated car first.");
+
+		status = storage_set(tables[t], "car500", NULL, test_conn);
+		fail_unless(status == 0, "Error deleting a key.");
+		status = storage_set(tables[t], "car000", NULL, test_conn);
+		fail_unless(status == 0, "Error deleting a key.");
+
+		foundkeys = storage_query_order(tables[t], "", "price", keys, 2, test_conn);
+		fail_unless(keys_have_prices(foundkeys, cheapest, 2), "storage_query_order should not list removed cars.");
+	}
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of ordered queries.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("order");
+	TCase *tc;
+
+	// Ordered query tests with empty tables
+	tc = tcase_create("order_empty");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_invalid_params);
+	tcase_add_test(tc, test_rejected_by_server);
+	tcase_add_test(tc, test_empty_table);
+	suite_add_tcase(s, tc);
+
+	// Ordered query tests with populated tables
+	tc = tcase_create("order_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple_populate, test_teardown);
+	tcase_add_test(tc, test_cheapest);
+	tcase_add_test(tc, test_descending_with_predicates);
+	tcase_add_test(tc, test_order_by_string);
+	tcase_add_test(tc, test_updates);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
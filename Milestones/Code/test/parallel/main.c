@@ -0,0 +1,338 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables, scanned on 2 threads.
+#define SERIALTABLES_CONF		"conf-serialtables.conf"	// Server configuration file with the same tables, scanned on 1 thread.
+
+#define COLTABLE		"coltbl"	// A table stored by columns.
+
+#define NUMKEYS		200000	// Keys stored in the table, 4 morsels of 65536 rows so that a scan runs on 2 threads.
+#define MAXKEYS		256	// Keys listed by one query at most.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/// Keys array with room for all the keys a query returns.
+char key_storage[MAXKEYS][MAX_KEY_LEN];
+char *keys[MAXKEYS];
+
+
+/**
+ * @brief Start the server and populate the table.
+ *
+ * The table holds the keys "key000000" to "key199999", the value of key i
+ * being "col i,grp i%1000".
+ */
+void populate(char *config_file, char *serverout_file)
+{
+	test_conn = init_start_connect(config_file, serverout_file, NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0;
+
+	for (i = 0; i < MAXKEYS; i++)
+		keys[i] = key_storage[i];
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "key%06d", i);
+		sprintf(record.value, "col %d,grp %d", i, i % 1000);
+		record.metadata[0] = 0;
+		storage_set(COLTABLE, key, &record, test_conn);
+	}
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server scanning on 2 threads and populate the table.
+ */
+void test_setup_parallel_populate()
+{
+	populate(SIMPLETABLES_CONF, "paralleldata.serverout");
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server scanning on 1 thread and populate the table.
+ */
+void test_setup_serial_populate()
+{
+	populate(SERIALTABLES_CONF, "serialdata.serverout");
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+/**
+ * @brief Checks that a query matches the keys of rows first to last, step apart, in row order.
+ */
+void check_query(const char *predicates, int first, int last, int step)
+{
+	char key[MAX_KEY_LEN];
+	int i, count = (last - first) / step + 1;
+
+	int foundkeys = storage_query(COLTABLE, predicates, keys, MAXKEYS, test_conn);
+	fail_unless(foundkeys == count, "storage_query should count every matching key.");
+
+	for (i = 0; i < count && i < MAXKEYS; i++) {
+		sprintf(key, "key%06d", first + i * step);
+		fail_unless(strcmp(keys[i], key) == 0, "storage_query should list the matching keys in row order.");
+	}
+}
+
+
+START_TEST (test_query)
+{
+	// Matches in every morsel
+	check_query("grp = 7", 7, NUMKEYS - 1, 1000);
+
+	// The keys listed run on from the end of the first morsel into the second
+	check_query("col > 65400", 65401, NUMKEYS - 1, 1);
+
+	check_query("col > -1", 0, NUMKEYS - 1, 1);
+	check_query("col < 0", 0, -1, 1);
+}
+END_TEST
+
+
+START_TEST (test_aggregate)
+{
+	double result, sum = 0;
+	int i, matches = 0;
+
+	// Every morsel adds to the aggregates, merged once all are done
+	for (i = 0; i < NUMKEYS; i++)
+		if (i % 1000 < 500) {
+			matches++;
+			sum += i;
+		}
+
+	int count = storage_aggregate(COLTABLE, "COUNT", "col", "grp < 500", &result, test_conn);
+	fail_unless(count == matches && result == matches, "storage_aggregate should count the matching records.");
+
+	count = storage_aggregate(COLTABLE, "SUM", "col", "grp < 500", &result, test_conn);
+	fail_unless(count == matches && result == sum, "storage_aggregate should sum the matching records.");
+
+	count = storage_aggregate(COLTABLE, "MIN", "col", "grp < 500", &result, test_conn);
+	fail_unless(count == matches && result == 0, "storage_aggregate should find the least value.");
+
+	count = storage_aggregate(COLTABLE, "MAX", "col", "grp < 500", &result, test_conn);
+	fail_unless(count == matches && result == NUMKEYS - 501, "storage_aggregate should find the greatest value.");
+
+	count = storage_aggregate(COLTABLE, "AVG", "grp", "grp < 500", &result, test_conn);
+	fail_unless(count == matches && fabs(result - 249.5) < 1e-9, "storage_aggregate should average the matching records.");
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of the scans split into morsels.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("parallel");
+	TCase *tc;
+
+	// Scans on 2 threads, one per 2 morsels
+	tc = tcase_create("parallel_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_parallel_populate, test_teardown);
+	tcase_add_test(tc, test_query);
+	tcase_add_test(tc, test_aggregate);
+	suite_add_tcase(s, tc);
+
+	// The same scans on 1 thread, which must give the same results
+	tc = tcase_create("serial_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_serial_populate, test_teardown);
+	tcase_add_test(tc, test_query);
+	tcase_add_test(tc, test_aggregate);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,394 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	60		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables.
+
+#define PLAINTABLE		"plaintbl"	// A table sized by the server.
+#define SIZEDTABLE		"sizedtbl"	// A table sized in the config file, for fewer keys than NUMKEYS.
+
+#define NUMKEYS		5000	// Keys stored in each table.
+#define SURVIVORS	16	// One key in SURVIVORS is kept when deleting most keys.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/// Tables the tests are run on.
+const char *tables[] = {PLAINTABLE, SIZEDTABLE};
+
+
+/**
+ * @brief Text fixture setup.  Start the server.
+ */
+void test_setup_simple()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server and populate the tables.
+ *
+ * Both tables hold the keys "key0000" to "key4999", the value of key i
+ * being "col i".
+ */
+void test_setup_simple_populate()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpledata.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0;
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "key%04d", i);
+		sprintf(record.value, "col %d", i);
+		record.metadata[0] = 0;
+		storage_set(PLAINTABLE, key, &record, test_conn);
+		storage_set(SIZEDTABLE, key, &record, test_conn);
+	}
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+/**
+ * @brief Sets key i of a table to "col value".
+ * @return The status of storage_set.
+ */
+int set_key(const char *table, int i, int value)
+{
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+
+	sprintf(key, "key%04d", i);
+	sprintf(record.value, "col %d", value);
+	record.metadata[0] = 0;
+	return storage_set(table, key, &record, test_conn);
+}
+
+
+/**
+ * @brief Deletes key i of a table.
+ * @return The status of storage_set.
+ */
+int delete_key(const char *table, int i)
+{
+	char key[MAX_KEY_LEN];
+
+	sprintf(key, "key%04d", i);
+	return storage_set(table, key, NULL, test_conn);
+}
+
+
+/**
+ * @brief Gets key i of a table.
+ * @return The value of its col, or -1 if storage_get fails.
+ */
+int get_key(const char *table, int i)
+{
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int value;
+
+	sprintf(key, "key%04d", i);
+	if (storage_get(table, key, &record, test_conn) != 0 || sscanf(record.value, "col %d", &value) != 1)
+		return -1;
+	return value;
+}
+
+
+START_TEST (test_get_all)
+{
+	int i, t;
+
+	// Both tables grew from their initial size while being populated
+	for (t = 0; t < 2; t++)
+		for (i = 0; i < NUMKEYS; i++)
+			fail_unless(get_key(tables[t], i) == i, "storage_get should find every key set.");
+}
+END_TEST
+
+
+START_TEST (test_delete_most)
+{
+	int i, t, status;
+
+	// Deleting all but one key in SURVIVORS shrinks both tables, the sized one down to its capacity only
+	for (t = 0; t < 2; t++) {
+		for (i = 0; i < NUMKEYS; i++) {
+			if (i % SURVIVORS == 0)
+				continue;
+			status = delete_key(tables[t], i);
+			fail_unless(status == 0, "Error deleting a key.");
+		}
+
+		for (i = 0; i < NUMKEYS; i++) {
+			if (i % SURVIVORS == 0) {
+				fail_unless(get_key(tables[t], i) == i, "storage_get should find the keys left.");
+			} else {
+				fail_unless(get_key(tables[t], i) == -1, "storage_get for deleted key should fail.");
+				fail_unless(errno == ERR_KEY_NOT_FOUND, "storage_get for deleted key not setting errno properly.");
+			}
+		}
+	}
+
+	// The tables grow again when the deleted keys are set back
+	for (t = 0; t < 2; t++) {
+		for (i = 0; i < NUMKEYS; i++) {
+			if (i % SURVIVORS == 0)
+				continue;
+			status = set_key(tables[t], i, NUMKEYS + i);
+			fail_unless(status == 0, "Error setting a key/value pair.");
+		}
+
+		for (i = 0; i < NUMKEYS; i++)
+			fail_unless(get_key(tables[t], i) == (i % SURVIVORS == 0 ? i : NUMKEYS + i), "storage_get should find every key set.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_during_resize)
+{
+	int i, t, status;
+
+	// Each operation moves only a few slots to the resized array, so the keys read right after a set are
+	// often still in the old array while the newer ones are in the new one
+	for (t = 0; t < 2; t++)
+		for (i = 0; i < NUMKEYS; i++) {
+			status = set_key(tables[t], i, i);
+			fail_unless(status == 0, "Error setting a key/value pair.");
+			fail_unless(get_key(tables[t], i) == i, "storage_get should find the key just set.");
+			fail_unless(get_key(tables[t], i / 2) == i / 2, "storage_get should find the keys set before.");
+		}
+
+	// The same while shrinking, updating the keys left between deletes
+	for (t = 0; t < 2; t++)
+		for (i = 0; i < NUMKEYS; i++) {
+			if (i % SURVIVORS == 0)
+				continue;
+			status = delete_key(tables[t], i);
+			fail_unless(status == 0, "Error deleting a key.");
+			fail_unless(get_key(tables[t], i) == -1, "storage_get for deleted key should fail.");
+			fail_unless(errno == ERR_KEY_NOT_FOUND, "storage_get for deleted key not setting errno properly.");
+
+			status = set_key(tables[t], i - i % SURVIVORS, i);
+			fail_unless(status == 0, "Error setting a key/value pair.");
+			fail_unless(get_key(tables[t], i - i % SURVIVORS) == i, "storage_get should find the key just updated.");
+			fail_unless(get_key(tables[t], i / 2 - i / 2 % SURVIVORS) >= 0, "storage_get should find the keys left.");
+		}
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of the table resizing.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("resize");
+	TCase *tc;
+
+	// Resize tests with empty tables
+	tc = tcase_create("resize_empty");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_during_resize);
+	suite_add_tcase(s, tc);
+
+	// Resize tests with populated tables
+	tc = tcase_create("resize_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple_populate, test_teardown);
+	tcase_add_test(tc, test_get_all);
+	tcase_add_test(tc, test_delete_most);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
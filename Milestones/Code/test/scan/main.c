@@ -0,0 +1,491 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	10		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables.
+
+#define BADTABLE	"spaced $table"	// A bad table name.
+
+#define ORDTABLE		"ordtbl"	// A table with an ordered key index.
+#define HASHTABLE		"hashtbl"	// A table without an ordered key index.
+
+#define MISSINGTABLE	"missingtable"	// A non-existing table.
+
+#define NUMKEYS		300	// Keys stored in each table, more than one SCAN reply holds.
+#define BADKEY		"bad key"	// A bad key.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/**
+ * @brief Text fixture setup.  Start the server.
+ */
+void test_setup_simple()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server and populate the tables.
+ *
+ * Both tables hold the keys "key000" to "key299", stored out of order.
+ */
+void test_setup_simple_populate()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpledata.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0;
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	strncpy(record.value, "col 1", sizeof record.value);
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "key%03d", (i * 7) % NUMKEYS);
+		storage_set(ORDTABLE, key, &record, test_conn);
+		storage_set(HASHTABLE, key, &record, test_conn);
+	}
+}
+
+
+void test_setup_not_authenticated()
+{
+	test_conn = start_connect_not_authenticated(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+/// Keys array with room for all the keys of a table.
+char key_storage[NUMKEYS][MAX_KEY_LEN];
+char *keys[NUMKEYS];
+
+
+/**
+ * @brief Points the keys array to its storage.
+ */
+void init_keys()
+{
+	int i;
+	for (i = 0; i < NUMKEYS; i++)
+		keys[i] = key_storage[i];
+}
+
+
+/**
+ * @brief Checks that retrieved keys are consecutive keys "keyNNN".
+ * @return 1 if keys[i] is the key number first + i for all i < count, 0 otherwise.
+ */
+int keys_from(int first, int count)
+{
+	char key[MAX_KEY_LEN];
+	int i;
+	for (i = 0; i < count; i++) {
+		sprintf(key, "key%03d", first + i);
+		if (strcmp(keys[i], key) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+
+START_TEST (test_null_conn)
+{
+	init_keys();
+	int status = storage_scan(ORDTABLE, NULL, NULL, keys, NUMKEYS, NULL);
+	fail_unless(status == -1, "storage_scan with null connection should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_scan with null connection not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_null_table)
+{
+	init_keys();
+	int status = storage_scan(NULL, NULL, NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_scan with no table name provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_scan with no table name provided (null) not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_table)
+{
+	init_keys();
+	int status = storage_scan(BADTABLE, NULL, NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_scan with bad table name should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_scan with bad table name not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_bound)
+{
+	init_keys();
+	int status = storage_scan(ORDTABLE, BADKEY, NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_scan with bad key bound should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_scan with bad key bound not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_null_prefix)
+{
+	init_keys();
+	int status = storage_scan_prefix(ORDTABLE, NULL, NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_scan_prefix with no prefix provided (null) should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_scan_prefix with no prefix provided (null) not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_invalid_max_keys)
+{
+	init_keys();
+	int status = storage_scan(ORDTABLE, NULL, NULL, keys, -1, test_conn);
+	fail_unless(status == -1, "storage_scan with negative max keys should fail.");
+	fail_unless(errno == ERR_INVALID_PARAM, "storage_scan with negative max keys not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_not_authenticated)
+{
+	init_keys();
+	int status = storage_scan(ORDTABLE, NULL, NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_scan without authenticating should fail.");
+	fail_unless(errno == ERR_NOT_AUTHENTICATED, "storage_scan without authenticating not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_missing_table)
+{
+	init_keys();
+	int status = storage_scan(MISSINGTABLE, NULL, NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == -1, "storage_scan with missing table should fail.");
+	fail_unless(errno == ERR_TABLE_NOT_FOUND, "storage_scan with missing table not setting errno properly.");
+}
+END_TEST
+
+
+START_TEST (test_empty_table)
+{
+	init_keys();
+	int status = storage_scan(ORDTABLE, NULL, NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == 0, "storage_scan of an empty table should retrieve no keys.");
+}
+END_TEST
+
+
+START_TEST (test_scan_all)
+{
+	init_keys();
+	int status = storage_scan(ORDTABLE, NULL, NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == NUMKEYS, "storage_scan should retrieve all the keys of the table.");
+	fail_unless(keys_from(0, NUMKEYS), "storage_scan should retrieve the keys in order.");
+
+	status = storage_scan(HASHTABLE, NULL, NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == NUMKEYS, "storage_scan should retrieve all the keys of a table without ordered index.");
+	fail_unless(keys_from(0, NUMKEYS), "storage_scan should retrieve the keys of a table without ordered index in order.");
+}
+END_TEST
+
+
+START_TEST (test_scan_range)
+{
+	init_keys();
+	int status = storage_scan(ORDTABLE, "key099", "key120", keys, NUMKEYS, test_conn);
+	fail_unless(status == 20, "storage_scan should only retrieve the keys between its bounds.");
+	fail_unless(keys_from(100, 20), "storage_scan should retrieve the keys between its bounds in order.");
+
+	status = storage_scan(HASHTABLE, "key099", "key120", keys, NUMKEYS, test_conn);
+	fail_unless(status == 20, "storage_scan should only retrieve the keys between its bounds without ordered index.");
+	fail_unless(keys_from(100, 20), "storage_scan should retrieve the keys between its bounds in order without ordered index.");
+}
+END_TEST
+
+
+START_TEST (test_scan_pages)
+{
+	init_keys();
+	int status = storage_scan(ORDTABLE, NULL, NULL, keys, 10, test_conn);
+	fail_unless(status == 10, "storage_scan should retrieve at most max_keys keys.");
+	fail_unless(keys_from(0, 10), "storage_scan should retrieve the first keys of the table.");
+
+	status = storage_scan(ORDTABLE, keys[9], NULL, keys, 10, test_conn);
+	fail_unless(status == 10, "storage_scan should retrieve the next page of keys.");
+	fail_unless(keys_from(10, 10), "storage_scan should continue after the last key of the previous page.");
+
+	status = storage_scan(ORDTABLE, "key295", NULL, keys, 10, test_conn);
+	fail_unless(status == 4, "storage_scan should retrieve fewer keys at the end of the table.");
+	fail_unless(keys_from(296, 4), "storage_scan should retrieve the last keys of the table.");
+}
+END_TEST
+
+
+START_TEST (test_scan_prefix)
+{
+	init_keys();
+	int status = storage_scan_prefix(ORDTABLE, "key02", NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == 10, "storage_scan_prefix should only retrieve the keys with the prefix.");
+	fail_unless(keys_from(20, 10), "storage_scan_prefix should retrieve the keys with the prefix in order.");
+
+	status = storage_scan_prefix(ORDTABLE, "key02", "key024", keys, NUMKEYS, test_conn);
+	fail_unless(status == 5, "storage_scan_prefix should only retrieve the keys with the prefix after after_key.");
+	fail_unless(keys_from(25, 5), "storage_scan_prefix should retrieve the keys after after_key in order.");
+
+	status = storage_scan_prefix(HASHTABLE, "key02", NULL, keys, NUMKEYS, test_conn);
+	fail_unless(status == 10, "storage_scan_prefix should only retrieve the keys with the prefix without ordered index.");
+	fail_unless(keys_from(20, 10), "storage_scan_prefix should retrieve the keys with the prefix in order without ordered index.");
+}
+END_TEST
+
+
+START_TEST (test_scan_after_delete)
+{
+	init_keys();
+	int status = storage_set(ORDTABLE, "key101", NULL, test_conn);
+	fail_unless(status == 0, "Error deleting a key/value pair.");
+
+	status = storage_scan(ORDTABLE, "key099", "key103", keys, NUMKEYS, test_conn);
+	fail_unless(status == 2, "storage_scan should not retrieve deleted keys.");
+	fail_unless(strcmp(keys[0], "key100") == 0 && strcmp(keys[1], "key102") == 0, "storage_scan should skip deleted keys.");
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of the key scans.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("scan");
+	TCase *tc;
+
+	// Scan tests with invalid parameters
+	tc = tcase_create("scan_invalid_parameters");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_null_conn);
+	tcase_add_test(tc, test_null_table);
+	tcase_add_test(tc, test_invalid_table);
+	tcase_add_test(tc, test_invalid_bound);
+	tcase_add_test(tc, test_null_prefix);
+	tcase_add_test(tc, test_invalid_max_keys);
+	suite_add_tcase(s, tc);
+
+	// Scan tests without authentication
+	tc = tcase_create("scan_without_authentication");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_not_authenticated, test_teardown);
+	tcase_add_test(tc, test_not_authenticated);
+	suite_add_tcase(s, tc);
+
+	// Scan tests with missing table
+	tc = tcase_create("scan_missing_table");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_missing_table);
+	tcase_add_test(tc, test_empty_table);
+	suite_add_tcase(s, tc);
+
+	// Scan tests with populated tables
+	tc = tcase_create("scan_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple_populate, test_teardown);
+	tcase_add_test(tc, test_scan_all);
+	tcase_add_test(tc, test_scan_range);
+	tcase_add_test(tc, test_scan_pages);
+	tcase_add_test(tc, test_scan_prefix);
+	tcase_add_test(tc, test_scan_after_delete);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
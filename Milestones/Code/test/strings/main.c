@@ -0,0 +1,427 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	10		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables.
+
+#define BADTABLE	"spaced $table"	// A bad table name.
+
+#define ROWTABLE		"rowtbl"	// A table stored by rows, with an index on province.
+#define COLTABLE		"coltbl"	// A table stored by columns, with an index on province.
+#define PLAINTABLE		"plaintbl"	// A table stored by columns, without index.
+
+#define MISSINGTABLE	"missingtable"	// A non-existing table.
+
+#define NUMKEYS		600	// Keys stored in each table.
+#define NUMPROVINCES	5	// Provinces the keys are spread over.
+#define NUMSTEMS	4	// City names the keys are spread over.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/// Keys array with room for all the keys a query returns.
+char key_storage[MAX_RECORDS_PER_TABLE][MAX_KEY_LEN];
+char *keys[MAX_RECORDS_PER_TABLE];
+
+
+/**
+ * @brief Points the keys array to its storage.
+ */
+void init_keys()
+{
+	int i;
+	for (i = 0; i < MAX_RECORDS_PER_TABLE; i++)
+		keys[i] = key_storage[i];
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server.
+ */
+void test_setup_simple()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	init_keys();
+}
+
+
+/// The province of each city, by its number modulo NUMPROVINCES.
+const char *provinces[NUMPROVINCES] = {"Ontario", "Quebec", "Alberta", "Manitoba", "BC"};
+
+/// The start of the name of each city, by its number modulo NUMSTEMS.
+const char *stems[NUMSTEMS] = {"Toronto", "Tor", "Ottawa", "Laval"};
+
+/// The tables holding the same cities.
+const char *tables[] = {ROWTABLE, COLTABLE, PLAINTABLE};
+
+
+/**
+ * @brief Text fixture setup.  Start the server and populate the tables.
+ *
+ * The tables hold the keys "city000" to "city599", the value of key i
+ * being "city <stems[i % NUMSTEMS]><i>,province <provinces[i % NUMPROVINCES]>,pop <i>".
+ */
+void test_setup_simple_populate()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpledata.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	init_keys();
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0, t;
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "city%03d", i);
+		record.metadata[0] = 0;
+		sprintf(record.value, "city %s%d,province %s,pop %d", stems[i % NUMSTEMS], i, provinces[i % NUMPROVINCES], i);
+		for (t = 0; t < 3; t++)
+			storage_set(tables[t], key, &record, test_conn);
+	}
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+/**
+ * @brief Counts the records of every table matching predicates.
+ * @return The number of matches if every table agrees, -2 otherwise.
+ */
+int count_matches(const char *predicates)
+{
+	int t, count = storage_query(tables[0], predicates, NULL, 0, test_conn);
+
+	for (t = 1; t < 3; t++)
+		if (storage_query(tables[t], predicates, NULL, 0, test_conn) != count)
+			return -2;
+
+	return count;
+}
+
+
+START_TEST (test_invalid_params)
+{
+	const char *predicates[] = {"province <= BC", "province ^ BC", "province =^ BC", "province ^^ BC", "province ^= B-C"};
+	int i;
+
+	for (i = 0; i < sizeof predicates / sizeof predicates[0]; i++) {
+		int foundkeys = storage_query(ROWTABLE, predicates[i], keys, 10, test_conn);
+		fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query with a bad string operator should fail.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_rejected_by_server)
+{
+	int t;
+
+	for (t = 0; t < 3; t++) {
+		int foundkeys = storage_query(tables[t], "pop ^= 5", keys, 10, test_conn);
+		fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query with a prefix of an int column should fail.");
+		foundkeys = storage_query(tables[t], "province ^= ABCDEFGHIJKL", keys, 10, test_conn);
+		fail_unless(foundkeys == -1 && errno == ERR_INVALID_PARAM, "storage_query with a prefix longer than the column should fail.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_empty_table)
+{
+	fail_unless(count_matches("province < Quebec") == 0, "storage_query on an empty table should find no key.");
+	fail_unless(count_matches("city ^= Tor") == 0, "storage_query on an empty table should find no key.");
+}
+END_TEST
+
+
+START_TEST (test_ranges)
+{
+	// Provinces in order are Alberta, BC, Manitoba, Ontario and Quebec, 120 cities each
+	fail_unless(count_matches("province < Manitoba") == 240, "storage_query should find the provinces before a value.");
+	fail_unless(count_matches("province > Manitoba") == 240, "storage_query should find the provinces after a value.");
+	fail_unless(count_matches("province < Mb") == 360, "storage_query should find the provinces before a missing value.");
+	fail_unless(count_matches("province > Mb") == 240, "storage_query should find the provinces after a missing value.");
+	fail_unless(count_matches("province > Quebec") == 0, "storage_query should find no province after the last.");
+	fail_unless(count_matches("province < Alberta") == 0, "storage_query should find no province before the first.");
+	fail_unless(count_matches("province = Yukon") == 0, "storage_query should find no missing province.");
+	fail_unless(count_matches("province = Quebec") == 120, "storage_query should find the cities of a province.");
+
+	// Letters sort after digits
+	fail_unless(count_matches("city > 5") == NUMKEYS, "storage_query should compare strings made of digits as strings.");
+	fail_unless(count_matches("city > Ottawa") == 450, "storage_query should find the cities after a value.");
+	fail_unless(count_matches("city < Ottawa") == 150, "storage_query should find the cities before a value.");
+}
+END_TEST
+
+
+START_TEST (test_prefixes)
+{
+	int t, i;
+
+	// "Tor" starts both "Toronto" and "Tor" cities
+	fail_unless(count_matches("city ^= Tor") == 300, "storage_query should find the cities starting with a prefix.");
+	fail_unless(count_matches("city ^= Toronto") == 150, "storage_query should find the cities starting with a prefix.");
+	fail_unless(count_matches("city ^= Tor1") == 28, "storage_query should find the cities starting with a prefix.");
+	fail_unless(count_matches("city ^= Toronto0") == 1, "storage_query should find a city equal to a prefix.");
+	fail_unless(count_matches("city ^= Z") == 0, "storage_query should find no city of a missing prefix.");
+	fail_unless(count_matches("province ^= Ma, pop < 100") == 20, "storage_query should combine a prefix with other predicates.");
+	fail_unless(count_matches("province^=O,city^=O") == 30, "storage_query should accept a prefix without spaces.");
+
+	for (t = 0; t < 3; t++) {
+		int foundkeys = storage_query(tables[t], "city ^= Laval, province ^= B", keys, MAX_RECORDS_PER_TABLE, test_conn);
+		fail_unless(foundkeys == 30, "storage_query should find the cities starting with both prefixes.");
+		for (i = 0; i < foundkeys; i++)
+			fail_unless(strcmp(keys[i], "city019") >= 0 && (keys[i][6] - '0') % 2 == 1, "storage_query should list matching cities.");
+	}
+}
+END_TEST
+
+
+START_TEST (test_updates)
+{
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int t, i;
+
+	// New provinces fall between those already stored, and removed cities no longer match
+	for (t = 0; t < 3; t++) {
+		for (i = 0; i < 10; i++) {
+			sprintf(key, "city%03d", i);
+			record.metadata[0] = 0;
+			sprintf(record.value, "city Nuuk%d,province Nunavut,pop %d", i, i);
+			int status = storage_set(tables[t], key, &record, test_conn);
+			fail_unless(status == 0, "Error setting a key/value pair.");
+		}
+		for (i = 10; i < 20; i++) {
+			sprintf(key, "city%03d", i);
+			int status = storage_set(tables[t], key, NULL, test_conn);
+			fail_unless(status == 0, "Error deleting a key.");
+		}
+	}
+
+	fail_unless(count_matches("province ^= N") == 10, "storage_query should find the cities of a new province.");
+	fail_unless(count_matches("province > Manitoba, pop < 20") == 10, "storage_query should find the cities of a new province.");
+	fail_unless(count_matches("province = Ontario") == 120 - 4, "storage_query should not find the cities moved or removed.");
+	fail_unless(count_matches("city ^= Nuuk") == 10, "storage_query should find the new cities.");
+	fail_unless(count_matches("city < Nuuk") == 150 - 5, "storage_query should not find the cities moved or removed.");
+
+	for (t = 0; t < 3; t++) {
+		int status = storage_get(tables[t], "city003", &record, test_conn);
+		fail_unless(status == 0 && strcmp(record.value, "city Nuuk3,province Nunavut,pop 3") == 0, "storage_get should return the new value.");
+	}
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of string comparisons.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("strings");
+	TCase *tc;
+
+	// String comparison tests with empty tables
+	tc = tcase_create("strings_empty");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_invalid_params);
+	tcase_add_test(tc, test_rejected_by_server);
+	tcase_add_test(tc, test_empty_table);
+	suite_add_tcase(s, tc);
+
+	// String comparison tests with populated tables
+	tc = tcase_create("strings_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple_populate, test_teardown);
+	tcase_add_test(tc, test_ranges);
+	tcase_add_test(tc, test_prefixes);
+	tcase_add_test(tc, test_updates);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,478 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <check.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include "storage.h"
+
+#define TESTTIMEOUT	10		// How long to wait for each test to run.
+#define SERVEREXEC	"./server"	// Server executable file.
+#define SERVEROUT	"default.serverout"	// File where the server's output is stored.
+#define SERVEROUT_MODE	0666		// Permissions of the server ouptut file.
+#define SIMPLETABLES_CONF		"conf-simpletables.conf"	// Server configuration file with simple tables.
+
+#define BADTABLE	"spaced $table"	// A bad table name.
+
+#define ROWTABLE		"rowtbl"	// A table stored by rows.
+#define COLTABLE		"coltbl"	// A table stored by columns.
+
+#define MISSINGTABLE	"missingtable"	// A non-existing table.
+
+#define NUMKEYS		1000	// Keys stored in each table.
+
+// These settings should correspond to what's in the config file.
+#define SERVERHOST	"localhost"	// The hostname where the server is running.
+#define SERVERPORT	4848		// The port where the server is running.
+#define SERVERUSERNAME	"admin"		// The server username
+#define SERVERPASSWORD	"dog4sale"	// The server password
+
+
+/* Server port used by test */
+int server_port;
+
+
+/**
+ * @brief Start the storage server.
+ *
+ * @param config_file The configuration file the server should use.
+ * @param status Status info about the server (from waitpid).
+ * @param serverout_file File where server output is stored.
+ * @return Return server process id on success, or -1 otherwise.
+ */
+int start_server(char *config_file, int *status, const char *serverout_file)
+{
+	sleep(1);       // Give the OS enough time to kill previous process
+
+	pid_t childpid = fork();
+	if (childpid < 0) {
+		// Failed to create child.
+		return -1;
+	} else if (childpid == 0) {
+		// The child.
+
+		// Redirect stdout and stderr to a file.
+		const char *outfile = serverout_file == NULL ? SERVEROUT : serverout_file;
+		//int outfd = creat(outfile, SERVEROUT_MODE);
+		int outfd = open(outfile, O_CREAT|O_WRONLY, SERVEROUT_MODE);
+		close(STDOUT_FILENO);
+		close(STDERR_FILENO);
+		if (dup2(outfd, STDOUT_FILENO) < 0 || dup2(outfd, STDERR_FILENO) < 0) {
+			perror("dup2 error");
+			return -1;
+		}
+
+		// Start the server
+		execl(SERVEREXEC, SERVEREXEC, config_file, NULL);
+
+		// Should never get here.
+		perror("Couldn't start server");
+		exit(EXIT_FAILURE);
+	} else {
+		// The parent.
+
+		// If the child terminates quickly, then there was probably a
+		// problem running the server (e.g., config file not found).
+		sleep(1);
+		int pid = waitpid(childpid, status, WNOHANG);
+		//printf("Parent returned %d with child status %d\n", pid, WEXITSTATUS(*status));
+		if (pid == childpid)
+			return -1; // Probably a problem starting the server.
+		else
+			return childpid; // Probably ok.
+	}
+}
+
+
+/**
+ * @brief Start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	// Authenticate with the server.
+	int status = storage_auth(SERVERUSERNAME,
+				  SERVERPASSWORD,
+				  //SERVERPUBLICKEY,
+				      conn);
+	fail_unless(status == 0, "Authentication failed.");
+
+	return conn;
+}
+
+
+void* start_connect_not_authenticated(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Start the server.
+	int pid = start_server(config_file, NULL, serverout_file);
+	fail_unless(pid > 0, "Server didn't run properly.");
+	if (serverpid != NULL)
+		*serverpid = pid;
+
+	// Connect to the server.
+	void *conn = storage_connect(SERVERHOST, server_port);
+	fail_unless(conn != NULL, "Couldn't connect to server.");
+
+	return conn;
+}
+
+
+/**
+ * @brief Delete the data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* clean_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Create an empty data directory, start the server, and connect to it.
+ * @return A connection to the server if successful.
+ */
+void* init_start_connect(char *config_file, char *serverout_file, int *serverpid)
+{
+	// Delete the data directory.
+//	system("rm -rf " DATADIR);
+	
+	// Create the data directory.
+//	mkdir(DATADIR, 0777);
+
+	return start_connect(config_file, serverout_file, serverpid);
+}
+
+
+/**
+ * @brief Kill the server with given pid.
+ * @return 0 on success, -1 on error.
+ */
+int kill_server(int pid)
+{
+	int status = kill(pid, SIGKILL);
+	fail_unless(status == 0, "Couldn't kill server.");
+	return status;
+}
+
+
+/// Connection used by test fixture.
+void *test_conn = NULL;
+
+
+/// Keys array with room for all the keys a query returns.
+char key_storage[MAX_RECORDS_PER_TABLE][MAX_KEY_LEN];
+char *keys[MAX_RECORDS_PER_TABLE];
+
+
+/**
+ * @brief Points the keys array to its storage.
+ */
+void init_keys()
+{
+	int i;
+	for (i = 0; i < MAX_RECORDS_PER_TABLE; i++)
+		keys[i] = key_storage[i];
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server.
+ */
+void test_setup_simple()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpleempty.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+}
+
+
+/**
+ * @brief Text fixture setup.  Start the server and populate the tables.
+ *
+ * Both tables hold the keys "key000" to "key999", the value of key i
+ * being "col i,name even" or "col i,name odd".
+ */
+void test_setup_simple_populate()
+{
+	test_conn = init_start_connect(SIMPLETABLES_CONF, "simpledata.serverout", NULL);
+	fail_unless(test_conn != NULL, "Couldn't start or connect to server.");
+	init_keys();
+
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i = 0;
+
+	// Do a bunch of sets (don't bother checking for error).
+
+	for (i = 0; i < NUMKEYS; i++) {
+		sprintf(key, "key%03d", i);
+		sprintf(record.value, "col %d,name %s", i, i % 2 == 0 ? "even" : "odd");
+		storage_set(ROWTABLE, key, &record, test_conn);
+		storage_set(COLTABLE, key, &record, test_conn);
+	}
+}
+
+
+/**
+ * @brief Text fixture teardown.  Disconnect from the server.
+ */
+void test_teardown()
+{
+	// Disconnect from the server.
+	storage_disconnect(test_conn);
+	//fail_unless(status == 0, "Error disconnecting from the server.");
+}
+
+
+/**
+ * @brief Reads one statistic from the value returned by storage_stats.
+ * @return The statistic, or -1 if it is missing.
+ */
+long stat_value(const char *stats, const char *name)
+{
+	char pattern[MAX_COLNAME_LEN + 2];
+	sprintf(pattern, "%s ", name);
+
+	const char *p = stats;
+	while ((p = strstr(p, pattern)) != NULL) {
+		// Only match whole names
+		if (p == stats || p[-1] == ',')
+			return atol(p + strlen(pattern));
+		p++;
+	}
+	return -1;
+}
+
+
+/**
+ * @brief Counts the keys of a query listed by a cursor, a few at a time.
+ * @return The number of keys, or -1 on error.
+ */
+int cursor_count(const char *table, const char *predicates, int batch)
+{
+	int cursor = storage_query_cursor(table, predicates, test_conn);
+	int found, total = 0;
+
+	if (cursor < 0)
+		return -1;
+	while ((found = storage_query_next(cursor, keys, batch, test_conn)) > 0)
+		total += found;
+	storage_query_close(cursor, test_conn);
+
+	return found < 0 ? -1 : total;
+}
+
+
+START_TEST (test_empty_table)
+{
+	struct storage_record record;
+	int status = storage_stats(ROWTABLE, &record, test_conn);
+	fail_unless(status == 0, "storage_stats with valid parameters should not fail.");
+	fail_unless(stat_value(record.value, "blocksRead") == 0, "storage_stats should count no block read before any scan.");
+	fail_unless(stat_value(record.value, "blocksSkipped") == 0, "storage_stats should count no block skipped before any scan.");
+}
+END_TEST
+
+
+START_TEST (test_skip_blocks)
+{
+	struct storage_record record;
+
+	// The rows are in ascending order of col, so only the last two blocks of 64 rows may match
+	int foundkeys = storage_query(ROWTABLE, "col > 900", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == NUMKEYS - 901, "storage_query should find the matching keys.");
+
+	int status = storage_stats(ROWTABLE, &record, test_conn);
+	fail_unless(status == 0, "storage_stats with valid parameters should not fail.");
+	fail_unless(stat_value(record.value, "blocksRead") == 2, "storage_stats should count the blocks compared.");
+	fail_unless(stat_value(record.value, "blocksSkipped") == 14, "storage_stats should count the blocks skipped.");
+
+	foundkeys = storage_query(COLTABLE, "name = odd, col < 100", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 50, "storage_query should find the matching keys.");
+
+	status = storage_stats(COLTABLE, &record, test_conn);
+	fail_unless(status == 0, "storage_stats with valid parameters should not fail.");
+	fail_unless(stat_value(record.value, "blocksRead") == 2, "storage_stats should count the blocks compared.");
+	fail_unless(stat_value(record.value, "blocksSkipped") == 14, "storage_stats should count the blocks skipped.");
+}
+END_TEST
+
+
+START_TEST (test_skip_string_blocks)
+{
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i, status;
+
+	// Each name sorts between "odd" and the names before it, which soon leaves no free code and gives all the names new codes
+	for (i = 0; i < 40; i++) {
+		sprintf(key, "key%03d", 960 + i);
+		sprintf(record.value, "col %d,name oz%c%c", 960 + i, 'z' - i / 26, 'z' - i % 26);
+		status = storage_set(ROWTABLE, key, &record, test_conn);
+		fail_unless(status == 0, "Error setting a key/value pair.");
+		status = storage_set(COLTABLE, key, &record, test_conn);
+		fail_unless(status == 0, "Error setting a key/value pair.");
+	}
+
+	int foundkeys = storage_query(ROWTABLE, "name > odd", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 40, "storage_query should find the new names.");
+
+	// The codes of the table stored by columns are bounded per block as well, so only the last block may match
+	foundkeys = storage_query(COLTABLE, "name > odd", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 40, "storage_query should find the new names.");
+
+	status = storage_stats(COLTABLE, &record, test_conn);
+	fail_unless(status == 0, "storage_stats with valid parameters should not fail.");
+	fail_unless(stat_value(record.value, "blocksRead") == 1, "storage_stats should count the blocks compared.");
+	fail_unless(stat_value(record.value, "blocksSkipped") == 15, "storage_stats should count the blocks skipped.");
+
+	foundkeys = storage_query(COLTABLE, "name IN (ozzz, ozyy)", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 2, "storage_query should find the listed names.");
+	foundkeys = storage_query(COLTABLE, "name = even", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 480, "storage_query should find the names left.");
+
+	status = storage_stats(COLTABLE, &record, test_conn);
+	fail_unless(status == 0, "storage_stats with valid parameters should not fail.");
+	fail_unless(stat_value(record.value, "blocksRead") == 18, "storage_stats should count the blocks compared.");
+	fail_unless(stat_value(record.value, "blocksSkipped") == 30, "storage_stats should count the blocks skipped.");
+}
+END_TEST
+
+
+START_TEST (test_widen_on_update)
+{
+	struct storage_record record;
+
+	// A value moved out of the bounds of its block widens them
+	strncpy(record.value, "col 5000,name even", sizeof record.value);
+	int status = storage_set(ROWTABLE, "key000", &record, test_conn);
+	fail_unless(status == 0, "Error setting a key/value pair.");
+	status = storage_set(COLTABLE, "key000", &record, test_conn);
+	fail_unless(status == 0, "Error setting a key/value pair.");
+
+	int foundkeys = storage_query(ROWTABLE, "col > 4000", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 1 && strcmp(keys[0], "key000") == 0, "storage_query should find the updated record.");
+	foundkeys = storage_query(COLTABLE, "col > 4000", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 1 && strcmp(keys[0], "key000") == 0, "storage_query should find the updated record.");
+
+	// Bounds are not narrowed, so the old value no longer matches but its block is still read
+	foundkeys = storage_query(ROWTABLE, "col < 1", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 0, "storage_query should not find the old value of the updated record.");
+	foundkeys = storage_query(COLTABLE, "col = 0", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 0, "storage_query should not find the old value of the updated record.");
+}
+END_TEST
+
+
+START_TEST (test_removed_records)
+{
+	struct storage_record record;
+	char key[MAX_KEY_LEN];
+	int i, status;
+
+	// Removing most records compacts the tables, moving the rows left to other blocks
+	for (i = 0; i < NUMKEYS; i++) {
+		if (i % 10 == 0)
+			continue;
+		sprintf(key, "key%03d", i);
+		status = storage_set(ROWTABLE, key, NULL, test_conn);
+		fail_unless(status == 0, "Error deleting a key.");
+		status = storage_set(COLTABLE, key, NULL, test_conn);
+		fail_unless(status == 0, "Error deleting a key.");
+	}
+
+	int foundkeys = storage_query(ROWTABLE, "col > 900", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 9, "storage_query should find the matching records left.");
+	foundkeys = storage_query(COLTABLE, "col > 900", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 9, "storage_query should find the matching records left.");
+
+	// Records added after the compaction extend the last blocks
+	for (i = 0; i < 100; i++) {
+		sprintf(key, "new%03d", i);
+		sprintf(record.value, "col %d,name new", 2000 + i);
+		status = storage_set(ROWTABLE, key, &record, test_conn);
+		fail_unless(status == 0, "Error setting a key/value pair.");
+		status = storage_set(COLTABLE, key, &record, test_conn);
+		fail_unless(status == 0, "Error setting a key/value pair.");
+	}
+
+	foundkeys = storage_query(ROWTABLE, "col > 900", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 109, "storage_query should find the records added.");
+	foundkeys = storage_query(COLTABLE, "col > 900", keys, MAX_RECORDS_PER_TABLE, test_conn);
+	fail_unless(foundkeys == 109, "storage_query should find the records added.");
+}
+END_TEST
+
+
+START_TEST (test_aggregate_and_cursor)
+{
+	double result;
+	int count = storage_aggregate(ROWTABLE, "SUM", "col", "col > 990", &result, test_conn);
+	fail_unless(count == 9 && result == 8955, "storage_aggregate should sum the matching records.");
+	count = storage_aggregate(COLTABLE, "MAX", "col", "col < 70", &result, test_conn);
+	fail_unless(count == 70 && result == 69, "storage_aggregate should aggregate the matching records.");
+
+	// Cursors resume within blocks, which are still skipped or read whole
+	fail_unless(cursor_count(ROWTABLE, "col > 900", 7) == NUMKEYS - 901, "A cursor should list every matching key.");
+	fail_unless(cursor_count(COLTABLE, "col < 130", 9) == 130, "A cursor should list every matching key.");
+	fail_unless(cursor_count(COLTABLE, "col = 500", 1) == 1, "A cursor should list every matching key.");
+}
+END_TEST
+
+
+/**
+ * @brief This runs the tests of the zone maps.
+ */
+int main(int argc, char *argv[])
+{
+	if(argc == 2)
+		server_port = atoi(argv[1]);
+	else
+		server_port = SERVERPORT;
+	printf("Using server port: %d.\n", server_port);
+	Suite *s = suite_create("zonemap");
+	TCase *tc;
+
+	// Zone map tests with empty tables
+	tc = tcase_create("zonemap_empty");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple, test_teardown);
+	tcase_add_test(tc, test_empty_table);
+	suite_add_tcase(s, tc);
+
+	// Zone map tests with populated tables
+	tc = tcase_create("zonemap_populated");
+	tcase_set_timeout(tc, TESTTIMEOUT);
+	tcase_add_checked_fixture(tc, test_setup_simple_populate, test_teardown);
+	tcase_add_test(tc, test_skip_blocks);
+	tcase_add_test(tc, test_skip_string_blocks);
+	tcase_add_test(tc, test_widen_on_update);
+	tcase_add_test(tc, test_removed_records);
+	tcase_add_test(tc, test_aggregate_and_cursor);
+	suite_add_tcase(s, tc);
+
+	SRunner *sr = srunner_create(s);
+	srunner_set_log(sr, "results.log");
+	srunner_run_all(sr, CK_ENV);
+	srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return EXIT_SUCCESS;
+}